@@ -0,0 +1,268 @@
+/* Copyright (c) 2020, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim
+ * <https://bbpcode.epfl.ch/browse/code/viz/EMSim/>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+
+#include <boost/program_options.hpp>
+
+#include <emSim/Events.h>
+#include <emSim/Kernels.h>
+#include <emSim/QuantizedEvents.h>
+#include <emSim/ThreadPool.h>
+
+/**
+ * Times the volume and sample points kernels of every available backend on
+ * synthetic events, to compare the ISPC and C++ implementations on the
+ * current machine.
+ */
+struct BenchmarkParams
+{
+    size_t nEvents = 100000u;
+    size_t nFrames = 4u;
+    uint32_t volumeSize = 64u;
+    uint32_t nSamplePoints = 1024u;
+    size_t repetitions = 3u;
+    ems::ThreadPoolConfig threadPool;
+};
+
+bool parseArgs(BenchmarkParams& params, int argc, char* argv[])
+{
+    namespace po = boost::program_options;
+    po::options_description desc("");
+
+    // clang-format off
+    desc.add_options()
+        ("help,h", "Print this help message.\n")
+        ("events", po::value<size_t>(&params.nEvents)->default_value(params.nEvents), "Number of random events.")
+        ("frames", po::value<size_t>(&params.nFrames)->default_value(params.nFrames), "Number of frames of the "
+         "multi-frame kernels.")
+        ("volume-size", po::value<uint32_t>(&params.volumeSize)->default_value(params.volumeSize),
+         "Number of voxels along each dimension of the volume.")
+        ("sample-points", po::value<uint32_t>(&params.nSamplePoints)->default_value(params.nSamplePoints),
+         "Number of sample points.")
+        ("repetitions", po::value<size_t>(&params.repetitions)->default_value(params.repetitions),
+         "Number of runs of each kernel, the fastest one is reported.")
+        ("threads", po::value<size_t>(&params.threadPool.threads), "The number of threads. Default is the "
+         "EMSIM_THREADS environment variable if set, one per CPU otherwise.")
+        ("pin-threads", "Pin each thread to a CPU.");
+    // clang-format on
+
+    po::variables_map vm;
+
+    try
+    {
+        params.threadPool = ems::ThreadPoolConfig::fromEnvironment();
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+
+        if (vm.count("help"))
+        {
+            std::cout << desc << std::endl;
+            return false;
+        }
+        po::notify(vm);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl << std::endl;
+        std::cout << desc << std::endl;
+        return false;
+    }
+
+    if (vm.count("pin-threads"))
+        params.threadPool.pinThreads = true;
+
+    return true;
+}
+
+void report(const std::string& name, const size_t repetitions,
+            const double interactions, const std::function<void()>& kernel)
+{
+    ems::ThreadPool& pool = ems::ThreadPool::getInstance();
+    double best = std::numeric_limits<double>::max();
+    double imbalance = 1.0;
+    for (size_t i = 0; i < repetitions; ++i)
+    {
+        pool.resetStats();
+        const auto start = std::chrono::high_resolution_clock::now();
+        kernel();
+        const std::chrono::duration<double> elapsed =
+            std::chrono::high_resolution_clock::now() - start;
+        if (elapsed.count() >= best)
+            continue;
+        best = elapsed.count();
+
+        // Busiest thread against the average one
+        double maxTime = 0.0;
+        double totalTime = 0.0;
+        for (const auto& stats : pool.getStats())
+        {
+            maxTime = std::max(maxTime, stats.busyTime);
+            totalTime += stats.busyTime;
+        }
+        if (totalTime > 0.0)
+            imbalance = maxTime * pool.getThreadsCount() / totalTime;
+    }
+    std::cout << "  " << std::left << std::setw(24) << name << std::right
+              << std::setw(10) << std::fixed << std::setprecision(2)
+              << best * 1000.0 << " ms " << std::setw(10)
+              << interactions / best * 1e-9 << " G interactions/s, imbalance "
+              << imbalance << std::endl;
+}
+
+void run(const BenchmarkParams& params)
+{
+    ems::ThreadPool::getInstance().configure(params.threadPool);
+    std::cout << "Threads: " << ems::ThreadPool::getInstance().getDescription()
+              << std::endl;
+
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> radius(1.0f, 5.0f);
+    std::uniform_real_distribution<float> power(-1.0f, 1.0f);
+
+    ems::Events events(params.nEvents, params.nFrames);
+    for (size_t i = 0; i < params.nEvents; ++i)
+        events.addEvent(glm::vec3(position(generator), position(generator),
+                                  position(generator)),
+                        radius(generator));
+    for (size_t j = 0; j < params.nFrames; ++j)
+        for (size_t i = 0; i < params.nEvents; ++i)
+            events.getPowers(j)[i] = power(generator);
+
+    const uint32_t size = params.volumeSize;
+    const float voxelSize = 1000.0f / size;
+    const uint32_t nEvents = uint32_t(params.nEvents);
+    const uint32_t nFrames = uint32_t(params.nFrames);
+    const uint64_t stride = events.getPaddedEventsCount();
+    std::vector<std::vector<float>> volumes(
+        nFrames, std::vector<float>(size_t(size) * size * size));
+    std::vector<float*> volumesData;
+    for (auto& volume : volumes)
+        volumesData.push_back(volume.data());
+    std::vector<uint16_t> halfVolume(size_t(size) * size * size);
+
+    ems::QuantizedEvents quantizedEvents(events, ems::Precision::fp16);
+    quantizedEvents.update(events);
+    const auto computeQuantizedVolume = [&](const ems::Precision precision) {
+        const bool fp32 = precision == ems::Precision::fp32;
+        ems::kernels::computeQuantizedVolume(
+            quantizedEvents.getPositionsX(), quantizedEvents.getPositionsY(),
+            quantizedEvents.getPositionsZ(), quantizedEvents.getBlocks(),
+            quantizedEvents.getRadii(), quantizedEvents.getPowers(),
+            uint32_t(ems::Precision::fp16), quantizedEvents.getPowersScale(),
+            nEvents, fp32 ? volumesData[0] : nullptr,
+            fp32 ? nullptr : halfVolume.data(), uint32_t(precision), size,
+            size, size, voxelSize, voxelSize, voxelSize, -500.0f, -500.0f,
+            -500.0f, false);
+    };
+
+    const uint32_t nPoints = params.nSamplePoints;
+    std::vector<float> spPosX(nPoints), spPosY(nPoints), spPosZ(nPoints);
+    for (size_t i = 0; i < nPoints; ++i)
+    {
+        spPosX[i] = position(generator);
+        spPosY[i] = position(generator);
+        spPosZ[i] = position(generator);
+    }
+    std::vector<float> spValues(size_t(nPoints) * nFrames);
+    std::vector<float> matrix(size_t(nPoints) * stride);
+
+    const double voxelInteractions = double(size) * size * size * nEvents;
+    const double pointInteractions = double(nPoints) * nEvents;
+
+    std::vector<ems::KernelsBackend> backends;
+    if (ems::hasISPCKernels())
+        backends.push_back(ems::KernelsBackend::ispc);
+    backends.push_back(ems::KernelsBackend::cpp);
+
+    for (const auto backend : backends)
+    {
+        ems::setKernelsBackend(backend);
+        std::cout << ems::getKernelsDescription() << std::endl;
+
+        report("volume", params.repetitions, voxelInteractions, [&] {
+            ems::kernels::computeVolume(
+                events.getPositionsX(), events.getPositionsY(),
+                events.getPositionsZ(), events.getRadii(), events.getPowers(),
+                nEvents, volumesData[0], size, size, size, voxelSize,
+                voxelSize, voxelSize, -500.0f, -500.0f, -500.0f);
+        });
+        report("volume tiles", params.repetitions, voxelInteractions, [&] {
+            ems::kernels::computeVolumeTiles(
+                events.getPositionsX(), events.getPositionsY(),
+                events.getPositionsZ(), events.getRadii(), events.getPowers(),
+                nEvents, volumesData[0], size, size, size, voxelSize,
+                voxelSize, voxelSize, -500.0f, -500.0f, -500.0f, 32u, 8u, 4u,
+                1024u, false);
+        });
+        report("volume fp16 events", params.repetitions, voxelInteractions,
+               [&] { computeQuantizedVolume(ems::Precision::fp32); });
+        report("volume fp16 voxels", params.repetitions, voxelInteractions,
+               [&] { computeQuantizedVolume(ems::Precision::fp16); });
+        report("volume frames", params.repetitions,
+               voxelInteractions * nFrames, [&] {
+                   ems::kernels::computeVolumeFrames(
+                       events.getPositionsX(), events.getPositionsY(),
+                       events.getPositionsZ(), events.getRadii(),
+                       events.getPowers(), nEvents, stride, nFrames,
+                       volumesData.data(), size, size, size, voxelSize,
+                       voxelSize, voxelSize, -500.0f, -500.0f, -500.0f);
+               });
+        report("sample points", params.repetitions, pointInteractions, [&] {
+            ems::kernels::computeSamplePoints(
+                events.getPositionsX(), events.getPositionsY(),
+                events.getPositionsZ(), events.getRadii(), events.getPowers(),
+                nEvents, 0u, spPosX.data(), spPosY.data(), spPosZ.data(),
+                spValues.data(), nPoints);
+        });
+        report("transfer matrix", params.repetitions, pointInteractions, [&] {
+            ems::kernels::computeTransferMatrix(
+                events.getPositionsX(), events.getPositionsY(),
+                events.getPositionsZ(), events.getRadii(), nEvents,
+                spPosX.data(), spPosY.data(), spPosZ.data(), nPoints,
+                matrix.data());
+        });
+        report("apply transfer matrix", params.repetitions,
+               pointInteractions * nFrames, [&] {
+                   ems::kernels::applyTransferMatrix(
+                       matrix.data(), nPoints, nEvents, events.getPowers(),
+                       stride, nFrames, spValues.data());
+               });
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    BenchmarkParams params;
+    if (parseArgs(params, argc, argv))
+    {
+        run(params);
+        return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,137 @@
+/* Copyright (c) 2020, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim
+ * <https://bbpcode.epfl.ch/browse/code/viz/EMSim/>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <emSim/FileWriter.h>
+#include <emSim/VolumeCodec.h>
+
+/**
+ * Decompresses the .emz volumes written by emsimLFP and emsimVSD with
+ * --error-bound or --relative-error to raw floats files with their MetaImage
+ * headers, the offset of the header being the origin of the volume in the
+ * circuit. The info text files written next to the .emz files still apply.
+ */
+namespace
+{
+struct DecodeParams
+{
+    std::vector<std::string> inputFiles;
+};
+
+bool parseArgs(DecodeParams& params, int argc, char* argv[])
+{
+    namespace po = boost::program_options;
+    po::options_description desc("");
+
+    // clang-format off
+    desc.add_options()
+        ("help,h", "Print this help message.\n")
+        ("input,i", po::value<std::vector<std::string>>(&params.inputFiles)->required()->composing(),
+         "The compressed volumes, each one decompressed to a .raw and a .mhd file next to it.");
+    // clang-format on
+
+    po::positional_options_description positional;
+    positional.add("input", -1);
+
+    po::variables_map vm;
+
+    try
+    {
+        po::store(po::command_line_parser(argc, argv)
+                      .options(desc)
+                      .positional(positional)
+                      .run(),
+                  vm);
+
+        if (vm.count("help"))
+        {
+            std::cout << desc << std::endl;
+            return false;
+        }
+        po::notify(vm);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl << std::endl;
+        std::cout << desc << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void decode(const std::string& inputFile)
+{
+    std::ifstream input(inputFile, std::ios::in | std::ios::binary);
+    if (!input)
+        throw std::runtime_error("error: Cannot open " + inputFile);
+    const std::string data((std::istreambuf_iterator<char>(input)),
+                           std::istreambuf_iterator<char>());
+
+    std::vector<float> values;
+    const ems::CompressedVolumeInfo info =
+        ems::decompressVolume(data.data(), data.size(), values);
+
+    std::string outputFile = inputFile;
+    const size_t extension = outputFile.rfind(".emz");
+    if (extension != std::string::npos && extension + 4 == outputFile.size())
+        outputFile.resize(extension);
+    const std::string rawFileName = outputFile + ".raw";
+    ems::writeFloatsFile(rawFileName, values.data(), values.size(), nullptr);
+
+    const std::string header = ems::createMhdHeader(
+        {info.size.x, info.size.y, info.size.z},
+        {info.voxelSize.x, info.voxelSize.y, info.voxelSize.z},
+        {info.origin.x, info.origin.y, info.origin.z}, rawFileName);
+    ems::writeTextFile(outputFile + ".mhd", header, nullptr);
+
+    std::cout << "INFO: " << inputFile << ": " << info.size.x << "x" << info.size.y << "x"
+              << info.size.z << " voxels, ratio "
+              << double(sizeof(float) * values.size()) / data.size() << ", error bound "
+              << info.errorBound << ", written to " << rawFileName << std::endl;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    DecodeParams params;
+    if (!parseArgs(params, argc, argv))
+        return 1;
+
+    try
+    {
+        for (const std::string& inputFile : params.inputFiles)
+            decode(inputFile);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
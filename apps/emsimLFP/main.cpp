@@ -19,15 +19,29 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <limits>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/program_options.hpp>
 
-#include <emSim/ComputeVolume.h>
+#include <emSim/CellMultipoles.h>
+#include <emSim/CompactEvents.h>
+#include <emSim/Kernels.h>
 #include <emSim/EventsLoader.h>
+#include <emSim/FFTVolume.h>
+#include <emSim/FileWriter.h>
+#include <emSim/HDF5Output.h>
+#include <emSim/IncrementalEvents.h>
+#include <emSim/MappedStack.h>
+#include <emSim/Memory.h>
+#include <emSim/Octree.h>
+#include <emSim/Precision.h>
+#include <emSim/QuantizedEvents.h>
 #include <emSim/SamplePoints.h>
+#include <emSim/ThreadPool.h>
 #include <emSim/Volume.h>
 
 namespace std
@@ -46,16 +60,99 @@ std::istream& operator>>(std::istream& in, glm::vec3& position)
 
     return in;
 }
+
+std::istream& operator>>(std::istream& in, glm::uvec3& size)
+{
+    std::string arg;
+    in >> arg;
+
+    std::vector<std::string> parts;
+    boost::split(parts, arg, boost::is_any_of(","));
+
+    size.x = boost::lexical_cast<uint32_t>(parts[0]);
+    size.y = boost::lexical_cast<uint32_t>(parts[1]);
+    size.z = boost::lexical_cast<uint32_t>(parts[2]);
+
+    return in;
+}
 }
 
-void computeLFP(const ems::Events& events, std::shared_ptr<ems::Volume> volume)
+/** Voxels tile and events chunk sizes of the cache blocked volume kernel */
+struct VolumeTiling
 {
-    ispc::ComputeVolume_ispc(events.getFlatPositions(), events.getRadii(),
-                             events.getPowers(), events.getEventsCount(),
-                             volume->getData(), volume->getSize().x, volume->getSize().y,
-                             volume->getSize().z, volume->getVoxelSize().x, volume->getVoxelSize().y,
-                             volume->getVoxelSize().z, volume->getOrigin().x, volume->getOrigin().y, 
-                             volume->getOrigin().y);
+    glm::uvec3 tileSize = glm::uvec3(32u, 8u, 4u);
+    uint32_t eventsChunkSize = 1024u;
+};
+
+template <typename EventsT>
+void computeLFP(const EventsT& events, const size_t nFrames,
+                const std::vector<std::shared_ptr<ems::Volume>>& volumes,
+                const VolumeTiling& tiling)
+{
+    const ems::Volume& volume = *volumes.front();
+    if (nFrames == 1)
+    {
+        ems::kernels::computeVolumeTiles(events.getPositionsX(), events.getPositionsY(),
+                                         events.getPositionsZ(), events.getRadii(),
+                                         events.getPowers(), events.getEventsCount(),
+                                         volumes.front()->getData(), volume.getSize().x,
+                                         volume.getSize().y, volume.getSize().z,
+                                         volume.getVoxelSize().x, volume.getVoxelSize().y,
+                                         volume.getVoxelSize().z, volume.getOrigin().x,
+                                         volume.getOrigin().y, volume.getOrigin().z,
+                                         tiling.tileSize.x, tiling.tileSize.y, tiling.tileSize.z,
+                                         tiling.eventsChunkSize, false);
+        return;
+    }
+
+    std::vector<float*> volumesData;
+    for (size_t i = 0; i < nFrames; ++i)
+        volumesData.push_back(volumes[i]->getData());
+
+    ems::kernels::computeVolumeFrames(events.getPositionsX(), events.getPositionsY(),
+                                      events.getPositionsZ(), events.getRadii(),
+                                      events.getPowers(), events.getEventsCount(),
+                                      events.getPaddedEventsCount(), nFrames,
+                                      volumesData.data(), volume.getSize().x, volume.getSize().y,
+                                      volume.getSize().z, volume.getVoxelSize().x, volume.getVoxelSize().y,
+                                      volume.getVoxelSize().z, volume.getOrigin().x, volume.getOrigin().y,
+                                      volume.getOrigin().z);
+}
+
+void computeLFP(const ems::IncrementalEvents& events, ems::Volume& volume,
+                const VolumeTiling& tiling)
+{
+    ems::kernels::computeVolumeTiles(events.getPositionsX(), events.getPositionsY(),
+                                     events.getPositionsZ(), events.getRadii(), events.getPowers(),
+                                     events.getEventsCount(), volume.getData(), volume.getSize().x,
+                                     volume.getSize().y, volume.getSize().z, volume.getVoxelSize().x,
+                                     volume.getVoxelSize().y, volume.getVoxelSize().z,
+                                     volume.getOrigin().x, volume.getOrigin().y, volume.getOrigin().z,
+                                     tiling.tileSize.x, tiling.tileSize.y, tiling.tileSize.z,
+                                     tiling.eventsChunkSize, !events.isFullRefresh());
+}
+
+void reportApproximation(const std::string& name, const ems::Octree::Stats& stats,
+                         const ems::Octree::Error& error, const bool hasError)
+{
+    std::cout << "INFO: Octree " << name << ": " << 100.0 * stats.getWorkRatio()
+              << "% of the exact interactions";
+    if (hasError)
+        std::cout << ", max error " << error.maxError << ", RMS error " << error.rmsError
+                  << " for a RMS value of " << error.rmsValue;
+    std::cout << std::endl;
+}
+
+void reportPrecision(const ems::QuantizedEvents::Error& error)
+{
+    std::cout << "INFO: Reduced precision volume: max error " << error.maxError << ", RMS error "
+              << error.rmsError << " for a RMS value of " << error.rmsValue << std::endl;
+}
+
+void reportMultipoles(const std::string& name, const float exactRatio)
+{
+    std::cout << "INFO: Cell multipoles " << name << ": " << 100.0 * exactRatio
+              << "% of the cells evaluated exactly" << std::endl;
 }
 
 struct EmsimParams
@@ -69,7 +166,44 @@ struct EmsimParams
     glm::vec3 voxelSize = glm::vec3(4.0f, 4.0f, 4.0f);
     glm::vec3 extent = glm::vec3(0.0f, 0.0f, 0.0f);
     bool exportVolume = false;
+    bool outputStack = false;
+    bool hdf5 = false;
+    std::string hdf5Chunks = "1,0,0,0";
+    ems::HDF5Config hdf5Config;
+    bool compress = false;
+    ems::CodecConfig codec;
     float fraction = 1.0f;
+    bool transferMatrix = false;
+    size_t framesPerBlock = 64u;
+    size_t maxMatrixSize = 1024u;
+    size_t framesPerBatch = 1u;
+    size_t prefetchDepth = 2u;
+    size_t writeBuffers = 2u;
+    size_t writeThreads = 4u;
+    float openingAngle = 0.0f;
+    bool dipoles = false;
+    size_t errorSamples = 1000u;
+    bool fftVolume = false;
+    uint32_t nearFieldVoxels = 2u;
+    float multipolesCutoff = 0.0f;
+    bool incremental = false;
+    float deltaThreshold = 0.0f;
+    size_t refreshPeriod = 100u;
+    bool sparse = false;
+    float sparseTolerance = 0.0f;
+    size_t lowRank = 0u;
+    size_t lowRankOversampling = 10u;
+    bool spatialOrder = false;
+    bool mergeEvents = true;
+    VolumeTiling tiling;
+    std::string kernels;
+    ems::ThreadPoolConfig threadPool;
+    ems::MemoryConfig memory;
+    std::string hugePages;
+    ems::Precision eventsPrecision = ems::Precision::fp32;
+    ems::Precision volumePrecision = ems::Precision::fp32;
+    std::string eventsPrecisionName;
+    std::string volumePrecisionName;
 };
 
 bool parseArgs(EmsimParams& params, int argc, char* argv[])
@@ -89,21 +223,123 @@ bool parseArgs(EmsimParams& params, int argc, char* argv[])
         ("fraction", po::value<float>(&params.fraction), "Specify the fraction [0.0 1.0] of gids to be used "
          "during the computation. Default is 1.0.")
         ("export-volume", "Will export a floating point volume for each time step.\n")
+        ("output-stack", "Write the volumes of all the time steps to a single memory mapped raw file with a 4D "
+         "MetaImage header, instead of one pair of files per time step.")
+        ("hdf5", "Write the volumes and the sample points to datasets of a single HDF5 file, with the "
+         "simulation's provenance as attributes, instead of raw and text files.")
+        ("hdf5-chunks", po::value<std::string>(&params.hdf5Chunks)->default_value(params.hdf5Chunks),
+         "The chunk shape of the HDF5 datasets as frames,x,y,z, 0 meaning the whole dimension. "
+         "1,0,0,0 suits reading whole frames, e.g. 256,8,8,8 suits reading time series, at the cost "
+         "of keeping that many frames in memory.")
+        ("hdf5-compression", po::value<int>(&params.hdf5Config.compression)
+             ->default_value(params.hdf5Config.compression),
+         "The deflate level [0 9] of the HDF5 datasets, 0 for none. The chunks are compressed in "
+         "parallel by --write-threads threads, in the background of the computations.")
+        ("error-bound", po::value<float>(&params.codec.errorBound),
+         "Compress the volumes with this maximum absolute error, in the units of the volumes, to "
+         ".emz files read back by emsimDecode.")
+        ("relative-error", po::value<float>(),
+         "Compress the volumes with a maximum error of this fraction of the value range of each "
+         "volume, e.g. 1e-3, to .emz files read back by emsimDecode.")
         ("voxel-size", po::value<glm::vec3>(&params.voxelSize), "The size in each dimension "
          "of a voxel in circuit units. Default is 4.0,4.0,4.0. Must be written in the form: "
          "--voxel-size rx,ry,rz")
         ("volume-extent", po::value<glm::vec3>(&params.extent), "Specify an additional 3d extent for the "
          "volume in micrometers. Default is 0.0,0.0,0.0. Must be written in the form: "
          "--volume-extent ex,ey,ez")
+        ("kernels", po::value<std::string>(&params.kernels),
+         "The implementation of the kernels, ispc or cpp. Default is the EMSIM_KERNELS environment "
+         "variable if set, ispc if compiled in, cpp otherwise.")
+        ("threads", po::value<size_t>(&params.threadPool.threads),
+         "The number of threads. Default is the EMSIM_THREADS environment variable if set, one per "
+         "CPU otherwise.")
+        ("pin-threads", "Pin each thread to a CPU. Also enabled by EMSIM_PIN_THREADS=1.")
+        ("no-smt", "Use a single hardware thread per core. Also enabled by EMSIM_SMT=0.")
+        ("huge-pages", po::value<std::string>(&params.hugePages),
+         "The pages of the large buffers: none, transparent or hugetlb (reserved huge pages). Default "
+         "is the EMSIM_HUGE_PAGES environment variable if set, none otherwise.")
+        ("volume-tile", po::value<glm::uvec3>(&params.tiling.tileSize),
+         "The number of voxels in each dimension of the tiles computed against a chunk of events at "
+         "once. 0 covers the whole dimension. Default is 32,8,4. Must be written in the form: "
+         "--volume-tile tx,ty,tz")
+        ("events-chunk", po::value<uint32_t>(&params.tiling.eventsChunkSize)
+             ->default_value(params.tiling.eventsChunkSize),
+         "The number of events kept in cache while a tile of voxels is computed. 0 uses all the "
+         "events at once.")
+        ("frames-per-batch", po::value<size_t>(&params.framesPerBatch)->default_value(params.framesPerBatch),
+         "The number of frames loaded and computed at once. Every voxel to event distance is reused for "
+         "all the frames of a batch, at the cost of one volume in memory per frame.")
+        ("prefetch-depth", po::value<size_t>(&params.prefetchDepth)->default_value(params.prefetchDepth),
+         "The number of batches of frames read from the report in the background while the current "
+         "batch is computed. 0 reads every batch when it is needed.")
+        ("write-buffers", po::value<size_t>(&params.writeBuffers)->default_value(params.writeBuffers),
+         "The number of output volumes written to disk in the background while the next frames are "
+         "computed, each one costing a volume in memory. 0 writes every volume before going on.")
+        ("write-threads", po::value<size_t>(&params.writeThreads)->default_value(params.writeThreads),
+         "The number of threads writing the chunks of the output files in parallel.")
         ("sample-point", po::value<std::vector<glm::vec3>>(&params.samplePointsPos)->composing(),
          "The x y z positions of a sample point. Must be written in the form: "
-         "--sample-point x,y,z");
+         "--sample-point x,y,z")
+        ("opening-angle", po::value<float>(&params.openingAngle)->default_value(params.openingAngle),
+         "Approximate the events with a Barnes-Hut octree, nodes seen under a smaller angle than this "
+         "value are evaluated from their moments. 0 computes the exact sum.")
+        ("dipoles", "Use the dipole moments of the octree nodes in addition to the monopoles.")
+        ("error-samples", po::value<size_t>(&params.errorSamples)->default_value(params.errorSamples),
+         "The number of voxels or sample points compared with the exact sum to report the error "
+         "of the octree approximation or of the reduced precisions. 0 disables the report.")
+        ("cell-multipoles", po::value<float>(&params.multipolesCutoff)->default_value(params.multipolesCutoff),
+         "Reduce the compartments of each cell to their monopole, dipole and quadrupole moments about "
+         "the soma. Cells closer than this distance in micrometers are still computed exactly. 0 "
+         "disables the multipoles.")
+        ("fft-volume", "Compute the volume as an FFT convolution of the events deposited on the voxel grid.")
+        ("near-field-voxels", po::value<uint32_t>(&params.nearFieldVoxels)->default_value(params.nearFieldVoxels),
+         "Half size of the cube of voxels around each event computed exactly with --fft-volume. 0 disables "
+         "the correction.")
+        ("low-rank", po::value<size_t>(&params.lowRank)->default_value(params.lowRank),
+         "Decompose the currents of all the frames into this number of basis vectors, compute the "
+         "outputs of the basis vectors only and combine them for every frame. 0 disables the "
+         "decomposition, which takes precedence over the other approximations.")
+        ("low-rank-oversampling", po::value<size_t>(&params.lowRankOversampling)
+             ->default_value(params.lowRankOversampling),
+         "The number of additional random samples used to find the basis vectors with --low-rank.")
+        ("spatial-order", "Sort the events along a Morton curve of the circuit for a better locality "
+         "of the computations. The outputs do not depend on the events' order.")
+        ("no-merge-events", "Keep the events of a cell having the same position and radius, e.g. the "
+         "compartments of a soma, separate instead of summing their powers into a single event.")
+        ("events-precision", po::value<std::string>(&params.eventsPrecisionName),
+         "The storage of the events used for the volume: fp32, or fp16 or bf16 powers with positions "
+         "quantized on 16 bits in blocks of events. The sums are always done in fp32. Only used with "
+         "the exact sum. Default is fp32.")
+        ("volume-precision", po::value<std::string>(&params.volumePrecisionName),
+         "The storage of the voxels: fp32, fp16 or bf16. The files always hold fp32 values. fp16 and "
+         "bf16 need --events-precision fp16 or bf16. Default is fp32.")
+        ("sparse", "Skip the inactive events of every frame. Only used with the exact sum.")
+        ("sparse-tolerance", po::value<float>(&params.sparseTolerance)->default_value(params.sparseTolerance),
+         "The absolute power, relative to the maximum absolute power of the frame, below which an event "
+         "is skipped with --sparse. 0 only skips the events with a null power.")
+        ("incremental", "Update the outputs of the previous frame with the events whose power changed "
+         "instead of recomputing them. Only used with the exact sum, frames are computed one at a time.")
+        ("delta-threshold", po::value<float>(&params.deltaThreshold)->default_value(params.deltaThreshold),
+         "The minimal absolute power change of an event to be applied with --incremental. The "
+         "error of an output value grows with the number of events, up to Ec * threshold * "
+         "sum(1 / max(distance, radius)).")
+        ("refresh-period", po::value<size_t>(&params.refreshPeriod)->default_value(params.refreshPeriod),
+         "The number of frames between two full recomputations with --incremental. 0 only computes the "
+         "first frame from scratch.")
+        ("transfer-matrix", "Compute the sample points as a matrix product of a precomputed "
+         "transfer matrix with blocks of frames.")
+        ("frames-per-block", po::value<size_t>(&params.framesPerBlock)->default_value(params.framesPerBlock),
+         "The number of frames evaluated at once in transfer matrix mode.")
+        ("max-matrix-size", po::value<size_t>(&params.maxMatrixSize)->default_value(params.maxMatrixSize),
+         "The maximum size in MB of the transfer matrix. Bigger matrices are computed in blocks of events.");
     // clang-format on
 
     po::variables_map vm;
 
     try
     {
+        params.threadPool = ems::ThreadPoolConfig::fromEnvironment();
+        params.memory = ems::MemoryConfig::fromEnvironment();
         po::store(po::parse_command_line(argc, argv, desc), vm);
 
         if (vm.count("help"))
@@ -123,49 +359,528 @@ bool parseArgs(EmsimParams& params, int argc, char* argv[])
     if (vm.count("export-volume"))
         params.exportVolume = true;
 
+    if (vm.count("output-stack"))
+        params.outputStack = true;
+
+    if (vm.count("error-bound") || vm.count("relative-error"))
+    {
+        if (vm.count("error-bound") && vm.count("relative-error"))
+        {
+            std::cerr << "Error: --error-bound and --relative-error are exclusive" << std::endl;
+            return false;
+        }
+        if (vm.count("relative-error"))
+        {
+            params.codec.errorBound = vm["relative-error"].as<float>();
+            params.codec.relative = true;
+        }
+        if (params.codec.errorBound < 0.0f)
+        {
+            std::cerr << "Error: the error bound must be positive" << std::endl;
+            return false;
+        }
+        if (params.outputStack || vm.count("hdf5"))
+        {
+            std::cerr << "Error: the compressed volumes can not be written to --output-stack "
+                         "or --hdf5"
+                      << std::endl;
+            return false;
+        }
+        params.compress = true;
+    }
+
+    if (vm.count("hdf5"))
+    {
+        params.hdf5 = true;
+        try
+        {
+            ems::parseHDF5Chunks(params.hdf5Chunks, params.hdf5Config);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
+        params.hdf5Config.compression = std::max(std::min(params.hdf5Config.compression, 9), 0);
+        params.hdf5Config.threads = std::max(params.writeThreads, size_t(1));
+        if (params.outputStack)
+        {
+            std::cerr << "Error: --hdf5 and --output-stack are exclusive" << std::endl;
+            return false;
+        }
+    }
+
+    if (vm.count("transfer-matrix"))
+        params.transferMatrix = true;
+
+    if (vm.count("dipoles"))
+        params.dipoles = true;
+
+    if (vm.count("fft-volume"))
+        params.fftVolume = true;
+
+    if (vm.count("incremental"))
+        params.incremental = true;
+
+    if (vm.count("sparse"))
+        params.sparse = true;
+
+    if (vm.count("spatial-order"))
+        params.spatialOrder = true;
+
+    if (vm.count("no-merge-events"))
+        params.mergeEvents = false;
+
+    if (vm.count("pin-threads"))
+        params.threadPool.pinThreads = true;
+
+    if (vm.count("no-smt"))
+        params.threadPool.useSMT = false;
+
+    if (vm.count("huge-pages"))
+    {
+        try
+        {
+            params.memory.hugePages = ems::parseHugePages(params.hugePages);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    try
+    {
+        if (vm.count("events-precision"))
+            params.eventsPrecision = ems::parsePrecision(params.eventsPrecisionName);
+        if (vm.count("volume-precision"))
+            params.volumePrecision = ems::parsePrecision(params.volumePrecisionName);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+
+    if (params.volumePrecision != ems::Precision::fp32 &&
+        params.eventsPrecision == ems::Precision::fp32)
+    {
+        std::cerr << "Error: --volume-precision " << params.volumePrecisionName
+                  << " needs --events-precision fp16 or bf16" << std::endl;
+        return false;
+    }
+
+    if (params.eventsPrecision != ems::Precision::fp32 &&
+        (params.openingAngle > 0.0f || params.fftVolume || params.multipolesCutoff > 0.0f ||
+         params.incremental || params.sparse || params.lowRank > 0u))
+    {
+        std::cerr << "Error: --events-precision is only supported by the exact sum" << std::endl;
+        return false;
+    }
+
     return true;
 }
 
+// Destinations of the volumes and sample points
+struct Output
+{
+    std::unique_ptr<ems::FileWriter> writer;
+    std::unique_ptr<ems::HDF5Output> hdf5;
+    std::unique_ptr<ems::MappedStack> stack;
+    size_t volumeDataset = 0u;
+    ems::CodecStats codecStats;
+};
+
+void createOutput(const EmsimParams& params, const ems::EventsLoader& eventLoader, Output& output)
+{
+    if (params.writeBuffers > 0u && !params.hdf5)
+        output.writer.reset(new ems::FileWriter(params.writeBuffers, params.writeThreads));
+    if (!params.hdf5)
+        return;
+
+    output.hdf5.reset(new ems::HDF5Output(params.outputFile + ".h5", params.hdf5Config));
+    std::string voltUnit = eventLoader.getDataUnit();
+    std::replace(voltUnit.begin(), voltUnit.end(), 'A', 'V');
+    output.hdf5->setAttribute("/", "Generator", "EMSim tool");
+    output.hdf5->setAttribute("/", "BlueConfig", params.inputFile);
+    output.hdf5->setAttribute("/", "Target", params.target);
+    output.hdf5->setAttribute("/", "Report", params.report);
+    output.hdf5->setAttribute("/", "Units", voltUnit);
+    output.hdf5->setAttribute("/", "TimeRange", std::vector<double>{eventLoader.getTimeRange().x,
+                                                                    eventLoader.getTimeRange().y});
+    output.hdf5->setAttribute("/", "TimeStep", std::vector<double>{eventLoader.getDt()});
+    std::cout << "INFO: Output to " << params.outputFile << ".h5" << std::endl;
+}
+
+void createVolumeOutput(const EmsimParams& params, const ems::Volume& volume,
+                        const ems::EventsLoader& eventLoader, Output& output)
+{
+    if (output.hdf5)
+        output.volumeDataset =
+            volume.createDataset(*output.hdf5, "volume", eventLoader.getFramesCount());
+    else if (params.outputStack)
+        output.stack = volume.createStack(eventLoader.getTimeRange().x, eventLoader.getDt(),
+                                          eventLoader.getFramesCount(), eventLoader.getDataUnit(),
+                                          params.outputFile, params.inputFile, params.report,
+                                          params.target);
+}
+
+void writeVolume(const EmsimParams& params, ems::Volume& volume,
+                 const ems::EventsLoader& eventLoader, const size_t frame, Output& output)
+{
+    if (output.hdf5)
+        volume.writeToHDF5(*output.hdf5, output.volumeDataset, frame);
+    else if (output.stack)
+        volume.writeToStack(*output.stack, frame);
+    else if (params.compress)
+        output.codecStats += volume.writeToFileCompressed(
+            eventLoader.getTimeRange().x + frame * eventLoader.getDt(), eventLoader.getDt(),
+            eventLoader.getDataUnit(), params.outputFile, params.inputFile, params.report,
+            params.target, params.codec, output.writer.get());
+    else
+        volume.writeToFile(eventLoader.getTimeRange().x + frame * eventLoader.getDt(),
+                           eventLoader.getDt(), eventLoader.getDataUnit(), params.outputFile,
+                           params.inputFile, params.report, params.target, output.writer.get());
+}
+
+void writeSamplePoints(const EmsimParams& params, ems::SamplePoints& samplePoints,
+                       const ems::EventsLoader& eventLoader, Output& output)
+{
+    if (output.hdf5)
+        samplePoints.writeToHDF5(*output.hdf5, eventLoader.getTimeRange(), eventLoader.getDt(),
+                                 eventLoader.getDataUnit());
+    else
+        samplePoints.writeToFile(eventLoader.getTimeRange(), eventLoader.getDt(),
+                                 eventLoader.getDataUnit(), params.outputFile, params.inputFile,
+                                 params.report, params.target, output.writer.get());
+}
+
+void finishOutput(Output& output)
+{
+    if (output.stack)
+        output.stack->flush();
+
+    if (output.codecStats.bytes > 0u)
+        std::cout << "INFO: Compression: " << output.codecStats.bytes << " bytes stored in "
+                  << output.codecStats.storedBytes << ", ratio " << output.codecStats.getRatio()
+                  << ", max error " << output.codecStats.maxError << std::endl;
+
+    if (output.hdf5)
+    {
+        output.hdf5->flush();
+        const ems::HDF5Stats stats = output.hdf5->getStats();
+        std::cout << "INFO: HDF5 output: " << stats.chunks << " chunks, " << stats.bytes
+                  << " bytes stored in " << stats.storedBytes << ", " << stats.stallTime
+                  << " s waiting for the queue" << std::endl;
+    }
+
+    if (!output.writer)
+        return;
+
+    output.writer->flush();
+    const ems::WriteStats stats = output.writer->getStats();
+    std::cout << "INFO: Output: " << stats.files << " files, " << stats.bytes << " bytes, "
+              << stats.writeTime << " s writing, " << stats.stallTime << " s waiting for a buffer"
+              << std::endl;
+}
+
+void processLowRank(const EmsimParams& params, ems::EventsLoader& eventLoader,
+                    Output& output)
+{
+    const ems::LowRankPowers lowRank =
+        eventLoader.computeLowRankPowers(params.lowRank, params.lowRankOversampling);
+    std::cout << "INFO: Low rank decomposition: " << lowRank.getRank()
+              << " basis vectors, relative error " << lowRank.getRelativeError() << std::endl;
+
+    const ems::Events& events = eventLoader.getLoadedFrame();
+    const size_t rank = lowRank.getRank();
+
+    if (!params.samplePointsPos.empty())
+    {
+        ems::SamplePoints samplePoints(eventLoader.getFramesCount(), params.samplePointsPos);
+        samplePoints.computeFrames(events, lowRank);
+        writeSamplePoints(params, samplePoints, eventLoader, output);
+    }
+
+    if (!params.exportVolume)
+        return;
+
+    std::vector<std::shared_ptr<ems::Volume>> basisVolumes;
+    std::vector<float*> basisData;
+    for (size_t k = 0; k < rank; ++k)
+    {
+        basisVolumes.emplace_back(
+            new ems::Volume(params.voxelSize, params.extent, eventLoader.getCircuitAABB()));
+        basisData.push_back(basisVolumes.back()->getData());
+    }
+    ems::Volume volume(params.voxelSize, params.extent, eventLoader.getCircuitAABB());
+    const glm::uvec3& size = volume.getSize();
+
+    if (rank > 0)
+        ems::kernels::computeVolumeFrames(events.getPositionsX(), events.getPositionsY(),
+                                          events.getPositionsZ(), events.getRadii(),
+                                          lowRank.getBasis(), events.getEventsCount(),
+                                          lowRank.getPaddedEventsCount(), rank,
+                                          basisData.data(), size.x, size.y, size.z,
+                                          volume.getVoxelSize().x, volume.getVoxelSize().y,
+                                          volume.getVoxelSize().z, volume.getOrigin().x,
+                                          volume.getOrigin().y, volume.getOrigin().z);
+
+    createVolumeOutput(params, volume, eventLoader, output);
+    const std::vector<const float*> basis(basisData.begin(), basisData.end());
+    for (size_t i = 0; i < eventLoader.getFramesCount(); ++i)
+    {
+        lowRank.reconstruct(basis, size_t(size.x) * size.y * size.z, i, volume.getData());
+        writeVolume(params, volume, eventLoader, i, output);
+    }
+}
+
 void process(const EmsimParams& params)
 {
+    if (!params.kernels.empty())
+        ems::setKernelsBackend(ems::parseKernelsBackend(params.kernels));
+    std::cout << "INFO: Kernels: " << ems::getKernelsDescription() << std::endl;
+    ems::ThreadPool::getInstance().configure(params.threadPool);
+    std::cout << "INFO: Threads: " << ems::ThreadPool::getInstance().getDescription() << std::endl;
+    ems::setMemoryConfig(params.memory);
+
     ems::EventsLoader eventLoader(params.inputFile, params.target, params.report,
-                                  params.timeRange, params.fraction);
+                                  params.timeRange, params.fraction, params.spatialOrder,
+                                  params.mergeEvents, params.prefetchDepth);
+
+    Output output;
+    createOutput(params, eventLoader, output);
+
+    if (params.lowRank > 0u)
+    {
+        processLowRank(params, eventLoader, output);
+        finishOutput(output);
+        return;
+    }
+
+    const bool incremental = params.incremental && params.openingAngle <= 0.0f &&
+                             params.multipolesCutoff <= 0.0f && !params.fftVolume;
 
     std::unique_ptr<ems::SamplePoints> samplePoints;
-    std::shared_ptr<ems::Volume> volume;
+    std::vector<std::shared_ptr<ems::Volume>> volumes;
 
     if (!params.samplePointsPos.empty())
+    {
         samplePoints.reset(new ems::SamplePoints(eventLoader.getFramesCount(),
                                                  params.samplePointsPos));
+        if (params.transferMatrix && params.openingAngle <= 0.0f &&
+            params.multipolesCutoff <= 0.0f && !incremental)
+            samplePoints->useTransferMatrix(params.framesPerBlock,
+                                            params.maxMatrixSize << 20);
+    }
+
+    const size_t framesPerBatch = params.exportVolume && !incremental
+                                      ? std::max(params.framesPerBatch, size_t(1))
+                                      : 1u;
 
     if (params.exportVolume)
-        volume.reset(
-            new ems::Volume(params.voxelSize, params.extent, eventLoader.getCircuitAABB()));
+    {
+        for (size_t i = 0; i < framesPerBatch; ++i)
+            volumes.emplace_back(new ems::Volume(params.voxelSize, params.extent,
+                                                 eventLoader.getCircuitAABB(),
+                                                 params.volumePrecision));
+
+        const ems::Volume& volume = *volumes.front();
+        const void* data = volume.getData() ? (const void*)volume.getData()
+                                            : (const void*)volume.getHalfData();
+        std::cout << "INFO: Volume memory: "
+                  << ems::getMemoryPlacement(data, volume.getDataSize()).getDescription()
+                  << std::endl;
+    }
+    if (params.exportVolume)
+        createVolumeOutput(params, *volumes.front(), eventLoader, output);
+
+    std::unique_ptr<ems::Octree> octree;
+    if (params.openingAngle > 0.0f)
+        octree.reset(new ems::Octree(eventLoader.getLoadedFrame(), params.openingAngle,
+                                     params.dipoles));
+    const bool reportError = params.errorSamples > 0u;
+
+    std::unique_ptr<ems::FFTVolume> fftVolume;
+    if (params.exportVolume && params.fftVolume)
+        fftVolume.reset(new ems::FFTVolume(*volumes.front(), eventLoader.getLoadedFrame(),
+                                           params.nearFieldVoxels));
+
+    std::unique_ptr<ems::CellMultipoles> multipoles;
+    if (params.multipolesCutoff > 0.0f)
+        multipoles.reset(new ems::CellMultipoles(eventLoader.getLoadedFrame(),
+                                                 eventLoader.getCellsEvents(),
+                                                 params.multipolesCutoff));
+
+    std::unique_ptr<ems::IncrementalEvents> incrementalEvents;
+    if (incremental)
+        incrementalEvents.reset(new ems::IncrementalEvents(eventLoader.getLoadedFrame(),
+                                                           params.deltaThreshold,
+                                                           params.refreshPeriod));
 
-    for (uint32_t i = 0; i < eventLoader.getFramesCount(); ++i)
+    std::unique_ptr<ems::CompactEvents> compactEvents;
+    if (params.sparse && !incremental)
+        compactEvents.reset(new ems::CompactEvents(eventLoader.getLoadedFrame(),
+                                                   params.sparseTolerance));
+    const bool compactSamplePoints = !params.transferMatrix;
+
+    std::unique_ptr<ems::QuantizedEvents> quantizedEvents;
+    if (params.exportVolume && params.eventsPrecision != ems::Precision::fp32)
+    {
+        const ems::Events& events = eventLoader.getLoadedFrame();
+        quantizedEvents.reset(new ems::QuantizedEvents(events, params.eventsPrecision));
+        std::cout << "INFO: Quantized events: " << ems::getPrecisionName(params.eventsPrecision)
+                  << " powers, " << quantizedEvents->getDataSize() << " bytes instead of "
+                  << events.getPaddedEventsCount() * 5u * sizeof(float)
+                  << ", max position error " << quantizedEvents->getPositionError() << std::endl;
+    }
+
+    for (uint32_t i = 0; i < eventLoader.getFramesCount(); i += framesPerBatch)
     {
-        const ems::Events& events = eventLoader.loadNextFrame();
+        const ems::Events& events = eventLoader.loadNextFrames(framesPerBatch);
+        const size_t nFrames = eventLoader.getLoadedFramesCount();
+
+        if (incrementalEvents)
+        {
+            incrementalEvents->update(events);
+            std::cout << "INFO: Incremental update: " << 100.0 * incrementalEvents->getSelectedRatio()
+                      << "% of the events" << (incrementalEvents->isFullRefresh() ? " (full refresh)" : "")
+                      << std::endl;
 
-        if(!params.samplePointsPos.empty())
-            samplePoints->computeNextFrame(events);
+            if (!params.samplePointsPos.empty())
+                samplePoints->computeNextFrame(*incrementalEvents);
+
+            if (params.exportVolume)
+                computeLFP(*incrementalEvents, *volumes.front(), params.tiling);
+        }
+        else if (!octree && !fftVolume && !multipoles)
+        {
+            if (compactEvents)
+            {
+                compactEvents->update(events, nFrames);
+                std::cout << "INFO: Sparse events: " << 100.0 * compactEvents->getCompactionRatio()
+                          << "% of the events are active" << std::endl;
+            }
+
+            if(!params.samplePointsPos.empty())
+            {
+                for (size_t j = 0; j < nFrames; ++j)
+                {
+                    if (compactEvents && compactSamplePoints)
+                        samplePoints->computeNextFrame(*compactEvents, j);
+                    else
+                        samplePoints->computeNextFrame(events, j);
+                }
+            }
+
+            if (quantizedEvents)
+            {
+                quantizedEvents->update(events, nFrames);
+                for (size_t j = 0; j < nFrames; ++j)
+                {
+                    quantizedEvents->computeVolume(*volumes[j], j);
+                    if (reportError)
+                        reportPrecision(quantizedEvents->estimateError(events, j, *volumes[j],
+                                                                       params.errorSamples));
+                }
+            }
+            else if(params.exportVolume)
+            {
+                if (compactEvents)
+                    computeLFP(*compactEvents, nFrames, volumes, params.tiling);
+                else
+                    computeLFP(events, nFrames, volumes, params.tiling);
+            }
+        }
+        else
+        {
+            for (size_t j = 0; j < nFrames; ++j)
+            {
+                if (octree)
+                    octree->update(events, j);
+                if (multipoles)
+                    multipoles->update(events, j);
+                ems::Octree::Error error;
+
+                if (!params.samplePointsPos.empty())
+                {
+                    if (octree)
+                    {
+                        const auto stats = samplePoints->computeNextFrame(*octree);
+                        const size_t count = samplePoints->getSamplePointsCount();
+                        if (reportError)
+                            error = octree->estimateError(samplePoints->getPositionsX(),
+                                                          samplePoints->getPositionsY(),
+                                                          samplePoints->getPositionsZ(), count,
+                                                          samplePoints->getValues() + (i + j) * count,
+                                                          params.errorSamples);
+                        reportApproximation("sample points", stats, error, reportError);
+                    }
+                    else if (multipoles)
+                        reportMultipoles("sample points",
+                                         samplePoints->computeNextFrame(*multipoles, events, j));
+                    else
+                        samplePoints->computeNextFrame(events, j);
+                }
+
+                if (params.exportVolume)
+                {
+                    if (fftVolume)
+                        fftVolume->compute(events, *volumes[j], j);
+                    else if (multipoles)
+                        reportMultipoles("volume",
+                                         multipoles->computeVolume(events, *volumes[j], j));
+                    else
+                    {
+                        const auto stats = octree->computeVolume(*volumes[j]);
+                        if (reportError)
+                            error = octree->estimateError(*volumes[j], params.errorSamples);
+                        reportApproximation("volume", stats, error, reportError);
+                    }
+                }
+            }
+        }
 
         if(params.exportVolume)
         {
-            computeLFP(events, volume);
-            volume->writeToFile(eventLoader.getTimeRange().x +
-                                    i * eventLoader.getDt(), eventLoader.getDt(),
-                                eventLoader.getDataUnit(), params.outputFile,
-                                params.inputFile, params.report, params.target);
+            for (size_t j = 0; j < nFrames; ++j)
+                writeVolume(params, *volumes[j], eventLoader, i + j, output);
         }
     }
 
+    const ems::LoadStats& loadStats = eventLoader.getLoadStats();
+    std::cout << "INFO: Report loading: " << loadStats.batches << " batches, " << loadStats.stalls
+              << " stalls, " << loadStats.stallTime << " s waiting" << std::endl;
+
     if (!params.samplePointsPos.empty())
+        writeSamplePoints(params, *samplePoints, eventLoader, output);
+    finishOutput(output);
+}
+
+void reportThreadsLoad()
+{
+    const std::vector<ems::ThreadStats> stats = ems::ThreadPool::getInstance().getStats();
+    double minTime = std::numeric_limits<double>::max();
+    double maxTime = 0.0;
+    double totalTime = 0.0;
+    size_t tasks = 0u;
+    size_t steals = 0u;
+    for (const auto& thread : stats)
     {
-        samplePoints->writeToFile(eventLoader.getTimeRange(),
-                                  eventLoader.getDt(),
-                                  eventLoader.getDataUnit(), params.outputFile,
-                                  params.inputFile, params.report, params.target);
+        minTime = std::min(minTime, thread.busyTime);
+        maxTime = std::max(maxTime, thread.busyTime);
+        totalTime += thread.busyTime;
+        tasks += thread.tasks;
+        steals += thread.steals;
     }
+    if (tasks == 0u)
+        return;
+
+    const double meanTime = totalTime / stats.size();
+    std::cout << "INFO: Threads load: " << tasks << " tasks, " << steals << " steals, busy time min "
+              << minTime << " s, mean " << meanTime << " s, max " << maxTime << " s, imbalance "
+              << maxTime / meanTime << std::endl;
 }
 
 int main(int argc, char* argv[])
@@ -174,6 +889,7 @@ int main(int argc, char* argv[])
     if(parseArgs(params, argc, argv))
     {
         process(params);
+        reportThreadsLoad();
         return 0;
     }
 
@@ -19,12 +19,16 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/program_options.hpp>
 
+#include <emSim/FileWriter.h>
+#include <emSim/HDF5Output.h>
+#include <emSim/MappedStack.h>
 #include <emSim/VSDLoader.h>
 #include <emSim/Volume.h>
 
@@ -46,31 +50,16 @@ std::vector<float> projectVSD(const std::shared_ptr<ems::Volume> volume)
 }
 
 void writeImageToFile(const std::vector<float>& image, const std::string& outputFile, const float time, 
-                      const glm::vec2& pixelSize, const glm::vec2& imageSize)
+                      const glm::vec2& pixelSize, const glm::vec2& imageSize, ems::FileWriter* writer)
 {
-    std::ofstream rawFile;
     const std::string rawFileName = outputFile + "_image_floats_" + ems::createTimeStepSuffix(time) + ".raw";
-    rawFile.open(rawFileName, std::ios::out | std::ios::binary);
-    rawFile.write((char*)image.data(), sizeof(float) * image.size());
-    rawFile.close();
-
-    std::ofstream mhdFile;
-    mhdFile.open(outputFile + "_image_floats_" + ems::createTimeStepSuffix(time) + ".mhd");
-
-    mhdFile << "ObjectType = Image\n"
-            << "NDims = 2\n"
-            << "BinaryData = True\n"
-            << "BinaryDataByteOrderMSB = False\n"
-            << "CompressedData = False\n"
-            << "TransformMatrix = 1 0 0 0 1 0 0 0 1\n"
-            << "Offset = 0 0 0\n"
-            << "CenterOfRotation = 0 0 0\n"
-            << "AnatomicalOrientation = 0 0 0\n"
-            << "ElementSpacing = "<< pixelSize.x << " " << pixelSize.y << "\n"
-            << "DimSize = "<< imageSize.x << " " << imageSize.y << "\n"
-            << "ElementType = MET_FLOAT\n"
-            << "ElementDataFile = " << rawFileName << "\n"
-            << std::endl;
+    ems::writeFloatsFile(rawFileName, image.data(), image.size(), writer);
+
+    const std::string header =
+        ems::createMhdHeader({size_t(imageSize.x), size_t(imageSize.y)}, {pixelSize.x, pixelSize.y},
+                             {0.0f, 0.0f}, rawFileName);
+    ems::writeTextFile(outputFile + "_image_floats_" + ems::createTimeStepSuffix(time) + ".mhd",
+                       header, writer);
 }
 
 bool parseArgs(ems::VSDParams& params, int argc, char* argv[])
@@ -110,7 +99,27 @@ bool parseArgs(ems::VSDParams& params, int argc, char* argv[])
         ("ap-threshold", po::value<float>(&params.apThreshold)->default_value(params.apThreshold), "Action potential threshold "
          "in millivolts.")
         ("soma-pixels", "Produce a text file containing the GIDs loaded and their corresponding 3D positions and indices "
-         "in the resulting 2D image.");
+         "in the resulting 2D image.")
+        ("output-stack", "Write the images of all the frames to a single memory mapped raw file with a 3D "
+         "MetaImage header, and the volumes to a single file with a 4D header, instead of files per frame.")
+        ("hdf5", "Write the images, and the volumes if exported, to datasets of a single HDF5 file, with the "
+         "simulation's provenance as attributes, instead of files per frame.")
+        ("hdf5-chunks", po::value<std::string>(&params.hdf5Chunks)->default_value(params.hdf5Chunks),
+         "The chunk shape of the HDF5 datasets as frames,x,y,z, 0 meaning the whole dimension. "
+         "1,0,0,0 suits reading whole frames, e.g. 256,8,8,8 suits reading time series, at the cost "
+         "of keeping that many frames in memory.")
+        ("hdf5-compression", po::value<int>(&params.hdf5Config.compression)
+             ->default_value(params.hdf5Config.compression),
+         "The deflate level [0 9] of the HDF5 datasets, 0 for none.")
+        ("error-bound", po::value<float>(&params.codec.errorBound), "Compress the exported volumes with this "
+         "maximum absolute error to .emz files read back by emsimDecode.")
+        ("relative-error", po::value<float>(), "Compress the exported volumes with a maximum error of this fraction "
+         "of the value range of each volume, e.g. 1e-3, to .emz files read back by emsimDecode.")
+        ("write-buffers", po::value<size_t>(&params.writeBuffers)->default_value(params.writeBuffers), "The number of "
+         "output volumes and images written to disk in the background while the next frames are computed. 0 writes "
+         "every output before going on.")
+        ("write-threads", po::value<size_t>(&params.writeThreads)->default_value(params.writeThreads), "The number of "
+         "threads writing the chunks of the output files in parallel.");
     // clang-format on
 
     po::variables_map vm;
@@ -142,6 +151,55 @@ bool parseArgs(ems::VSDParams& params, int argc, char* argv[])
     if (vm.count("soma-pixels"))
         params.exportSomaPixels = true;
 
+    if (vm.count("output-stack"))
+        params.outputStack = true;
+
+    if (vm.count("error-bound") || vm.count("relative-error"))
+    {
+        if (vm.count("error-bound") && vm.count("relative-error"))
+        {
+            std::cerr << "Error: --error-bound and --relative-error are exclusive" << std::endl;
+            return false;
+        }
+        if (vm.count("relative-error"))
+        {
+            params.codec.errorBound = vm["relative-error"].as<float>();
+            params.codec.relative = true;
+        }
+        if (params.codec.errorBound < 0.0f)
+        {
+            std::cerr << "Error: the error bound must be positive" << std::endl;
+            return false;
+        }
+        if (params.outputStack || vm.count("hdf5"))
+        {
+            std::cerr << "Error: the compressed volumes can not be written to --output-stack or --hdf5"
+                      << std::endl;
+            return false;
+        }
+        params.compressVolume = true;
+    }
+
+    if (vm.count("hdf5"))
+    {
+        params.hdf5 = true;
+        try
+        {
+            ems::parseHDF5Chunks(params.hdf5Chunks, params.hdf5Config);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
+        params.hdf5Config.compression = std::max(std::min(params.hdf5Config.compression, 9), 0);
+        if (params.outputStack)
+        {
+            std::cerr << "Error: --hdf5 and --output-stack are exclusive" << std::endl;
+            return false;
+        }
+    }
+
     return true;
 }
 
@@ -150,19 +208,119 @@ void process(const ems::VSDParams& params)
 {
     ems::VSDLoader vsdLoader(params);
 
+    std::unique_ptr<ems::FileWriter> writer;
+    if (params.writeBuffers > 0u && !params.hdf5)
+        writer.reset(new ems::FileWriter(params.writeBuffers, params.writeThreads));
+
+    std::unique_ptr<ems::MappedStack> volumeStack;
+    std::unique_ptr<ems::MappedStack> imageStack;
+
+    std::unique_ptr<ems::HDF5Output> hdf5;
+    size_t volumeDataset = 0u;
+    size_t imageDataset = 0u;
+    ems::CodecStats codecStats;
+    if (params.hdf5)
+    {
+        ems::HDF5Config config = params.hdf5Config;
+        config.threads = std::max(params.writeThreads, size_t(1));
+        hdf5.reset(new ems::HDF5Output(params.outputFileName + ".h5", config));
+        hdf5->setAttribute("/", "Generator", "EMSim VSD tool");
+        hdf5->setAttribute("/", "BlueConfig", params.inputFile);
+        hdf5->setAttribute("/", "Target", params.target);
+        hdf5->setAttribute("/", "ReportVoltage", params.reportVoltage);
+        hdf5->setAttribute("/", "ReportArea", params.reportArea);
+        hdf5->setAttribute("/", "Units", vsdLoader.getDataUnit());
+        hdf5->setAttribute("/", "TimeRange", std::vector<double>{vsdLoader.getTimeRange().x,
+                                                                 vsdLoader.getTimeRange().y});
+        hdf5->setAttribute("/", "TimeStep", std::vector<double>{vsdLoader.getDt()});
+    }
+
     for(uint32_t i = 0; i < vsdLoader.getFramesCount(); ++i)
     {
         const std::shared_ptr<ems::Volume> volume = vsdLoader.loadNextFrame();
         const float currentTime = vsdLoader.getTimeRange().x + i * vsdLoader.getDt();
+        const glm::uvec3& size = volume->getSize();
+        const glm::vec3& voxelSize = volume->getVoxelSize();
+        if (params.outputStack && i == 0)
+        {
+            if (params.exportVolume)
+                volumeStack.reset(new ems::MappedStack(
+                    params.outputFileName + "_volume_floats", {size.x, size.y, size.z},
+                    {voxelSize.x, voxelSize.y, voxelSize.z}, vsdLoader.getFramesCount(),
+                    currentTime, vsdLoader.getDt()));
+            imageStack.reset(new ems::MappedStack(params.outputFileName + "_image_floats",
+                                                  {size.x, size.z}, {voxelSize.x, voxelSize.z},
+                                                  vsdLoader.getFramesCount(), currentTime,
+                                                  vsdLoader.getDt()));
+        }
+        if (hdf5 && i == 0)
+        {
+            if (params.exportVolume)
+                volumeDataset =
+                    volume->createDataset(*hdf5, "volume", vsdLoader.getFramesCount());
+            imageDataset = hdf5->createDataset("image", {size.x, size.z},
+                                               vsdLoader.getFramesCount());
+            hdf5->setAttribute("image", "PixelSize",
+                               std::vector<double>{voxelSize.x, voxelSize.z});
+        }
+
         if(params.exportVolume)
         {
-            volume->writeToFileMhd(currentTime, vsdLoader.getDataUnit(), 
-                                   params.outputFileName);
+            if (hdf5)
+                volume->writeToHDF5(*hdf5, volumeDataset, i);
+            else if (volumeStack)
+                volume->writeToStack(*volumeStack, i);
+            else if (params.compressVolume)
+                codecStats += volume->writeToFileCompressed(
+                    currentTime, vsdLoader.getDt(), vsdLoader.getDataUnit(), params.outputFileName,
+                    params.inputFile, params.reportVoltage, params.target, params.codec, writer.get());
+            else
+                volume->writeToFileMhd(currentTime, vsdLoader.getDataUnit(), 
+                                       params.outputFileName, writer.get());
         }
         std::vector<float> image = projectVSD(volume);
-        const glm::vec2 imageSize(volume->getSize().x, volume->getSize().z);
-        const glm::vec2 pixelSize(volume->getVoxelSize().x, volume->getVoxelSize().z);
-        writeImageToFile(image, params.outputFileName, currentTime, pixelSize, imageSize);
+        if (hdf5)
+        {
+            hdf5->writeFrame(imageDataset, i, image.data());
+            continue;
+        }
+        if (imageStack)
+        {
+            imageStack->writeFrame(i, image.data());
+            continue;
+        }
+        const glm::vec2 imageSize(size.x, size.z);
+        const glm::vec2 pixelSize(voxelSize.x, voxelSize.z);
+        writeImageToFile(image, params.outputFileName, currentTime, pixelSize, imageSize,
+                         writer.get());
+    }
+
+    if (volumeStack)
+        volumeStack->flush();
+    if (imageStack)
+        imageStack->flush();
+
+    if (codecStats.bytes > 0u)
+        std::cout << "INFO: Compression: " << codecStats.bytes << " bytes stored in "
+                  << codecStats.storedBytes << ", ratio " << codecStats.getRatio() << ", max error "
+                  << codecStats.maxError << std::endl;
+
+    if (hdf5)
+    {
+        hdf5->flush();
+        const ems::HDF5Stats stats = hdf5->getStats();
+        std::cout << "INFO: HDF5 output: " << stats.chunks << " chunks, " << stats.bytes
+                  << " bytes stored in " << stats.storedBytes << ", " << stats.stallTime
+                  << " s waiting for the queue" << std::endl;
+    }
+
+    if (writer)
+    {
+        writer->flush();
+        const ems::WriteStats stats = writer->getStats();
+        std::cout << "INFO: Output: " << stats.files << " files, " << stats.bytes << " bytes, "
+                  << stats.writeTime << " s writing, " << stats.stallTime
+                  << " s waiting for a buffer" << std::endl;
     }
 }
 
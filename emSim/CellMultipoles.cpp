@@ -0,0 +1,162 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <cmath>
+
+#include <emSim/CellMultipoles.h>
+#include <emSim/helpers.h>
+
+namespace ems
+{
+CellMultipoles::CellMultipoles(const Events& events, const CellsEvents& cells,
+                               const float cutoff)
+    : _cells(cells)
+    , _cellRadii(cells.size(), 0.0f)
+    , _moments(cells.size())
+    , _cutoff(cutoff)
+{
+    for (size_t i = 0; i < _cells.size(); ++i)
+    {
+        for (uint32_t j = _cells[i].begin; j < _cells[i].end; ++j)
+        {
+            const float dist =
+                glm::length(events.getPosition(j) - _cells[i].soma) +
+                events.getRadii()[j];
+            _cellRadii[i] = std::max(_cellRadii[i], dist);
+        }
+    }
+}
+
+void CellMultipoles::update(const Events& events, const size_t frame)
+{
+    const float* powers = events.getPowers(frame);
+
+    parallelFor(_cells.size(), [&](const size_t i) {
+        Moments moments;
+        for (uint32_t j = _cells[i].begin; j < _cells[i].end; ++j)
+        {
+            const glm::vec3 r = events.getPosition(j) - _cells[i].soma;
+            const float power = powers[j];
+            const float squaredDist = glm::dot(r, r);
+
+            moments.monopole += power;
+            moments.dipole += power * r;
+            moments.quadrupole[0] += power * (3.0f * r.x * r.x - squaredDist);
+            moments.quadrupole[1] += power * (3.0f * r.y * r.y - squaredDist);
+            moments.quadrupole[2] += power * (3.0f * r.z * r.z - squaredDist);
+            moments.quadrupole[3] += power * 3.0f * r.x * r.y;
+            moments.quadrupole[4] += power * 3.0f * r.x * r.z;
+            moments.quadrupole[5] += power * 3.0f * r.y * r.z;
+        }
+        _moments[i] = moments;
+    });
+}
+
+float CellMultipoles::_computeValue(const Events& events, const float* powers,
+                                    const glm::vec3& pos,
+                                    uint64_t& exactCells) const
+{
+    const float* radii = events.getRadii();
+
+    float value = 0.0f;
+    for (size_t i = 0; i < _cells.size(); ++i)
+    {
+        const glm::vec3 delta = pos - _cells[i].soma;
+        const float dist = glm::length(delta);
+
+        if (dist < _cellRadii[i] + _cutoff)
+        {
+            for (uint32_t j = _cells[i].begin; j < _cells[i].end; ++j)
+            {
+                const float eventDist = glm::length(pos - events.getPosition(j));
+                value += powers[j] / std::max(eventDist, radii[j]);
+            }
+            ++exactCells;
+            continue;
+        }
+
+        const Moments& moments = _moments[i];
+        const float distInv = 1.0f / dist;
+        const float distInv2 = distInv * distInv;
+        const float* q = moments.quadrupole;
+        const float quadrupole =
+            q[0] * delta.x * delta.x + q[1] * delta.y * delta.y +
+            q[2] * delta.z * delta.z +
+            2.0f * (q[3] * delta.x * delta.y + q[4] * delta.x * delta.z +
+                    q[5] * delta.y * delta.z);
+
+        value += distInv * (moments.monopole +
+                            glm::dot(moments.dipole, delta) * distInv2 +
+                            0.5f * quadrupole * distInv2 * distInv2);
+    }
+    return Ec * value;
+}
+
+float CellMultipoles::computeVolume(const Events& events, Volume& volume,
+                                    const size_t frame) const
+{
+    const glm::uvec3& size = volume.getSize();
+    const glm::vec3& origin = volume.getOrigin();
+    const glm::vec3& voxelSize = volume.getVoxelSize();
+    const float* powers = events.getPowers(frame);
+    float* data = volume.getData();
+
+    std::atomic<uint64_t> exactCells(0u);
+    parallelFor(size_t(size.y) * size.z, [&](const size_t row) {
+        const size_t y = row % size.y;
+        const size_t z = row / size.y;
+        uint64_t rowExactCells = 0u;
+        for (size_t x = 0; x < size.x; ++x)
+        {
+            const glm::vec3 pos(origin.x + x * voxelSize.x,
+                                origin.y + y * voxelSize.y,
+                                origin.z + z * voxelSize.z);
+            data[row * size.x + x] =
+                _computeValue(events, powers, pos, rowExactCells);
+        }
+        exactCells += rowExactCells;
+    });
+
+    const double interactions = double(size.x) * size.y * size.z * _cells.size();
+    return interactions > 0.0 ? exactCells / interactions : 0.0f;
+}
+
+float CellMultipoles::computeValues(const Events& events,
+                                    const float* positionsX,
+                                    const float* positionsY,
+                                    const float* positionsZ,
+                                    const size_t nPoints, float* values,
+                                    const size_t frame) const
+{
+    const float* powers = events.getPowers(frame);
+
+    std::atomic<uint64_t> exactCells(0u);
+    parallelFor(nPoints, [&](const size_t i) {
+        uint64_t pointExactCells = 0u;
+        values[i] = _computeValue(
+            events, powers,
+            glm::vec3(positionsX[i], positionsY[i], positionsZ[i]),
+            pointExactCells);
+        exactCells += pointExactCells;
+    });
+
+    const double interactions = double(nPoints) * _cells.size();
+    return interactions > 0.0 ? exactCells / interactions : 0.0f;
+}
+}
@@ -0,0 +1,110 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _CellMultipoles_h_
+#define _CellMultipoles_h_
+
+#define GLM_FORCE_CTOR_INIT
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include <emSim/Events.h>
+#include <emSim/Volume.h>
+
+namespace ems
+{
+/** The contiguous range of events of a cell and the position of its soma */
+struct CellEvents
+{
+    uint32_t begin = 0u;
+    uint32_t end = 0u;
+    glm::vec3 soma;
+};
+typedef std::vector<CellEvents> CellsEvents;
+
+/**
+ * Far field compression of the cells' compartments. Every frame, the events of
+ * each cell are reduced to their monopole, dipole and quadrupole moments about
+ * the soma. A point closer to a cell than the cutoff distance sees the cell's
+ * events exactly, other points only see the cell's moments.
+ */
+class CellMultipoles
+{
+public:
+    /**
+     * @param events the events whose geometry is used
+     * @param cells the events' ranges of the cells, covering all events
+     * @param cutoff the distance to a cell's bounding sphere below which its
+     * events are evaluated exactly
+     */
+    CellMultipoles(const Events& events, const CellsEvents& cells,
+                   float cutoff);
+
+    /**
+     * Reduce the cells' events to their moments for a frame.
+     * @param events the events used to create the multipoles
+     * @param frame the frame of the events to use
+     */
+    void update(const Events& events, size_t frame = 0u);
+
+    /**
+     * Compute all the voxels of a volume.
+     * @param events the events given to the last update
+     * @param volume the volume to fill
+     * @param frame the frame given to the last update
+     * @return the fraction of the cells evaluated exactly
+     */
+    float computeVolume(const Events& events, Volume& volume,
+                        size_t frame = 0u) const;
+
+    /**
+     * Compute the values at the given positions.
+     * @param events the events given to the last update
+     * @param positionsX the x coordinates of the positions
+     * @param positionsY the y coordinates of the positions
+     * @param positionsZ the z coordinates of the positions
+     * @param nPoints the number of positions
+     * @param values the output values
+     * @param frame the frame given to the last update
+     * @return the fraction of the cells evaluated exactly
+     */
+    float computeValues(const Events& events, const float* positionsX,
+                        const float* positionsY, const float* positionsZ,
+                        size_t nPoints, float* values, size_t frame = 0u) const;
+
+private:
+    struct Moments
+    {
+        float monopole = 0.0f;
+        glm::vec3 dipole;
+        // Traceless quadrupole, xx yy zz xy xz yz
+        float quadrupole[6] = {0.0f};
+    };
+
+    float _computeValue(const Events& events, const float* powers,
+                        const glm::vec3& pos, uint64_t& exactCells) const;
+
+    CellsEvents _cells;
+    std::vector<float> _cellRadii;
+    std::vector<Moments> _moments;
+    float _cutoff = 0.0f;
+};
+}
+#endif // _CellMultipoles_h_
@@ -0,0 +1,167 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <cmath>
+
+#include <emSim/CompactEvents.h>
+
+namespace ems
+{
+namespace
+{
+// Number of consecutive events scanned by a single thread
+const size_t chunkSize = 1u << 14;
+}
+
+CompactEvents::CompactEvents(const Events& events, const float tolerance)
+    : _nEvents(events.getEventsCount())
+    , _nPaddedEvents(padEventsCount(_nEvents))
+    , _tolerance(tolerance)
+    , _positionsX(alignedMalloc<float>(_nPaddedEvents))
+    , _positionsY(alignedMalloc<float>(_nPaddedEvents))
+    , _positionsZ(alignedMalloc<float>(_nPaddedEvents))
+    , _radii(alignedMalloc<float>(_nPaddedEvents))
+    , _powers(alignedMalloc<float>(_nPaddedEvents))
+    , _chunkOffsets((_nEvents + chunkSize - 1) / chunkSize + 1, 0u)
+{
+}
+
+void CompactEvents::update(const Events& events, const size_t nFrames)
+{
+    if (nFrames != _nFrames)
+    {
+        _powers.reset(alignedMalloc<float>(_nPaddedEvents * nFrames));
+        _nFrames = nFrames;
+    }
+
+    const size_t nChunks = _chunkOffsets.size() - 1;
+    const auto chunkEnd = [&](const size_t chunk) {
+        return std::min((chunk + 1) * chunkSize, _nEvents);
+    };
+
+    std::vector<float> chunkMaxPowers(nChunks, 0.0f);
+    parallelFor(nChunks, [&](const size_t chunk) {
+        float maxPower = 0.0f;
+        for (size_t f = 0; f < _nFrames; ++f)
+        {
+            const float* powers = events.getPowers(f);
+            for (size_t i = chunk * chunkSize; i < chunkEnd(chunk); ++i)
+                maxPower = std::max(maxPower, std::abs(powers[i]));
+        }
+        chunkMaxPowers[chunk] = maxPower;
+    });
+    const float threshold =
+        chunkMaxPowers.empty()
+            ? 0.0f
+            : _tolerance * *std::max_element(chunkMaxPowers.begin(),
+                                             chunkMaxPowers.end());
+
+    const auto isActive = [&](const size_t i) {
+        for (size_t f = 0; f < _nFrames; ++f)
+        {
+            const float power = events.getPowers(f)[i];
+            if (power != 0.0f && std::abs(power) >= threshold)
+                return true;
+        }
+        return false;
+    };
+
+    // Count the active events of every chunk, then pack each chunk at the
+    // offset given by the prefix sum of the counts.
+    parallelFor(nChunks, [&](const size_t chunk) {
+        size_t count = 0u;
+        for (size_t i = chunk * chunkSize; i < chunkEnd(chunk); ++i)
+            count += isActive(i);
+        _chunkOffsets[chunk + 1] = count;
+    });
+    for (size_t chunk = 0; chunk < nChunks; ++chunk)
+        _chunkOffsets[chunk + 1] += _chunkOffsets[chunk];
+    _nCompacted = _chunkOffsets[nChunks];
+    const size_t nPadded = padEventsCount(_nCompacted);
+
+    const float* radii = events.getRadii();
+    parallelFor(nChunks, [&](const size_t chunk) {
+        size_t index = _chunkOffsets[chunk];
+        for (size_t i = chunk * chunkSize; i < chunkEnd(chunk); ++i)
+        {
+            if (!isActive(i))
+                continue;
+
+            _positionsX[index] = events.getPositionsX()[i];
+            _positionsY[index] = events.getPositionsY()[i];
+            _positionsZ[index] = events.getPositionsZ()[i];
+            _radii[index] = radii[i];
+            for (size_t f = 0; f < _nFrames; ++f)
+                _powers[f * nPadded + index] = events.getPowers(f)[i];
+            ++index;
+        }
+    });
+
+    // Null padding events, as in Events
+    for (size_t i = _nCompacted; i < nPadded; ++i)
+    {
+        _positionsX[i] = 0.0f;
+        _positionsY[i] = 0.0f;
+        _positionsZ[i] = 0.0f;
+        _radii[i] = 1.0f;
+        for (size_t f = 0; f < _nFrames; ++f)
+            _powers[f * nPadded + i] = 0.0f;
+    }
+}
+
+const float* CompactEvents::getPositionsX() const
+{
+    return _positionsX.get();
+}
+
+const float* CompactEvents::getPositionsY() const
+{
+    return _positionsY.get();
+}
+
+const float* CompactEvents::getPositionsZ() const
+{
+    return _positionsZ.get();
+}
+
+const float* CompactEvents::getRadii() const
+{
+    return _radii.get();
+}
+
+const float* CompactEvents::getPowers(const size_t frame) const
+{
+    return _powers.get() + frame * padEventsCount(_nCompacted);
+}
+
+size_t CompactEvents::getEventsCount() const
+{
+    return _nCompacted;
+}
+
+size_t CompactEvents::getPaddedEventsCount() const
+{
+    return padEventsCount(_nCompacted);
+}
+
+float CompactEvents::getCompactionRatio() const
+{
+    return _nEvents == 0u ? 0.0f : float(_nCompacted) / float(_nEvents);
+}
+}
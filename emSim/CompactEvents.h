@@ -0,0 +1,114 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _EMSim_CompactEvents_h_
+#define _EMSim_CompactEvents_h_
+
+#include <vector>
+
+#include <emSim/Events.h>
+#include <emSim/helpers.h>
+
+namespace ems
+{
+/**
+ * This class packs the active events of one or several time steps, i.e. the
+ * events whose absolute power is above a tolerance relative to the maximum
+ * absolute power of the time steps. The packed events are stored in the same
+ * aligned and padded layout as Events, so they can be given to the same
+ * kernels.
+ */
+class CompactEvents
+{
+public:
+    /**
+     * Allocate the memory needed to store all the events for one time step.
+     * @param events The events whose geometric data is used
+     * @param tolerance The relative tolerance below which an event is skipped
+     * @throw std::bad_alloc if memory allocation did not work.
+     */
+    CompactEvents(const Events& events, float tolerance);
+
+    /**
+     * Pack the events active in any of the first time steps of the events.
+     * @param events The events given to the constructor
+     * @param nFrames The number of time steps to pack
+     * @throw std::bad_alloc if memory allocation did not work.
+     */
+    void update(const Events& events, size_t nFrames = 1u);
+
+    /**
+     * @return The pointer to the packed events' x coordinates.
+     */
+    const float* getPositionsX() const;
+
+    /**
+     * @return The pointer to the packed events' y coordinates.
+     */
+    const float* getPositionsY() const;
+
+    /**
+     * @return The pointer to the packed events' z coordinates.
+     */
+    const float* getPositionsZ() const;
+
+    /**
+     * @return The pointer to the packed events' radii.
+     */
+    const float* getRadii() const;
+
+    /**
+     * @param frame The index of the packed time step
+     * @return The pointer to the packed events' powers.
+     */
+    const float* getPowers(size_t frame = 0u) const;
+
+    /**
+     * @return the number of packed events.
+     */
+    size_t getEventsCount() const;
+
+    /**
+     * @return the number of packed events including the padding, which is
+     * also the offset between the powers of consecutive time steps.
+     */
+    size_t getPaddedEventsCount() const;
+
+    /**
+     * @return the ratio of packed events over all the events.
+     */
+    float getCompactionRatio() const;
+
+private:
+    const size_t _nEvents;
+    const size_t _nPaddedEvents;
+    const float _tolerance;
+    size_t _nFrames = 1u;
+    size_t _nCompacted = 0u;
+
+    AlignedFloatPtr _positionsX;
+    AlignedFloatPtr _positionsY;
+    AlignedFloatPtr _positionsZ;
+    AlignedFloatPtr _radii;
+    AlignedFloatPtr _powers;
+    std::vector<size_t> _chunkOffsets;
+};
+}
+
+#endif // _EMSim_CompactEvents_h_
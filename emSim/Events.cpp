@@ -17,6 +17,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <algorithm>
 #include <cstring>
 
 #include <emSim/Events.h>
@@ -24,15 +25,24 @@
 
 namespace ems
 {
-Events::Events(const size_t nEvents)
+Events::Events(const size_t nEvents, const size_t nFrames)
     : _nEvents(nEvents)
-    , _flatPositions(alignedMalloc<float>(_nEvents * 3u))
-    , _radii(alignedMalloc<float>(_nEvents))
-    , _powers(alignedMalloc<float>(_nEvents))
+    , _nPaddedEvents(padEventsCount(nEvents))
+    , _nFrames(nFrames)
+    , _positionsX(alignedMalloc<float>(_nPaddedEvents))
+    , _positionsY(alignedMalloc<float>(_nPaddedEvents))
+    , _positionsZ(alignedMalloc<float>(_nPaddedEvents))
+    , _radii(alignedMalloc<float>(_nPaddedEvents))
+    , _powers(alignedMalloc<float>(_nPaddedEvents * _nFrames))
 {
-    std::memset(_flatPositions.get(), 0.0f, _nEvents * 3u * sizeof(float));
-    std::memset(_radii.get(), 0.0f, _nEvents * sizeof(float));
-    std::memset(_powers.get(), 0.0f, _nEvents * sizeof(float));
+    fillMemory(_positionsX.get(), _nPaddedEvents, 0.0f);
+    fillMemory(_positionsY.get(), _nPaddedEvents, 0.0f);
+    fillMemory(_positionsZ.get(), _nPaddedEvents, 0.0f);
+    fillMemory(_radii.get(), _nEvents, 0.0f);
+    fillMemory(_powers.get(), _nPaddedEvents * _nFrames, 0.0f);
+
+    // A non null radius keeps the padding events' distances finite
+    std::fill(_radii.get() + _nEvents, _radii.get() + _nPaddedEvents, 1.0f);
 }
 
 void Events::addEvent(const glm::vec3& pos, const float radius)
@@ -41,16 +51,59 @@ void Events::addEvent(const glm::vec3& pos, const float radius)
         throw(std::runtime_error(
             "error: Cannot add event. Maximum number of events reached."));
 
-    _flatPositions[_eventIndex * 3] = pos.x;
-    _flatPositions[_eventIndex * 3 + 1] = pos.y;
-    _flatPositions[_eventIndex * 3 + 2] = pos.z;
+    _positionsX[_eventIndex] = pos.x;
+    _positionsY[_eventIndex] = pos.y;
+    _positionsZ[_eventIndex] = pos.z;
     _radii[_eventIndex] = radius;
     ++_eventIndex;
 }
 
-const float* Events::getFlatPositions() const
+void Events::reorder(const std::vector<uint32_t>& order)
+{
+    if (order.size() != _nEvents)
+        throw(std::runtime_error(
+            "error: Cannot reorder events. Wrong number of indices."));
+
+    const auto gather = [&](AlignedFloatPtr& values, const size_t nFrames) {
+        AlignedFloatPtr reordered(
+            alignedMalloc<float>(_nPaddedEvents * nFrames));
+        std::memcpy(reordered.get(), values.get(),
+                    _nPaddedEvents * nFrames * sizeof(float));
+        for (size_t frame = 0; frame < nFrames; ++frame)
+        {
+            const float* source = values.get() + frame * _nPaddedEvents;
+            float* destination = reordered.get() + frame * _nPaddedEvents;
+            for (size_t i = 0; i < _nEvents; ++i)
+                destination[i] = source[order[i]];
+        }
+        values = std::move(reordered);
+    };
+    gather(_positionsX, 1u);
+    gather(_positionsY, 1u);
+    gather(_positionsZ, 1u);
+    gather(_radii, 1u);
+    gather(_powers, _nFrames);
+}
+
+const float* Events::getPositionsX() const
+{
+    return _positionsX.get();
+}
+
+const float* Events::getPositionsY() const
+{
+    return _positionsY.get();
+}
+
+const float* Events::getPositionsZ() const
+{
+    return _positionsZ.get();
+}
+
+glm::vec3 Events::getPosition(const size_t index) const
 {
-    return _flatPositions.get();
+    return glm::vec3(_positionsX[index], _positionsY[index],
+                     _positionsZ[index]);
 }
 
 const float* Events::getRadii() const
@@ -58,18 +111,87 @@ const float* Events::getRadii() const
     return _radii.get();
 }
 
-const float* Events::getPowers() const
+const float* Events::getPowers(const size_t frame) const
+{
+    return _powers.get() + frame * _nPaddedEvents;
+}
+
+float* Events::getPowers(const size_t frame)
+{
+    return _powers.get() + frame * _nPaddedEvents;
+}
+
+void Events::setFramesCount(const size_t nFrames)
 {
-    return _powers.get();
+    _powers.reset(alignedMalloc<float>(_nPaddedEvents * nFrames));
+    _nFrames = nFrames;
+    fillMemory(_powers.get(), _nPaddedEvents * _nFrames, 0.0f);
 }
 
-float* Events::getPowers()
+void Events::swapPowers(AlignedFloatPtr& powers, size_t& nFrames)
 {
-    return _powers.get();
+    std::swap(_powers, powers);
+    std::swap(_nFrames, nFrames);
 }
 
 size_t Events::getEventsCount() const
 {
     return _nEvents;
 }
+
+size_t Events::getFramesCount() const
+{
+    return _nFrames;
+}
+
+size_t Events::getPaddedEventsCount() const
+{
+    return _nPaddedEvents;
+}
+
+PowersPool::PowersPool(const size_t nPaddedEvents)
+    : _nPaddedEvents(nPaddedEvents)
+{
+}
+
+AlignedFloatPtr PowersPool::acquire(const size_t nFrames, size_t& capacity)
+{
+    auto best = _buffers.end();
+    for (auto i = _buffers.begin(); i != _buffers.end(); ++i)
+    {
+        if (i->capacity >= nFrames &&
+            (best == _buffers.end() || i->capacity < best->capacity))
+        {
+            best = i;
+        }
+    }
+    if (best != _buffers.end())
+    {
+        AlignedFloatPtr powers = std::move(best->powers);
+        capacity = best->capacity;
+        _buffers.erase(best);
+        return powers;
+    }
+
+    _buffers.erase(std::remove_if(_buffers.begin(), _buffers.end(),
+                                  [nFrames](const Buffer& buffer) {
+                                      return buffer.capacity < nFrames;
+                                  }),
+                   _buffers.end());
+    AlignedFloatPtr powers(alignedMalloc<float>(_nPaddedEvents * nFrames));
+    fillMemory(powers.get(), _nPaddedEvents * nFrames, 0.0f);
+    capacity = nFrames;
+    return powers;
+}
+
+void PowersPool::release(AlignedFloatPtr powers, const size_t capacity)
+{
+    if (powers)
+        _buffers.push_back(Buffer{std::move(powers), capacity});
+}
+
+size_t PowersPool::getFreeCount() const
+{
+    return _buffers.size();
+}
 }
@@ -22,6 +22,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
 #define GLM_FORCE_CTOR_INIT
 #include <glm/glm.hpp>
@@ -33,9 +34,14 @@ namespace ems
 {
 /**
  * This class store the events' geometric data (position and radius) and power
- * values for one time step. The geometric data consist of an event's 3d
- * position and radius and is constant for all time steps. The power values
- * changes every time steps and need to be reloaded.
+ * values for one or several time steps. The geometric data consist of an
+ * event's 3d position and radius and is constant for all time steps. The power
+ * values changes every time steps and need to be reloaded. The power values of
+ * consecutive time steps are stored one after the other.
+ *
+ * Every component is stored in its own array, aligned on a cache line and
+ * padded to a multiple of simdPadding events. The padding events have a null
+ * power, so the kernels can safely read them.
  */
 class Events
 {
@@ -44,9 +50,10 @@ public:
      * Allocate all the memory needed to store the data. Set all data values
      * to 0.0f.
      * @param nEvent The number of events
+     * @param nFrames The number of time steps for which powers are stored
      * @throw std::bad_alloc if memory allocation did not work.
      */
-    Events(size_t nEvent);
+    Events(size_t nEvent, size_t nFrames = 1u);
 
     Events(Events&& other) = default;
     Events& operator=(Events&& other) = default;
@@ -64,11 +71,33 @@ public:
     void addEvent(const glm::vec3& pos, const float radius);
 
     /**
-     * Return a const pointer to the events' positions. The positions are stored
-     * in x,y,z order.
-     * @return The pointer to the events positions.
+     * Reorder the events' geometric data and the powers of all the time
+     * steps.
+     * @param order the current index of every event of the new order
+     * @throw std::runtime_error if order does not have one index per event
+     */
+    void reorder(const std::vector<uint32_t>& order);
+
+    /**
+     * @return The const pointer to the events' x coordinates.
+     */
+    const float* getPositionsX() const;
+
+    /**
+     * @return The const pointer to the events' y coordinates.
+     */
+    const float* getPositionsY() const;
+
+    /**
+     * @return The const pointer to the events' z coordinates.
+     */
+    const float* getPositionsZ() const;
+
+    /**
+     * @param index The index of the event
+     * @return The position of the event.
      */
-    const float* getFlatPositions() const;
+    glm::vec3 getPosition(size_t index) const;
 
     /**
      * @return The const pointer to the events' radii.
@@ -76,29 +105,111 @@ public:
     const float* getRadii() const;
 
     /**
+     * @param frame The index of the time step
      * @return The const pointer to the events' powers.
      */
-    const float* getPowers() const;
+    const float* getPowers(size_t frame = 0u) const;
 
     /**
+     * @param frame The index of the time step
      * @return The pointer to the events' powers.
      */
-    float* getPowers();
+    float* getPowers(size_t frame = 0u);
+
+    /**
+     * Reallocate the power values to store the given number of time steps.
+     * The geometric data is kept, all power values are set to 0.0f.
+     * @param nFrames The number of time steps for which powers are stored
+     * @throw std::bad_alloc if memory allocation did not work.
+     */
+    void setFramesCount(size_t nFrames);
+
+    /**
+     * Exchange the power values with another buffer of the same layout,
+     * without copying any value.
+     * @param powers the new power values, nFrames * getPaddedEventsCount()
+     * values with null powers for the padding events; receives the previous
+     * power values
+     * @param nFrames the number of time steps stored in powers; receives the
+     * previous number of time steps
+     */
+    void swapPowers(AlignedFloatPtr& powers, size_t& nFrames);
 
     /**
      * @return the number of stored events.
      */
     size_t getEventsCount() const;
 
+    /**
+     * @return the number of time steps for which powers are stored.
+     */
+    size_t getFramesCount() const;
+
+    /**
+     * @return the number of events including the padding, which is also the
+     * offset between the powers of consecutive time steps.
+     */
+    size_t getPaddedEventsCount() const;
+
 private:
     size_t _nEvents = 0u;
+    size_t _nPaddedEvents = 0u;
+    size_t _nFrames = 0u;
 
-    AlignedFloatPtr _flatPositions;
+    AlignedFloatPtr _positionsX;
+    AlignedFloatPtr _positionsY;
+    AlignedFloatPtr _positionsZ;
     AlignedFloatPtr _radii;
     AlignedFloatPtr _powers;
 
     size_t _eventIndex = 0u;
 };
+
+/**
+ * Free power buffers with the layout of an Events' powers, to be exchanged
+ * with Events::swapPowers() without allocating every time step.
+ */
+class PowersPool
+{
+public:
+    /**
+     * @param nPaddedEvents the number of events including the padding of the
+     * buffers
+     */
+    explicit PowersPool(size_t nPaddedEvents);
+
+    /**
+     * Take the smallest free buffer of at least nFrames time steps, or
+     * allocate one of nFrames time steps if there is none. A new buffer has
+     * null powers, the free buffers smaller than it are then released as
+     * they would never be taken again for so many time steps.
+     * @param nFrames the number of time steps of the buffer
+     * @param capacity receives the number of time steps of the buffer
+     * @return the buffer
+     * @throw std::bad_alloc if memory allocation did not work.
+     */
+    AlignedFloatPtr acquire(size_t nFrames, size_t& capacity);
+
+    /**
+     * Give back a buffer, its padding events must still have a null power.
+     * @param powers the buffer
+     * @param capacity the number of time steps of the buffer
+     */
+    void release(AlignedFloatPtr powers, size_t capacity);
+
+    /** @return the number of free buffers */
+    size_t getFreeCount() const;
+
+private:
+    struct Buffer
+    {
+        AlignedFloatPtr powers;
+        size_t capacity;
+    };
+
+    size_t _nPaddedEvents;
+    std::vector<Buffer> _buffers;
+};
 }
 
 #endif // _EMSim_Events_h_
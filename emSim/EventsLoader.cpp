@@ -19,13 +19,19 @@
 
 #include <emSim/EventsLoader.h>
 
+#include <chrono>
+#include <limits>
+
 namespace ems
 {
 EventsLoader::EventsLoader(const std::string& filePath,
                            const std::string& target, const std::string& report,
-                           const glm::vec2& timeRange, const float fraction)
+                           const glm::vec2& timeRange, const float fraction,
+                           const bool spatialOrder, const bool mergeEvents,
+                           const size_t prefetchDepth)
     : _bc(filePath)
     , _timeRange(timeRange)
+    , _prefetchDepth(prefetchDepth)
 {
     _circuit.reset(new brain::Circuit(_bc));
 
@@ -43,18 +49,117 @@ EventsLoader::EventsLoader(const std::string& filePath,
     _validateCurrentReport(_gids);
     _loadStaticEventGeometry();
     _report->updateMapping(_gids);
+
+    if (mergeEvents)
+    {
+        CellsEvents cells = _cells;
+        EventsMerge merge = computeEventsMerge(*_events, cells);
+        const size_t nEvents = _events->getEventsCount();
+        if (merge.getEventsCount() < nEvents)
+        {
+            _events.reset(new Events(ems::mergeEvents(*_events, merge)));
+            _cells = std::move(cells);
+            _eventsMerge = std::move(merge);
+            std::cout << "INFO: " << nEvents << " events merged into "
+                      << _events->getEventsCount() << " co-located events"
+                      << std::endl;
+        }
+    }
+
+    if (spatialOrder)
+    {
+        _eventsOrder = computeSpatialOrder(*_events, _cells, _circuitAABB);
+        _events->reorder(_eventsOrder);
+        if (!_eventsMerge.members.empty())
+        {
+            // The order refers to the merged events and not to the report,
+            // so it is folded in the merge which alone maps the loaded events
+            // to the report, see getEventsOrder().
+            _eventsMerge = reorderEventsMerge(_eventsMerge, _eventsOrder);
+            _eventsOrder.clear();
+        }
+        std::cout << "INFO: Events sorted along a Morton curve" << std::endl;
+    }
+    _freePowers.reset(new PowersPool(_events->getPaddedEventsCount()));
+}
+
+EventsLoader::~EventsLoader()
+{
+    _cancelPrefetch();
 }
 
 const Events& EventsLoader::loadNextFrame()
 {
-    const auto& values = _report->loadFrame(_currentFrame * _report->getTimestep() +
-                                            _timeRange.x).get().data;
-    memcpy(_events->getPowers(), values->data(),
-           _report->getFrameSize() * sizeof(float));
-    ++_currentFrame;
+    return loadNextFrames(1u);
+}
+
+const Events& EventsLoader::loadNextFrames(size_t nFrames)
+{
+    nFrames = std::min(nFrames, size_t(_numberOfFrames - _currentFrame));
+    _loadedFrames = nFrames;
+    if (nFrames == 0u)
+        return *_events;
+
+    if (!_pendingBatches.empty() && _pendingBatches.front().nFrames != nFrames)
+        _cancelPrefetch();
+    if (_pendingBatches.empty())
+        _requestFrames(nFrames);
+
+    FramesBatch batch = std::move(_pendingBatches.front());
+    _pendingBatches.pop_front();
+    if (batch.loaded.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        batch.loaded.wait();
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        _loadStats.stallTime += elapsed.count();
+        ++_loadStats.stalls;
+    }
+    try
+    {
+        batch.loaded.get();
+    }
+    catch (...)
+    {
+        _freePowers->release(std::move(batch.powers), batch.capacity);
+        _cancelPrefetch();
+        throw;
+    }
+    ++_loadStats.batches;
+    _currentFrame += nFrames;
+
+    // The previous buffer is reused by the next requests
+    _events->swapPowers(batch.powers, batch.capacity);
+    _freePowers->release(std::move(batch.powers), batch.capacity);
+
+    while (_pendingBatches.size() < _prefetchDepth &&
+           _requestedFrame < _numberOfFrames)
+        _requestFrames(
+            std::min(nFrames, size_t(_numberOfFrames - _requestedFrame)));
     return *_events;
 }
 
+LowRankPowers EventsLoader::computeLowRankPowers(const size_t rank,
+                                                 const size_t oversampling)
+{
+    const auto loadFrame = [this](const size_t frame, float* powers) {
+        const auto& values =
+            _report->loadFrame(frame * _report->getTimestep() + _timeRange.x)
+                .get()
+                .data;
+        _copyPowers(values->data(), powers);
+    };
+    return LowRankPowers(_events->getEventsCount(), _numberOfFrames, rank,
+                         oversampling, loadFrame);
+}
+
+size_t EventsLoader::getLoadedFramesCount() const
+{
+    return _loadedFrames;
+}
+
 const Events& EventsLoader::getLoadedFrame() const
 {
     return *_events;
@@ -98,6 +203,7 @@ void EventsLoader::_computeStaticEventGeometry(
     const FlatInverseMapping& mapping,
     const brain::neuron::Morphologies& morphologies)
 {
+    uint32_t lastCellIndex = std::numeric_limits<uint32_t>::max();
     for (const auto& j : mapping)
     {
         uint32_t cellIndex;
@@ -106,6 +212,18 @@ void EventsLoader::_computeStaticEventGeometry(
         std::tie(cellIndex, sectionId, compartments) = j;
 
         const auto& morphology = *morphologies[cellIndex];
+        // The mapping is sorted by cell, so the events of a cell are contiguous
+        if (cellIndex != lastCellIndex)
+        {
+            lastCellIndex = cellIndex;
+            CellEvents cell;
+            cell.begin = _cells.empty() ? 0u : _cells.back().end;
+            cell.end = cell.begin;
+            cell.soma = morphology.getSoma().getCentroid();
+            _cells.push_back(cell);
+        }
+        _cells.back().end += compartments;
+
         if (sectionId == 0)
         {
             const auto& soma = morphology.getSoma();
@@ -222,6 +340,82 @@ const std::string& EventsLoader::getDataUnit() const
     return _report->getDataUnit();
 }
 
+const CellsEvents& EventsLoader::getCellsEvents() const
+{
+    return _cells;
+}
+
+const EventsOrder& EventsLoader::getEventsOrder() const
+{
+    return _eventsOrder;
+}
+
+const EventsMerge& EventsLoader::getEventsMerge() const
+{
+    return _eventsMerge;
+}
+
+const LoadStats& EventsLoader::getLoadStats() const
+{
+    return _loadStats;
+}
+
+void EventsLoader::_copyPowers(const float* reportPowers, float* powers) const
+{
+    if (!_eventsMerge.members.empty())
+        gatherSumPowers(reportPowers, _eventsMerge, powers);
+    else if (_eventsOrder.empty())
+        memcpy(powers, reportPowers, _report->getFrameSize() * sizeof(float));
+    else
+        gatherPowers(reportPowers, _eventsOrder, powers);
+}
+
+void EventsLoader::_requestFrames(const size_t nFrames)
+{
+    FramesBatch batch;
+    const size_t nPaddedEvents = _events->getPaddedEventsCount();
+    // The padding events keep a null power, the copies never write them
+    batch.powers = _freePowers->acquire(nFrames, batch.capacity);
+    batch.nFrames = nFrames;
+
+    // All the frames are requested before waiting for the first one
+    std::vector<std::future<brion::Frame>> frames;
+    frames.reserve(nFrames);
+    for (size_t i = 0; i < nFrames; ++i)
+        frames.push_back(
+            _report->loadFrame((_requestedFrame + i) * _report->getTimestep() +
+                               _timeRange.x));
+    _requestedFrame += nFrames;
+
+    float* powers = batch.powers.get();
+    batch.loaded = std::async(
+        std::launch::async,
+        [this, powers, nPaddedEvents](
+            std::vector<std::future<brion::Frame>> reportFrames) {
+            for (size_t i = 0; i < reportFrames.size(); ++i)
+            {
+                const auto values = reportFrames[i].get().data;
+                if (!values)
+                    throw std::runtime_error(
+                        "error: Cannot read the frame from the report.");
+                _copyPowers(values->data(), powers + i * nPaddedEvents);
+            }
+        },
+        std::move(frames));
+    _pendingBatches.push_back(std::move(batch));
+}
+
+void EventsLoader::_cancelPrefetch()
+{
+    for (auto& batch : _pendingBatches)
+    {
+        batch.loaded.wait();
+        _freePowers->release(std::move(batch.powers), batch.capacity);
+    }
+    _pendingBatches.clear();
+    _requestedFrame = _currentFrame;
+}
+
 FlatInverseMapping EventsLoader::_computeInverseMapping() const
 {
     FlatInverseMapping mapping;
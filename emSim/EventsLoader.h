@@ -20,22 +20,45 @@
 #ifndef _EventsLoader_h_
 #define _EventsLoader_h_
 
+#include <emSim/CellMultipoles.h>
 #include <emSim/Events.h>
+#include <emSim/EventsMerge.h>
+#include <emSim/LowRankPowers.h>
+#include <emSim/SpatialOrder.h>
 
 #include <brain/brain.h>
 #include <brain/neuron/types.h>
 #include <brion/brion.h>
 
+#include <deque>
+#include <future>
+
 namespace ems
 {
 /** Tuple of buffer cell index, section ID, compartment counts */
 typedef std::tuple<uint32_t, uint32_t, uint16_t> MappingElement;
 typedef std::vector<MappingElement> FlatInverseMapping;
 
+/** Waits of loadNextFrames() for the report since the loader creation */
+struct LoadStats
+{
+    /** Number of batches of frames loaded */
+    size_t batches = 0u;
+    /** Number of batches which were not loaded yet when requested */
+    size_t stalls = 0u;
+    /** Time spent waiting for the batches which were not loaded yet */
+    double stallTime = 0.0;
+};
+
 /**
  * This class is responsible for events loading. The event's geometric
  * data is loaded once. The event's powers need to be reloaded for each new
  * time step.
+ *
+ * The powers of the next batches of frames are read and copied to the events'
+ * layout in the background while the current batch is used. Every batch has
+ * its own power buffer, which is swapped into the events when the batch is
+ * requested, so the report I/O overlaps the computations.
  */
 class EventsLoader
 {
@@ -48,10 +71,20 @@ public:
      * @param report the circuit report to be loaded
      * @param timeRange a 2d vector with the start and end times to be loaded
      * @param fraction Specify a percentage of gids to be loaded
+     * @param spatialOrder Sort the events along a Morton curve instead of
+     * keeping the report order
+     * @param mergeEvents Merge the events of a cell having the same position
+     * and radius, e.g. the compartments of a soma, into a single event
+     * @param prefetchDepth The number of batches of frames loaded in advance,
+     * 0 to load every batch when it is requested
      */
     EventsLoader(const std::string& filePath, const std::string& target,
                  const std::string& report, const glm::vec2& timeRange,
-                 const float fraction);
+                 const float fraction, const bool spatialOrder = false,
+                 const bool mergeEvents = true, const size_t prefetchDepth = 2u);
+
+    /** Wait for the batches of frames still being loaded. */
+    ~EventsLoader();
 
     /**
      * Update the events power values for the next frame.
@@ -59,6 +92,25 @@ public:
      */
     const Events& loadNextFrame();
 
+    /**
+     * Update the events power values for several consecutive frames at once.
+     * The powers of the i-th loaded frame are given by Events::getPowers(i),
+     * whose pointers change at every call. The next batches of nFrames
+     * frames are then prefetched, calling with another number of frames
+     * discards them.
+     * @param nFrames the number of frames to load, clamped to the number of
+     * remaining frames
+     * @return the events with updated power values
+     * @throw std::runtime_error if the report could not be read
+     */
+    const Events& loadNextFrames(size_t nFrames);
+
+    /**
+     * @return the number of frames loaded by the last call to
+     * loadNextFrame() or loadNextFrames().
+     */
+    size_t getLoadedFramesCount() const;
+
     /**
      * Return the currently loaded events without updating anything.
      * @return the events currently loaded.
@@ -90,13 +142,61 @@ public:
      */
     const std::string& getDataUnit() const;
 
+    /**
+     * Decompose the events' powers of all the time steps into a few basis
+     * power vectors. Every time step of the report is read twice, the frames
+     * loaded by loadNextFrame() are not affected.
+     * @param rank the maximum number of basis power vectors
+     * @param oversampling the number of additional random samples of the
+     * powers' range
+     * @return the decomposition of the powers
+     */
+    LowRankPowers computeLowRankPowers(size_t rank, size_t oversampling);
+
+    /**
+     * @return the events' range and soma position of every loaded cell.
+     */
+    const CellsEvents& getCellsEvents() const;
+
+    /**
+     * @return the report index of every loaded event, empty if the events
+     * are in report order. Also empty if events were merged, whether they are
+     * sorted or not: a loaded event then has several report indices, given
+     * by getEventsMerge() in the order of the loaded events.
+     */
+    const EventsOrder& getEventsOrder() const;
+
+    /**
+     * @return the report indices of the events merged into every loaded
+     * event, in the order of the loaded events, spatial or not. Empty if no
+     * events were merged, see getEventsOrder() then.
+     */
+    const EventsMerge& getEventsMerge() const;
+
+    /**
+     * @return the batches loaded and the time spent waiting for the report.
+     */
+    const LoadStats& getLoadStats() const;
+
 private:
+    /** Power values of consecutive frames, copied in the background */
+    struct FramesBatch
+    {
+        size_t nFrames = 0u;
+        size_t capacity = 0u;
+        AlignedFloatPtr powers;
+        std::future<void> loaded;
+    };
+
     void _loadStaticEventGeometry();
     void _computeStaticEventGeometry(const FlatInverseMapping& mapping,
                                      const brain::neuron::Morphologies& morphologies);
     void _validateTimeRange();
     void _validateCurrentReport(const brain::GIDSet& gidSet) const;
     FlatInverseMapping _computeInverseMapping() const;
+    void _copyPowers(const float* reportPowers, float* powers) const;
+    void _requestFrames(size_t nFrames);
+    void _cancelPrefetch();
 
     const brion::BlueConfig _bc;
     std::unique_ptr<brion::CompartmentReport> _report;
@@ -107,7 +207,17 @@ private:
     glm::vec2 _timeRange = glm::vec2(0.0f, 0.0f);
     EventsAABB _circuitAABB;
     std::unique_ptr<Events> _events;
+    CellsEvents _cells;
+    EventsOrder _eventsOrder;
+    EventsMerge _eventsMerge;
     uint32_t _currentFrame = 0u;
+    size_t _loadedFrames = 0u;
+
+    size_t _prefetchDepth = 0u;
+    uint32_t _requestedFrame = 0u;
+    std::deque<FramesBatch> _pendingBatches;
+    std::unique_ptr<PowersPool> _freePowers;
+    LoadStats _loadStats;
 };
 }
 #endif // _EventsLoader_h_
@@ -0,0 +1,129 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+
+#include <emSim/EventsMerge.h>
+#include <emSim/helpers.h>
+
+namespace ems
+{
+EventsMerge computeEventsMerge(const Events& events, CellsEvents& cells)
+{
+    const size_t nEvents = events.getEventsCount();
+    const float* positionsX = events.getPositionsX();
+    const float* positionsY = events.getPositionsY();
+    const float* positionsZ = events.getPositionsZ();
+    const float* radii = events.getRadii();
+    const auto key = [&](const uint32_t i) {
+        return std::make_tuple(positionsX[i], positionsY[i], positionsZ[i],
+                               radii[i]);
+    };
+
+    // Every event points to the first event of the cell with the same
+    // position and radius, itself if there is none. Only the events of a
+    // same cell are merged, so the cells stay contiguous.
+    std::vector<uint32_t> first(nEvents);
+    std::iota(first.begin(), first.end(), 0u);
+    parallelFor(cells.size(), [&](const size_t i) {
+        std::vector<uint32_t> sorted(cells[i].end - cells[i].begin);
+        std::iota(sorted.begin(), sorted.end(), cells[i].begin);
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [&](const uint32_t a, const uint32_t b) {
+                             return key(a) < key(b);
+                         });
+        for (size_t j = 1; j < sorted.size(); ++j)
+            if (key(sorted[j]) == key(sorted[j - 1]))
+                first[sorted[j]] = first[sorted[j - 1]];
+    });
+
+    // Merged index of every event and number of merged events before every
+    // event.
+    std::vector<uint32_t> mergedIndex(nEvents);
+    std::vector<uint32_t> mergedBefore(nEvents + 1, 0u);
+    uint32_t nMerged = 0u;
+    for (uint32_t i = 0; i < nEvents; ++i)
+    {
+        mergedIndex[i] = first[i] == i ? nMerged++ : mergedIndex[first[i]];
+        mergedBefore[i + 1] = nMerged;
+    }
+
+    EventsMerge merge;
+    merge.offsets.assign(nMerged + 1, 0u);
+    for (uint32_t i = 0; i < nEvents; ++i)
+        ++merge.offsets[mergedIndex[i] + 1];
+    std::partial_sum(merge.offsets.begin(), merge.offsets.end(),
+                     merge.offsets.begin());
+
+    merge.members.resize(nEvents);
+    std::vector<uint32_t> filled(merge.offsets.begin(),
+                                 merge.offsets.end() - 1);
+    for (uint32_t i = 0; i < nEvents; ++i)
+        merge.members[filled[mergedIndex[i]]++] = i;
+
+    for (auto& cell : cells)
+    {
+        cell.begin = mergedBefore[cell.begin];
+        cell.end = mergedBefore[cell.end];
+    }
+    return merge;
+}
+
+Events mergeEvents(const Events& events, const EventsMerge& merge)
+{
+    Events merged(merge.getEventsCount());
+    for (size_t i = 0; i < merge.getEventsCount(); ++i)
+    {
+        const uint32_t index = merge.members[merge.offsets[i]];
+        merged.addEvent(events.getPosition(index), events.getRadii()[index]);
+    }
+    return merged;
+}
+
+EventsMerge reorderEventsMerge(const EventsMerge& merge,
+                               const EventsOrder& order)
+{
+    EventsMerge reordered;
+    reordered.offsets.reserve(order.size() + 1);
+    reordered.members.reserve(merge.members.size());
+    reordered.offsets.push_back(0u);
+    for (const uint32_t index : order)
+    {
+        reordered.members.insert(
+            reordered.members.end(),
+            merge.members.begin() + merge.offsets[index],
+            merge.members.begin() + merge.offsets[index + 1]);
+        reordered.offsets.push_back(reordered.members.size());
+    }
+    return reordered;
+}
+
+void gatherSumPowers(const float* reportPowers, const EventsMerge& merge,
+                     float* powers)
+{
+    for (size_t i = 0; i < merge.getEventsCount(); ++i)
+    {
+        float power = 0.0f;
+        for (uint32_t j = merge.offsets[i]; j < merge.offsets[i + 1]; ++j)
+            power += reportPowers[merge.members[j]];
+        powers[i] = power;
+    }
+}
+}
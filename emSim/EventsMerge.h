@@ -0,0 +1,87 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _EventsMerge_h_
+#define _EventsMerge_h_
+
+#include <cstdint>
+#include <vector>
+
+#include <emSim/CellMultipoles.h>
+#include <emSim/Events.h>
+#include <emSim/SpatialOrder.h>
+
+namespace ems
+{
+/**
+ * Report indices of the events merged into every event of a layout: the
+ * power of the i-th event of the layout is the sum of the report powers of
+ * members[offsets[i]] to members[offsets[i + 1] - 1].
+ */
+struct EventsMerge
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> members;
+
+    /** @return the number of events of the layout */
+    size_t getEventsCount() const
+    {
+        return offsets.empty() ? 0u : offsets.size() - 1u;
+    }
+};
+
+/**
+ * Find the events of a cell having the same position and radius, e.g. the
+ * compartments of a soma. The distances to these events are identical, so
+ * each group can be replaced by a single event whose power is the sum of the
+ * group's powers without changing the results beyond the order of the sums.
+ * The merged events keep the order of their first member.
+ * @param events the events in report order
+ * @param cells the events' ranges of the cells in report order, updated to
+ * the ranges of the merged events
+ * @return the members of every merged event
+ */
+EventsMerge computeEventsMerge(const Events& events, CellsEvents& cells);
+
+/**
+ * @param events the events in report order
+ * @param merge the members of every merged event
+ * @return the geometric data of the merged events, with null powers
+ * @throw std::bad_alloc if memory allocation did not work.
+ */
+Events mergeEvents(const Events& events, const EventsMerge& merge);
+
+/**
+ * @param merge the members of every merged event
+ * @param order the index of every event of the new order in the merged
+ * layout, see computeSpatialOrder()
+ * @return the members of every merged event of the new order
+ */
+EventsMerge reorderEventsMerge(const EventsMerge& merge,
+                               const EventsOrder& order);
+
+/**
+ * Sum the powers of a frame from report order to a merged layout.
+ * @param reportPowers the powers in report order
+ * @param merge the members of every event of the layout
+ * @param powers the powers of the layout, merge.getEventsCount() values
+ */
+void gatherSumPowers(const float* reportPowers, const EventsMerge& merge,
+                     float* powers);
+}
+#endif // _EventsMerge_h_
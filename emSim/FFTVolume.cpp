@@ -0,0 +1,368 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <cmath>
+#include <iostream>
+
+#include <emSim/FFTVolume.h>
+#include <emSim/helpers.h>
+
+namespace ems
+{
+namespace
+{
+using Complex = std::complex<float>;
+
+uint32_t nextPowerOfTwo(const uint32_t value)
+{
+    uint32_t result = 1u;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
+
+// In place iterative radix-2 FFT, n must be a power of two
+void fft(Complex* data, const size_t n, const bool inverse)
+{
+    for (size_t i = 1, j = 0; i < n; ++i)
+    {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            std::swap(data[i], data[j]);
+    }
+
+    for (size_t length = 2; length <= n; length <<= 1)
+    {
+        const double angle = (inverse ? 2.0 : -2.0) * M_PI / length;
+        const std::complex<double> step(std::cos(angle), std::sin(angle));
+        for (size_t i = 0; i < n; i += length)
+        {
+            std::complex<double> twiddle(1.0, 0.0);
+            for (size_t j = 0; j < length / 2; ++j)
+            {
+                const Complex u = data[i + j];
+                const Complex v = data[i + j + length / 2] *
+                                  Complex(twiddle.real(), twiddle.imag());
+                data[i + j] = u + v;
+                data[i + j + length / 2] = u - v;
+                twiddle *= step;
+            }
+        }
+    }
+}
+
+// FFT of all the lines of a 3D grid along one axis. Only the lines whose
+// other coordinates are below the given limits are transformed.
+void fftLines(Complex* data, const glm::uvec3& size, const uint32_t axis,
+              const glm::uvec3& limits, const bool inverse)
+{
+    const size_t strides[3] = {1u, size.x, size_t(size.x) * size.y};
+    const uint32_t axis1 = axis == 0 ? 1 : 0;
+    const uint32_t axis2 = axis == 2 ? 1 : 2;
+    const size_t n = size[axis];
+    const size_t nLines = size_t(limits[axis1]) * limits[axis2];
+
+    parallelFor(nLines, [&](const size_t line) {
+        Complex* first = data + (line % limits[axis1]) * strides[axis1] +
+                         (line / limits[axis1]) * strides[axis2];
+        if (axis == 0)
+        {
+            fft(first, n, inverse);
+            return;
+        }
+
+        std::vector<Complex> buffer(n);
+        for (size_t i = 0; i < n; ++i)
+            buffer[i] = first[i * strides[axis]];
+        fft(buffer.data(), n, inverse);
+        for (size_t i = 0; i < n; ++i)
+            first[i * strides[axis]] = buffer[i];
+    });
+}
+}
+
+FFTVolume::FFTVolume(const Volume& volume, const Events& events,
+                     const uint32_t nearFieldVoxels)
+    : _volumeSize(volume.getSize())
+    , _gridSize(nextPowerOfTwo(2u * _volumeSize.x - 1u),
+                nextPowerOfTwo(2u * _volumeSize.y - 1u),
+                nextPowerOfTwo(2u * _volumeSize.z - 1u))
+    , _origin(volume.getOrigin())
+    , _voxelSize(volume.getVoxelSize())
+    , _nearFieldVoxels(nearFieldVoxels)
+{
+    const size_t gridCount = size_t(_gridSize.x) * _gridSize.y * _gridSize.z;
+    _kernelSpectrum.resize(gridCount);
+    _grid.resize(gridCount);
+
+    std::cout << "INFO: FFT grid size is [" << _gridSize.x << " "
+              << _gridSize.y << " " << _gridSize.z << "]" << std::endl;
+
+    // The kernel is laid out for a linear convolution: negative offsets wrap
+    // around, offsets beyond the volume size are never used. The inverse
+    // transform normalization is folded into the spectrum.
+    const float normalization = 1.0f / gridCount;
+    parallelFor(_gridSize.z, [&](const size_t z) {
+        for (size_t y = 0; y < _gridSize.y; ++y)
+        {
+            for (size_t x = 0; x < _gridSize.x; ++x)
+            {
+                const glm::uvec3 index(x, y, z);
+                glm::ivec3 offset;
+                bool used = true;
+                for (uint32_t i = 0; i < 3; ++i)
+                {
+                    if (index[i] < _volumeSize[i])
+                        offset[i] = index[i];
+                    else if (index[i] > _gridSize[i] - _volumeSize[i])
+                        offset[i] = int32_t(index[i]) - int32_t(_gridSize[i]);
+                    else
+                        used = false;
+                }
+                _kernelSpectrum[_gridIndex(x, y, z)] =
+                    used ? _gridKernel(offset) * normalization : 0.0f;
+            }
+        }
+    });
+    _transform(_kernelSpectrum, false, false);
+
+    // Cloud in cell deposition on the 8 grid nodes surrounding each event
+    const size_t nEvents = events.getEventsCount();
+    _slabSize = std::max(2u * _nearFieldVoxels, 1u);
+    _slabEvents.resize((_volumeSize.z - 1u) / _slabSize + 1u);
+
+    for (size_t i = 0; i < nEvents; ++i)
+    {
+        const glm::vec3 gridPos =
+            (events.getPosition(i) - _origin) / _voxelSize;
+
+        bool inside = true;
+        glm::ivec3 node;
+        glm::vec3 weight;
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            if (_volumeSize[j] < 2u || gridPos[j] < 0.0f ||
+                gridPos[j] > float(_volumeSize[j] - 1u))
+            {
+                inside = false;
+                break;
+            }
+            node[j] = std::min(int32_t(gridPos[j]),
+                               int32_t(_volumeSize[j]) - 2);
+            weight[j] = gridPos[j] - node[j];
+        }
+
+        if (!inside)
+        {
+            _outsideEvents.push_back(i);
+            _eventNodes.push_back(glm::ivec3(-1));
+            _eventWeights.push_back(glm::vec3(0.0f));
+            continue;
+        }
+        _eventNodes.push_back(node);
+        _eventWeights.push_back(weight);
+        _slabEvents[node.z / _slabSize].push_back(i);
+    }
+
+    if (!_outsideEvents.empty())
+        std::cout << "WARNING: " << _outsideEvents.size()
+                  << " events outside of the volume are summed exactly."
+                  << std::endl;
+}
+
+void FFTVolume::compute(const Events& events, Volume& volume,
+                        const size_t frame)
+{
+    const float* powers = events.getPowers(frame);
+    std::fill(_grid.begin(), _grid.end(), Complex(0.0f));
+
+    for (size_t i = 0; i < _eventNodes.size(); ++i)
+    {
+        const glm::ivec3& node = _eventNodes[i];
+        if (node.x < 0)
+            continue;
+
+        const glm::vec3& weight = _eventWeights[i];
+        for (uint32_t corner = 0; corner < 8; ++corner)
+        {
+            const uint32_t dx = corner & 1u;
+            const uint32_t dy = (corner >> 1) & 1u;
+            const uint32_t dz = (corner >> 2) & 1u;
+            const float w = (dx ? weight.x : 1.0f - weight.x) *
+                            (dy ? weight.y : 1.0f - weight.y) *
+                            (dz ? weight.z : 1.0f - weight.z);
+            _grid[_gridIndex(node.x + dx, node.y + dy, node.z + dz)] +=
+                w * powers[i];
+        }
+    }
+
+    _transform(_grid, false, true);
+    parallelFor(_gridSize.z, [&](const size_t z) {
+        const size_t planeSize = size_t(_gridSize.x) * _gridSize.y;
+        for (size_t i = z * planeSize; i < (z + 1) * planeSize; ++i)
+            _grid[i] *= _kernelSpectrum[i];
+    });
+    _transform(_grid, true, true);
+
+    float* data = volume.getData();
+    parallelFor(_volumeSize.z, [&](const size_t z) {
+        for (size_t y = 0; y < _volumeSize.y; ++y)
+        {
+            for (size_t x = 0; x < _volumeSize.x; ++x)
+                data[(z * _volumeSize.y + y) * _volumeSize.x + x] =
+                    _grid[_gridIndex(x, y, z)].real();
+        }
+    });
+
+    // Slabs of the same parity never touch the same voxels
+    if (_nearFieldVoxels > 0u)
+    {
+        for (size_t parity = 0; parity < 2; ++parity)
+        {
+            parallelFor((_slabEvents.size() + 1u - parity) / 2u,
+                        [&](const size_t i) {
+                            _correctNearField(events, powers, volume,
+                                              2u * i + parity);
+                        });
+        }
+    }
+
+    if (_outsideEvents.empty())
+        return;
+
+    const float* radii = events.getRadii();
+    parallelFor(size_t(_volumeSize.y) * _volumeSize.z, [&](const size_t row) {
+        const size_t y = row % _volumeSize.y;
+        const size_t z = row / _volumeSize.y;
+        for (size_t x = 0; x < _volumeSize.x; ++x)
+        {
+            const glm::vec3 voxelPos = _origin + glm::vec3(x, y, z) * _voxelSize;
+            float value = 0.0f;
+            for (const uint32_t i : _outsideEvents)
+            {
+                value += powers[i] /
+                         std::max(glm::length(voxelPos - events.getPosition(i)),
+                                  radii[i]);
+            }
+            data[row * _volumeSize.x + x] += Ec * value;
+        }
+    });
+}
+
+void FFTVolume::_correctNearField(const Events& events, const float* powers,
+                                  Volume& volume, const size_t slab) const
+{
+    const float* radii = events.getRadii();
+    float* data = volume.getData();
+    const int32_t extent = _nearFieldVoxels;
+
+    for (const uint32_t i : _slabEvents[slab])
+    {
+        const glm::ivec3& node = _eventNodes[i];
+        const glm::vec3& weight = _eventWeights[i];
+        const glm::vec3 pos = events.getPosition(i);
+
+        const glm::ivec3 first(std::max(node.x + 1 - extent, 0),
+                               std::max(node.y + 1 - extent, 0),
+                               std::max(node.z + 1 - extent, 0));
+        const glm::ivec3 last(
+            std::min(node.x + extent, int32_t(_volumeSize.x) - 1),
+            std::min(node.y + extent, int32_t(_volumeSize.y) - 1),
+            std::min(node.z + extent, int32_t(_volumeSize.z) - 1));
+
+        for (int32_t z = first.z; z <= last.z; ++z)
+        {
+            for (int32_t y = first.y; y <= last.y; ++y)
+            {
+                for (int32_t x = first.x; x <= last.x; ++x)
+                {
+                    const glm::ivec3 voxel(x, y, z);
+                    float gridValue = 0.0f;
+                    for (uint32_t corner = 0; corner < 8; ++corner)
+                    {
+                        const glm::ivec3 delta(corner & 1u, (corner >> 1) & 1u,
+                                               (corner >> 2) & 1u);
+                        const float w =
+                            (delta.x ? weight.x : 1.0f - weight.x) *
+                            (delta.y ? weight.y : 1.0f - weight.y) *
+                            (delta.z ? weight.z : 1.0f - weight.z);
+                        gridValue += w * _gridKernel(voxel - node - delta);
+                    }
+
+                    const glm::vec3 voxelPos =
+                        _origin + glm::vec3(voxel) * _voxelSize;
+                    const float exactValue =
+                        Ec / std::max(glm::length(voxelPos - pos), radii[i]);
+
+                    data[(size_t(z) * _volumeSize.y + y) * _volumeSize.x + x] +=
+                        powers[i] * (exactValue - gridValue);
+                }
+            }
+        }
+    }
+}
+
+float FFTVolume::_gridKernel(const glm::ivec3& offset) const
+{
+    // The kernel is regularized at the origin with half a voxel, the voxels
+    // close to the events are meant to be corrected by the near field.
+    const float minDist = 0.5f * std::min(_voxelSize.x,
+                                          std::min(_voxelSize.y, _voxelSize.z));
+    const float dist = glm::length(glm::vec3(offset) * _voxelSize);
+    return Ec / std::max(dist, minDist);
+}
+
+void FFTVolume::_transform(std::vector<Complex>& data, const bool inverse,
+                           const bool zeroPadded) const
+{
+    // A zero padded grid only has non zero values below the volume size, and
+    // only those values are needed from the inverse transform.
+    const glm::uvec3 limits = zeroPadded ? _volumeSize : _gridSize;
+    if (!inverse)
+    {
+        fftLines(data.data(), _gridSize, 0,
+                 glm::uvec3(0u, limits.y, limits.z), false);
+        fftLines(data.data(), _gridSize, 1,
+                 glm::uvec3(_gridSize.x, 0u, limits.z), false);
+        fftLines(data.data(), _gridSize, 2,
+                 glm::uvec3(_gridSize.x, _gridSize.y, 0u), false);
+        return;
+    }
+    fftLines(data.data(), _gridSize, 2,
+             glm::uvec3(_gridSize.x, _gridSize.y, 0u), true);
+    fftLines(data.data(), _gridSize, 1,
+             glm::uvec3(_gridSize.x, 0u, limits.z), true);
+    fftLines(data.data(), _gridSize, 0, glm::uvec3(0u, limits.y, limits.z),
+             true);
+}
+
+size_t FFTVolume::_gridIndex(const size_t x, const size_t y,
+                             const size_t z) const
+{
+    return (z * _gridSize.y + y) * _gridSize.x + x;
+}
+
+const glm::uvec3& FFTVolume::getGridSize() const
+{
+    return _gridSize;
+}
+}
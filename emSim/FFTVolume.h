@@ -0,0 +1,97 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _FFTVolume_h_
+#define _FFTVolume_h_
+
+#define GLM_FORCE_CTOR_INIT
+#include <glm/glm.hpp>
+
+#include <complex>
+#include <vector>
+
+#include <emSim/Events.h>
+#include <emSim/Volume.h>
+
+namespace ems
+{
+/**
+ * Computes a volume as the convolution of the events' powers, deposited on
+ * the voxel grid, with the 1/r point source kernel. The convolution is done
+ * with FFTs on a zero padded grid, which makes the cost of a frame
+ * O(N log N) in the number of voxels instead of voxels x events.
+ * The grid smooths the field close to the events, the voxels within a few
+ * voxels of each event can be corrected with the exact point source model.
+ * Events outside of the volume are summed exactly on every voxel.
+ */
+class FFTVolume
+{
+public:
+    /**
+     * Precompute the kernel spectrum and the events' grid coordinates.
+     * @param volume the volume to be computed, only its geometry is used
+     * @param events the events whose geometry is used
+     * @param nearFieldVoxels half size of the cube of voxels around each event
+     * that is computed exactly. 0 disables the correction.
+     * @throw std::bad_alloc if memory allocation did not work
+     */
+    FFTVolume(const Volume& volume, const Events& events,
+              uint32_t nearFieldVoxels = 2u);
+
+    /**
+     * Compute the volume for a frame.
+     * @param events the events used to create the engine
+     * @param volume the volume to fill, with the geometry given at creation
+     * @param frame the frame of the events to use
+     */
+    void compute(const Events& events, Volume& volume, size_t frame = 0u);
+
+    /** @return the size of the padded FFT grid. */
+    const glm::uvec3& getGridSize() const;
+
+private:
+    using Complex = std::complex<float>;
+
+    size_t _gridIndex(size_t x, size_t y, size_t z) const;
+    void _transform(std::vector<Complex>& data, bool inverse,
+                    bool zeroPadded) const;
+    float _gridKernel(const glm::ivec3& offset) const;
+    void _correctNearField(const Events& events, const float* powers,
+                           Volume& volume, size_t slab) const;
+
+    glm::uvec3 _volumeSize;
+    glm::uvec3 _gridSize;
+    glm::vec3 _origin;
+    glm::vec3 _voxelSize;
+    uint32_t _nearFieldVoxels = 0u;
+
+    std::vector<Complex> _kernelSpectrum;
+    std::vector<Complex> _grid;
+
+    // Lowest grid node and interpolation weights of the deposited events
+    std::vector<glm::ivec3> _eventNodes;
+    std::vector<glm::vec3> _eventWeights;
+    std::vector<uint32_t> _outsideEvents;
+
+    // Deposited events sorted by z slabs for the near field correction
+    uint32_t _slabSize = 1u;
+    std::vector<std::vector<uint32_t>> _slabEvents;
+};
+}
+#endif // _FFTVolume_h_
@@ -0,0 +1,333 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <emSim/FileWriter.h>
+
+namespace ems
+{
+namespace
+{
+void writeSynchronously(const std::string& fileName, const char* data,
+                        const size_t size)
+{
+    std::ofstream output(fileName, std::ios::out | std::ios::binary);
+    output.write(data, size);
+    output.close();
+    if (!output)
+        throw std::runtime_error("error: Cannot write " + fileName);
+}
+}
+
+FileWriter::FileWriter(const size_t buffers, const size_t threads,
+                       const size_t chunkSize)
+    : _chunkSize(std::max(chunkSize, size_t(1)))
+    , _maxBuffers(std::max(buffers, size_t(1)))
+{
+    for (size_t i = 0; i < std::max(threads, size_t(1)); ++i)
+        _threads.emplace_back(&FileWriter::_worker, this);
+}
+
+FileWriter::~FileWriter()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _doneCondition.wait(lock, [this] { return _pendingFiles == 0u; });
+        _stopping = true;
+    }
+    _workCondition.notify_all();
+    for (auto& thread : _threads)
+        thread.join();
+}
+
+WriteBuffer FileWriter::acquireBuffer(const size_t count)
+{
+    WriteBuffer buffer;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _throwError();
+        if (_freeBuffers.empty() && _allocatedBuffers >= _maxBuffers)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            _doneCondition.wait(lock, [this] {
+                return !_freeBuffers.empty() || !_error.empty();
+            });
+            const std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            _stats.stallTime += elapsed.count();
+            _throwError();
+        }
+
+        if (_freeBuffers.empty())
+            ++_allocatedBuffers;
+        else
+        {
+            buffer = std::move(_freeBuffers.back());
+            _freeBuffers.pop_back();
+        }
+    }
+
+    if (buffer.capacity < count)
+    {
+        buffer.data.reset();
+        buffer.capacity = 0u;
+        try
+        {
+            buffer.data.reset(alignedMalloc<float>(count));
+        }
+        catch (const std::bad_alloc&)
+        {
+            // The empty buffer keeps its place in the pool
+            std::lock_guard<std::mutex> lock(_mutex);
+            _freeBuffers.push_back(std::move(buffer));
+            throw;
+        }
+        buffer.capacity = count;
+    }
+    return buffer;
+}
+
+void FileWriter::write(const std::string& fileName, WriteBuffer buffer,
+                       const size_t count)
+{
+    std::shared_ptr<File> file(new File);
+    file->name = fileName;
+    file->buffer = std::move(buffer);
+    file->data = (const char*)file->buffer.data.get();
+    file->size = count * sizeof(float);
+    _queue(std::move(file));
+}
+
+void FileWriter::write(const std::string& fileName, std::string text)
+{
+    std::shared_ptr<File> file(new File);
+    file->name = fileName;
+    file->text = std::move(text);
+    file->data = file->text.data();
+    file->size = file->text.size();
+    _queue(std::move(file));
+}
+
+void FileWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _doneCondition.wait(lock, [this] { return _pendingFiles == 0u; });
+    _throwError();
+}
+
+WriteStats FileWriter::getStats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+void FileWriter::_queue(std::shared_ptr<File> file)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!_error.empty())
+    {
+        if (file->buffer.data)
+            _freeBuffers.push_back(std::move(file->buffer));
+        _doneCondition.notify_all();
+        _throwError();
+    }
+
+    const size_t nChunks =
+        std::max((file->size + _chunkSize - 1) / _chunkSize, size_t(1));
+    file->remainingChunks = nChunks;
+    for (size_t i = 0; i < nChunks; ++i)
+    {
+        Chunk chunk;
+        chunk.file = file;
+        chunk.offset = i * _chunkSize;
+        chunk.size = std::min(_chunkSize, file->size - chunk.offset);
+        _chunks.push_back(std::move(chunk));
+    }
+    ++_pendingFiles;
+    lock.unlock();
+    _workCondition.notify_all();
+}
+
+void FileWriter::_worker()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;)
+    {
+        _workCondition.wait(lock,
+                            [this] { return _stopping || !_chunks.empty(); });
+        if (_chunks.empty())
+            return;
+
+        const Chunk chunk = std::move(_chunks.front());
+        _chunks.pop_front();
+        lock.unlock();
+
+        double elapsed = 0.0;
+        File& file = *chunk.file;
+        if (_openFile(file))
+            _writeChunk(chunk, elapsed);
+
+        lock.lock();
+        _stats.writeTime += elapsed;
+        _stats.bytes += chunk.size;
+        if (--file.remainingChunks > 0u)
+            continue;
+
+        if (file.descriptor >= 0)
+        {
+            lock.unlock();
+            const bool closed = ::close(file.descriptor) == 0;
+            const int error = errno;
+            lock.lock();
+            if (!closed)
+                _setError("error: Cannot close " + file.name + ": " +
+                          std::strerror(error));
+        }
+        if (file.buffer.data)
+            _freeBuffers.push_back(std::move(file.buffer));
+        ++_stats.files;
+        --_pendingFiles;
+        _doneCondition.notify_all();
+    }
+}
+
+bool FileWriter::_openFile(File& file)
+{
+    // The threads writing the other chunks wait for the first one to open it
+    std::call_once(file.opened, [this, &file] {
+        file.descriptor =
+            ::open(file.name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (file.descriptor >= 0)
+            return;
+        const std::string reason = std::strerror(errno);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _setError("error: Cannot open " + file.name + ": " + reason);
+    });
+    return file.descriptor >= 0;
+}
+
+void FileWriter::_writeChunk(const Chunk& chunk, double& elapsed)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const File& file = *chunk.file;
+    size_t written = 0u;
+    while (written < chunk.size)
+    {
+        const ssize_t count =
+            ::pwrite(file.descriptor, file.data + chunk.offset + written,
+                     chunk.size - written, chunk.offset + written);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+        {
+            const std::string reason =
+                count < 0 ? std::strerror(errno) : "no space written";
+            std::lock_guard<std::mutex> lock(_mutex);
+            _setError("error: Cannot write " + file.name + ": " + reason);
+            break;
+        }
+        written += count;
+    }
+    const std::chrono::duration<double> duration =
+        std::chrono::steady_clock::now() - start;
+    elapsed = duration.count();
+}
+
+void FileWriter::_setError(const std::string& message)
+{
+    if (_error.empty())
+        _error = message;
+    _doneCondition.notify_all();
+}
+
+void FileWriter::_throwError()
+{
+    if (_error.empty())
+        return;
+    const std::string message = std::move(_error);
+    _error.clear();
+    throw std::runtime_error(message);
+}
+
+void writeFloatsFile(const std::string& fileName, const float* values,
+                     const size_t count, FileWriter* writer)
+{
+    if (!writer)
+    {
+        writeSynchronously(fileName, (const char*)values,
+                           count * sizeof(float));
+        return;
+    }
+
+    WriteBuffer buffer = writer->acquireBuffer(count);
+    parallelCopy(buffer.data.get(), values, count);
+    writer->write(fileName, std::move(buffer), count);
+}
+
+void writeTextFile(const std::string& fileName, std::string text,
+                   FileWriter* writer)
+{
+    if (writer)
+        writer->write(fileName, std::move(text));
+    else
+        writeSynchronously(fileName, text.data(), text.size());
+}
+
+std::string createMhdHeader(const std::vector<size_t>& size,
+                            const std::vector<float>& spacing,
+                            const std::vector<float>& offset,
+                            const std::string& rawFileName)
+{
+    const size_t nDims = size.size();
+    std::ostringstream header;
+    header << "ObjectType = Image\n"
+           << "NDims = " << nDims << "\n"
+           << "BinaryData = True\n"
+           << "BinaryDataByteOrderMSB = False\n"
+           << "CompressedData = False\n"
+           << "TransformMatrix =";
+    for (size_t i = 0; i < nDims * nDims; ++i)
+        header << (i % (nDims + 1) == 0 ? " 1" : " 0");
+    header << "\nOffset =";
+    for (const float value : offset)
+        header << " " << value;
+    header << "\nCenterOfRotation =";
+    for (size_t i = 0; i < nDims; ++i)
+        header << " 0";
+    header << "\nElementSpacing =";
+    for (const float value : spacing)
+        header << " " << value;
+    header << "\nDimSize =";
+    for (const size_t value : size)
+        header << " " << value;
+    header << "\nElementType = MET_FLOAT\n"
+           << "ElementDataFile = "
+           << rawFileName.substr(rawFileName.find_last_of('/') + 1) << "\n"
+           << std::endl;
+    return header.str();
+}
+}
@@ -0,0 +1,201 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _EMSim_FileWriter_h_
+#define _EMSim_FileWriter_h_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <emSim/helpers.h>
+
+namespace ems
+{
+/** Buffer of a FileWriter pool, filled by the caller and written in the
+ * background */
+struct WriteBuffer
+{
+    AlignedFloatPtr data;
+    /** Number of floats allocated */
+    size_t capacity = 0u;
+};
+
+/** Output done by a FileWriter since its creation */
+struct WriteStats
+{
+    /** Number of files written */
+    size_t files = 0u;
+    /** Number of bytes written */
+    size_t bytes = 0u;
+    /** Time spent by the writing threads in the system calls */
+    double writeTime = 0.0;
+    /** Time spent by the caller waiting for a free buffer */
+    double stallTime = 0.0;
+};
+
+/**
+ * Background writer of the output files, so that the computation of the next
+ * frame overlaps the output of the previous one.
+ *
+ * The binary files are written from buffers of a bounded pool: the caller
+ * gets a buffer with acquireBuffer(), fills it and queues it with write(). A
+ * large buffer is split into chunks written in parallel with pwrite() by the
+ * threads of the writer, and the buffer returns to the pool once its file is
+ * closed. When all the buffers are queued, acquireBuffer() blocks until one
+ * is written, which bounds the memory used by the pending outputs.
+ *
+ * The first error is kept and thrown by the next call to acquireBuffer(),
+ * write() or flush().
+ */
+class FileWriter
+{
+public:
+    /**
+     * @param buffers the number of buffers of the pool, at least 1
+     * @param threads the number of threads writing the chunks, at least 1
+     * @param chunkSize the size in bytes of the chunks written in parallel
+     */
+    FileWriter(size_t buffers = 2u, size_t threads = 4u,
+               size_t chunkSize = size_t(64) << 20);
+
+    /** Wait for the pending files, the errors are lost. */
+    ~FileWriter();
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    /**
+     * Get a buffer of the pool, waiting for a queued buffer to be written if
+     * all of them are in use.
+     * @param count the number of floats to store
+     * @return a buffer of at least count floats, uninitialized
+     * @throw std::runtime_error if a previous write failed
+     * @throw std::bad_alloc if memory allocation did not work.
+     */
+    WriteBuffer acquireBuffer(size_t count);
+
+    /**
+     * Queue the first values of a buffer for writing, the buffer returns to
+     * the pool once the file is written.
+     * @param fileName the path of the file, replaced if it exists
+     * @param buffer a buffer from acquireBuffer()
+     * @param count the number of floats to write
+     * @throw std::runtime_error if a previous write failed
+     */
+    void write(const std::string& fileName, WriteBuffer buffer, size_t count);
+
+    /**
+     * Queue a text file for writing, outside of the buffers of the pool.
+     * @param fileName the path of the file, replaced if it exists
+     * @param text the content of the file
+     * @throw std::runtime_error if a previous write failed
+     */
+    void write(const std::string& fileName, std::string text);
+
+    /**
+     * Wait for all the queued files to be written.
+     * @throw std::runtime_error if a write failed since the last flush
+     */
+    void flush();
+
+    /** @return the output done so far, to be called after flush() */
+    WriteStats getStats() const;
+
+private:
+    // A file being written, opened by the thread writing its first chunk
+    // and closed by the thread writing its last chunk, out of the lock as
+    // these are slow on parallel filesystems
+    struct File
+    {
+        std::string name;
+        WriteBuffer buffer;
+        std::string text;
+        const char* data = nullptr;
+        size_t size = 0u;
+        std::once_flag opened;
+        int descriptor = -1;
+        size_t remainingChunks = 0u;
+    };
+
+    struct Chunk
+    {
+        std::shared_ptr<File> file;
+        size_t offset = 0u;
+        size_t size = 0u;
+    };
+
+    void _queue(std::shared_ptr<File> file);
+    void _worker();
+    bool _openFile(File& file);
+    void _writeChunk(const Chunk& chunk, double& elapsed);
+    void _setError(const std::string& message);
+    void _throwError();
+
+    const size_t _chunkSize;
+    const size_t _maxBuffers;
+    std::vector<std::thread> _threads;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _workCondition;
+    std::condition_variable _doneCondition;
+    std::deque<Chunk> _chunks;
+    std::vector<WriteBuffer> _freeBuffers;
+    size_t _allocatedBuffers = 0u;
+    size_t _pendingFiles = 0u;
+    bool _stopping = false;
+    std::string _error;
+    WriteStats _stats;
+};
+
+/**
+ * Write a binary file of floats, queued in the writer if not null, written
+ * synchronously otherwise. The values are copied, they can be modified as
+ * soon as the function returns.
+ * @throw std::runtime_error if the file can not be written
+ */
+void writeFloatsFile(const std::string& fileName, const float* values,
+                     size_t count, FileWriter* writer);
+
+/**
+ * Write a text file, queued in the writer if not null, written synchronously
+ * otherwise.
+ * @throw std::runtime_error if the file can not be written
+ */
+void writeTextFile(const std::string& fileName, std::string text,
+                   FileWriter* writer);
+
+/**
+ * @param size the number of values along every dimension, x first
+ * @param spacing the distance between two values along every dimension
+ * @param offset the position of the first value
+ * @param rawFileName the raw floats file, referred to by its name only as
+ * the header is next to it
+ * @return the MetaImage header of a raw floats file
+ */
+std::string createMhdHeader(const std::vector<size_t>& size,
+                            const std::vector<float>& spacing,
+                            const std::vector<float>& offset,
+                            const std::string& rawFileName);
+}
+#endif // _EMSim_FileWriter_h_
@@ -0,0 +1,508 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+
+#include <hdf5.h>
+#include <zlib.h>
+
+#include <emSim/HDF5Output.h>
+#include <emSim/ThreadPool.h>
+
+namespace ems
+{
+namespace
+{
+template <typename T>
+T check(const T result, const std::string& message)
+{
+    if (result < 0)
+        throw std::runtime_error("error: " + message);
+    return result;
+}
+
+// A chunk of a block, compressed or not
+struct Chunk
+{
+    hsize_t offset[4];
+    std::vector<unsigned char> data;
+    uint32_t filters = 0u;
+};
+}
+
+void parseHDF5Chunks(const std::string& shape, HDF5Config& config)
+{
+    std::vector<size_t> values;
+    std::istringstream stream(shape);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        size_t end = 0u;
+        try
+        {
+            values.push_back(std::stoul(item, &end));
+        }
+        catch (const std::exception&)
+        {
+            end = 0u;
+        }
+        if (end == 0u || end != item.size())
+            break;
+    }
+    if (values.size() != 4u || values[0] == 0u || !stream.eof())
+        throw std::runtime_error("ERROR: Cannot parse the chunk shape '" +
+                                 shape + "', expected frames,x,y,z");
+    config.chunkFrames = values[0];
+    config.chunkSize = glm::uvec3(values[1], values[2], values[3]);
+}
+
+HDF5Output::HDF5Output(const std::string& fileName, const HDF5Config& config)
+    : _config(config)
+{
+    // The chunks are written by the background thread while Brion may read
+    // an HDF5 report from its own threads, only a thread-safe build
+    // serializes the two.
+    hbool_t threadSafe = false;
+    if (H5is_library_threadsafe(&threadSafe) < 0 || !threadSafe)
+        throw std::runtime_error(
+            "error: The HDF5 output needs an HDF5 library built with "
+            "--enable-threadsafe");
+
+    // The errors are reported by the exceptions, not printed by HDF5
+    H5E_BEGIN_TRY
+    {
+        _file = H5Fcreate(fileName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
+                          H5P_DEFAULT);
+    }
+    H5E_END_TRY;
+    check(_file, "Cannot create " + fileName);
+
+    // The writing thread compresses too
+    for (size_t i = 1; i < _config.threads; ++i)
+        _compressThreads.emplace_back(&HDF5Output::_compressor, this);
+    _thread = std::thread(&HDF5Output::_worker, this);
+}
+
+HDF5Output::~HDF5Output()
+{
+    try
+    {
+        flush();
+    }
+    catch (...)
+    {
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _workCondition.notify_all();
+    _thread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(_compressMutex);
+        _stoppingCompressors = true;
+    }
+    _compressCondition.notify_all();
+    for (auto& thread : _compressThreads)
+        thread.join();
+
+    H5E_BEGIN_TRY
+    {
+        for (const auto& dataset : _datasets)
+            H5Dclose(dataset->id);
+        H5Fclose(_file);
+    }
+    H5E_END_TRY;
+}
+
+size_t HDF5Output::createDataset(const std::string& name,
+                                 const std::vector<size_t>& frameSize,
+                                 const size_t nFrames)
+{
+    if (frameSize.empty() || frameSize.size() > 3u)
+        throw std::runtime_error("error: Cannot create dataset " + name +
+                                 ". Wrong number of dimensions.");
+
+    std::unique_ptr<Dataset> dataset(new Dataset);
+    dataset->rank = frameSize.size() + 1u;
+    dataset->size[0] = nFrames;
+    dataset->chunk[0] = std::max(std::min(_config.chunkFrames, nFrames),
+                                 size_t(1));
+    for (size_t i = 0; i < 3u; ++i)
+    {
+        const size_t size = i < frameSize.size() ? frameSize[i] : 1u;
+        const size_t chunk = _config.chunkSize[i];
+        dataset->size[3 - i] = size;
+        dataset->chunk[3 - i] =
+            std::max(chunk == 0u ? size : std::min(chunk, size), size_t(1));
+    }
+
+    size_t chunkBytes = sizeof(float);
+    hsize_t dims[4];
+    hsize_t chunkDims[4];
+    for (size_t i = 0; i < dataset->rank; ++i)
+    {
+        // The missing dimensions are the first ones of z, y, x
+        const size_t index = i == 0 ? 0 : i + 4 - dataset->rank;
+        dims[i] = dataset->size[index];
+        chunkDims[i] = dataset->chunk[index];
+        chunkBytes *= dataset->chunk[index];
+    }
+    if (chunkBytes >= (size_t(1) << 32))
+        throw std::runtime_error("error: Cannot create dataset " + name +
+                                 ". Chunks larger than 4 GB.");
+
+    H5E_BEGIN_TRY
+    {
+        const hid_t space = H5Screate_simple(dataset->rank, dims, nullptr);
+        const hid_t properties = H5Pcreate(H5P_DATASET_CREATE);
+        H5Pset_chunk(properties, dataset->rank, chunkDims);
+        if (_config.compression > 0)
+            H5Pset_deflate(properties, _config.compression);
+        dataset->id = H5Dcreate2(_file, name.c_str(), H5T_IEEE_F32LE, space,
+                                 H5P_DEFAULT, properties, H5P_DEFAULT);
+        H5Pclose(properties);
+        H5Sclose(space);
+    }
+    H5E_END_TRY;
+    check(dataset->id, "Cannot create dataset " + name);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _datasets.push_back(std::move(dataset));
+    return _datasets.size() - 1u;
+}
+
+void HDF5Output::setAttribute(const std::string& object,
+                              const std::string& name, const std::string& value)
+{
+    herr_t status = -1;
+    H5E_BEGIN_TRY
+    {
+        const hid_t id = H5Oopen(_file, object.c_str(), H5P_DEFAULT);
+        const hid_t type = H5Tcopy(H5T_C_S1);
+        H5Tset_size(type, std::max(value.size(), size_t(1)));
+        const hid_t space = H5Screate(H5S_SCALAR);
+        const hid_t attribute = H5Acreate2(id, name.c_str(), type, space,
+                                           H5P_DEFAULT, H5P_DEFAULT);
+        if (attribute >= 0)
+        {
+            status = H5Awrite(attribute, type, value.c_str());
+            H5Aclose(attribute);
+        }
+        H5Sclose(space);
+        H5Tclose(type);
+        H5Oclose(id);
+    }
+    H5E_END_TRY;
+    check(status, "Cannot write attribute " + name + " of " + object);
+}
+
+void HDF5Output::setAttribute(const std::string& object,
+                              const std::string& name,
+                              const std::vector<double>& values)
+{
+    herr_t status = -1;
+    H5E_BEGIN_TRY
+    {
+        const hid_t id = H5Oopen(_file, object.c_str(), H5P_DEFAULT);
+        const hsize_t size = values.size();
+        const hid_t space = H5Screate_simple(1, &size, nullptr);
+        const hid_t attribute = H5Acreate2(id, name.c_str(), H5T_IEEE_F64LE,
+                                           space, H5P_DEFAULT, H5P_DEFAULT);
+        if (attribute >= 0)
+        {
+            status = H5Awrite(attribute, H5T_NATIVE_DOUBLE, values.data());
+            H5Aclose(attribute);
+        }
+        H5Sclose(space);
+        H5Oclose(id);
+    }
+    H5E_END_TRY;
+    check(status, "Cannot write attribute " + name + " of " + object);
+}
+
+float* HDF5Output::beginFrame(const size_t index, const size_t frame)
+{
+    Dataset& dataset = *_datasets.at(index);
+    if (frame >= dataset.size[0])
+        throw std::runtime_error("error: Frame " + std::to_string(frame) +
+                                 " out of the dataset");
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _throwError();
+    }
+
+    const size_t frameValues =
+        dataset.size[1] * dataset.size[2] * dataset.size[3];
+    const size_t firstFrame = frame / dataset.chunk[0] * dataset.chunk[0];
+    Block& block = dataset.block;
+    if (!block.values.empty() && block.firstFrame != firstFrame)
+        _queueBlock(index);
+    if (block.values.empty())
+    {
+        block.firstFrame = firstFrame;
+        block.nFrames = std::min(dataset.chunk[0], dataset.size[0] - firstFrame);
+        block.values.assign(block.nFrames * frameValues, 0.0f);
+        dataset.filledFrames = 0u;
+    }
+    return block.values.data() + (frame - firstFrame) * frameValues;
+}
+
+void HDF5Output::endFrame(const size_t index, const size_t)
+{
+    Dataset& dataset = *_datasets.at(index);
+    if (++dataset.filledFrames == dataset.block.nFrames)
+        _queueBlock(index);
+}
+
+void HDF5Output::writeFrame(const size_t dataset, const size_t frame,
+                            const float* values)
+{
+    const Dataset& data = *_datasets.at(dataset);
+    parallelCopy(beginFrame(dataset, frame), values,
+                 data.size[1] * data.size[2] * data.size[3]);
+    endFrame(dataset, frame);
+}
+
+void HDF5Output::flush()
+{
+    for (size_t i = 0; i < _datasets.size(); ++i)
+        if (!_datasets[i]->block.values.empty())
+            _queueBlock(i);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _doneCondition.wait(lock, [this] { return _blocks.empty() && !_busy; });
+    herr_t status = -1;
+    H5E_BEGIN_TRY
+    {
+        status = H5Fflush(_file, H5F_SCOPE_GLOBAL);
+    }
+    H5E_END_TRY;
+    if (status < 0)
+        _setError("error: Cannot flush the HDF5 file");
+    _throwError();
+}
+
+HDF5Stats HDF5Output::getStats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+void HDF5Output::_queueBlock(const size_t index)
+{
+    Dataset& dataset = *_datasets[index];
+    Block block = std::move(dataset.block);
+    block.dataset = index;
+    dataset.block = Block();
+    dataset.filledFrames = 0u;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_blocks.size() >= std::max(_config.queuedBlocks, size_t(1)))
+    {
+        const auto start = std::chrono::steady_clock::now();
+        _doneCondition.wait(lock, [this] {
+            return _blocks.size() < std::max(_config.queuedBlocks, size_t(1));
+        });
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        _stats.stallTime += elapsed.count();
+    }
+    _blocks.push_back(std::move(block));
+    lock.unlock();
+    _workCondition.notify_all();
+}
+
+void HDF5Output::_worker()
+{
+    // The errors of this thread are reported by flush()
+    H5Eset_auto2(H5E_DEFAULT, nullptr, nullptr);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;)
+    {
+        _workCondition.wait(lock,
+                            [this] { return _stopping || !_blocks.empty(); });
+        if (_blocks.empty())
+            return;
+
+        const Block block = std::move(_blocks.front());
+        _blocks.pop_front();
+        const Dataset& dataset = *_datasets[block.dataset];
+        _busy = true;
+        // A free place in the queue
+        _doneCondition.notify_all();
+        lock.unlock();
+
+        try
+        {
+            _writeBlock(block, dataset);
+        }
+        catch (const std::exception& e)
+        {
+            std::lock_guard<std::mutex> errorLock(_mutex);
+            _setError(e.what());
+        }
+
+        lock.lock();
+        _busy = false;
+        _doneCondition.notify_all();
+    }
+}
+
+void HDF5Output::_compress(const std::function<void()>& work)
+{
+    {
+        std::lock_guard<std::mutex> lock(_compressMutex);
+        _compressWork = &work;
+        _activeCompressors = _compressThreads.size();
+        ++_compressGeneration;
+    }
+    _compressCondition.notify_all();
+    work();
+
+    std::unique_lock<std::mutex> lock(_compressMutex);
+    _compressedCondition.wait(lock, [this] { return _activeCompressors == 0u; });
+    _compressWork = nullptr;
+}
+
+void HDF5Output::_compressor()
+{
+    size_t generation = 0u;
+    std::unique_lock<std::mutex> lock(_compressMutex);
+    for (;;)
+    {
+        _compressCondition.wait(lock, [&] {
+            return _stoppingCompressors || _compressGeneration != generation;
+        });
+        if (_compressGeneration == generation)
+            return;
+
+        generation = _compressGeneration;
+        const std::function<void()>& work = *_compressWork;
+        lock.unlock();
+        work();
+        lock.lock();
+        if (--_activeCompressors == 0u)
+            _compressedCondition.notify_all();
+    }
+}
+
+void HDF5Output::_writeBlock(const Block& block, const Dataset& dataset)
+{
+    const size_t* size = dataset.size;
+    const size_t* chunk = dataset.chunk;
+    const size_t nChunks[3] = {(size[1] + chunk[1] - 1) / chunk[1],
+                               (size[2] + chunk[2] - 1) / chunk[2],
+                               (size[3] + chunk[3] - 1) / chunk[3]};
+    const size_t chunkCount = nChunks[0] * nChunks[1] * nChunks[2];
+    const size_t chunkValues = chunk[0] * chunk[1] * chunk[2] * chunk[3];
+    std::vector<Chunk> chunks(chunkCount);
+
+    // Every thread gathers the values of its chunks, padded with zeros up to
+    // the full chunk size as HDF5 expects, and compresses them
+    std::atomic<size_t> next(0u);
+    const auto work = [&] {
+        std::vector<float> values(chunkValues);
+        for (size_t i = next++; i < chunkCount; i = next++)
+        {
+            const size_t start[4] = {block.firstFrame,
+                                     i / (nChunks[1] * nChunks[2]) * chunk[1],
+                                     i / nChunks[2] % nChunks[1] * chunk[2],
+                                     i % nChunks[2] * chunk[3]};
+            std::fill(values.begin(), values.end(), 0.0f);
+            const size_t countX = std::min(chunk[3], size[3] - start[3]);
+            for (size_t t = 0; t < block.nFrames; ++t)
+                for (size_t z = 0; z < std::min(chunk[1], size[1] - start[1]);
+                     ++z)
+                    for (size_t y = 0;
+                         y < std::min(chunk[2], size[2] - start[2]); ++y)
+                    {
+                        const float* source =
+                            block.values.data() +
+                            ((t * size[1] + start[1] + z) * size[2] +
+                             start[2] + y) *
+                                size[3] +
+                            start[3];
+                        std::copy(source, source + countX,
+                                  values.data() +
+                                      ((t * chunk[1] + z) * chunk[2] + y) *
+                                          chunk[3]);
+                    }
+
+            Chunk& output = chunks[i];
+            for (size_t j = 0; j < dataset.rank; ++j)
+                output.offset[j] = start[j == 0 ? 0 : j + 4 - dataset.rank];
+
+            const unsigned char* raw = (const unsigned char*)values.data();
+            const size_t rawSize = chunkValues * sizeof(float);
+            if (_config.compression > 0)
+            {
+                uLongf compressedSize = compressBound(rawSize);
+                output.data.resize(compressedSize);
+                if (compress2(output.data.data(), &compressedSize, raw,
+                              rawSize, _config.compression) == Z_OK &&
+                    compressedSize < rawSize)
+                {
+                    output.data.resize(compressedSize);
+                    continue;
+                }
+                // Stored as is, the deflate filter being skipped
+                output.filters = 1u;
+            }
+            output.data.assign(raw, raw + rawSize);
+        }
+    };
+    _compress(work);
+
+    size_t storedBytes = 0u;
+    for (const auto& output : chunks)
+    {
+        check(H5Dwrite_chunk(dataset.id, H5P_DEFAULT, output.filters,
+                             output.offset, output.data.size(),
+                             output.data.data()),
+              "Cannot write a chunk to the HDF5 file");
+        storedBytes += output.data.size();
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.chunks += chunkCount;
+    _stats.bytes += block.values.size() * sizeof(float);
+    _stats.storedBytes += storedBytes;
+}
+
+void HDF5Output::_setError(const std::string& message)
+{
+    if (_error.empty())
+        _error = message;
+}
+
+void HDF5Output::_throwError()
+{
+    if (_error.empty())
+        return;
+    const std::string message = std::move(_error);
+    _error.clear();
+    throw std::runtime_error(message);
+}
+}
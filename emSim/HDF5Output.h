@@ -0,0 +1,227 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _EMSim_HDF5Output_h_
+#define _EMSim_HDF5Output_h_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define GLM_FORCE_CTOR_INIT
+#include <glm/glm.hpp>
+
+namespace ems
+{
+/** Storage of the datasets of an HDF5Output */
+struct HDF5Config
+{
+    /**
+     * Number of frames per chunk. 1 suits reading whole frames, a larger
+     * number with small chunkSize suits reading the time series of a few
+     * voxels or sample points, at the cost of keeping that many frames in
+     * memory until their chunks are complete.
+     */
+    size_t chunkFrames = 1u;
+    /**
+     * Number of values per chunk along x, y and z of a frame, 0 for the whole
+     * dimension. The components beyond the dimensions of a dataset are
+     * ignored.
+     */
+    glm::uvec3 chunkSize = glm::uvec3(0u);
+    /** zlib level of the deflate filter, 0 to store the chunks uncompressed */
+    int compression = 0;
+    /** Number of threads compressing the chunks, the writing one included */
+    size_t threads = 4u;
+    /** Number of complete rows of chunks queued before writeFrame() waits */
+    size_t queuedBlocks = 2u;
+};
+
+/**
+ * @param shape the chunk shape as "frames,x,y,z", e.g. "1,0,0,0" for whole
+ * frames or "256,8,8,8" for time series
+ * @param config the configuration to update
+ * @throw std::runtime_error if the shape can not be parsed
+ */
+void parseHDF5Chunks(const std::string& shape, HDF5Config& config);
+
+/** Output done by an HDF5Output since its creation */
+struct HDF5Stats
+{
+    /** Number of chunks written */
+    size_t chunks = 0u;
+    /** Size of the values written, before compression */
+    size_t bytes = 0u;
+    /** Size of the chunks written, after compression */
+    size_t storedBytes = 0u;
+    /** Time spent by the caller waiting for the queue */
+    double stallTime = 0.0;
+};
+
+/**
+ * HDF5 file of time series datasets, one frame after the other along the
+ * first dimension of each dataset and x being the last, fastest dimension.
+ *
+ * The frames are gathered by row of chunks of config.chunkFrames frames. A
+ * complete row is queued to a background thread which splits it in chunks,
+ * compresses them in parallel and writes them with H5Dwrite_chunk(), so that
+ * the compression is off the compute thread. The compression runs on
+ * persistent threads of the HDF5Output, started with it, rather than on the
+ * ThreadPool: the pool runs one loop at a time and would stall the
+ * computation of the next frames. The chunks are standard deflate
+ * chunks, readable by any HDF5 reader.
+ *
+ * The first error is kept and thrown by the next call to beginFrame(),
+ * writeFrame() or flush().
+ *
+ * A thread-safe build of HDF5 is required, the compartment reports being
+ * read by Brion from other threads while the chunks are written.
+ */
+class HDF5Output
+{
+public:
+    /**
+     * Create the file, replaced if it exists.
+     * @throw std::runtime_error if the file can not be created, or if the
+     * HDF5 library is not thread-safe
+     */
+    HDF5Output(const std::string& fileName, const HDF5Config& config);
+
+    /** Write the queued frames and close the file, the errors are lost. */
+    ~HDF5Output();
+
+    HDF5Output(const HDF5Output&) = delete;
+    HDF5Output& operator=(const HDF5Output&) = delete;
+
+    /**
+     * Create a dataset of nFrames frames.
+     * @param name the name of the dataset in the root group
+     * @param frameSize the number of values of a frame along x, y and z, 1 to
+     * 3 dimensions
+     * @param nFrames the number of frames
+     * @return the index of the dataset
+     * @throw std::runtime_error if the dataset can not be created
+     */
+    size_t createDataset(const std::string& name,
+                         const std::vector<size_t>& frameSize, size_t nFrames);
+
+    /**
+     * Set an attribute of the root group, or of a dataset.
+     * @param object "/" or the name of a dataset
+     * @throw std::runtime_error if the attribute can not be written
+     */
+    void setAttribute(const std::string& object, const std::string& name,
+                      const std::string& value);
+    void setAttribute(const std::string& object, const std::string& name,
+                      const std::vector<double>& values);
+
+    /**
+     * @param dataset the index of the dataset
+     * @param frame the index of the frame
+     * @return the buffer of the values of the frame, to be filled before
+     * calling endFrame()
+     * @throw std::runtime_error if a previous write failed
+     */
+    float* beginFrame(size_t dataset, size_t frame);
+
+    /**
+     * Mark a frame filled, queuing its row of chunks once complete.
+     * @param dataset the index of the dataset
+     * @param frame the index of the frame given to beginFrame()
+     */
+    void endFrame(size_t dataset, size_t frame);
+
+    /**
+     * Copy a whole frame, see beginFrame() and endFrame().
+     * @throw std::runtime_error if a previous write failed
+     */
+    void writeFrame(size_t dataset, size_t frame, const float* values);
+
+    /**
+     * Queue the incomplete rows of chunks, the missing frames being null,
+     * and wait for all the chunks to be written.
+     * @throw std::runtime_error if a write failed since the last flush
+     */
+    void flush();
+
+    /** @return the output done so far, to be called after flush() */
+    HDF5Stats getStats() const;
+
+private:
+    // Frames of a dataset sharing the same chunks, x fastest then y, z and t
+    struct Block
+    {
+        size_t dataset = 0u;
+        size_t firstFrame = 0u;
+        size_t nFrames = 0u;
+        std::vector<float> values;
+    };
+
+    struct Dataset
+    {
+        int64_t id = -1;
+        size_t rank = 0u;
+        // Sizes and chunk sizes along t, z, y and x, 1 for the missing
+        // dimensions
+        size_t size[4];
+        size_t chunk[4];
+        Block block;
+        size_t filledFrames = 0u;
+    };
+
+    void _queueBlock(size_t index);
+    void _worker();
+    void _compress(const std::function<void()>& work);
+    void _compressor();
+    void _writeBlock(const Block& block, const Dataset& dataset);
+    void _setError(const std::string& message);
+    void _throwError();
+
+    const HDF5Config _config;
+    int64_t _file = -1;
+    std::vector<std::unique_ptr<Dataset>> _datasets;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _workCondition;
+    std::condition_variable _doneCondition;
+    std::deque<Block> _blocks;
+    bool _busy = false;
+    bool _stopping = false;
+    std::string _error;
+    HDF5Stats _stats;
+    std::thread _thread;
+
+    // Threads running the compression of a row with the writing thread
+    std::vector<std::thread> _compressThreads;
+    std::mutex _compressMutex;
+    std::condition_variable _compressCondition;
+    std::condition_variable _compressedCondition;
+    const std::function<void()>* _compressWork = nullptr;
+    size_t _compressGeneration = 0u;
+    size_t _activeCompressors = 0u;
+    bool _stoppingCompressors = false;
+};
+}
+#endif // _EMSim_HDF5Output_h_
@@ -0,0 +1,46 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <emSim/ISPCTarget.h>
+
+#ifdef EMSIM_USE_ISPC
+#include <emSim/ComputeVolume.h>
+#endif
+
+namespace ems
+{
+std::string getISPCTarget()
+{
+#ifdef EMSIM_USE_ISPC
+    // Same values as the TARGET_ defines of ComputeVolume.ispc
+    static const char* names[] = {"unknown", "sse4", "avx", "avx2",
+                                  "avx512knl", "avx512skx"};
+
+    int32_t isa = 0;
+    int32_t width = 0;
+    ispc::GetTarget_ispc(&isa, &width);
+    if (isa < 0 || isa >= int32_t(sizeof(names) / sizeof(names[0])))
+        isa = 0;
+    return std::string(names[isa]) + " (" + std::to_string(width) +
+           " lanes)";
+#else
+    return "none";
+#endif
+}
+}
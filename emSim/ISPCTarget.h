@@ -0,0 +1,35 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _ISPCTarget_h_
+#define _ISPCTarget_h_
+
+#include <string>
+
+namespace ems
+{
+/**
+ * The ISPC kernels are compiled for every target of EMSIM_ISPC_TARGETS and
+ * the best instruction set supported by the CPU is picked at runtime.
+ * @return the name and SIMD width of the target used by the kernels, e.g.
+ * "avx2 (8 lanes)", or "none" without the ISPC kernels (EMSIM_USE_ISPC).
+ */
+std::string getISPCTarget();
+}
+#endif // _ISPCTarget_h_
@@ -0,0 +1,92 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Task system entry points called by the ispc generated code for the launch
+// and sync statements, running the tasks on the thread pool of the library.
+
+#include "ThreadPool.h"
+#include "helpers.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace
+{
+typedef void (*TaskFunction)(void* data, int threadIndex, int threadCount,
+                             int taskIndex, int taskCount, int taskIndex0,
+                             int taskIndex1, int taskIndex2, int taskCount0,
+                             int taskCount1, int taskCount2);
+
+// Arguments of the tasks launched by an ispc function, freed on sync
+struct TaskGroup
+{
+    std::vector<std::unique_ptr<char[], ems::AlignedMemoryDeleter<char>>>
+        allocations;
+};
+
+TaskGroup* getTaskGroup(void** handlePtr)
+{
+    if (!*handlePtr)
+        *handlePtr = new TaskGroup;
+    return static_cast<TaskGroup*>(*handlePtr);
+}
+}
+
+extern "C" {
+// ispc asks for the alignment of its vectors, at most the 64 bytes of AVX-512
+void* ISPCAlloc(void** handlePtr, const int64_t size, int32_t)
+{
+    TaskGroup* group = getTaskGroup(handlePtr);
+    group->allocations.emplace_back(ems::alignedMalloc<char>(size_t(size)));
+    return group->allocations.back().get();
+}
+
+// The tasks are run to completion before returning, which ispc allows as
+// they only need to be done when the launching function syncs.
+void ISPCLaunch(void** handlePtr, void* func, void* data, const int countX,
+                const int countY, const int countZ)
+{
+    getTaskGroup(handlePtr);
+
+    const TaskFunction task = reinterpret_cast<TaskFunction>(func);
+    const int count = countX * countY * countZ;
+    ems::ThreadPool& pool = ems::ThreadPool::getInstance();
+    const int nThreads = int(pool.getThreadsCount());
+
+    pool.parallelFor(size_t(count), [&](const size_t index,
+                                        const size_t threadIndex) {
+        const int i = int(index);
+        task(data, int(threadIndex), nThreads, i, count, i % countX,
+             (i / countX) % countY, i / (countX * countY), countX, countY,
+             countZ);
+    });
+}
+
+// Lets the kernels size their launches and buffers for the pool
+int32_t ISPCThreadsCount()
+{
+    return int32_t(ems::ThreadPool::getInstance().getThreadsCount());
+}
+
+void ISPCSync(void* handle)
+{
+    delete static_cast<TaskGroup*>(handle);
+}
+}
@@ -0,0 +1,132 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <cmath>
+#include <cstring>
+
+#include <emSim/IncrementalEvents.h>
+
+namespace ems
+{
+IncrementalEvents::IncrementalEvents(const Events& events,
+                                     const float threshold,
+                                     const size_t refreshPeriod)
+    : _nEvents(events.getEventsCount())
+    , _threshold(threshold)
+    , _refreshPeriod(refreshPeriod)
+    , _appliedPowers(alignedMalloc<float>(_nEvents))
+    , _positionsX(alignedMalloc<float>(padEventsCount(_nEvents)))
+    , _positionsY(alignedMalloc<float>(padEventsCount(_nEvents)))
+    , _positionsZ(alignedMalloc<float>(padEventsCount(_nEvents)))
+    , _radii(alignedMalloc<float>(padEventsCount(_nEvents)))
+    , _powers(alignedMalloc<float>(padEventsCount(_nEvents)))
+{
+    std::memset(_appliedPowers.get(), 0.0f, _nEvents * sizeof(float));
+}
+
+void IncrementalEvents::update(const Events& events, const size_t frame)
+{
+    const float* radii = events.getRadii();
+    const float* powers = events.getPowers(frame);
+
+    _fullRefresh = _framesSinceRefresh == 0u;
+    ++_framesSinceRefresh;
+    if (_refreshPeriod != 0u && _framesSinceRefresh >= _refreshPeriod)
+        _framesSinceRefresh = 0u;
+
+    if (_fullRefresh)
+    {
+        std::memcpy(_appliedPowers.get(), powers, _nEvents * sizeof(float));
+        _selectedPositionsX = events.getPositionsX();
+        _selectedPositionsY = events.getPositionsY();
+        _selectedPositionsZ = events.getPositionsZ();
+        _selectedRadii = radii;
+        _selectedPowers = powers;
+        _nSelected = _nEvents;
+        return;
+    }
+
+    // The applied power of an event only changes when the event is selected,
+    // so it stays within the threshold of the actual power. The error of an
+    // output value is at most Ec * threshold * sum(1 / max(d, r)) over the
+    // events, which grows with the number of events.
+    size_t nSelected = 0u;
+    for (size_t i = 0; i < _nEvents; ++i)
+    {
+        const float delta = powers[i] - _appliedPowers[i];
+        if (std::abs(delta) <= _threshold || delta == 0.0f)
+            continue;
+
+        _appliedPowers[i] = powers[i];
+        _positionsX[nSelected] = events.getPositionsX()[i];
+        _positionsY[nSelected] = events.getPositionsY()[i];
+        _positionsZ[nSelected] = events.getPositionsZ()[i];
+        _radii[nSelected] = radii[i];
+        _powers[nSelected] = delta;
+        ++nSelected;
+    }
+
+    _selectedPositionsX = _positionsX.get();
+    _selectedPositionsY = _positionsY.get();
+    _selectedPositionsZ = _positionsZ.get();
+    _selectedRadii = _radii.get();
+    _selectedPowers = _powers.get();
+    _nSelected = nSelected;
+}
+
+bool IncrementalEvents::isFullRefresh() const
+{
+    return _fullRefresh;
+}
+
+const float* IncrementalEvents::getPositionsX() const
+{
+    return _selectedPositionsX;
+}
+
+const float* IncrementalEvents::getPositionsY() const
+{
+    return _selectedPositionsY;
+}
+
+const float* IncrementalEvents::getPositionsZ() const
+{
+    return _selectedPositionsZ;
+}
+
+const float* IncrementalEvents::getRadii() const
+{
+    return _selectedRadii;
+}
+
+const float* IncrementalEvents::getPowers() const
+{
+    return _selectedPowers;
+}
+
+size_t IncrementalEvents::getEventsCount() const
+{
+    return _nSelected;
+}
+
+float IncrementalEvents::getSelectedRatio() const
+{
+    return _nEvents == 0u ? 0.0f : float(_nSelected) / float(_nEvents);
+}
+}
@@ -0,0 +1,125 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _EMSim_IncrementalEvents_h_
+#define _EMSim_IncrementalEvents_h_
+
+#include <emSim/Events.h>
+#include <emSim/helpers.h>
+
+namespace ems
+{
+/**
+ * This class selects, for every new time step, the events whose power
+ * changed by more than a threshold since it was last applied to the outputs.
+ * As the field is linear in the powers, adding the contributions of the
+ * selected power deltas to the previous outputs updates them to the new time
+ * step. The outputs are periodically recomputed from scratch to bound the
+ * accumulated error.
+ */
+class IncrementalEvents
+{
+public:
+    /**
+     * Allocate the memory needed to store the selected events.
+     * @param events The events whose geometric data is used
+     * @param threshold The minimal absolute power change of a selected event.
+     * The power applied to an event stays within this threshold of its
+     * actual power, so an output value differs from the exact sum by at most
+     * Ec * threshold * sum(1 / max(d, r)) over the events.
+     * @param refreshPeriod The number of time steps between two full
+     * refreshes. 0 only refreshes the first time step.
+     * @throw std::bad_alloc if memory allocation did not work.
+     */
+    IncrementalEvents(const Events& events, float threshold,
+                      size_t refreshPeriod);
+
+    /**
+     * Select the events of a new time step.
+     * @param events The events given to the constructor
+     * @param frame The index of the time step in the events' powers
+     */
+    void update(const Events& events, size_t frame = 0u);
+
+    /**
+     * @return true if the last update requires to recompute the outputs from
+     * scratch, in which case the selected events are all the events and
+     * their powers are the full powers of the time step.
+     */
+    bool isFullRefresh() const;
+
+    /**
+     * @return The pointer to the selected events' x coordinates.
+     */
+    const float* getPositionsX() const;
+
+    /**
+     * @return The pointer to the selected events' y coordinates.
+     */
+    const float* getPositionsY() const;
+
+    /**
+     * @return The pointer to the selected events' z coordinates.
+     */
+    const float* getPositionsZ() const;
+
+    /**
+     * @return The pointer to the selected events' radii.
+     */
+    const float* getRadii() const;
+
+    /**
+     * @return The pointer to the selected events' power changes.
+     */
+    const float* getPowers() const;
+
+    /**
+     * @return the number of selected events.
+     */
+    size_t getEventsCount() const;
+
+    /**
+     * @return the ratio of selected events over all the events.
+     */
+    float getSelectedRatio() const;
+
+private:
+    const size_t _nEvents;
+    const float _threshold;
+    const size_t _refreshPeriod;
+    size_t _framesSinceRefresh = 0u;
+
+    AlignedFloatPtr _appliedPowers;
+    AlignedFloatPtr _positionsX;
+    AlignedFloatPtr _positionsY;
+    AlignedFloatPtr _positionsZ;
+    AlignedFloatPtr _radii;
+    AlignedFloatPtr _powers;
+
+    const float* _selectedPositionsX = nullptr;
+    const float* _selectedPositionsY = nullptr;
+    const float* _selectedPositionsZ = nullptr;
+    const float* _selectedRadii = nullptr;
+    const float* _selectedPowers = nullptr;
+    size_t _nSelected = 0u;
+    bool _fullRefresh = true;
+};
+}
+
+#endif // _EMSim_IncrementalEvents_h_
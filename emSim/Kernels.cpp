@@ -0,0 +1,290 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <emSim/ISPCTarget.h>
+#include <emSim/Kernels.h>
+#include <emSim/SimdKernels.h>
+
+#ifdef EMSIM_USE_ISPC
+#include <emSim/ComputeSamplePoints.h>
+#include <emSim/ComputeVolume.h>
+#endif
+
+namespace ems
+{
+namespace
+{
+KernelsBackend getDefaultBackend()
+{
+    const char* name = std::getenv("EMSIM_KERNELS");
+    if (name && *name)
+    {
+        const KernelsBackend backend = parseKernelsBackend(name);
+        if (backend == KernelsBackend::ispc && !hasISPCKernels())
+            throw(std::runtime_error(
+                "ERROR: EMSIM_KERNELS=ispc but the ISPC kernels are not "
+                "compiled in"));
+        return backend;
+    }
+    return hasISPCKernels() ? KernelsBackend::ispc : KernelsBackend::cpp;
+}
+
+std::atomic<KernelsBackend>& currentBackend()
+{
+    static std::atomic<KernelsBackend> backend(getDefaultBackend());
+    return backend;
+}
+
+bool useISPC()
+{
+#ifdef EMSIM_USE_ISPC
+    return currentBackend() == KernelsBackend::ispc;
+#else
+    return false;
+#endif
+}
+
+const char* getSimdName()
+{
+    switch (simd::nativeWidth)
+    {
+    case 16:
+        return "avx512";
+    case 8:
+        return "avx";
+    case 4:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+#ifdef EMSIM_USE_ISPC
+#define EMSIM_DISPATCH(ispcCall, cppCall) \
+    if (useISPC())                        \
+        ispc::ispcCall;                   \
+    else                                  \
+        simd::cppCall;
+#else
+#define EMSIM_DISPATCH(ispcCall, cppCall) simd::cppCall;
+#endif
+
+const size_t W = simd::nativeWidth;
+}
+
+bool hasISPCKernels()
+{
+#ifdef EMSIM_USE_ISPC
+    return true;
+#else
+    return false;
+#endif
+}
+
+void setKernelsBackend(const KernelsBackend backend)
+{
+    if (backend == KernelsBackend::ispc && !hasISPCKernels())
+        throw(std::runtime_error(
+            "ERROR: The ISPC kernels are not compiled in"));
+    currentBackend() = backend;
+}
+
+KernelsBackend getKernelsBackend()
+{
+    return currentBackend();
+}
+
+KernelsBackend parseKernelsBackend(const std::string& name)
+{
+    if (name == "ispc")
+        return KernelsBackend::ispc;
+    if (name == "cpp")
+        return KernelsBackend::cpp;
+    throw(std::runtime_error("ERROR: Unknown kernels backend: " + name));
+}
+
+std::string getKernelsDescription()
+{
+    if (useISPC())
+        return "ispc " + getISPCTarget();
+    return std::string("cpp ") + getSimdName() + " (" +
+           std::to_string(simd::nativeWidth) + " lanes)";
+}
+
+namespace kernels
+{
+void computeVolume(const float* eventPosX, const float* eventPosY,
+                   const float* eventPosZ, const float* eventRadii,
+                   const float* eventPowers, const uint32_t nEvents,
+                   float* volumeData, const uint32_t sizeX,
+                   const uint32_t sizeY, const uint32_t sizeZ,
+                   const float resX, const float resY, const float resZ,
+                   const float originX, const float originY,
+                   const float originZ)
+{
+    EMSIM_DISPATCH(ComputeVolume_ispc(eventPosX, eventPosY, eventPosZ,
+                                      eventRadii, eventPowers, nEvents,
+                                      volumeData, sizeX, sizeY, sizeZ, resX,
+                                      resY, resZ, originX, originY, originZ),
+                   computeVolume<W>(eventPosX, eventPosY, eventPosZ,
+                                    eventRadii, eventPowers, nEvents,
+                                    volumeData, sizeX, sizeY, sizeZ, resX,
+                                    resY, resZ, originX, originY, originZ,
+                                    false))
+}
+
+void accumulateVolume(const float* eventPosX, const float* eventPosY,
+                      const float* eventPosZ, const float* eventRadii,
+                      const float* eventPowers, const uint32_t nEvents,
+                      float* volumeData, const uint32_t sizeX,
+                      const uint32_t sizeY, const uint32_t sizeZ,
+                      const float resX, const float resY, const float resZ,
+                      const float originX, const float originY,
+                      const float originZ)
+{
+    EMSIM_DISPATCH(AccumulateVolume_ispc(eventPosX, eventPosY, eventPosZ,
+                                         eventRadii, eventPowers, nEvents,
+                                         volumeData, sizeX, sizeY, sizeZ,
+                                         resX, resY, resZ, originX, originY,
+                                         originZ),
+                   computeVolume<W>(eventPosX, eventPosY, eventPosZ,
+                                    eventRadii, eventPowers, nEvents,
+                                    volumeData, sizeX, sizeY, sizeZ, resX,
+                                    resY, resZ, originX, originY, originZ,
+                                    true))
+}
+
+void computeVolumeTiles(const float* eventPosX, const float* eventPosY,
+                        const float* eventPosZ, const float* eventRadii,
+                        const float* eventPowers, const uint32_t nEvents,
+                        float* volumeData, const uint32_t sizeX,
+                        const uint32_t sizeY, const uint32_t sizeZ,
+                        const float resX, const float resY, const float resZ,
+                        const float originX, const float originY,
+                        const float originZ, const uint32_t tileSizeX,
+                        const uint32_t tileSizeY, const uint32_t tileSizeZ,
+                        const uint32_t eventsChunkSize, const bool accumulate)
+{
+    EMSIM_DISPATCH(
+        ComputeVolumeTiles_ispc(eventPosX, eventPosY, eventPosZ, eventRadii,
+                                eventPowers, nEvents, volumeData, sizeX,
+                                sizeY, sizeZ, resX, resY, resZ, originX,
+                                originY, originZ, tileSizeX, tileSizeY,
+                                tileSizeZ, eventsChunkSize, accumulate),
+        computeVolumeTiles<W>(eventPosX, eventPosY, eventPosZ, eventRadii,
+                              eventPowers, nEvents, volumeData, sizeX, sizeY,
+                              sizeZ, resX, resY, resZ, originX, originY,
+                              originZ, tileSizeX, tileSizeY, tileSizeZ,
+                              eventsChunkSize, accumulate))
+}
+
+void computeVolumeFrames(const float* eventPosX, const float* eventPosY,
+                         const float* eventPosZ, const float* eventRadii,
+                         const float* eventPowers, const uint32_t nEvents,
+                         const uint64_t powersStride, const uint32_t nFrames,
+                         float** volumesData, const uint32_t sizeX,
+                         const uint32_t sizeY, const uint32_t sizeZ,
+                         const float resX, const float resY, const float resZ,
+                         const float originX, const float originY,
+                         const float originZ)
+{
+    EMSIM_DISPATCH(
+        ComputeVolumeFrames_ispc(eventPosX, eventPosY, eventPosZ, eventRadii,
+                                 eventPowers, nEvents, powersStride, nFrames,
+                                 volumesData, sizeX, sizeY, sizeZ, resX, resY,
+                                 resZ, originX, originY, originZ),
+        computeVolumeFrames<W>(eventPosX, eventPosY, eventPosZ, eventRadii,
+                               eventPowers, nEvents, powersStride, nFrames,
+                               volumesData, sizeX, sizeY, sizeZ, resX, resY,
+                               resZ, originX, originY, originZ))
+}
+
+void computeQuantizedVolume(
+    const uint16_t* eventPosX, const uint16_t* eventPosY,
+    const uint16_t* eventPosZ, const float* eventBlocks,
+    const uint16_t* eventRadii, const uint16_t* eventPowers,
+    const uint32_t powersPrecision, const float powersScale,
+    const uint32_t nEvents, float* volumeData, uint16_t* volumeHalfData,
+    const uint32_t volumePrecision, const uint32_t sizeX,
+    const uint32_t sizeY, const uint32_t sizeZ, const float resX,
+    const float resY, const float resZ, const float originX,
+    const float originY, const float originZ, const bool accumulate)
+{
+    EMSIM_DISPATCH(
+        ComputeQuantizedVolume_ispc(
+            eventPosX, eventPosY, eventPosZ, eventBlocks, eventRadii,
+            eventPowers, powersPrecision, powersScale, nEvents, volumeData,
+            volumeHalfData, volumePrecision, sizeX, sizeY, sizeZ, resX, resY,
+            resZ, originX, originY, originZ, accumulate),
+        computeQuantizedVolume<W>(
+            eventPosX, eventPosY, eventPosZ, eventBlocks, eventRadii,
+            eventPowers, powersPrecision, powersScale, nEvents, volumeData,
+            volumeHalfData, volumePrecision, sizeX, sizeY, sizeZ, resX, resY,
+            resZ, originX, originY, originZ, accumulate))
+}
+
+void computeSamplePoints(const float* eventPosX, const float* eventPosY,
+                         const float* eventPosZ, const float* eventRadii,
+                         const float* eventPowers, const uint32_t nEvents,
+                         const uint32_t currentFrame, const float* spPosX,
+                         const float* spPosY, const float* spPosZ,
+                         float* spValues, const uint32_t nSamplePoints)
+{
+    EMSIM_DISPATCH(
+        ComputeSamplePoints_ispc(eventPosX, eventPosY, eventPosZ, eventRadii,
+                                 eventPowers, nEvents, currentFrame, spPosX,
+                                 spPosY, spPosZ, spValues, nSamplePoints),
+        computeSamplePoints<W>(eventPosX, eventPosY, eventPosZ, eventRadii,
+                               eventPowers, nEvents, currentFrame, spPosX,
+                               spPosY, spPosZ, spValues, nSamplePoints))
+}
+
+void computeTransferMatrix(const float* eventPosX, const float* eventPosY,
+                           const float* eventPosZ, const float* eventRadii,
+                           const uint32_t nEvents, const float* spPosX,
+                           const float* spPosY, const float* spPosZ,
+                           const uint32_t nSamplePoints, float* matrix)
+{
+    EMSIM_DISPATCH(
+        ComputeTransferMatrix_ispc(eventPosX, eventPosY, eventPosZ,
+                                   eventRadii, nEvents, spPosX, spPosY,
+                                   spPosZ, nSamplePoints, matrix),
+        computeTransferMatrix<W>(eventPosX, eventPosY, eventPosZ, eventRadii,
+                                 nEvents, spPosX, spPosY, spPosZ,
+                                 nSamplePoints, matrix))
+}
+
+void applyTransferMatrix(const float* matrix, const uint32_t nSamplePoints,
+                         const uint32_t nEvents, const float* framePowers,
+                         const uint64_t powersStride, const uint32_t nFrames,
+                         float* spValues)
+{
+    EMSIM_DISPATCH(ApplyTransferMatrix_ispc(matrix, nSamplePoints, nEvents,
+                                            framePowers, powersStride,
+                                            nFrames, spValues),
+                   applyTransferMatrix<W>(matrix, nSamplePoints, nEvents,
+                                          framePowers, powersStride, nFrames,
+                                          spValues))
+}
+}
+}
@@ -0,0 +1,133 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _EMSim_Kernels_h_
+#define _EMSim_Kernels_h_
+
+#include <cstdint>
+#include <string>
+
+namespace ems
+{
+/** Implementations of the kernels */
+enum class KernelsBackend
+{
+    ispc,
+    cpp
+};
+
+/**
+ * @return true if the ISPC kernels were compiled in (EMSIM_USE_ISPC).
+ */
+bool hasISPCKernels();
+
+/**
+ * Select the implementation used by all the kernels. The default is the
+ * EMSIM_KERNELS environment variable if set, ISPC if compiled in, C++
+ * otherwise.
+ * @throw std::runtime_error if the ISPC kernels are not compiled in
+ */
+void setKernelsBackend(KernelsBackend backend);
+
+/**
+ * @return the implementation currently used by the kernels.
+ */
+KernelsBackend getKernelsBackend();
+
+/**
+ * @param name "ispc" or "cpp"
+ * @return the backend of the given name
+ * @throw std::runtime_error if the name is unknown
+ */
+KernelsBackend parseKernelsBackend(const std::string& name);
+
+/**
+ * @return the current backend with its instruction set and SIMD width, e.g.
+ * "ispc avx2 (8 lanes)".
+ */
+std::string getKernelsDescription();
+
+/**
+ * Entry points of the kernels, forwarded to the current backend. The
+ * arguments are the ones of the ISPC exports of ComputeVolume.ispc and
+ * ComputeSamplePoints.ispc.
+ */
+namespace kernels
+{
+void computeVolume(const float* eventPosX, const float* eventPosY,
+                   const float* eventPosZ, const float* eventRadii,
+                   const float* eventPowers, uint32_t nEvents,
+                   float* volumeData, uint32_t sizeX, uint32_t sizeY,
+                   uint32_t sizeZ, float resX, float resY, float resZ,
+                   float originX, float originY, float originZ);
+
+void accumulateVolume(const float* eventPosX, const float* eventPosY,
+                      const float* eventPosZ, const float* eventRadii,
+                      const float* eventPowers, uint32_t nEvents,
+                      float* volumeData, uint32_t sizeX, uint32_t sizeY,
+                      uint32_t sizeZ, float resX, float resY, float resZ,
+                      float originX, float originY, float originZ);
+
+void computeVolumeTiles(const float* eventPosX, const float* eventPosY,
+                        const float* eventPosZ, const float* eventRadii,
+                        const float* eventPowers, uint32_t nEvents,
+                        float* volumeData, uint32_t sizeX, uint32_t sizeY,
+                        uint32_t sizeZ, float resX, float resY, float resZ,
+                        float originX, float originY, float originZ,
+                        uint32_t tileSizeX, uint32_t tileSizeY,
+                        uint32_t tileSizeZ, uint32_t eventsChunkSize,
+                        bool accumulate);
+
+void computeVolumeFrames(const float* eventPosX, const float* eventPosY,
+                         const float* eventPosZ, const float* eventRadii,
+                         const float* eventPowers, uint32_t nEvents,
+                         uint64_t powersStride, uint32_t nFrames,
+                         float** volumesData, uint32_t sizeX, uint32_t sizeY,
+                         uint32_t sizeZ, float resX, float resY, float resZ,
+                         float originX, float originY, float originZ);
+
+void computeQuantizedVolume(
+    const uint16_t* eventPosX, const uint16_t* eventPosY,
+    const uint16_t* eventPosZ, const float* eventBlocks,
+    const uint16_t* eventRadii, const uint16_t* eventPowers,
+    uint32_t powersPrecision, float powersScale, uint32_t nEvents,
+    float* volumeData, uint16_t* volumeHalfData, uint32_t volumePrecision,
+    uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ, float resX, float resY,
+    float resZ, float originX, float originY, float originZ, bool accumulate);
+
+void computeSamplePoints(const float* eventPosX, const float* eventPosY,
+                         const float* eventPosZ, const float* eventRadii,
+                         const float* eventPowers, uint32_t nEvents,
+                         uint32_t currentFrame, const float* spPosX,
+                         const float* spPosY, const float* spPosZ,
+                         float* spValues, uint32_t nSamplePoints);
+
+void computeTransferMatrix(const float* eventPosX, const float* eventPosY,
+                           const float* eventPosZ, const float* eventRadii,
+                           uint32_t nEvents, const float* spPosX,
+                           const float* spPosY, const float* spPosZ,
+                           uint32_t nSamplePoints, float* matrix);
+
+void applyTransferMatrix(const float* matrix, uint32_t nSamplePoints,
+                         uint32_t nEvents, const float* framePowers,
+                         uint64_t powersStride, uint32_t nFrames,
+                         float* spValues);
+}
+}
+#endif // _EMSim_Kernels_h_
@@ -0,0 +1,352 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <random>
+
+#include <emSim/LowRankPowers.h>
+
+namespace ems
+{
+namespace
+{
+// Number of consecutive events processed by a single thread
+const size_t chunkSize = 1u << 14;
+
+size_t getChunksCount(const size_t count)
+{
+    return (count + chunkSize - 1) / chunkSize;
+}
+
+size_t getChunkEnd(const size_t chunk, const size_t count)
+{
+    return std::min((chunk + 1) * chunkSize, count);
+}
+
+double computeDot(const float* a, const float* b, const size_t count)
+{
+    std::vector<double> partials(getChunksCount(count), 0.0);
+    parallelFor(partials.size(), [&](const size_t chunk) {
+        double sum = 0.0;
+        for (size_t i = chunk * chunkSize; i < getChunkEnd(chunk, count); ++i)
+            sum += double(a[i]) * b[i];
+        partials[chunk] = sum;
+    });
+    return std::accumulate(partials.begin(), partials.end(), 0.0);
+}
+
+void addScaled(float* a, const float* b, const float scale, const size_t count)
+{
+    parallelFor(getChunksCount(count), [&](const size_t chunk) {
+        for (size_t i = chunk * chunkSize; i < getChunkEnd(chunk, count); ++i)
+            a[i] += scale * b[i];
+    });
+}
+
+void scale(float* a, const float factor, const size_t count)
+{
+    parallelFor(getChunksCount(count), [&](const size_t chunk) {
+        for (size_t i = chunk * chunkSize; i < getChunkEnd(chunk, count); ++i)
+            a[i] *= factor;
+    });
+}
+
+/**
+ * Cyclic Jacobi eigen decomposition of a small symmetric matrix. The matrix
+ * is diagonalized in place and the eigen vectors are stored in the columns
+ * of vectors.
+ */
+void computeEigenVectors(std::vector<double>& matrix, const size_t n,
+                         std::vector<double>& vectors)
+{
+    vectors.assign(n * n, 0.0);
+    for (size_t i = 0; i < n; ++i)
+        vectors[i * n + i] = 1.0;
+
+    for (size_t sweep = 0; sweep < 100; ++sweep)
+    {
+        double diagonal = 0.0;
+        double offDiagonal = 0.0;
+        for (size_t p = 0; p < n; ++p)
+        {
+            diagonal += matrix[p * n + p] * matrix[p * n + p];
+            for (size_t q = p + 1; q < n; ++q)
+                offDiagonal += matrix[p * n + q] * matrix[p * n + q];
+        }
+        if (offDiagonal <= 1e-24 * diagonal)
+            return;
+
+        for (size_t p = 0; p < n; ++p)
+        {
+            for (size_t q = p + 1; q < n; ++q)
+            {
+                const double apq = matrix[p * n + q];
+                if (apq == 0.0)
+                    continue;
+
+                const double theta =
+                    (matrix[q * n + q] - matrix[p * n + p]) / (2.0 * apq);
+                const double t =
+                    (theta < 0.0 ? -1.0 : 1.0) /
+                    (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                const double c = 1.0 / std::sqrt(t * t + 1.0);
+                const double s = t * c;
+
+                for (size_t k = 0; k < n; ++k)
+                {
+                    const double akp = matrix[k * n + p];
+                    const double akq = matrix[k * n + q];
+                    matrix[k * n + p] = c * akp - s * akq;
+                    matrix[k * n + q] = s * akp + c * akq;
+                }
+                for (size_t k = 0; k < n; ++k)
+                {
+                    const double apk = matrix[p * n + k];
+                    const double aqk = matrix[q * n + k];
+                    matrix[p * n + k] = c * apk - s * aqk;
+                    matrix[q * n + k] = s * apk + c * aqk;
+                }
+                for (size_t k = 0; k < n; ++k)
+                {
+                    const double vkp = vectors[k * n + p];
+                    const double vkq = vectors[k * n + q];
+                    vectors[k * n + p] = c * vkp - s * vkq;
+                    vectors[k * n + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+}
+}
+
+LowRankPowers::LowRankPowers(const size_t nEvents, const size_t nFrames,
+                             const size_t rank, const size_t oversampling,
+                             const LoadFrameFunc& loadFrame)
+    : _nEvents(nEvents)
+    , _nFrames(nFrames)
+{
+    const size_t nSamples =
+        std::min(std::min(rank + oversampling, nFrames), nEvents);
+    if (nSamples == 0u || rank == 0u)
+    {
+        _relativeError = 1.0f;
+        return;
+    }
+
+    const size_t nChunks = getChunksCount(_nEvents);
+    AlignedFloatPtr powers(alignedMalloc<float>(_nEvents));
+
+    // First pass: sample the range of the powers with random combinations of
+    // the time steps.
+    std::mt19937 generator(0u);
+    std::normal_distribution<float> normal;
+    std::vector<float> omega(_nFrames * nSamples);
+    for (auto& value : omega)
+        value = normal(generator);
+
+    AlignedFloatPtr range(alignedMalloc<float>(_nEvents * nSamples));
+    std::memset(range.get(), 0.0f, _nEvents * nSamples * sizeof(float));
+    for (size_t t = 0; t < _nFrames; ++t)
+    {
+        loadFrame(t, powers.get());
+        parallelFor(nChunks, [&](const size_t chunk) {
+            for (size_t l = 0; l < nSamples; ++l)
+            {
+                const float weight = omega[t * nSamples + l];
+                float* column = range.get() + l * _nEvents;
+                for (size_t i = chunk * chunkSize;
+                     i < getChunkEnd(chunk, _nEvents); ++i)
+                    column[i] += weight * powers[i];
+            }
+        });
+    }
+
+    // Orthonormalize the samples with modified Gram-Schmidt, applied twice
+    // for numerical stability. Linearly dependent samples are zeroed.
+    for (size_t pass = 0; pass < 2; ++pass)
+    {
+        for (size_t l = 0; l < nSamples; ++l)
+        {
+            float* column = range.get() + l * _nEvents;
+            const double norm =
+                std::sqrt(computeDot(column, column, _nEvents));
+            for (size_t m = 0; m < l; ++m)
+            {
+                const float* other = range.get() + m * _nEvents;
+                addScaled(column, other,
+                          -float(computeDot(other, column, _nEvents)),
+                          _nEvents);
+            }
+
+            const double orthogonalNorm =
+                std::sqrt(computeDot(column, column, _nEvents));
+            if (orthogonalNorm <= 1e-5 * norm || orthogonalNorm == 0.0)
+                std::memset(column, 0.0f, _nEvents * sizeof(float));
+            else
+                scale(column, float(1.0 / orthogonalNorm), _nEvents);
+        }
+    }
+
+    // Second pass: project every time step on the orthonormal samples.
+    std::vector<double> projections(nSamples * _nFrames);
+    double squaredNorm = 0.0;
+    std::vector<double> partials(nChunks * (nSamples + 1));
+    for (size_t t = 0; t < _nFrames; ++t)
+    {
+        loadFrame(t, powers.get());
+        parallelFor(nChunks, [&](const size_t chunk) {
+            double* partial = partials.data() + chunk * (nSamples + 1);
+            for (size_t l = 0; l <= nSamples; ++l)
+            {
+                const float* column =
+                    l < nSamples ? range.get() + l * _nEvents : powers.get();
+                double sum = 0.0;
+                for (size_t i = chunk * chunkSize;
+                     i < getChunkEnd(chunk, _nEvents); ++i)
+                    sum += double(column[i]) * powers[i];
+                partial[l] = sum;
+            }
+        });
+
+        for (size_t chunk = 0; chunk < nChunks; ++chunk)
+        {
+            const double* partial = partials.data() + chunk * (nSamples + 1);
+            for (size_t l = 0; l < nSamples; ++l)
+                projections[l * _nFrames + t] += partial[l];
+            squaredNorm += partial[nSamples];
+        }
+    }
+
+    // The singular vectors of the small projected matrix give the best
+    // combinations of the samples, sorted by decreasing singular value.
+    std::vector<double> gram(nSamples * nSamples, 0.0);
+    for (size_t l = 0; l < nSamples; ++l)
+        for (size_t m = 0; m < nSamples; ++m)
+            for (size_t t = 0; t < _nFrames; ++t)
+                gram[l * nSamples + m] += projections[l * _nFrames + t] *
+                                          projections[m * _nFrames + t];
+
+    std::vector<double> vectors;
+    computeEigenVectors(gram, nSamples, vectors);
+
+    std::vector<size_t> order(nSamples);
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](const size_t a, const size_t b) {
+        return gram[a * nSamples + a] > gram[b * nSamples + b];
+    });
+
+    const double maxEigenValue = std::max(gram[order[0] * nSamples + order[0]],
+                                          0.0);
+    double keptSquaredNorm = 0.0;
+    for (size_t k = 0; k < std::min(rank, nSamples); ++k)
+    {
+        const double eigenValue = gram[order[k] * nSamples + order[k]];
+        if (eigenValue <= 1e-12 * maxEigenValue)
+            break;
+        keptSquaredNorm += eigenValue;
+        ++_rank;
+    }
+    _relativeError =
+        squaredNorm > 0.0
+            ? std::sqrt(std::max(squaredNorm - keptSquaredNorm, 0.0) /
+                        squaredNorm)
+            : 0.0f;
+
+    // The basis vectors are padded with null powers, as in Events
+    const size_t nPadded = padEventsCount(_nEvents);
+    _basis.reset(alignedMalloc<float>(nPadded * _rank));
+    fillMemory(_basis.get(), nPadded * _rank, 0.0f);
+    parallelFor(nChunks, [&](const size_t chunk) {
+        for (size_t k = 0; k < _rank; ++k)
+        {
+            float* basis = _basis.get() + k * nPadded;
+            for (size_t i = chunk * chunkSize;
+                 i < getChunkEnd(chunk, _nEvents); ++i)
+            {
+                double value = 0.0;
+                for (size_t l = 0; l < nSamples; ++l)
+                    value += vectors[l * nSamples + order[k]] *
+                             range[l * _nEvents + i];
+                basis[i] = float(value);
+            }
+        }
+    });
+
+    _coefficients.resize(_nFrames * _rank);
+    for (size_t t = 0; t < _nFrames; ++t)
+    {
+        for (size_t k = 0; k < _rank; ++k)
+        {
+            double value = 0.0;
+            for (size_t l = 0; l < nSamples; ++l)
+                value += vectors[l * nSamples + order[k]] *
+                         projections[l * _nFrames + t];
+            _coefficients[t * _rank + k] = float(value);
+        }
+    }
+}
+
+size_t LowRankPowers::getRank() const
+{
+    return _rank;
+}
+
+size_t LowRankPowers::getFramesCount() const
+{
+    return _nFrames;
+}
+
+const float* LowRankPowers::getBasis(const size_t index) const
+{
+    return _basis.get() + index * padEventsCount(_nEvents);
+}
+
+const float* LowRankPowers::getCoefficients(const size_t frame) const
+{
+    return _coefficients.data() + frame * _rank;
+}
+
+size_t LowRankPowers::getPaddedEventsCount() const
+{
+    return padEventsCount(_nEvents);
+}
+
+float LowRankPowers::getRelativeError() const
+{
+    return _relativeError;
+}
+
+void LowRankPowers::reconstruct(const std::vector<const float*>& basisValues,
+                                const size_t count, const size_t frame,
+                                float* values) const
+{
+    const float* coefficients = getCoefficients(frame);
+    parallelFor(getChunksCount(count), [&](const size_t chunk) {
+        for (size_t i = chunk * chunkSize; i < getChunkEnd(chunk, count); ++i)
+        {
+            float value = 0.0f;
+            for (size_t k = 0; k < _rank; ++k)
+                value += coefficients[k] * basisValues[k][i];
+            values[i] = value;
+        }
+    });
+}
+}
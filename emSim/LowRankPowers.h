@@ -0,0 +1,118 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _EMSim_LowRankPowers_h_
+#define _EMSim_LowRankPowers_h_
+
+#include <functional>
+#include <vector>
+
+#include <emSim/helpers.h>
+
+namespace ems
+{
+/**
+ * This class stores a truncated decomposition of the events' powers of all
+ * time steps. The nEvents x nFrames matrix of powers is approximated by rank
+ * basis power vectors and, for each time step, the coefficients of their
+ * linear combination. The decomposition is computed with a randomized range
+ * finder that reads every time step twice. As the field is linear in the
+ * powers, the outputs of a time step are the same combination of the outputs
+ * of the basis power vectors.
+ */
+class LowRankPowers
+{
+public:
+    /**
+     * Function filling the powers of all the events for a time step.
+     */
+    using LoadFrameFunc = std::function<void(size_t frame, float* powers)>;
+
+    /**
+     * Compute the decomposition.
+     * @param nEvents The number of events
+     * @param nFrames The number of time steps
+     * @param rank The maximum number of basis power vectors
+     * @param oversampling The number of additional random samples of the
+     * range of the powers, improving the accuracy of the basis
+     * @param loadFrame The function giving the powers of a time step
+     * @throw std::bad_alloc if memory allocation did not work.
+     */
+    LowRankPowers(size_t nEvents, size_t nFrames, size_t rank,
+                  size_t oversampling, const LoadFrameFunc& loadFrame);
+
+    LowRankPowers(LowRankPowers&& other) = default;
+    LowRankPowers& operator=(LowRankPowers&& other) = default;
+
+    /**
+     * @return the number of basis power vectors.
+     */
+    size_t getRank() const;
+
+    /**
+     * @return the number of time steps.
+     */
+    size_t getFramesCount() const;
+
+    /**
+     * @param index The index of the basis power vector
+     * @return the pointer to the powers of the basis vector. The powers of
+     * the basis vectors are stored one after the other.
+     */
+    const float* getBasis(size_t index = 0u) const;
+
+    /**
+     * @return the number of events including the padding, which is also the
+     * offset between the powers of consecutive basis vectors.
+     */
+    size_t getPaddedEventsCount() const;
+
+    /**
+     * @param frame The index of the time step
+     * @return the pointer to the rank coefficients of the time step.
+     */
+    const float* getCoefficients(size_t frame) const;
+
+    /**
+     * @return the relative error of the decomposition in Frobenius norm.
+     */
+    float getRelativeError() const;
+
+    /**
+     * Combine the outputs of the basis vectors for a time step.
+     * @param basisValues The outputs of every basis vector
+     * @param count The number of values of an output
+     * @param frame The index of the time step
+     * @param values The combined output values
+     */
+    void reconstruct(const std::vector<const float*>& basisValues,
+                     size_t count, size_t frame, float* values) const;
+
+private:
+    size_t _nEvents = 0u;
+    size_t _nFrames = 0u;
+    size_t _rank = 0u;
+    float _relativeError = 0.0f;
+
+    AlignedFloatPtr _basis;
+    std::vector<float> _coefficients;
+};
+}
+
+#endif // _EMSim_LowRankPowers_h_
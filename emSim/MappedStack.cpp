@@ -0,0 +1,181 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <emSim/MappedStack.h>
+#include <emSim/helpers.h>
+
+namespace ems
+{
+namespace
+{
+std::runtime_error createError(const std::string& message,
+                               const std::string& fileName, const int error)
+{
+    return std::runtime_error("error: " + message + " " + fileName + ": " +
+                              std::strerror(error));
+}
+
+void writeHeader(const std::string& fileName, const std::string& rawFileName,
+                 const std::vector<size_t>& frameSize,
+                 const std::vector<float>& spacing, const size_t nFrames,
+                 const float startTime, const float timeStep)
+{
+    const size_t nDims = frameSize.size() + 1u;
+    std::ostringstream transform;
+    for (size_t i = 0; i < nDims * nDims; ++i)
+        transform << (i > 0 ? " " : "") << (i % (nDims + 1) == 0 ? 1 : 0);
+
+    std::ofstream mhdFile(fileName);
+    mhdFile << "ObjectType = Image\n"
+            << "NDims = " << nDims << "\n"
+            << "BinaryData = True\n"
+            << "BinaryDataByteOrderMSB = False\n"
+            << "CompressedData = False\n"
+            << "TransformMatrix = " << transform.str() << "\n"
+            << "Offset =";
+    for (size_t i = 0; i < frameSize.size(); ++i)
+        mhdFile << " 0";
+    mhdFile << " " << startTime << "\n"
+            << "CenterOfRotation =";
+    for (size_t i = 0; i < nDims; ++i)
+        mhdFile << " 0";
+    mhdFile << "\nElementSpacing =";
+    for (const float value : spacing)
+        mhdFile << " " << value;
+    mhdFile << " " << timeStep << "\n"
+            << "DimSize =";
+    for (const size_t size : frameSize)
+        mhdFile << " " << size;
+    mhdFile << " " << nFrames << "\n"
+            << "ElementType = MET_FLOAT\n"
+            // Relative to the header, which is next to the raw file
+            << "ElementDataFile = "
+            << rawFileName.substr(rawFileName.find_last_of('/') + 1) << "\n"
+            << std::endl;
+    mhdFile.close();
+    if (!mhdFile)
+        throw std::runtime_error("error: Cannot write " + fileName);
+}
+}
+
+MappedStack::MappedStack(const std::string& fileName,
+                         const std::vector<size_t>& frameSize,
+                         const std::vector<float>& spacing,
+                         const size_t nFrames, const float startTime,
+                         const float timeStep)
+    : _rawFileName(fileName + ".raw")
+    , _nFrames(nFrames)
+{
+    if (frameSize.size() != spacing.size() || frameSize.empty())
+        throw std::runtime_error(
+            "error: Cannot create the stack. Wrong number of dimensions.");
+    for (const size_t size : frameSize)
+        _frameValues *= size;
+
+    writeHeader(fileName + ".mhd", _rawFileName, frameSize, spacing, nFrames,
+                startTime, timeStep);
+
+    _descriptor = ::open(_rawFileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_descriptor < 0)
+        throw createError("Cannot open", _rawFileName, errno);
+
+    const size_t size = _frameValues * _nFrames * sizeof(float);
+    if (size == 0u)
+        return;
+
+    // posix_fallocate() reserves the blocks, some file systems only support
+    // a sparse file
+    int error = ::posix_fallocate(_descriptor, 0, size);
+    if (error == EOPNOTSUPP || error == EINVAL)
+    {
+        std::cout << "WARNING: Cannot preallocate " << _rawFileName
+                  << ", writing a sparse file instead. A full disk will "
+                     "crash the run."
+                  << std::endl;
+        error = ::ftruncate(_descriptor, size) == 0 ? 0 : errno;
+    }
+    if (error != 0)
+    {
+        ::close(_descriptor);
+        throw createError("Cannot preallocate", _rawFileName, error);
+    }
+
+    void* data =
+        ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _descriptor, 0);
+    if (data == MAP_FAILED)
+    {
+        error = errno;
+        ::close(_descriptor);
+        throw createError("Cannot map", _rawFileName, error);
+    }
+    _data = (float*)data;
+}
+
+MappedStack::~MappedStack()
+{
+    if (_data)
+        ::munmap(_data, _frameValues * _nFrames * sizeof(float));
+    ::close(_descriptor);
+}
+
+float* MappedStack::getFrame(const size_t index)
+{
+    if (index >= _nFrames)
+        throw std::runtime_error("error: Frame " + std::to_string(index) +
+                                 " out of the stack " + _rawFileName);
+    return _data + index * _frameValues;
+}
+
+void MappedStack::writeFrame(const size_t index, const float* values)
+{
+    parallelCopy(getFrame(index), values, _frameValues);
+}
+
+void MappedStack::flush()
+{
+    if (_data &&
+        ::msync(_data, _frameValues * _nFrames * sizeof(float), MS_SYNC) != 0)
+        throw createError("Cannot write", _rawFileName, errno);
+}
+
+size_t MappedStack::getFrameValuesCount() const
+{
+    return _frameValues;
+}
+
+size_t MappedStack::getFramesCount() const
+{
+    return _nFrames;
+}
+
+const std::string& MappedStack::getRawFileName() const
+{
+    return _rawFileName;
+}
+}
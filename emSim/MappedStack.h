@@ -0,0 +1,106 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _EMSim_MappedStack_h_
+#define _EMSim_MappedStack_h_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace ems
+{
+/**
+ * Single raw file holding the fp32 frames of a whole run one after the
+ * other, with a MetaImage header whose last dimension is the time. The file
+ * is preallocated and mapped in memory, each frame is written in its slice
+ * of the mapping and flushed to disk by the kernel, without any per frame
+ * file. Readers can map any range of frames of the file.
+ *
+ * The file is preallocated on disk when the file system supports it, so that
+ * writing to the mapping can not fail on a full disk, which would raise
+ * SIGBUS. Otherwise a warning is printed and the file is sparse, the disk
+ * space being only taken as the frames are written.
+ */
+class MappedStack
+{
+public:
+    /**
+     * Create and map the raw file, and write its MetaImage header.
+     * @param fileName the path of the files without extension, ".raw" and
+     * ".mhd" are appended
+     * @param frameSize the number of values of a frame along every
+     * dimension, x first
+     * @param spacing the distance between two values of a frame along every
+     * dimension
+     * @param nFrames the number of frames
+     * @param startTime the time of the first frame
+     * @param timeStep the time between two frames
+     * @throw std::runtime_error if the file can not be created, preallocated
+     * or mapped, or if frameSize and spacing differ in size
+     */
+    MappedStack(const std::string& fileName,
+                const std::vector<size_t>& frameSize,
+                const std::vector<float>& spacing, size_t nFrames,
+                float startTime, float timeStep);
+
+    /** Unmap the file, the frames written are kept. */
+    ~MappedStack();
+
+    MappedStack(const MappedStack&) = delete;
+    MappedStack& operator=(const MappedStack&) = delete;
+
+    /**
+     * @param index the index of the frame
+     * @return the mapped values of the frame, getFrameValuesCount() floats
+     * @throw std::runtime_error if index is out of range
+     */
+    float* getFrame(size_t index);
+
+    /**
+     * Copy the values of a frame to the mapping, in parallel.
+     * @param index the index of the frame
+     * @param values getFrameValuesCount() floats
+     * @throw std::runtime_error if index is out of range
+     */
+    void writeFrame(size_t index, const float* values);
+
+    /**
+     * Write the modified frames to disk and wait for the end of the writes.
+     * @throw std::runtime_error if the writes failed
+     */
+    void flush();
+
+    /** @return the number of values of every frame */
+    size_t getFrameValuesCount() const;
+
+    /** @return the number of frames */
+    size_t getFramesCount() const;
+
+    /** @return the path of the raw file */
+    const std::string& getRawFileName() const;
+
+private:
+    std::string _rawFileName;
+    size_t _frameValues = 1u;
+    size_t _nFrames = 0u;
+    int _descriptor = -1;
+    float* _data = nullptr;
+};
+}
+#endif // _EMSim_MappedStack_h_
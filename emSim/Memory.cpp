@@ -0,0 +1,375 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Memory.h"
+#include "helpers.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef USE_ALIGNED_MALLOC
+#include <mm_malloc.h>
+#endif
+
+namespace ems
+{
+namespace
+{
+const size_t hugePageSize = 2u << 20;
+const size_t maxSampledPages = 4096u;
+
+enum class Backing
+{
+    regular,
+    transparent,
+    hugetlb
+};
+
+struct Allocation
+{
+    size_t bytes;
+    Backing backing;
+};
+
+// All the live buffers, to know how to release them and for the statistics
+struct Allocations
+{
+    std::mutex mutex;
+    std::unordered_map<void*, Allocation> buffers;
+    MemoryStats stats;
+    MemoryConfig config = MemoryConfig::fromEnvironment();
+};
+
+// Never destroyed, buffers of static objects may be released after it would
+Allocations& getAllocations()
+{
+    static Allocations* allocations = new Allocations;
+    return *allocations;
+}
+
+void* allocateRegular(const size_t bytes, const size_t alignment)
+{
+#ifdef USE_ALIGNED_MALLOC
+    return _mm_malloc(bytes, alignment);
+#else
+    void* data = nullptr;
+    if (posix_memalign(&data, alignment, bytes) != 0)
+        return nullptr;
+    return data;
+#endif
+}
+
+void* allocateTransparent(const size_t bytes)
+{
+    void* data = allocateRegular(bytes, hugePageSize);
+    if (data)
+        madvise(data, (bytes + hugePageSize - 1) / hugePageSize * hugePageSize,
+                MADV_HUGEPAGE);
+    return data;
+}
+
+// The length of a hugetlb mapping is rounded up to whole huge pages, as
+// munmap() fails on a length which is not a multiple of them.
+void* allocateHugeTLB(size_t& bytes)
+{
+    const size_t mappedBytes =
+        (bytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+    void* data = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (data == MAP_FAILED)
+        return nullptr;
+    bytes = mappedBytes;
+    return data;
+}
+
+// Huge pages of the mappings overlapping [begin, end) in /proc/self/smaps,
+// clamped to the overlap as a mapping may hold other buffers.
+size_t readHugePageBytes(const uintptr_t begin, const uintptr_t end)
+{
+    std::ifstream smaps("/proc/self/smaps");
+    size_t total = 0u;
+    size_t overlap = 0u;
+    size_t mappingHugePages = 0u;
+    std::string line;
+    while (std::getline(smaps, line))
+    {
+        uintptr_t mappingBegin, mappingEnd;
+        char dash;
+        std::istringstream header(line);
+        if (line.find(':') > line.find(' ') &&
+            header >> std::hex >> mappingBegin >> dash >> mappingEnd &&
+            dash == '-')
+        {
+            total += std::min(mappingHugePages, overlap);
+            mappingHugePages = 0u;
+            overlap = mappingBegin < end && begin < mappingEnd
+                          ? std::min(end, mappingEnd) -
+                                std::max(begin, mappingBegin)
+                          : 0u;
+            continue;
+        }
+
+        if (overlap == 0u)
+            continue;
+        std::istringstream field(line);
+        std::string name;
+        size_t kiloBytes;
+        if (field >> name >> kiloBytes &&
+            (name == "AnonHugePages:" || name == "Private_Hugetlb:" ||
+             name == "Shared_Hugetlb:"))
+        {
+            mappingHugePages += kiloBytes * 1024u;
+        }
+    }
+    return total + std::min(mappingHugePages, overlap);
+}
+}
+
+MemoryConfig MemoryConfig::fromEnvironment()
+{
+    MemoryConfig config;
+    const char* hugePages = std::getenv("EMSIM_HUGE_PAGES");
+    if (hugePages && *hugePages)
+        config.hugePages = parseHugePages(hugePages);
+    config.parallelFirstTouch =
+        parseEnvironmentFlag("EMSIM_FIRST_TOUCH", config.parallelFirstTouch);
+    return config;
+}
+
+HugePages parseHugePages(const std::string& name)
+{
+    if (name == "none")
+        return HugePages::none;
+    if (name == "transparent")
+        return HugePages::transparent;
+    if (name == "hugetlb")
+        return HugePages::hugetlb;
+    throw(std::runtime_error("ERROR: Unknown huge pages '" + name +
+                             "', expected none, transparent or hugetlb"));
+}
+
+void setMemoryConfig(const MemoryConfig& config)
+{
+    Allocations& allocations = getAllocations();
+    std::lock_guard<std::mutex> lock(allocations.mutex);
+    allocations.config = config;
+}
+
+MemoryConfig getMemoryConfig()
+{
+    Allocations& allocations = getAllocations();
+    std::lock_guard<std::mutex> lock(allocations.mutex);
+    return allocations.config;
+}
+
+void* allocateMemory(size_t bytes)
+{
+    bytes = std::max(bytes, size_t(1));
+    Allocations& allocations = getAllocations();
+    const HugePages hugePages = getMemoryConfig().hugePages;
+
+    // Smaller buffers would waste most of their huge page
+    Backing backing = Backing::regular;
+    void* data = nullptr;
+    bool fallback = false;
+    if (bytes >= hugePageSize && hugePages == HugePages::hugetlb)
+    {
+        data = allocateHugeTLB(bytes);
+        backing = Backing::hugetlb;
+        fallback = !data;
+    }
+    if (!data && bytes >= hugePageSize && hugePages != HugePages::none)
+    {
+        data = allocateTransparent(bytes);
+        backing = Backing::transparent;
+    }
+    if (!data)
+    {
+        data = allocateRegular(bytes, alignment);
+        backing = Backing::regular;
+    }
+    if (!data)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(allocations.mutex);
+    allocations.buffers[data] = {bytes, backing};
+    MemoryStats& stats = allocations.stats;
+    stats.allocatedBytes += bytes;
+    if (backing == Backing::transparent)
+        stats.transparentBytes += bytes;
+    if (backing == Backing::hugetlb)
+        stats.hugetlbBytes += bytes;
+    if (fallback)
+        ++stats.hugetlbFallbacks;
+    return data;
+}
+
+void freeMemory(void* data)
+{
+    if (!data)
+        return;
+
+    Allocations& allocations = getAllocations();
+    Allocation allocation{0u, Backing::regular};
+    {
+        std::lock_guard<std::mutex> lock(allocations.mutex);
+        const auto i = allocations.buffers.find(data);
+        if (i != allocations.buffers.end())
+        {
+            allocation = i->second;
+            allocations.buffers.erase(i);
+            MemoryStats& stats = allocations.stats;
+            stats.allocatedBytes -= allocation.bytes;
+            if (allocation.backing == Backing::transparent)
+                stats.transparentBytes -= allocation.bytes;
+            if (allocation.backing == Backing::hugetlb)
+                stats.hugetlbBytes -= allocation.bytes;
+        }
+    }
+
+    if (allocation.backing == Backing::hugetlb)
+    {
+        if (munmap(data, allocation.bytes) != 0)
+            std::cout << "WARNING: Cannot release " << allocation.bytes
+                      << " bytes of huge pages: " << std::strerror(errno)
+                      << std::endl;
+    }
+    else
+#ifdef USE_ALIGNED_MALLOC
+        _mm_free(data);
+#else
+        free(data);
+#endif
+}
+
+namespace
+{
+template <typename T>
+void fill(T* data, const size_t count, const T value)
+{
+    const size_t chunkSize = hugePageSize / sizeof(T);
+    ThreadPool& pool = ThreadPool::getInstance();
+    if (!getMemoryConfig().parallelFirstTouch || count <= chunkSize ||
+        pool.getThreadsCount() < 2)
+    {
+        std::fill(data, data + count, value);
+        return;
+    }
+
+    // One contiguous part per thread, cut on huge page boundaries
+    const size_t nChunks = (count + chunkSize - 1) / chunkSize;
+    const size_t nThreads = std::min(pool.getThreadsCount(), nChunks);
+    pool.parallelFor(nThreads, [&](const size_t part, size_t) {
+        const size_t begin = nChunks * part / nThreads * chunkSize;
+        const size_t end =
+            std::min(nChunks * (part + 1) / nThreads * chunkSize, count);
+        std::fill(data + begin, data + end, value);
+    });
+}
+}
+
+void fillMemory(float* data, const size_t count, const float value)
+{
+    fill(data, count, value);
+}
+
+void fillMemory(uint16_t* data, const size_t count, const uint16_t value)
+{
+    fill(data, count, value);
+}
+
+MemoryStats getMemoryStats()
+{
+    Allocations& allocations = getAllocations();
+    std::lock_guard<std::mutex> lock(allocations.mutex);
+    return allocations.stats;
+}
+
+MemoryPlacement getMemoryPlacement(const void* data, const size_t bytes)
+{
+    MemoryPlacement placement;
+    if (!data || bytes == 0)
+        return placement;
+
+    const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+    const uintptr_t begin = uintptr_t(data) / pageSize * pageSize;
+    const uintptr_t end = uintptr_t(data) + bytes;
+    const size_t nPages = (end - begin + pageSize - 1) / pageSize;
+    const size_t step = (nPages + maxSampledPages - 1) / maxSampledPages;
+
+    std::vector<void*> pages;
+    for (size_t i = 0; i < nPages; i += step)
+        pages.push_back(reinterpret_cast<void*>(begin + i * pageSize));
+    std::vector<int> nodes(pages.size(), -1);
+
+    // move_pages without target nodes only reports the node of every page
+    const bool queried = syscall(SYS_move_pages, 0, pages.size(), pages.data(),
+                                 nullptr, nodes.data(), 0) == 0;
+
+    const size_t sampleBytes = bytes / pages.size();
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        const size_t sample =
+            i + 1 < pages.size() ? sampleBytes
+                                 : bytes - sampleBytes * (pages.size() - 1);
+        if (!queried || nodes[i] < 0)
+        {
+            placement.unknownBytes += sample;
+            continue;
+        }
+        if (size_t(nodes[i]) >= placement.nodeBytes.size())
+            placement.nodeBytes.resize(nodes[i] + 1, 0u);
+        placement.nodeBytes[nodes[i]] += sample;
+    }
+
+    placement.hugePageBytes =
+        std::min(readHugePageBytes(uintptr_t(data), end), bytes);
+    return placement;
+}
+
+std::string MemoryPlacement::getDescription() const
+{
+    size_t total = unknownBytes;
+    for (const size_t node : nodeBytes)
+        total += node;
+    if (total == 0)
+        return "empty";
+
+    std::ostringstream description;
+    description << std::fixed << std::setprecision(0);
+    for (size_t i = 0; i < nodeBytes.size(); ++i)
+        description << "node " << i << ": " << 100.0 * nodeBytes[i] / total
+                    << "%, ";
+    if (unknownBytes > 0)
+        description << "unknown: " << 100.0 * unknownBytes / total << "%, ";
+    description << "huge pages: " << 100.0 * hugePageBytes / total << "%";
+    return description.str();
+}
+}
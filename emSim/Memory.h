@@ -0,0 +1,129 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _EMSim_Memory_h_
+#define _EMSim_Memory_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ems
+{
+/** Backing of the large buffers */
+enum class HugePages
+{
+    /** Regular pages */
+    none,
+    /** Transparent huge pages, requested with madvise() */
+    transparent,
+    /** Huge pages reserved by the administrator, mapped with MAP_HUGETLB.
+        Falls back to transparent huge pages if none are available. */
+    hugetlb
+};
+
+struct MemoryConfig
+{
+    /** Huge pages used by the buffers of at least one huge page */
+    HugePages hugePages = HugePages::none;
+    /** Initialize the buffers from the threads of the pool, see fillMemory() */
+    bool parallelFirstTouch = true;
+
+    /**
+     * @return the configuration given by the environment variables
+     * EMSIM_HUGE_PAGES (none, transparent or hugetlb) and EMSIM_FIRST_TOUCH
+     * (0 or 1), the defaults above otherwise.
+     * @throw std::runtime_error if a variable can not be parsed
+     */
+    static MemoryConfig fromEnvironment();
+};
+
+/**
+ * @param name "none", "transparent" or "hugetlb"
+ * @throw std::runtime_error if the name is unknown
+ */
+HugePages parseHugePages(const std::string& name);
+
+/** Set the configuration of the following allocations */
+void setMemoryConfig(const MemoryConfig& config);
+
+/** @return the current configuration, MemoryConfig::fromEnvironment() first */
+MemoryConfig getMemoryConfig();
+
+/**
+ * Allocate a buffer aligned to the cache line size, backed by huge pages as
+ * configured. The pages are only placed on a NUMA node by the first thread
+ * writing to them, see fillMemory().
+ * @return the buffer, to be released with freeMemory(), or null on failure
+ */
+void* allocateMemory(size_t bytes);
+
+/** Release a buffer of allocateMemory() */
+void freeMemory(void* data);
+
+/**
+ * Set count floats to value. With parallelFirstTouch the buffer is split in
+ * as many contiguous parts as there are threads in the pool, so that with
+ * pinned threads the pages of a fresh buffer are spread over the NUMA nodes
+ * of the threads. The placement is only approximate for the volumes: their
+ * bricks are numbered along x, then y and z, so the first bricks of a thread
+ * may span several parts of the buffer, and the balancing moves bricks
+ * between the threads.
+ */
+void fillMemory(float* data, size_t count, float value);
+
+/** fillMemory() of 16 bits values, see Precision.h */
+void fillMemory(uint16_t* data, size_t count, uint16_t value);
+
+/** Totals of the allocations done by allocateMemory() */
+struct MemoryStats
+{
+    /** Bytes of the buffers currently allocated */
+    size_t allocatedBytes = 0u;
+    /** Bytes of the current buffers advised to use transparent huge pages */
+    size_t transparentBytes = 0u;
+    /**
+     * Bytes of the current buffers mapped on reserved huge pages, rounded up
+     * to whole huge pages. They are also counted so in allocatedBytes.
+     */
+    size_t hugetlbBytes = 0u;
+    /** Number of hugetlb allocations which fell back to transparent pages */
+    size_t hugetlbFallbacks = 0u;
+};
+
+MemoryStats getMemoryStats();
+
+/** Where the pages of a buffer are */
+struct MemoryPlacement
+{
+    /** Bytes on every NUMA node, estimated from up to 4096 sampled pages */
+    std::vector<size_t> nodeBytes;
+    /** Bytes not touched yet or whose node can't be queried */
+    size_t unknownBytes = 0u;
+    /** Bytes backed by huge pages, transparent or reserved */
+    size_t hugePageBytes = 0u;
+
+    /** @return e.g. "node 0: 50%, node 1: 50%, huge pages: 100%" */
+    std::string getDescription() const;
+};
+
+MemoryPlacement getMemoryPlacement(const void* data, size_t bytes);
+}
+#endif // _EMSim_Memory_h_
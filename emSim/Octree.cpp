@@ -0,0 +1,378 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <cmath>
+#include <iostream>
+
+#include <emSim/Octree.h>
+#include <emSim/helpers.h>
+
+namespace ems
+{
+namespace
+{
+// Deep enough for any circuit, bounds the recursion on co-located events
+const uint32_t maxDepth = 32u;
+const size_t maxStackSize = maxDepth * 7u + 1u;
+
+struct AtomicStats
+{
+    void add(const Octree::Stats& stats)
+    {
+        exactInteractions += stats.exactInteractions;
+        approximatedInteractions += stats.approximatedInteractions;
+    }
+
+    std::atomic<uint64_t> exactInteractions{0u};
+    std::atomic<uint64_t> approximatedInteractions{0u};
+};
+}
+
+double Octree::Stats::getWorkRatio() const
+{
+    if (points == 0u || events == 0u)
+        return 0.0;
+    return double(exactInteractions + approximatedInteractions) /
+           (double(points) * double(events));
+}
+
+Octree::Octree(const Events& events, const float openingAngle,
+               const bool useDipoles, const size_t maxLeafSize)
+    : _openingAngle(openingAngle)
+    , _useDipoles(useDipoles)
+{
+    const size_t nEvents = events.getEventsCount();
+    _eventIndices.resize(nEvents);
+    _positions.resize(nEvents);
+    _radii.resize(nEvents);
+    _powers.resize(nEvents, 0.0f);
+
+    for (size_t i = 0; i < nEvents; ++i)
+    {
+        _eventIndices[i] = i;
+        _positions[i] = events.getPosition(i);
+        _radii[i] = events.getRadii()[i];
+    }
+
+    Node root;
+    root.end = nEvents;
+    _nodes.push_back(root);
+    _build(0u, std::max(maxLeafSize, size_t(1)), 0u);
+
+    _monopoles.resize(_nodes.size(), 0.0f);
+    _dipoles.resize(_nodes.size(), glm::vec3(0.0f));
+
+    std::cout << "INFO: Octree of " << _nodes.size() << " nodes built, opening "
+              << "angle " << _openingAngle
+              << (_useDipoles ? " with dipoles." : ".") << std::endl;
+}
+
+void Octree::_build(const uint32_t nodeIndex, const size_t maxLeafSize,
+                    const uint32_t depth)
+{
+    const uint32_t begin = _nodes[nodeIndex].begin;
+    const uint32_t end = _nodes[nodeIndex].end;
+    if (begin == end)
+        return;
+
+    glm::vec3 center(0.0f);
+    for (uint32_t i = begin; i < end; ++i)
+        center += _positions[i];
+    center /= float(end - begin);
+
+    float radius = 0.0f;
+    float maxEventRadius = 0.0f;
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        radius = std::max(radius, glm::length(_positions[i] - center));
+        maxEventRadius = std::max(maxEventRadius, _radii[i]);
+    }
+
+    Node& node = _nodes[nodeIndex];
+    node.center = center;
+    node.radius = radius;
+    node.maxEventRadius = maxEventRadius;
+
+    if (end - begin <= maxLeafSize || depth >= maxDepth || radius == 0.0f)
+        return;
+
+    // Counting sort of the node's events by octant around the centroid
+    const auto octant = [&center](const glm::vec3& pos) {
+        return (pos.x > center.x ? 1u : 0u) | (pos.y > center.y ? 2u : 0u) |
+               (pos.z > center.z ? 4u : 0u);
+    };
+
+    uint32_t counts[8] = {0u};
+    for (uint32_t i = begin; i < end; ++i)
+        ++counts[octant(_positions[i])];
+
+    uint32_t offsets[8];
+    offsets[0] = 0u;
+    for (uint32_t i = 1; i < 8; ++i)
+        offsets[i] = offsets[i - 1] + counts[i - 1];
+
+    std::vector<uint32_t> indices(end - begin);
+    std::vector<glm::vec3> positions(end - begin);
+    std::vector<float> radii(end - begin);
+    uint32_t cursors[8];
+    std::copy(offsets, offsets + 8, cursors);
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        const uint32_t dst = cursors[octant(_positions[i])]++;
+        indices[dst] = _eventIndices[i];
+        positions[dst] = _positions[i];
+        radii[dst] = _radii[i];
+    }
+    std::copy(indices.begin(), indices.end(), _eventIndices.begin() + begin);
+    std::copy(positions.begin(), positions.end(), _positions.begin() + begin);
+    std::copy(radii.begin(), radii.end(), _radii.begin() + begin);
+
+    const uint32_t firstChild = _nodes.size();
+    uint32_t nChildren = 0u;
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        if (counts[i] == 0u)
+            continue;
+        Node child;
+        child.begin = begin + offsets[i];
+        child.end = child.begin + counts[i];
+        _nodes.push_back(child);
+        ++nChildren;
+    }
+    _nodes[nodeIndex].firstChild = firstChild;
+    _nodes[nodeIndex].nChildren = nChildren;
+
+    for (uint32_t i = 0; i < nChildren; ++i)
+        _build(firstChild + i, maxLeafSize, depth + 1u);
+}
+
+void Octree::update(const Events& events, const size_t frame)
+{
+    const float* powers = events.getPowers(frame);
+    for (size_t i = 0; i < _eventIndices.size(); ++i)
+        _powers[i] = powers[_eventIndices[i]];
+
+    // Children are stored after their parent, a reverse traversal visits
+    // them first.
+    for (size_t i = _nodes.size(); i-- > 0;)
+    {
+        const Node& node = _nodes[i];
+        float monopole = 0.0f;
+        glm::vec3 dipole(0.0f);
+
+        if (node.nChildren == 0u)
+        {
+            for (uint32_t j = node.begin; j < node.end; ++j)
+            {
+                monopole += _powers[j];
+                dipole += _powers[j] * (_positions[j] - node.center);
+            }
+        }
+        else
+        {
+            for (uint32_t j = 0; j < node.nChildren; ++j)
+            {
+                const uint32_t child = node.firstChild + j;
+                monopole += _monopoles[child];
+                dipole += _dipoles[child] +
+                          _monopoles[child] * (_nodes[child].center - node.center);
+            }
+        }
+        _monopoles[i] = monopole;
+        _dipoles[i] = dipole;
+    }
+}
+
+float Octree::_computeValue(const glm::vec3& pos, Stats& stats) const
+{
+    float value = 0.0f;
+    uint32_t stack[maxStackSize];
+    size_t stackSize = 0u;
+    if (!_nodes.empty())
+        stack[stackSize++] = 0u;
+
+    while (stackSize > 0u)
+    {
+        const uint32_t nodeIndex = stack[--stackSize];
+        const Node& node = _nodes[nodeIndex];
+        const glm::vec3 delta = pos - node.center;
+        const float dist = glm::length(delta);
+
+        // The events' radii must not clamp the distance to an approximated
+        // node, otherwise the point source model does not hold.
+        if (dist * _openingAngle > node.radius &&
+            dist > node.radius + node.maxEventRadius)
+        {
+            const float distInv = 1.0f / dist;
+            value += _monopoles[nodeIndex] * distInv;
+            if (_useDipoles)
+                value += glm::dot(_dipoles[nodeIndex], delta) * distInv *
+                         distInv * distInv;
+            ++stats.approximatedInteractions;
+            continue;
+        }
+
+        if (node.nChildren == 0u)
+        {
+            for (uint32_t i = node.begin; i < node.end; ++i)
+            {
+                const float eventDist = glm::length(pos - _positions[i]);
+                value += _powers[i] / std::max(eventDist, _radii[i]);
+            }
+            stats.exactInteractions += node.end - node.begin;
+            continue;
+        }
+
+        for (uint32_t i = 0; i < node.nChildren; ++i)
+            stack[stackSize++] = node.firstChild + i;
+    }
+    return Ec * value;
+}
+
+float Octree::_computeExactValue(const glm::vec3& pos) const
+{
+    double value = 0.0;
+    for (size_t i = 0; i < _positions.size(); ++i)
+    {
+        const float eventDist = glm::length(pos - _positions[i]);
+        value += _powers[i] / std::max(eventDist, _radii[i]);
+    }
+    return Ec * value;
+}
+
+Octree::Stats Octree::computeVolume(Volume& volume) const
+{
+    const glm::uvec3& size = volume.getSize();
+    const glm::vec3& origin = volume.getOrigin();
+    const glm::vec3& voxelSize = volume.getVoxelSize();
+    float* data = volume.getData();
+
+    AtomicStats atomicStats;
+    parallelFor(size_t(size.y) * size.z, [&](const size_t row) {
+        const size_t y = row % size.y;
+        const size_t z = row / size.y;
+        Stats stats;
+        for (size_t x = 0; x < size.x; ++x)
+        {
+            const glm::vec3 pos(origin.x + x * voxelSize.x,
+                                origin.y + y * voxelSize.y,
+                                origin.z + z * voxelSize.z);
+            data[row * size.x + x] = _computeValue(pos, stats);
+        }
+        atomicStats.add(stats);
+    });
+
+    Stats stats;
+    stats.exactInteractions = atomicStats.exactInteractions;
+    stats.approximatedInteractions = atomicStats.approximatedInteractions;
+    stats.points = uint64_t(size.x) * size.y * size.z;
+    stats.events = _positions.size();
+    return stats;
+}
+
+Octree::Stats Octree::computeValues(const float* positionsX,
+                                    const float* positionsY,
+                                    const float* positionsZ,
+                                    const size_t nPoints, float* values) const
+{
+    AtomicStats atomicStats;
+    parallelFor(nPoints, [&](const size_t i) {
+        Stats stats;
+        values[i] = _computeValue(glm::vec3(positionsX[i], positionsY[i],
+                                            positionsZ[i]),
+                                  stats);
+        atomicStats.add(stats);
+    });
+
+    Stats stats;
+    stats.exactInteractions = atomicStats.exactInteractions;
+    stats.approximatedInteractions = atomicStats.approximatedInteractions;
+    stats.points = nPoints;
+    stats.events = _positions.size();
+    return stats;
+}
+
+Octree::Error Octree::estimateError(const Volume& volume,
+                                    const size_t nSamples) const
+{
+    const glm::uvec3& size = volume.getSize();
+    const glm::vec3& origin = volume.getOrigin();
+    const glm::vec3& voxelSize = volume.getVoxelSize();
+    const size_t voxelCount = size_t(size.x) * size.y * size.z;
+    const size_t count = std::min(std::max(nSamples, size_t(1)), voxelCount);
+    const size_t stride = count > 0u ? voxelCount / count : 1u;
+
+    std::vector<float> positionsX(count);
+    std::vector<float> positionsY(count);
+    std::vector<float> positionsZ(count);
+    std::vector<float> values(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const size_t index = i * stride;
+        const size_t x = index % size.x;
+        const size_t y = (index / size.x) % size.y;
+        const size_t z = index / (size_t(size.x) * size.y);
+        positionsX[i] = origin.x + x * voxelSize.x;
+        positionsY[i] = origin.y + y * voxelSize.y;
+        positionsZ[i] = origin.z + z * voxelSize.z;
+        values[i] = volume.getData()[index];
+    }
+    return estimateError(positionsX.data(), positionsY.data(),
+                         positionsZ.data(), count, values.data());
+}
+
+Octree::Error Octree::estimateError(const float* positionsX,
+                                    const float* positionsY,
+                                    const float* positionsZ,
+                                    const size_t nPoints,
+                                    const float* values,
+                                    const size_t nSamples) const
+{
+    const size_t count = std::min(std::max(nSamples, size_t(1)), nPoints);
+    const size_t stride = count > 0u ? nPoints / count : 1u;
+    std::vector<float> exactValues(count);
+    parallelFor(count, [&](const size_t i) {
+        const size_t index = i * stride;
+        exactValues[i] = _computeExactValue(glm::vec3(
+            positionsX[index], positionsY[index], positionsZ[index]));
+    });
+
+    Error error;
+    double squaredError = 0.0;
+    double squaredValue = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const double delta = values[i * stride] - exactValues[i];
+        error.maxError = std::max(error.maxError, float(std::abs(delta)));
+        squaredError += delta * delta;
+        squaredValue += double(exactValues[i]) * exactValues[i];
+    }
+    if (count > 0u)
+    {
+        error.rmsError = std::sqrt(squaredError / count);
+        error.rmsValue = std::sqrt(squaredValue / count);
+    }
+    return error;
+}
+
+size_t Octree::getNodesCount() const
+{
+    return _nodes.size();
+}
+}
@@ -0,0 +1,159 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _Octree_h_
+#define _Octree_h_
+
+#define GLM_FORCE_CTOR_INIT
+#include <glm/glm.hpp>
+
+#include <limits>
+#include <vector>
+
+#include <emSim/Events.h>
+#include <emSim/Volume.h>
+
+namespace ems
+{
+/**
+ * Barnes-Hut approximation of the events' field. The octree is built once
+ * from the static events geometry and the multipole moments of its nodes are
+ * refreshed for every frame. A node seen from a point under an angle smaller
+ * than the opening angle is evaluated from its moments instead of its events.
+ * An opening angle of 0 gives the exact sum.
+ */
+class Octree
+{
+public:
+    /** Number of interactions evaluated by a computation */
+    struct Stats
+    {
+        uint64_t exactInteractions = 0u;
+        uint64_t approximatedInteractions = 0u;
+        uint64_t points = 0u;
+        uint64_t events = 0u;
+
+        /** @return the fraction of the exact sum's work actually done. */
+        double getWorkRatio() const;
+    };
+
+    /** Deviation of approximated values from the exact sum */
+    struct Error
+    {
+        float maxError = 0.0f;
+        float rmsError = 0.0f;
+        float rmsValue = 0.0f;
+    };
+
+    /**
+     * Build the octree from the events' geometric data.
+     * @param events the events whose geometry is used
+     * @param openingAngle the ratio between node radius and distance under
+     * which a node is approximated
+     * @param useDipoles use the dipole moments in addition to the monopoles
+     * @param maxLeafSize the maximum number of events in a leaf
+     */
+    Octree(const Events& events, float openingAngle, bool useDipoles = false,
+           size_t maxLeafSize = 32u);
+
+    /**
+     * Refresh the nodes' moments with the events' powers of a frame.
+     * @param events the events used to build the octree
+     * @param frame the frame of the events to use
+     */
+    void update(const Events& events, size_t frame = 0u);
+
+    /**
+     * Compute all the voxels of a volume.
+     * @param volume the volume to fill
+     * @return the interactions statistics of the computation
+     */
+    Stats computeVolume(Volume& volume) const;
+
+    /**
+     * Compute the values at the given positions.
+     * @param positionsX the x coordinates of the positions
+     * @param positionsY the y coordinates of the positions
+     * @param positionsZ the z coordinates of the positions
+     * @param nPoints the number of positions
+     * @param values the output values
+     * @return the interactions statistics of the computation
+     */
+    Stats computeValues(const float* positionsX, const float* positionsY,
+                        const float* positionsZ, size_t nPoints,
+                        float* values) const;
+
+    /**
+     * Compare computed values with the exact sum on a subset of voxels.
+     * @param volume a volume computed by computeVolume()
+     * @param nSamples the number of voxels compared, evenly spread
+     * @return the error of the volume values
+     */
+    Error estimateError(const Volume& volume, size_t nSamples) const;
+
+    /**
+     * Compare computed values with the exact sum on a subset of positions.
+     * @param positionsX the x coordinates of the positions
+     * @param positionsY the y coordinates of the positions
+     * @param positionsZ the z coordinates of the positions
+     * @param nPoints the number of positions
+     * @param values the values computed by computeValues()
+     * @param nSamples the number of positions compared, evenly spread
+     * @return the error of the values
+     */
+    Error estimateError(
+        const float* positionsX, const float* positionsY,
+        const float* positionsZ, size_t nPoints, const float* values,
+        size_t nSamples = std::numeric_limits<size_t>::max()) const;
+
+    /** @return the number of nodes of the tree. */
+    size_t getNodesCount() const;
+
+private:
+    struct Node
+    {
+        glm::vec3 center;
+        float radius = 0.0f;
+        float maxEventRadius = 0.0f;
+        uint32_t begin = 0u;
+        uint32_t end = 0u;
+        uint32_t firstChild = 0u;
+        uint32_t nChildren = 0u;
+    };
+
+    void _build(uint32_t nodeIndex, size_t maxLeafSize, uint32_t depth);
+    float _computeValue(const glm::vec3& pos, Stats& stats) const;
+    float _computeExactValue(const glm::vec3& pos) const;
+
+    float _openingAngle = 0.0f;
+    bool _useDipoles = false;
+
+    std::vector<Node> _nodes;
+    std::vector<uint32_t> _eventIndices;
+
+    // Events geometry and powers in the tree order
+    std::vector<glm::vec3> _positions;
+    std::vector<float> _radii;
+    std::vector<float> _powers;
+
+    std::vector<float> _monopoles;
+    std::vector<glm::vec3> _dipoles;
+};
+}
+#endif // _Octree_h_
@@ -0,0 +1,76 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <algorithm>
+#include <stdexcept>
+
+#include <emSim/Precision.h>
+#include <emSim/ThreadPool.h>
+
+namespace ems
+{
+namespace
+{
+// Number of values converted by a single task
+const size_t conversionChunkSize = 1u << 16;
+}
+
+Precision parsePrecision(const std::string& name)
+{
+    if (name == "fp32")
+        return Precision::fp32;
+    if (name == "fp16")
+        return Precision::fp16;
+    if (name == "bf16")
+        return Precision::bf16;
+    throw(std::runtime_error("ERROR: Unknown precision: " + name));
+}
+
+std::string getPrecisionName(const Precision precision)
+{
+    switch (precision)
+    {
+    case Precision::fp16:
+        return "fp16";
+    case Precision::bf16:
+        return "bf16";
+    default:
+        return "fp32";
+    }
+}
+
+void encodeValues(const float* values, const size_t count,
+                  const Precision precision, uint16_t* encoded)
+{
+    parallelForChunks(count, conversionChunkSize,
+                      [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            encoded[i] = encodeValue(values[i], precision);
+    });
+}
+
+void decodeValues(const uint16_t* encoded, const size_t count,
+                  const Precision precision, float* values)
+{
+    parallelForChunks(count, conversionChunkSize,
+                      [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            values[i] = decodeValue(encoded[i], precision);
+    });
+}
+}
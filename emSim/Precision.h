@@ -0,0 +1,143 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _EMSim_Precision_h_
+#define _EMSim_Precision_h_
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace ems
+{
+/**
+ * Storage format of the reduced precision events and volumes. The values are
+ * always converted to fp32 before any arithmetic, and the sums accumulated in
+ * fp32.
+ */
+enum class Precision
+{
+    /** IEEE single precision, the default */
+    fp32,
+    /** IEEE half precision: 11 bits of mantissa, values up to 65504 */
+    fp16,
+    /** bfloat16: 8 bits of mantissa, the range of fp32 */
+    bf16
+};
+
+/**
+ * @param name "fp32", "fp16" or "bf16"
+ * @throw std::runtime_error if the name is unknown
+ */
+Precision parsePrecision(const std::string& name);
+
+/** @return "fp32", "fp16" or "bf16" */
+std::string getPrecisionName(Precision precision);
+
+/** @return the fp16 value nearest to value, ties to even */
+inline uint16_t floatToHalf(const float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = (bits >> 16) & 0x8000u;
+    uint32_t absBits = bits & 0x7fffffffu;
+
+    // Infinity and NaN, NaN keeping a non null mantissa
+    if (absBits >= 0x7f800000u)
+        return sign | 0x7c00u | (absBits > 0x7f800000u ? 0x0200u : 0u);
+    // Rounds to 65520 or more
+    if (absBits >= 0x477ff000u)
+        return sign | 0x7c00u;
+    // Below 2^-14, subnormal: multiples of 2^-24
+    if (absBits < 0x38800000u)
+        return sign | uint16_t(std::nearbyint(std::abs(value) * 16777216.0f));
+
+    // Rebias the exponent from 127 to 15 and round the 13 dropped bits
+    absBits += 0xc8000fffu + ((absBits >> 13) & 1u);
+    return sign | uint16_t(absBits >> 13);
+}
+
+/** @return the fp32 value of an fp16 value, exact */
+inline float halfToFloat(const uint16_t value)
+{
+    const uint32_t sign = uint32_t(value & 0x8000u) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1fu;
+    const uint32_t mantissa = value & 0x3ffu;
+
+    uint32_t bits;
+    if (exponent == 0)
+    {
+        const float subnormal = float(mantissa) / 16777216.0f;
+        std::memcpy(&bits, &subnormal, sizeof(bits));
+        bits |= sign;
+    }
+    else if (exponent == 0x1fu)
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    else
+        bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+/** @return the bf16 value nearest to value, ties to even */
+inline uint16_t floatToBFloat16(const float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7fffffffu) > 0x7f800000u)
+        return uint16_t(bits >> 16) | 0x0040u;
+    bits += 0x7fffu + ((bits >> 16) & 1u);
+    return uint16_t(bits >> 16);
+}
+
+/** @return the fp32 value of a bf16 value, exact */
+inline float bfloat16ToFloat(const uint16_t value)
+{
+    const uint32_t bits = uint32_t(value) << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+/** @return value stored with a 16 bits precision, fp16 or bf16 */
+inline uint16_t encodeValue(const float value, const Precision precision)
+{
+    return precision == Precision::bf16 ? floatToBFloat16(value)
+                                        : floatToHalf(value);
+}
+
+/** @return the fp32 value of encodeValue() */
+inline float decodeValue(const uint16_t value, const Precision precision)
+{
+    return precision == Precision::bf16 ? bfloat16ToFloat(value)
+                                        : halfToFloat(value);
+}
+
+/** encodeValue() of count values, on the thread pool */
+void encodeValues(const float* values, size_t count, Precision precision,
+                  uint16_t* encoded);
+
+/** decodeValue() of count values, on the thread pool */
+void decodeValues(const uint16_t* encoded, size_t count, Precision precision,
+                  float* values);
+}
+#endif // _EMSim_Precision_h_
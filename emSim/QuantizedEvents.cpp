@@ -0,0 +1,298 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <cmath>
+#include <stdexcept>
+
+#include <emSim/Kernels.h>
+#include <emSim/QuantizedEvents.h>
+
+namespace ems
+{
+namespace
+{
+// Number of consecutive powers converted by a single thread
+const size_t chunkSize = 1u << 14;
+
+// Largest quantized coordinate
+const float maxQuantized = 65535.0f;
+
+size_t getBlocksCount(const size_t nPaddedEvents)
+{
+    return (nPaddedEvents + quantizedBlockSize - 1) / quantizedBlockSize;
+}
+}
+
+QuantizedEvents::QuantizedEvents(const Events& events,
+                                 const Precision powersPrecision)
+    : _nEvents(events.getEventsCount())
+    , _nPaddedEvents(events.getPaddedEventsCount())
+    , _powersPrecision(powersPrecision)
+    , _positionsX(alignedMalloc<uint16_t>(_nPaddedEvents))
+    , _positionsY(alignedMalloc<uint16_t>(_nPaddedEvents))
+    , _positionsZ(alignedMalloc<uint16_t>(_nPaddedEvents))
+    , _radii(alignedMalloc<uint16_t>(_nPaddedEvents))
+    , _powers(alignedMalloc<uint16_t>(_nPaddedEvents))
+    , _blocks(alignedMalloc<float>(4 * getBlocksCount(_nPaddedEvents)))
+    , _powersScales(1u, 1.0f)
+{
+    if (powersPrecision == Precision::fp32)
+        throw(std::runtime_error(
+            "error: Quantized events need a 16 bits precision."));
+
+    const size_t nBlocks = getBlocksCount(_nPaddedEvents);
+    std::vector<float> blockErrors(nBlocks, 0.0f);
+    parallelFor(nBlocks, [&](const size_t block) {
+        const size_t begin = block * quantizedBlockSize;
+        const size_t end = std::min(begin + quantizedBlockSize, _nEvents);
+        const size_t paddedEnd =
+            std::min(begin + quantizedBlockSize, _nPaddedEvents);
+
+        glm::vec3 origin(0.0f);
+        glm::vec3 extent(0.0f);
+        if (begin < end)
+        {
+            origin = events.getPosition(begin);
+            glm::vec3 max = origin;
+            for (size_t i = begin + 1; i < end; ++i)
+            {
+                origin = glm::min(origin, events.getPosition(i));
+                max = glm::max(max, events.getPosition(i));
+            }
+            extent = max - origin;
+        }
+        const float step =
+            std::max(std::max(extent.x, extent.y), extent.z) / maxQuantized;
+
+        float* blockData = _blocks.get() + 4 * block;
+        blockData[0] = origin.x;
+        blockData[1] = origin.y;
+        blockData[2] = origin.z;
+        blockData[3] = step;
+
+        const auto quantize = [&](const float value, const float min) {
+            if (step == 0.0f)
+                return uint16_t(0u);
+            return uint16_t(
+                std::min(std::nearbyint((value - min) / step), maxQuantized));
+        };
+
+        // The padding events sit on the origin of the block, with the radius
+        // and null power of the padding of Events.
+        float maxError = 0.0f;
+        for (size_t i = begin; i < paddedEnd; ++i)
+        {
+            if (i >= end)
+            {
+                _positionsX[i] = 0u;
+                _positionsY[i] = 0u;
+                _positionsZ[i] = 0u;
+                _radii[i] = floatToHalf(1.0f);
+                continue;
+            }
+
+            const glm::vec3 position = events.getPosition(i);
+            _positionsX[i] = quantize(position.x, origin.x);
+            _positionsY[i] = quantize(position.y, origin.y);
+            _positionsZ[i] = quantize(position.z, origin.z);
+            _radii[i] = floatToHalf(events.getRadii()[i]);
+
+            const glm::vec3 quantized =
+                origin + glm::vec3(_positionsX[i], _positionsY[i],
+                                   _positionsZ[i]) *
+                             step;
+            maxError = std::max(maxError, glm::length(position - quantized));
+        }
+        blockErrors[block] = maxError;
+    });
+    if (!blockErrors.empty())
+        _positionError =
+            *std::max_element(blockErrors.begin(), blockErrors.end());
+
+    fillMemory(_powers.get(), _nPaddedEvents, uint16_t(0u));
+}
+
+void QuantizedEvents::update(const Events& events, const size_t nFrames)
+{
+    if (nFrames != _nFrames)
+    {
+        _powers.reset(alignedMalloc<uint16_t>(_nPaddedEvents * nFrames));
+        _nFrames = nFrames;
+        _powersScales.resize(nFrames);
+    }
+
+    const size_t nChunks = (_nPaddedEvents + chunkSize - 1) / chunkSize;
+
+    for (size_t frame = 0; frame < _nFrames; ++frame)
+    {
+        const float* powers = events.getPowers(frame);
+        std::vector<float> chunkMaxPowers(nChunks, 0.0f);
+        parallelForChunks(_nPaddedEvents, chunkSize,
+                          [&](const size_t begin, const size_t end) {
+            float maxPower = 0.0f;
+            for (size_t i = begin; i < end; ++i)
+                maxPower = std::max(maxPower, std::abs(powers[i]));
+            chunkMaxPowers[begin / chunkSize] = maxPower;
+        });
+        const float maxPower =
+            chunkMaxPowers.empty()
+                ? 0.0f
+                : *std::max_element(chunkMaxPowers.begin(),
+                                    chunkMaxPowers.end());
+
+        // The scaled powers are below 1024, far from the fp16 limit. A power
+        // of two scale keeps the stored values exact.
+        int exponent = 0;
+        std::frexp(maxPower, &exponent);
+        const float scale =
+            maxPower > 0.0f ? std::ldexp(1.0f, exponent - 10) : 1.0f;
+        _powersScales[frame] = scale;
+
+        uint16_t* encoded = _powers.get() + frame * _nPaddedEvents;
+        parallelForChunks(_nPaddedEvents, chunkSize,
+                          [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                encoded[i] = encodeValue(powers[i] / scale, _powersPrecision);
+        });
+    }
+}
+
+void QuantizedEvents::computeVolume(Volume& volume, const size_t frame,
+                                    const bool accumulate) const
+{
+    const glm::uvec3& size = volume.getSize();
+    const glm::vec3& voxelSize = volume.getVoxelSize();
+    const glm::vec3& origin = volume.getOrigin();
+    kernels::computeQuantizedVolume(
+        _positionsX.get(), _positionsY.get(), _positionsZ.get(),
+        _blocks.get(), _radii.get(), getPowers(frame),
+        uint32_t(_powersPrecision), _powersScales[frame], _nEvents,
+        volume.getData(), volume.getHalfData(),
+        uint32_t(volume.getPrecision()), size.x, size.y, size.z, voxelSize.x,
+        voxelSize.y, voxelSize.z, origin.x, origin.y, origin.z, accumulate);
+}
+
+QuantizedEvents::Error QuantizedEvents::estimateError(
+    const Events& events, const size_t frame, const Volume& volume,
+    const size_t nSamples) const
+{
+    const glm::uvec3& size = volume.getSize();
+    const glm::vec3& origin = volume.getOrigin();
+    const glm::vec3& voxelSize = volume.getVoxelSize();
+    const size_t voxelCount = size_t(size.x) * size.y * size.z;
+    const size_t count = std::min(std::max(nSamples, size_t(1)), voxelCount);
+    const size_t stride = count > 0u ? voxelCount / count : 1u;
+
+    std::vector<float> positionsX(count);
+    std::vector<float> positionsY(count);
+    std::vector<float> positionsZ(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const size_t index = i * stride;
+        positionsX[i] = origin.x + (index % size.x) * voxelSize.x;
+        positionsY[i] = origin.y + (index / size.x % size.y) * voxelSize.y;
+        positionsZ[i] =
+            origin.z + (index / (size_t(size.x) * size.y)) * voxelSize.z;
+    }
+
+    std::vector<float> exactValues(count);
+    kernels::computeSamplePoints(
+        events.getPositionsX(), events.getPositionsY(), events.getPositionsZ(),
+        events.getRadii(), events.getPowers(frame), _nEvents, 0u,
+        positionsX.data(), positionsY.data(), positionsZ.data(),
+        exactValues.data(), count);
+
+    Error error;
+    double squaredError = 0.0;
+    double squaredValue = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const double delta = volume.getValue(i * stride) - exactValues[i];
+        error.maxError = std::max(error.maxError, float(std::abs(delta)));
+        squaredError += delta * delta;
+        squaredValue += double(exactValues[i]) * exactValues[i];
+    }
+    if (count > 0u)
+    {
+        error.rmsError = std::sqrt(squaredError / count);
+        error.rmsValue = std::sqrt(squaredValue / count);
+    }
+    return error;
+}
+
+const uint16_t* QuantizedEvents::getPositionsX() const
+{
+    return _positionsX.get();
+}
+
+const uint16_t* QuantizedEvents::getPositionsY() const
+{
+    return _positionsY.get();
+}
+
+const uint16_t* QuantizedEvents::getPositionsZ() const
+{
+    return _positionsZ.get();
+}
+
+const float* QuantizedEvents::getBlocks() const
+{
+    return _blocks.get();
+}
+
+const uint16_t* QuantizedEvents::getRadii() const
+{
+    return _radii.get();
+}
+
+const uint16_t* QuantizedEvents::getPowers(const size_t frame) const
+{
+    return _powers.get() + frame * _nPaddedEvents;
+}
+
+float QuantizedEvents::getPowersScale(const size_t frame) const
+{
+    return _powersScales[frame];
+}
+
+Precision QuantizedEvents::getPowersPrecision() const
+{
+    return _powersPrecision;
+}
+
+float QuantizedEvents::getPositionError() const
+{
+    return _positionError;
+}
+
+size_t QuantizedEvents::getEventsCount() const
+{
+    return _nEvents;
+}
+
+size_t QuantizedEvents::getPaddedEventsCount() const
+{
+    return _nPaddedEvents;
+}
+
+size_t QuantizedEvents::getDataSize() const
+{
+    return _nPaddedEvents * (4u + _nFrames) * sizeof(uint16_t) +
+           getBlocksCount(_nPaddedEvents) * 4u * sizeof(float);
+}
+}
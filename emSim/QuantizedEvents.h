@@ -0,0 +1,176 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _EMSim_QuantizedEvents_h_
+#define _EMSim_QuantizedEvents_h_
+
+#include <vector>
+
+#include <emSim/Events.h>
+#include <emSim/Precision.h>
+#include <emSim/Volume.h>
+#include <emSim/helpers.h>
+
+namespace ems
+{
+/**
+ * This class stores the events with 16 bits per value, for the volumes whose
+ * kernel is bound by the memory bandwidth.
+ *
+ * The events are split in blocks of quantizedBlockSize consecutive events,
+ * which are close to each other when loaded cell by cell or in spatial order.
+ * The positions are quantized on 16 bits relative to the origin of their
+ * block, with a step given by the largest extent of the block. The radii are
+ * stored as fp16, the powers as fp16 or bf16 after a per time step scaling by
+ * a power of two, which keeps the fp16 values in range without changing their
+ * relative precision. The kernels decode one block at a time and accumulate
+ * in fp32.
+ */
+class QuantizedEvents
+{
+public:
+    /** Deviation of the reduced precision values from the fp32 kernels */
+    struct Error
+    {
+        float maxError = 0.0f;
+        float rmsError = 0.0f;
+        float rmsValue = 0.0f;
+    };
+
+    /**
+     * Quantize the events' geometric data, and allocate the memory needed to
+     * store the powers of one time step.
+     * @param events The events whose geometric data is used
+     * @param powersPrecision The storage of the powers, fp16 or bf16
+     * @throw std::runtime_error if powersPrecision is fp32
+     * @throw std::bad_alloc if memory allocation did not work.
+     */
+    QuantizedEvents(const Events& events, Precision powersPrecision);
+
+    /**
+     * Convert the powers of the first time steps of the events.
+     * @param events The events given to the constructor
+     * @param nFrames The number of time steps to convert
+     * @throw std::bad_alloc if memory allocation did not work.
+     */
+    void update(const Events& events, size_t nFrames = 1u);
+
+    /**
+     * Compute a volume from the powers of a converted time step.
+     * @param volume The volume to compute, of any precision
+     * @param frame The index of the converted time step
+     * @param accumulate Add the contributions of the events to the current
+     * values of the volume instead of replacing them
+     */
+    void computeVolume(Volume& volume, size_t frame = 0u,
+                       bool accumulate = false) const;
+
+    /**
+     * Compare voxels of a volume computed from these events with the fp32
+     * kernels applied to the original events.
+     * @param events The events given to update()
+     * @param frame The index of the time step of the volume
+     * @param volume The volume computed by computeVolume()
+     * @param nSamples The number of compared voxels, evenly spread
+     */
+    Error estimateError(const Events& events, size_t frame,
+                        const Volume& volume, size_t nSamples) const;
+
+    /**
+     * @return The const pointer to the events' quantized x coordinates.
+     */
+    const uint16_t* getPositionsX() const;
+
+    /**
+     * @return The const pointer to the events' quantized y coordinates.
+     */
+    const uint16_t* getPositionsY() const;
+
+    /**
+     * @return The const pointer to the events' quantized z coordinates.
+     */
+    const uint16_t* getPositionsZ() const;
+
+    /**
+     * @return The origin x, y, z and quantization step of every block of
+     * events, 4 floats per block.
+     */
+    const float* getBlocks() const;
+
+    /**
+     * @return The pointer to the fp16 radii of the events.
+     */
+    const uint16_t* getRadii() const;
+
+    /**
+     * @param frame The index of the converted time step
+     * @return The pointer to the scaled powers of the events.
+     */
+    const uint16_t* getPowers(size_t frame = 0u) const;
+
+    /**
+     * @param frame The index of the converted time step
+     * @return The factor applied to the stored powers of the time step.
+     */
+    float getPowersScale(size_t frame = 0u) const;
+
+    /**
+     * @return the storage of the powers, fp16 or bf16.
+     */
+    Precision getPowersPrecision() const;
+
+    /**
+     * @return the largest distance between an event and its quantized
+     * position.
+     */
+    float getPositionError() const;
+
+    /**
+     * @return the number of events.
+     */
+    size_t getEventsCount() const;
+
+    /**
+     * @return the number of events including the padding, which is also the
+     * offset between the powers of consecutive time steps.
+     */
+    size_t getPaddedEventsCount() const;
+
+    /**
+     * @return the size in bytes of the stored events.
+     */
+    size_t getDataSize() const;
+
+private:
+    const size_t _nEvents;
+    const size_t _nPaddedEvents;
+    const Precision _powersPrecision;
+    size_t _nFrames = 1u;
+    float _positionError = 0.0f;
+
+    AlignedHalfPtr _positionsX;
+    AlignedHalfPtr _positionsY;
+    AlignedHalfPtr _positionsZ;
+    AlignedHalfPtr _radii;
+    AlignedHalfPtr _powers;
+    AlignedFloatPtr _blocks;
+    std::vector<float> _powersScales;
+};
+}
+
+#endif // _EMSim_QuantizedEvents_h_
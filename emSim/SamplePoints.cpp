@@ -19,10 +19,10 @@
 
 #include <algorithm>
 #include <cstring>
-#include <fstream>
 #include <iostream>
+#include <sstream>
 
-#include <emSim/ComputeSamplePoints.h>
+#include <emSim/Kernels.h>
 #include <emSim/SamplePoints.h>
 #include <emSim/helpers.h>
 
@@ -32,31 +32,231 @@ SamplePoints::SamplePoints(uint32_t nTimeSteps,
                            const std::vector<glm::vec3>& positions)
     : _nSamplePoints(positions.size())
     , _nTimeSteps(nTimeSteps)
-    , _flatPositions(alignedMalloc<float>(_nSamplePoints * 3u))
+    , _positionsX(alignedMalloc<float>(_nSamplePoints))
+    , _positionsY(alignedMalloc<float>(_nSamplePoints))
+    , _positionsZ(alignedMalloc<float>(_nSamplePoints))
     , _values(alignedMalloc<float>(_nSamplePoints * _nTimeSteps))
 {
-    std::memset(_values.get(), 0.0f,
-                _nSamplePoints * _nTimeSteps * sizeof(float));
+    fillMemory(_values.get(), size_t(_nSamplePoints) * _nTimeSteps, 0.0f);
 
     for (uint32_t i = 0; i < positions.size(); ++i)
     {
-        _flatPositions[i * 3] = positions[i].x;
-        _flatPositions[i * 3 + 1] = positions[i].y;
-        _flatPositions[i * 3 + 2] = positions[i].z;
+        _positionsX[i] = positions[i].x;
+        _positionsY[i] = positions[i].y;
+        _positionsZ[i] = positions[i].z;
     }
 }
 
-void SamplePoints::computeNextFrame(const Events& events)
+template <typename EventsT>
+void SamplePoints::_computeValues(const EventsT& events, const float* powers,
+                                  const uint32_t frame, float* values) const
+{
+    kernels::computeSamplePoints(events.getPositionsX(),
+                                 events.getPositionsY(),
+                                 events.getPositionsZ(), events.getRadii(),
+                                 powers, events.getEventsCount(), frame,
+                                 _positionsX.get(), _positionsY.get(),
+                                 _positionsZ.get(), values, _nSamplePoints);
+}
+
+void SamplePoints::computeNextFrame(const Events& events, const size_t frame)
+{
+    if (_useTransferMatrix)
+        _bufferFrame(events, frame);
+    else
+        _computeValues(events, events.getPowers(frame), _currentFrame,
+                       _values.get());
+    _printProgress();
+    ++_currentFrame;
+}
+
+Octree::Stats SamplePoints::computeNextFrame(const Octree& octree)
+{
+    const Octree::Stats stats =
+        octree.computeValues(_positionsX.get(), _positionsY.get(),
+                             _positionsZ.get(), _nSamplePoints,
+                             _values.get() + _currentFrame * _nSamplePoints);
+    _printProgress();
+    ++_currentFrame;
+    return stats;
+}
+
+float SamplePoints::computeNextFrame(const CellMultipoles& multipoles,
+                                     const Events& events, const size_t frame)
+{
+    const float exactRatio = multipoles.computeValues(
+        events, _positionsX.get(), _positionsY.get(), _positionsZ.get(),
+        _nSamplePoints, _values.get() + _currentFrame * _nSamplePoints, frame);
+    _printProgress();
+    ++_currentFrame;
+    return exactRatio;
+}
+
+void SamplePoints::computeNextFrame(const CompactEvents& events,
+                                    const size_t frame)
+{
+    if (_useTransferMatrix)
+        throw(std::runtime_error(
+            "error: Compacted events are not supported in transfer matrix "
+            "mode."));
+
+    _computeValues(events, events.getPowers(frame), _currentFrame,
+                   _values.get());
+    _printProgress();
+    ++_currentFrame;
+}
+
+void SamplePoints::computeFrames(const Events& events,
+                                 const LowRankPowers& lowRank)
+{
+    if (_currentFrame != 0u || lowRank.getFramesCount() != _nTimeSteps)
+        throw(std::runtime_error(
+            "error: The low rank powers must cover all the frames."));
+
+    const size_t rank = lowRank.getRank();
+    AlignedFloatPtr basisValues(
+        alignedMalloc<float>(std::max(rank, size_t(1)) * _nSamplePoints));
+    std::vector<const float*> basis;
+    for (size_t k = 0; k < rank; ++k)
+    {
+        _computeValues(events, lowRank.getBasis(k), k, basisValues.get());
+        basis.push_back(basisValues.get() + k * _nSamplePoints);
+    }
+
+    for (; _currentFrame < _nTimeSteps; ++_currentFrame)
+    {
+        lowRank.reconstruct(basis, _nSamplePoints, _currentFrame,
+                            _values.get() + _currentFrame * _nSamplePoints);
+        _printProgress();
+    }
+}
+
+void SamplePoints::computeNextFrame(const IncrementalEvents& events)
+{
+    if (_useTransferMatrix)
+        throw(std::runtime_error(
+            "error: Incremental frames are not supported in transfer matrix "
+            "mode."));
+
+    if (events.isFullRefresh())
+        _computeValues(events, events.getPowers(), _currentFrame,
+                       _values.get());
+    else
+    {
+        if (_currentFrame == 0u)
+            throw(std::runtime_error(
+                "error: The first incremental frame must be a full refresh."));
+
+        if (!_deltaValues)
+            _deltaValues.reset(alignedMalloc<float>(_nSamplePoints));
+
+        float* values = _values.get() + _currentFrame * _nSamplePoints;
+        const float* previousValues = values - _nSamplePoints;
+        if (events.getEventsCount() == 0u)
+            std::memcpy(values, previousValues, _nSamplePoints * sizeof(float));
+        else
+        {
+            _computeValues(events, events.getPowers(), 0u,
+                           _deltaValues.get());
+            for (size_t i = 0; i < _nSamplePoints; ++i)
+                values[i] = previousValues[i] + _deltaValues[i];
+        }
+    }
+    _printProgress();
+    ++_currentFrame;
+}
+
+void SamplePoints::_printProgress() const
 {
-    ispc::ComputeSamplePoints_ispc(events.getFlatPositions(), events.getRadii(),
-                                   events.getPowers(), events.getEventsCount(),
-                                   _currentFrame, _flatPositions.get(),
-                                   _values.get(), _nSamplePoints);
     std::cout << "\rINFO: Computing frames: " << _currentFrame + 1u << "/"
               << _nTimeSteps << "  -  "
               << 100.0f * (float)(_currentFrame + 1u) / (float)_nTimeSteps
               << "%." << std::flush;
-    ++_currentFrame;
+}
+
+void SamplePoints::useTransferMatrix(const size_t framesPerBlock,
+                                     const size_t maxMatrixSize)
+{
+    if (_currentFrame != 0u)
+        throw(std::runtime_error(
+            "error: Cannot switch to transfer matrix mode after the first "
+            "frame."));
+
+    _useTransferMatrix = true;
+    _framesPerBlock = std::max(framesPerBlock, size_t(1));
+    _maxMatrixSize = maxMatrixSize;
+}
+
+void SamplePoints::_bufferFrame(const Events& events, const size_t frame)
+{
+    const size_t nEvents = events.getEventsCount();
+    if (!_framePowers)
+    {
+        _eventsPerMatrixBlock =
+            std::max(_maxMatrixSize / (_nSamplePoints * sizeof(float)),
+                     size_t(1));
+        // Blocks start on a padding boundary to keep the events aligned
+        _eventsPerMatrixBlock = std::min(_eventsPerMatrixBlock, nEvents);
+        if (_eventsPerMatrixBlock > simdPadding)
+            _eventsPerMatrixBlock -= _eventsPerMatrixBlock % simdPadding;
+
+        _framesPerBlock = std::min(_framesPerBlock, _nTimeSteps);
+        _framePowers.reset(alignedMalloc<float>(
+            _framesPerBlock * events.getPaddedEventsCount()));
+        _transferMatrix.reset(
+            alignedMalloc<float>(_nSamplePoints * _eventsPerMatrixBlock));
+
+        std::cout << "INFO: Transfer matrix of " << _nSamplePoints << "x"
+                  << nEvents << " computed in blocks of "
+                  << _eventsPerMatrixBlock << " events, " << _framesPerBlock
+                  << " frames per block." << std::endl;
+    }
+
+    std::memcpy(_framePowers.get() +
+                    _bufferedFrames * events.getPaddedEventsCount(),
+                events.getPowers(frame), nEvents * sizeof(float));
+    ++_bufferedFrames;
+
+    if (_bufferedFrames == _framesPerBlock ||
+        _currentFrame + 1u == _nTimeSteps)
+    {
+        _computeBufferedFrames(events);
+    }
+}
+
+void SamplePoints::_computeBufferedFrames(const Events& events)
+{
+    const size_t nEvents = events.getEventsCount();
+    const uint32_t firstFrame = _currentFrame + 1u - _bufferedFrames;
+    float* values = _values.get() + firstFrame * _nSamplePoints;
+
+    for (size_t blockStart = 0; blockStart < nEvents;
+         blockStart += _eventsPerMatrixBlock)
+    {
+        const size_t blockSize =
+            std::min(_eventsPerMatrixBlock, nEvents - blockStart);
+
+        // A matrix holding all the events is computed once for all frames,
+        // partial ones are recomputed for every block of frames.
+        if (!_transferMatrixValid)
+        {
+            kernels::computeTransferMatrix(
+                events.getPositionsX() + blockStart,
+                events.getPositionsY() + blockStart,
+                events.getPositionsZ() + blockStart,
+                events.getRadii() + blockStart, blockSize, _positionsX.get(),
+                _positionsY.get(), _positionsZ.get(), _nSamplePoints,
+                _transferMatrix.get());
+            _transferMatrixValid = blockSize == nEvents;
+        }
+
+        kernels::applyTransferMatrix(_transferMatrix.get(), _nSamplePoints,
+                                     blockSize,
+                                     _framePowers.get() + blockStart,
+                                     events.getPaddedEventsCount(),
+                                     _bufferedFrames, values);
+    }
+    _bufferedFrames = 0u;
 }
 
 void SamplePoints::writeToFile(const glm::vec2& timeRange, const float dt,
@@ -64,10 +264,10 @@ void SamplePoints::writeToFile(const glm::vec2& timeRange, const float dt,
                                const std::string& outputFile,
                                const std::string& blueconfig,
                                const std::string& report,
-                               const std::string& target)
+                               const std::string& target,
+                               FileWriter* writer)
 {
-    std::ofstream output;
-    output.open(outputFile + "_sample_points");
+    std::ostringstream output;
 
     output
         << "# File generated by EMSim tool:\n"
@@ -82,8 +282,8 @@ void SamplePoints::writeToFile(const glm::vec2& timeRange, const float dt,
     for (size_t i = 0; i < _nSamplePoints; ++i)
     {
         output << "# - SamplePoint_" << i
-               << " position: " << _flatPositions[i * 3] << ","
-               << _flatPositions[i * 3 + 1] << "," << _flatPositions[i * 3 + 2]
+               << " position: " << _positionsX[i] << "," << _positionsY[i]
+               << "," << _positionsZ[i]
                << std::endl;
     }
 
@@ -97,10 +297,58 @@ void SamplePoints::writeToFile(const glm::vec2& timeRange, const float dt,
         for (uint32_t j = 0; j < _nSamplePoints; ++j)
             output << _values[_nSamplePoints * i + j] << " ";
     }
+    writeTextFile(outputFile + "_sample_points", output.str(), writer);
+}
+
+void SamplePoints::writeToHDF5(HDF5Output& output, const glm::vec2& timeRange,
+                               const float dt,
+                               const std::string& dataUnit) const
+{
+    const std::string name = "sample_points";
+    const size_t dataset =
+        output.createDataset(name, {_nSamplePoints}, _nTimeSteps);
+
+    std::vector<double> positions;
+    for (size_t i = 0; i < _nSamplePoints; ++i)
+    {
+        positions.push_back(_positionsX[i]);
+        positions.push_back(_positionsY[i]);
+        positions.push_back(_positionsZ[i]);
+    }
+    output.setAttribute(name, "Positions", positions);
+    output.setAttribute(name, "TimeRange",
+                        std::vector<double>{timeRange.x, timeRange.y});
+    output.setAttribute(name, "TimeStep", std::vector<double>{dt});
+    std::string voltUnit = dataUnit;
+    std::replace(voltUnit.begin(), voltUnit.end(), 'A', 'V');
+    output.setAttribute(name, "Units", voltUnit);
+
+    for (size_t i = 0; i < _nTimeSteps; ++i)
+        output.writeFrame(dataset, i, _values.get() + i * _nSamplePoints);
 }
 
 const float* SamplePoints::getValues() const
 {
     return _values.get();
 }
+
+const float* SamplePoints::getPositionsX() const
+{
+    return _positionsX.get();
+}
+
+const float* SamplePoints::getPositionsY() const
+{
+    return _positionsY.get();
+}
+
+const float* SamplePoints::getPositionsZ() const
+{
+    return _positionsZ.get();
+}
+
+size_t SamplePoints::getSamplePointsCount() const
+{
+    return _nSamplePoints;
+}
 }
@@ -26,7 +26,14 @@
 #include <string>
 #include <vector>
 
+#include <emSim/CellMultipoles.h>
+#include <emSim/CompactEvents.h>
 #include <emSim/Events.h>
+#include <emSim/FileWriter.h>
+#include <emSim/HDF5Output.h>
+#include <emSim/IncrementalEvents.h>
+#include <emSim/LowRankPowers.h>
+#include <emSim/Octree.h>
 
 namespace ems
 {
@@ -57,9 +64,74 @@ public:
 
     /**
      * Compute the values of all sample points for the next frame.
-     * @param events the events of a single frame.
+     * In transfer matrix mode, the frame is only buffered and the values are
+     * computed once a block of frames is complete or the last frame is
+     * reached.
+     * @param events the events of one or several frames.
+     * @param frame the frame of the events to use.
      */
-    void computeNextFrame(const Events& events);
+    void computeNextFrame(const Events& events, size_t frame = 0u);
+
+    /**
+     * Compute the values of all sample points for the next frame with the
+     * Barnes-Hut approximation.
+     * @param octree the octree updated with the powers of the frame.
+     * @return the interactions statistics of the computation
+     */
+    Octree::Stats computeNextFrame(const Octree& octree);
+
+    /**
+     * Compute the values of all sample points for the next frame with the
+     * cells' multipoles.
+     * @param multipoles the multipoles updated with the powers of the frame.
+     * @param events the events given to the multipoles update
+     * @param frame the frame given to the multipoles update
+     * @return the fraction of the cells evaluated exactly
+     */
+    float computeNextFrame(const CellMultipoles& multipoles,
+                           const Events& events, size_t frame = 0u);
+
+    /**
+     * Compute the values of all sample points for the next frame from the
+     * active events only.
+     * @param events the packed active events.
+     * @param frame the index of the packed frame to compute
+     * @throw std::runtime_error in transfer matrix mode.
+     */
+    void computeNextFrame(const CompactEvents& events, size_t frame = 0u);
+
+    /**
+     * Compute the values of all sample points for all the frames at once,
+     * as combinations of the values of the basis power vectors.
+     * @param events the events whose geometric data is used.
+     * @param lowRank the decomposition of the powers of all the frames.
+     * @throw std::runtime_error if a frame was already computed or if the
+     * decomposition does not cover all the frames.
+     */
+    void computeFrames(const Events& events, const LowRankPowers& lowRank);
+
+    /**
+     * Compute the values of all sample points for the next frame by adding
+     * the contributions of the selected power changes to the values of the
+     * previous frame, or from scratch on a full refresh.
+     * @param events the events selected for the frame.
+     * @throw std::runtime_error if the first frame is not a full refresh or
+     * in transfer matrix mode.
+     */
+    void computeNextFrame(const IncrementalEvents& events);
+
+    /**
+     * Switch to the transfer matrix mode. As the events geometry is static,
+     * the value of each sample point is a fixed linear combination of the
+     * events' powers. The weights of these combinations are computed once
+     * and the frames are then evaluated in blocks as a matrix product.
+     * If the matrix does not fit in the given memory budget, it is split in
+     * blocks of events which are recomputed for every block of frames.
+     * @param framesPerBlock the number of frames buffered before evaluation
+     * @param maxMatrixSize the maximum size of the matrix in bytes
+     * @throw std::runtime_error if called after the first frame
+     */
+    void useTransferMatrix(size_t framesPerBlock, size_t maxMatrixSize);
 
     /**
      * Write sample points values for all time steps in a file.
@@ -70,23 +142,78 @@ public:
      * @param blueconfig the name of the blueconfig
      * @param report the name of the report
      * @param target the name of the target
+     * @param writer the background writer of the file, null to write it
+     * before returning
+     * @throw std::runtime_error if the file can not be written
      */
     void writeToFile(const glm::vec2& timeRange, const float dt,
                      const std::string& dataUnit, const std::string& outputFile,
                      const std::string& blueconfig, const std::string& report,
-                     const std::string& target);
+                     const std::string& target, FileWriter* writer = nullptr);
+
+    /**
+     * Write the sample points values for all time steps to a dataset
+     * "sample_points" of an HDF5 file, one row per time step, with the
+     * positions, time range and units as attributes.
+     * @param output the HDF5 file
+     * @param timeRange the time range used to compute sample points
+     * @param dt the time dt used for computation
+     * @param dataUnit a string describing the data units (ex: "mA")
+     * @throw std::runtime_error if the dataset can not be created
+     */
+    void writeToHDF5(HDF5Output& output, const glm::vec2& timeRange,
+                     const float dt, const std::string& dataUnit) const;
 
     /**
      * @return The pointer to the sample points values.
      */
     const float* getValues() const;
 
+    /**
+     * @return The pointer to the sample points x coordinates.
+     */
+    const float* getPositionsX() const;
+
+    /**
+     * @return The pointer to the sample points y coordinates.
+     */
+    const float* getPositionsY() const;
+
+    /**
+     * @return The pointer to the sample points z coordinates.
+     */
+    const float* getPositionsZ() const;
+
+    /**
+     * @return the number of sample points.
+     */
+    size_t getSamplePointsCount() const;
+
 private:
+    template <typename EventsT>
+    void _computeValues(const EventsT& events, const float* powers,
+                        uint32_t frame, float* values) const;
+    void _printProgress() const;
+    void _bufferFrame(const Events& events, size_t frame);
+    void _computeBufferedFrames(const Events& events);
+
     size_t _nSamplePoints = 0u;
     size_t _nTimeSteps = 0u;
     uint32_t _currentFrame = 0u;
-    AlignedFloatPtr _flatPositions;
+    AlignedFloatPtr _positionsX;
+    AlignedFloatPtr _positionsY;
+    AlignedFloatPtr _positionsZ;
     AlignedFloatPtr _values;
+    AlignedFloatPtr _deltaValues;
+
+    bool _useTransferMatrix = false;
+    size_t _framesPerBlock = 0u;
+    size_t _maxMatrixSize = 0u;
+    size_t _eventsPerMatrixBlock = 0u;
+    bool _transferMatrixValid = false;
+    uint32_t _bufferedFrames = 0u;
+    AlignedFloatPtr _transferMatrix;
+    AlignedFloatPtr _framePowers;
 };
 }
 #endif // _SamplePoints_h_
@@ -0,0 +1,235 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _EMSim_Simd_h_
+#define _EMSim_Simd_h_
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(__AVX__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace ems
+{
+namespace simd
+{
+/**
+ * Register of W floats. Only the widths supported by the instruction sets
+ * enabled at compile time are defined, the scalar one always is.
+ */
+template <size_t W>
+struct Float;
+
+template <>
+struct Float<1>
+{
+    static const size_t width = 1;
+    float value;
+
+    static Float load(const float* ptr) { return {*ptr}; }
+    static Float broadcast(const float value) { return {value}; }
+    static Float ramp(const float start) { return {start}; }
+    void store(float* ptr) const { *ptr = value; }
+    float sum() const { return value; }
+
+    Float operator+(const Float& other) const { return {value + other.value}; }
+    Float operator-(const Float& other) const { return {value - other.value}; }
+    Float operator*(const Float& other) const { return {value * other.value}; }
+    Float& operator+=(const Float& other)
+    {
+        value += other.value;
+        return *this;
+    }
+    Float max(const Float& other) const
+    {
+        return {value > other.value ? value : other.value};
+    }
+    Float invSqrt() const { return {1.0f / std::sqrt(value)}; }
+};
+
+#ifdef __SSE2__
+template <>
+struct Float<4>
+{
+    static const size_t width = 4;
+    __m128 value;
+
+    static Float load(const float* ptr) { return {_mm_loadu_ps(ptr)}; }
+    static Float broadcast(const float value) { return {_mm_set1_ps(value)}; }
+    static Float ramp(const float start)
+    {
+        return {_mm_setr_ps(start, start + 1.0f, start + 2.0f, start + 3.0f)};
+    }
+    void store(float* ptr) const { _mm_storeu_ps(ptr, value); }
+    float sum() const
+    {
+        const __m128 pairs = _mm_add_ps(value, _mm_movehl_ps(value, value));
+        return _mm_cvtss_f32(
+            _mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+    }
+
+    Float operator+(const Float& other) const
+    {
+        return {_mm_add_ps(value, other.value)};
+    }
+    Float operator-(const Float& other) const
+    {
+        return {_mm_sub_ps(value, other.value)};
+    }
+    Float operator*(const Float& other) const
+    {
+        return {_mm_mul_ps(value, other.value)};
+    }
+    Float& operator+=(const Float& other)
+    {
+        value = _mm_add_ps(value, other.value);
+        return *this;
+    }
+    Float max(const Float& other) const
+    {
+        return {_mm_max_ps(value, other.value)};
+    }
+    Float invSqrt() const
+    {
+        return {_mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(value))};
+    }
+};
+#endif
+
+#ifdef __AVX__
+template <>
+struct Float<8>
+{
+    static const size_t width = 8;
+    __m256 value;
+
+    static Float load(const float* ptr) { return {_mm256_loadu_ps(ptr)}; }
+    static Float broadcast(const float value)
+    {
+        return {_mm256_set1_ps(value)};
+    }
+    static Float ramp(const float start)
+    {
+        return {_mm256_add_ps(_mm256_set1_ps(start),
+                              _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f,
+                                             5.0f, 6.0f, 7.0f))};
+    }
+    void store(float* ptr) const { _mm256_storeu_ps(ptr, value); }
+    float sum() const
+    {
+        const Float<4> half = {_mm_add_ps(_mm256_castps256_ps128(value),
+                                          _mm256_extractf128_ps(value, 1))};
+        return half.sum();
+    }
+
+    Float operator+(const Float& other) const
+    {
+        return {_mm256_add_ps(value, other.value)};
+    }
+    Float operator-(const Float& other) const
+    {
+        return {_mm256_sub_ps(value, other.value)};
+    }
+    Float operator*(const Float& other) const
+    {
+        return {_mm256_mul_ps(value, other.value)};
+    }
+    Float& operator+=(const Float& other)
+    {
+        value = _mm256_add_ps(value, other.value);
+        return *this;
+    }
+    Float max(const Float& other) const
+    {
+        return {_mm256_max_ps(value, other.value)};
+    }
+    Float invSqrt() const
+    {
+        return {_mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(value))};
+    }
+};
+#endif
+
+#ifdef __AVX512F__
+template <>
+struct Float<16>
+{
+    static const size_t width = 16;
+    __m512 value;
+
+    static Float load(const float* ptr) { return {_mm512_loadu_ps(ptr)}; }
+    static Float broadcast(const float value)
+    {
+        return {_mm512_set1_ps(value)};
+    }
+    static Float ramp(const float start)
+    {
+        return {_mm512_add_ps(_mm512_set1_ps(start),
+                              _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f,
+                                             5.0f, 6.0f, 7.0f, 8.0f, 9.0f,
+                                             10.0f, 11.0f, 12.0f, 13.0f,
+                                             14.0f, 15.0f))};
+    }
+    void store(float* ptr) const { _mm512_storeu_ps(ptr, value); }
+    float sum() const { return _mm512_reduce_add_ps(value); }
+
+    Float operator+(const Float& other) const
+    {
+        return {_mm512_add_ps(value, other.value)};
+    }
+    Float operator-(const Float& other) const
+    {
+        return {_mm512_sub_ps(value, other.value)};
+    }
+    Float operator*(const Float& other) const
+    {
+        return {_mm512_mul_ps(value, other.value)};
+    }
+    Float& operator+=(const Float& other)
+    {
+        value = _mm512_add_ps(value, other.value);
+        return *this;
+    }
+    Float max(const Float& other) const
+    {
+        return {_mm512_max_ps(value, other.value)};
+    }
+    Float invSqrt() const
+    {
+        return {_mm512_div_ps(_mm512_set1_ps(1.0f), _mm512_sqrt_ps(value))};
+    }
+};
+#endif
+
+/** The widest register width enabled at compile time */
+#if defined(__AVX512F__)
+const size_t nativeWidth = 16;
+#elif defined(__AVX__)
+const size_t nativeWidth = 8;
+#elif defined(__SSE2__)
+const size_t nativeWidth = 4;
+#else
+const size_t nativeWidth = 1;
+#endif
+}
+}
+
+#endif // _EMSim_Simd_h_
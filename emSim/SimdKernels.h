@@ -0,0 +1,625 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _EMSim_SimdKernels_h_
+#define _EMSim_SimdKernels_h_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <emSim/Precision.h>
+#include <emSim/Simd.h>
+#include <emSim/ThreadPool.h>
+#include <emSim/helpers.h>
+
+namespace ems
+{
+/**
+ * C++ implementation of the ISPC kernels, templated on the SIMD width. The
+ * functions have the same arguments and results as their ISPC counterparts,
+ * see Kernels.h for the documented entry points.
+ */
+namespace simd
+{
+// Same blocking as the ISPC kernels
+const uint32_t brickSizeX = 32u;
+const uint32_t brickSizeY = 4u;
+const uint32_t brickSizeZ = 4u;
+const uint32_t framesTile = 4u;
+const uint32_t samplePointsTile = 2u;
+const uint32_t eventBlockSize = 4096u;
+
+/**
+ * Sum of the powers of the events [startEvent, endEvent) divided by their
+ * distance to a position, the events being spread across the lanes.
+ */
+template <size_t W>
+float sumEvents(const float* eventPosX, const float* eventPosY,
+                const float* eventPosZ, const float* eventRadii,
+                const float* eventPowers, const uint32_t startEvent,
+                const uint32_t endEvent, const float posX, const float posY,
+                const float posZ)
+{
+    typedef Float<W> V;
+    const V x = V::broadcast(posX);
+    const V y = V::broadcast(posY);
+    const V z = V::broadcast(posZ);
+
+    V accum = V::broadcast(0.0f);
+    uint32_t i = startEvent;
+    for (; i + W <= endEvent; i += W)
+    {
+        const V deltaX = x - V::load(eventPosX + i);
+        const V deltaY = y - V::load(eventPosY + i);
+        const V deltaZ = z - V::load(eventPosZ + i);
+        const V radius = V::load(eventRadii + i);
+        const V squaredDist =
+            deltaX * deltaX + deltaY * deltaY + deltaZ * deltaZ;
+        accum += V::load(eventPowers + i) *
+                 squaredDist.max(radius * radius).invSqrt();
+    }
+    float sum = accum.sum();
+    if (W > 1 && i < endEvent)
+        sum += sumEvents<1>(eventPosX, eventPosY, eventPosZ, eventRadii,
+                            eventPowers, i, endEvent, posX, posY, posZ);
+    return sum;
+}
+
+/**
+ * Compute W consecutive voxels of a row against the events
+ * [startEvent, endEvent), the voxels being spread across the lanes.
+ */
+template <size_t W>
+void computeVoxels(const float* eventPosX, const float* eventPosY,
+                   const float* eventPosZ, const float* eventRadii,
+                   const float* eventPowers, const uint32_t startEvent,
+                   const uint32_t endEvent, const uint32_t x,
+                   const float voxelPosY, const float voxelPosZ,
+                   const float resX, const float originX, float* row,
+                   const bool overwrite)
+{
+    typedef Float<W> V;
+    const V voxelPosX =
+        V::broadcast(originX) + V::ramp(float(x)) * V::broadcast(resX);
+
+    V voxelValue = V::broadcast(0.0f);
+    for (uint32_t i = startEvent; i < endEvent; ++i)
+    {
+        const float deltaY = voxelPosY - eventPosY[i];
+        const float deltaZ = voxelPosZ - eventPosZ[i];
+        const V squaredDistYZ = V::broadcast(deltaY * deltaY + deltaZ * deltaZ);
+        const V deltaX = voxelPosX - V::broadcast(eventPosX[i]);
+        const V squaredDist = deltaX * deltaX + squaredDistYZ;
+        const float radius = eventRadii[i];
+        voxelValue += V::broadcast(eventPowers[i]) *
+                      squaredDist.max(V::broadcast(radius * radius)).invSqrt();
+    }
+
+    V value = V::broadcast(Ec) * voxelValue;
+    if (!overwrite)
+        value += V::load(row + x);
+    value.store(row + x);
+}
+
+/**
+ * Compute the voxels [startX, endX) of a row against the events
+ * [startEvent, endEvent).
+ */
+template <size_t W>
+void computeRow(const float* eventPosX, const float* eventPosY,
+                const float* eventPosZ, const float* eventRadii,
+                const float* eventPowers, const uint32_t startEvent,
+                const uint32_t endEvent, const uint32_t startX,
+                const uint32_t endX, const float voxelPosY,
+                const float voxelPosZ, const float resX, const float originX,
+                float* row, const bool overwrite)
+{
+    uint32_t x = startX;
+    for (; x + W <= endX; x += W)
+        computeVoxels<W>(eventPosX, eventPosY, eventPosZ, eventRadii,
+                         eventPowers, startEvent, endEvent, x, voxelPosY,
+                         voxelPosZ, resX, originX, row, overwrite);
+    for (; x < endX; ++x)
+        computeVoxels<1>(eventPosX, eventPosY, eventPosZ, eventRadii,
+                         eventPowers, startEvent, endEvent, x, voxelPosY,
+                         voxelPosZ, resX, originX, row, overwrite);
+}
+
+/** @sa ComputeVolumeTiles_ispc */
+template <size_t W>
+void computeVolumeTiles(
+    const float* eventPosX, const float* eventPosY, const float* eventPosZ,
+    const float* eventRadii, const float* eventPowers, const uint32_t nEvents,
+    float* volumeData, const uint32_t sizeX, const uint32_t sizeY,
+    const uint32_t sizeZ, const float resX, const float resY,
+    const float resZ, const float originX, const float originY,
+    const float originZ, const uint32_t tileSizeX, const uint32_t tileSizeY,
+    const uint32_t tileSizeZ, const uint32_t eventsChunkSize,
+    const bool accumulate)
+{
+    if (sizeX == 0 || sizeY == 0 || sizeZ == 0)
+        return;
+
+    const uint32_t tileX = tileSizeX == 0 ? sizeX : tileSizeX;
+    const uint32_t tileY = tileSizeY == 0 ? sizeY : tileSizeY;
+    const uint32_t tileZ = tileSizeZ == 0 ? sizeZ : tileSizeZ;
+    const uint32_t chunkSize =
+        eventsChunkSize == 0 ? std::max(nEvents, 1u) : eventsChunkSize;
+
+    const size_t nTilesX = (sizeX - 1) / tileX + 1;
+    const size_t nTilesY = (sizeY - 1) / tileY + 1;
+    const size_t nTilesZ = (sizeZ - 1) / tileZ + 1;
+
+    parallelFor(nTilesX * nTilesY * nTilesZ, [&](const size_t tile) {
+        const uint32_t startX = (tile % nTilesX) * tileX;
+        const uint32_t startY = (tile / nTilesX % nTilesY) * tileY;
+        const uint32_t startZ = (tile / nTilesX / nTilesY) * tileZ;
+        const uint32_t endX = std::min(startX + tileX, sizeX);
+        const uint32_t endY = std::min(startY + tileY, sizeY);
+        const uint32_t endZ = std::min(startZ + tileZ, sizeZ);
+
+        const auto rowOf = [&](const uint32_t y, const uint32_t z) {
+            return volumeData + (uint64_t(z) * sizeY + y) * sizeX;
+        };
+
+        if (nEvents == 0 && !accumulate)
+        {
+            for (uint32_t z = startZ; z < endZ; ++z)
+                for (uint32_t y = startY; y < endY; ++y)
+                    std::fill(rowOf(y, z) + startX, rowOf(y, z) + endX, 0.0f);
+            return;
+        }
+
+        for (uint32_t chunkStart = 0; chunkStart < nEvents;
+             chunkStart += chunkSize)
+        {
+            const uint32_t chunkEnd = std::min(chunkStart + chunkSize, nEvents);
+            // The first chunk overwrites the previous values of the tile
+            const bool overwrite = chunkStart == 0 && !accumulate;
+
+            for (uint32_t z = startZ; z < endZ; ++z)
+                for (uint32_t y = startY; y < endY; ++y)
+                    computeRow<W>(eventPosX, eventPosY, eventPosZ, eventRadii,
+                                  eventPowers, chunkStart, chunkEnd, startX,
+                                  endX, originY + y * resY,
+                                  originZ + z * resZ, resX, originX,
+                                  rowOf(y, z), overwrite);
+        }
+    });
+}
+
+/** @sa ComputeVolume_ispc, AccumulateVolume_ispc */
+template <size_t W>
+void computeVolume(const float* eventPosX, const float* eventPosY,
+                   const float* eventPosZ, const float* eventRadii,
+                   const float* eventPowers, const uint32_t nEvents,
+                   float* volumeData, const uint32_t sizeX,
+                   const uint32_t sizeY, const uint32_t sizeZ,
+                   const float resX, const float resY, const float resZ,
+                   const float originX, const float originY,
+                   const float originZ, const bool accumulate)
+{
+    // One task per brick, every brick sees all the events at once
+    computeVolumeTiles<W>(eventPosX, eventPosY, eventPosZ, eventRadii,
+                          eventPowers, nEvents, volumeData, sizeX, sizeY,
+                          sizeZ, resX, resY, resZ, originX, originY, originZ,
+                          brickSizeX, brickSizeY, brickSizeZ, 0u, accumulate);
+}
+
+/**
+ * Compute W consecutive voxels of a row for a tile of frames, every distance
+ * being reused for all the frames of the tile.
+ */
+template <size_t W>
+void computeFramesVoxels(const float* eventPosX, const float* eventPosY,
+                         const float* eventPosZ, const float* eventRadii,
+                         const float* const* powers, const uint32_t nEvents,
+                         const uint32_t x, const float voxelPosY,
+                         const float voxelPosZ, const float resX,
+                         const float originX, float* const* rows,
+                         const uint32_t nFrames)
+{
+    typedef Float<W> V;
+    const V voxelPosX =
+        V::broadcast(originX) + V::ramp(float(x)) * V::broadcast(resX);
+
+    V voxelValues[framesTile];
+    for (uint32_t f = 0; f < framesTile; ++f)
+        voxelValues[f] = V::broadcast(0.0f);
+
+    for (uint32_t i = 0; i < nEvents; ++i)
+    {
+        const float deltaY = voxelPosY - eventPosY[i];
+        const float deltaZ = voxelPosZ - eventPosZ[i];
+        const V squaredDistYZ = V::broadcast(deltaY * deltaY + deltaZ * deltaZ);
+        const V deltaX = voxelPosX - V::broadcast(eventPosX[i]);
+        const V squaredDist = deltaX * deltaX + squaredDistYZ;
+        const float radius = eventRadii[i];
+        const V distInv =
+            squaredDist.max(V::broadcast(radius * radius)).invSqrt();
+        for (uint32_t f = 0; f < framesTile; ++f)
+            voxelValues[f] += V::broadcast(powers[f][i]) * distInv;
+    }
+
+    for (uint32_t f = 0; f < nFrames; ++f)
+        (V::broadcast(Ec) * voxelValues[f]).store(rows[f] + x);
+}
+
+/** @sa ComputeVolumeFrames_ispc */
+template <size_t W>
+void computeVolumeFrames(
+    const float* eventPosX, const float* eventPosY, const float* eventPosZ,
+    const float* eventRadii, const float* eventPowers, const uint32_t nEvents,
+    const uint64_t powersStride, const uint32_t nFrames, float** volumesData,
+    const uint32_t sizeX, const uint32_t sizeY, const uint32_t sizeZ,
+    const float resX, const float resY, const float resZ,
+    const float originX, const float originY, const float originZ)
+{
+    if (nFrames == 0 || sizeX == 0 || sizeY == 0 || sizeZ == 0)
+        return;
+
+    const size_t nBricksX = (sizeX - 1) / brickSizeX + 1;
+    const size_t nBricksY = (sizeY - 1) / brickSizeY + 1;
+    const size_t nBricksZ = (sizeZ - 1) / brickSizeZ + 1;
+
+    parallelFor(nBricksX * nBricksY * nBricksZ, [&](const size_t brick) {
+        const uint32_t startX = (brick % nBricksX) * brickSizeX;
+        const uint32_t startY = (brick / nBricksX % nBricksY) * brickSizeY;
+        const uint32_t startZ = (brick / nBricksX / nBricksY) * brickSizeZ;
+        const uint32_t endX = std::min(startX + brickSizeX, sizeX);
+        const uint32_t endY = std::min(startY + brickSizeY, sizeY);
+        const uint32_t endZ = std::min(startZ + brickSizeZ, sizeZ);
+
+        for (uint32_t firstFrame = 0; firstFrame < nFrames;
+             firstFrame += framesTile)
+        {
+            // Out of range frames of the tile are clamped to the last valid
+            // one and their results discarded.
+            const uint32_t tileFrames =
+                std::min(framesTile, nFrames - firstFrame);
+            const float* powers[framesTile];
+            for (uint32_t f = 0; f < framesTile; ++f)
+            {
+                const uint32_t frame = std::min(firstFrame + f, nFrames - 1);
+                powers[f] = eventPowers + frame * powersStride;
+            }
+
+            for (uint32_t z = startZ; z < endZ; ++z)
+                for (uint32_t y = startY; y < endY; ++y)
+                {
+                    const uint64_t rowIndex = (uint64_t(z) * sizeY + y) * sizeX;
+                    float* rows[framesTile];
+                    for (uint32_t f = 0; f < framesTile; ++f)
+                        rows[f] =
+                            volumesData[std::min(firstFrame + f, nFrames - 1)] +
+                            rowIndex;
+
+                    const float voxelPosY = originY + y * resY;
+                    const float voxelPosZ = originZ + z * resZ;
+                    uint32_t x = startX;
+                    for (; x + W <= endX; x += W)
+                        computeFramesVoxels<W>(eventPosX, eventPosY, eventPosZ,
+                                               eventRadii, powers, nEvents, x,
+                                               voxelPosY, voxelPosZ, resX,
+                                               originX, rows, tileFrames);
+                    for (; x < endX; ++x)
+                        computeFramesVoxels<1>(eventPosX, eventPosY, eventPosZ,
+                                               eventRadii, powers, nEvents, x,
+                                               voxelPosY, voxelPosZ, resX,
+                                               originX, rows, tileFrames);
+                }
+        }
+    });
+}
+
+/** @sa ComputeQuantizedVolume_ispc */
+template <size_t W>
+void computeQuantizedVolume(
+    const uint16_t* eventPosX, const uint16_t* eventPosY,
+    const uint16_t* eventPosZ, const float* eventBlocks,
+    const uint16_t* eventRadii, const uint16_t* eventPowers,
+    const uint32_t powersPrecision, const float powersScale,
+    const uint32_t nEvents, float* volumeData, uint16_t* volumeHalfData,
+    const uint32_t volumePrecision, const uint32_t sizeX,
+    const uint32_t sizeY, const uint32_t sizeZ, const float resX,
+    const float resY, const float resZ, const float originX,
+    const float originY, const float originZ, const bool accumulate)
+{
+    if (sizeX == 0 || sizeY == 0 || sizeZ == 0)
+        return;
+
+    const size_t nBricksX = (sizeX - 1) / brickSizeX + 1;
+    const size_t nBricksY = (sizeY - 1) / brickSizeY + 1;
+    const size_t nBricksZ = (sizeZ - 1) / brickSizeZ + 1;
+    const Precision powersFormat = Precision(powersPrecision);
+    const Precision volumeFormat = Precision(volumePrecision);
+
+    parallelFor(nBricksX * nBricksY * nBricksZ, [&](const size_t brick) {
+        const uint32_t startX = (brick % nBricksX) * brickSizeX;
+        const uint32_t startY = (brick / nBricksX % nBricksY) * brickSizeY;
+        const uint32_t startZ = (brick / nBricksX / nBricksY) * brickSizeZ;
+        const uint32_t endX = std::min(startX + brickSizeX, sizeX);
+        const uint32_t endY = std::min(startY + brickSizeY, sizeY);
+        const uint32_t endZ = std::min(startZ + brickSizeZ, sizeZ);
+
+        // The brick is accumulated in fp32 over the blocks of events, every
+        // block being decoded once for the whole brick.
+        float brickValues[brickSizeX * brickSizeY * brickSizeZ] = {};
+        float posX[quantizedBlockSize];
+        float posY[quantizedBlockSize];
+        float posZ[quantizedBlockSize];
+        float radii[quantizedBlockSize];
+        float powers[quantizedBlockSize];
+        const auto brickRow = [&](const uint32_t y, const uint32_t z) {
+            return brickValues + ((z - startZ) * brickSizeY + y - startY) *
+                                     brickSizeX;
+        };
+
+        for (uint32_t blockStart = 0; blockStart < nEvents;
+             blockStart += quantizedBlockSize)
+        {
+            const uint32_t count =
+                std::min(nEvents - blockStart, quantizedBlockSize);
+            const float* block =
+                eventBlocks + 4 * (blockStart / quantizedBlockSize);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const uint32_t index = blockStart + i;
+                posX[i] = block[0] + float(eventPosX[index]) * block[3];
+                posY[i] = block[1] + float(eventPosY[index]) * block[3];
+                posZ[i] = block[2] + float(eventPosZ[index]) * block[3];
+                radii[i] = halfToFloat(eventRadii[index]);
+                powers[i] = decodeValue(eventPowers[index], powersFormat);
+            }
+
+            for (uint32_t z = startZ; z < endZ; ++z)
+                for (uint32_t y = startY; y < endY; ++y)
+                    computeRow<W>(posX, posY, posZ, radii, powers, 0u, count,
+                                  0u, endX - startX, originY + y * resY,
+                                  originZ + z * resZ, resX,
+                                  originX + startX * resX, brickRow(y, z),
+                                  false);
+        }
+
+        for (uint32_t z = startZ; z < endZ; ++z)
+            for (uint32_t y = startY; y < endY; ++y)
+            {
+                const uint64_t rowIndex = (uint64_t(z) * sizeY + y) * sizeX;
+                const float* values = brickRow(y, z);
+                for (uint32_t x = startX; x < endX; ++x)
+                {
+                    float value = powersScale * values[x - startX];
+                    if (volumeFormat == Precision::fp32)
+                    {
+                        if (accumulate)
+                            value += volumeData[rowIndex + x];
+                        volumeData[rowIndex + x] = value;
+                        continue;
+                    }
+                    if (accumulate)
+                        value += decodeValue(volumeHalfData[rowIndex + x],
+                                             volumeFormat);
+                    volumeHalfData[rowIndex + x] =
+                        encodeValue(value, volumeFormat);
+                }
+            }
+    });
+}
+
+/** @sa ComputeSamplePoints_ispc */
+template <size_t W>
+void computeSamplePoints(const float* eventPosX, const float* eventPosY,
+                         const float* eventPosZ, const float* eventRadii,
+                         const float* eventPowers, const uint32_t nEvents,
+                         const uint32_t currentFrame, const float* spPosX,
+                         const float* spPosY, const float* spPosZ,
+                         float* spValues, const uint32_t nSamplePoints)
+{
+    if (nSamplePoints == 0)
+        return;
+
+    float* values = spValues + uint64_t(currentFrame) * nSamplePoints;
+    const uint32_t nThreads = uint32_t(
+        std::max(ThreadPool::getInstance().getThreadsCount(), size_t(1)));
+
+    if (nSamplePoints >= 2 * nThreads || nEvents < 2 * nThreads)
+    {
+        parallelFor(nSamplePoints, [&](const size_t i) {
+            values[i] = Ec * sumEvents<W>(eventPosX, eventPosY, eventPosZ,
+                                          eventRadii, eventPowers, 0, nEvents,
+                                          spPosX[i], spPosY[i], spPosZ[i]);
+        });
+        return;
+    }
+
+    // Too few sample points to keep every core busy: split the events in
+    // aligned blocks instead and reduce the partial sums of each sample point.
+    const uint32_t blockSize = std::min(
+        eventBlockSize,
+        uint32_t(padEventsCount((nEvents - 1) / nThreads + 1)));
+    const size_t nBlocks = (nEvents - 1) / blockSize + 1;
+    std::vector<float> partialValues(nBlocks * nSamplePoints);
+    parallelFor(nBlocks, [&](const size_t block) {
+        const uint32_t startEvent = block * blockSize;
+        const uint32_t endEvent = std::min(startEvent + blockSize, nEvents);
+        for (uint32_t i = 0; i < nSamplePoints; ++i)
+            partialValues[block * nSamplePoints + i] =
+                sumEvents<W>(eventPosX, eventPosY, eventPosZ, eventRadii,
+                             eventPowers, startEvent, endEvent, spPosX[i],
+                             spPosY[i], spPosZ[i]);
+    });
+
+    for (uint32_t i = 0; i < nSamplePoints; ++i)
+    {
+        float accum = 0.0f;
+        for (size_t block = 0; block < nBlocks; ++block)
+            accum += partialValues[block * nSamplePoints + i];
+        values[i] = Ec * accum;
+    }
+}
+
+/**
+ * Compute the transfer coefficients of the events [startEvent, endEvent)
+ * for a sample point.
+ */
+template <size_t W>
+void computeMatrixRow(const float* eventPosX, const float* eventPosY,
+                      const float* eventPosZ, const float* eventRadii,
+                      const uint32_t startEvent, const uint32_t endEvent,
+                      const float posX, const float posY, const float posZ,
+                      float* row)
+{
+    typedef Float<W> V;
+    const V x = V::broadcast(posX);
+    const V y = V::broadcast(posY);
+    const V z = V::broadcast(posZ);
+
+    uint32_t i = startEvent;
+    for (; i + W <= endEvent; i += W)
+    {
+        const V deltaX = x - V::load(eventPosX + i);
+        const V deltaY = y - V::load(eventPosY + i);
+        const V deltaZ = z - V::load(eventPosZ + i);
+        const V radius = V::load(eventRadii + i);
+        const V squaredDist =
+            deltaX * deltaX + deltaY * deltaY + deltaZ * deltaZ;
+        (V::broadcast(Ec) * squaredDist.max(radius * radius).invSqrt())
+            .store(row + i);
+    }
+    if (W > 1 && i < endEvent)
+        computeMatrixRow<1>(eventPosX, eventPosY, eventPosZ, eventRadii, i,
+                            endEvent, posX, posY, posZ, row);
+}
+
+/** @sa ComputeTransferMatrix_ispc */
+template <size_t W>
+void computeTransferMatrix(const float* eventPosX, const float* eventPosY,
+                           const float* eventPosZ, const float* eventRadii,
+                           const uint32_t nEvents, const float* spPosX,
+                           const float* spPosY, const float* spPosZ,
+                           const uint32_t nSamplePoints, float* matrix)
+{
+    if (nEvents == 0)
+        return;
+
+    const size_t nBlocks = (nEvents - 1) / eventBlockSize + 1;
+    parallelFor(nBlocks, [&](const size_t block) {
+        const uint32_t startEvent = block * eventBlockSize;
+        const uint32_t endEvent =
+            std::min(startEvent + eventBlockSize, nEvents);
+        for (uint32_t i = 0; i < nSamplePoints; ++i)
+            computeMatrixRow<W>(eventPosX, eventPosY, eventPosZ, eventRadii,
+                                startEvent, endEvent, spPosX[i], spPosY[i],
+                                spPosZ[i], matrix + uint64_t(i) * nEvents);
+    });
+}
+
+/**
+ * Accumulate the products of a tile of frames with a tile of matrix rows
+ * over the events [startEvent, endEvent).
+ */
+template <size_t W>
+void multiplyTile(const float* const* weights, const float* const* powers,
+                  const uint32_t startEvent, const uint32_t endEvent,
+                  float accum[framesTile][samplePointsTile])
+{
+    typedef Float<W> V;
+    V sums[framesTile][samplePointsTile];
+    for (uint32_t f = 0; f < framesTile; ++f)
+        for (uint32_t s = 0; s < samplePointsTile; ++s)
+            sums[f][s] = V::broadcast(0.0f);
+
+    uint32_t j = startEvent;
+    for (; j + W <= endEvent; j += W)
+    {
+        V power[framesTile];
+        for (uint32_t f = 0; f < framesTile; ++f)
+            power[f] = V::load(powers[f] + j);
+        for (uint32_t s = 0; s < samplePointsTile; ++s)
+        {
+            const V weight = V::load(weights[s] + j);
+            for (uint32_t f = 0; f < framesTile; ++f)
+                sums[f][s] += power[f] * weight;
+        }
+    }
+
+    for (uint32_t f = 0; f < framesTile; ++f)
+        for (uint32_t s = 0; s < samplePointsTile; ++s)
+            accum[f][s] += sums[f][s].sum();
+    if (W > 1 && j < endEvent)
+        multiplyTile<1>(weights, powers, j, endEvent, accum);
+}
+
+/** @sa ApplyTransferMatrix_ispc */
+template <size_t W>
+void applyTransferMatrix(const float* matrix, const uint32_t nSamplePoints,
+                         const uint32_t nEvents, const float* framePowers,
+                         const uint64_t powersStride, const uint32_t nFrames,
+                         float* spValues)
+{
+    if (nFrames == 0 || nSamplePoints == 0)
+        return;
+
+    const size_t nTasks = (nFrames - 1) / framesTile + 1;
+    parallelFor(nTasks, [&](const size_t task) {
+        // Out of range rows of the tile are clamped to the last valid one
+        // and their results discarded.
+        const float* powers[framesTile];
+        for (uint32_t f = 0; f < framesTile; ++f)
+            powers[f] =
+                framePowers +
+                std::min<uint64_t>(task * framesTile + f, nFrames - 1) *
+                    powersStride;
+
+        for (uint32_t blockStart = 0; blockStart < nEvents;
+             blockStart += eventBlockSize)
+        {
+            const uint32_t blockEnd =
+                std::min(blockStart + eventBlockSize, nEvents);
+
+            for (uint32_t i = 0; i < nSamplePoints; i += samplePointsTile)
+            {
+                const float* weights[samplePointsTile];
+                for (uint32_t s = 0; s < samplePointsTile; ++s)
+                    weights[s] =
+                        matrix +
+                        uint64_t(std::min(i + s, nSamplePoints - 1)) * nEvents;
+
+                float accum[framesTile][samplePointsTile] = {};
+                multiplyTile<W>(weights, powers, blockStart, blockEnd, accum);
+
+                for (uint32_t f = 0; f < framesTile; ++f)
+                {
+                    const uint64_t frame = task * framesTile + f;
+                    if (frame >= nFrames)
+                        continue;
+                    for (uint32_t s = 0; s < samplePointsTile; ++s)
+                        if (i + s < nSamplePoints)
+                            spValues[frame * nSamplePoints + i + s] +=
+                                accum[f][s];
+                }
+            }
+        }
+    });
+}
+}
+}
+
+#endif // _EMSim_SimdKernels_h_
@@ -0,0 +1,123 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <algorithm>
+#include <numeric>
+
+#include <emSim/SpatialOrder.h>
+
+namespace ems
+{
+namespace
+{
+const uint32_t mortonBits = 21u;
+
+// Spread the 21 low bits of a value, two zero bits between consecutive bits
+uint64_t spreadBits(uint64_t value)
+{
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffff;
+    value = (value | value << 16) & 0x1f0000ff0000ff;
+    value = (value | value << 8) & 0x100f00f00f00f00f;
+    value = (value | value << 4) & 0x10c30c30c30c30c3;
+    value = (value | value << 2) & 0x1249249249249249;
+    return value;
+}
+
+uint64_t quantize(const float value, const float min, const float max)
+{
+    const float maxCell = float((1u << mortonBits) - 1u);
+    if (max <= min)
+        return 0u;
+    const float cell = (value - min) / (max - min) * maxCell;
+    return uint64_t(std::min(std::max(cell, 0.0f), maxCell));
+}
+}
+
+uint64_t computeMortonCode(const glm::vec3& pos, const EventsAABB& aabb)
+{
+    return spreadBits(quantize(pos.x, aabb.min.x, aabb.max.x)) |
+           spreadBits(quantize(pos.y, aabb.min.y, aabb.max.y)) << 1 |
+           spreadBits(quantize(pos.z, aabb.min.z, aabb.max.z)) << 2;
+}
+
+EventsOrder computeSpatialOrder(const Events& events, CellsEvents& cells,
+                                const EventsAABB& aabb)
+{
+    const size_t nEvents = events.getEventsCount();
+    std::vector<uint64_t> codes(nEvents);
+    parallelFor((nEvents + 4095) / 4096, [&](const size_t block) {
+        const size_t end = std::min(nEvents, (block + 1) * 4096);
+        for (size_t i = block * 4096; i < end; ++i)
+            codes[i] = computeMortonCode(events.getPosition(i), aabb);
+    });
+
+    std::vector<uint64_t> cellCodes(cells.size());
+    for (size_t i = 0; i < cells.size(); ++i)
+        cellCodes[i] = computeMortonCode(cells[i].soma, aabb);
+
+    std::vector<uint32_t> cellsOrder(cells.size());
+    std::iota(cellsOrder.begin(), cellsOrder.end(), 0u);
+    std::stable_sort(cellsOrder.begin(), cellsOrder.end(),
+                     [&](const uint32_t a, const uint32_t b) {
+                         return cellCodes[a] < cellCodes[b];
+                     });
+
+    // Events outside of any cell are kept at the end, in report order
+    EventsOrder order;
+    order.reserve(nEvents);
+    CellsEvents sortedCells;
+    sortedCells.reserve(cells.size());
+    std::vector<bool> inCell(nEvents, false);
+    for (const uint32_t index : cellsOrder)
+    {
+        CellEvents cell = cells[index];
+        const uint32_t begin = order.size();
+        for (uint32_t i = cell.begin; i < cell.end; ++i)
+        {
+            order.push_back(i);
+            inCell[i] = true;
+        }
+        cell.begin = begin;
+        cell.end = order.size();
+        sortedCells.push_back(cell);
+    }
+    for (uint32_t i = 0; i < nEvents; ++i)
+        if (!inCell[i])
+            order.push_back(i);
+
+    parallelFor(sortedCells.size(), [&](const size_t i) {
+        std::stable_sort(order.begin() + sortedCells[i].begin,
+                         order.begin() + sortedCells[i].end,
+                         [&](const uint32_t a, const uint32_t b) {
+                             return codes[a] < codes[b];
+                         });
+    });
+
+    cells = std::move(sortedCells);
+    return order;
+}
+
+void gatherPowers(const float* reportPowers, const EventsOrder& order,
+                  float* powers)
+{
+    for (size_t i = 0; i < order.size(); ++i)
+        powers[i] = reportPowers[order[i]];
+}
+}
@@ -0,0 +1,72 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _SpatialOrder_h_
+#define _SpatialOrder_h_
+
+#define GLM_FORCE_CTOR_INIT
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include <emSim/CellMultipoles.h>
+#include <emSim/Events.h>
+#include <emSim/helpers.h>
+
+namespace ems
+{
+/**
+ * Report index of every event of a reordered layout: the i-th event of the
+ * layout is the order[i]-th event of the report.
+ */
+typedef std::vector<uint32_t> EventsOrder;
+
+/**
+ * @param pos the position to encode
+ * @param aabb the box mapped on the 2^21 x 2^21 x 2^21 grid of the code
+ * @return the 63 bits Morton code of the position, the bits of the 3
+ * quantized coordinates being interleaved.
+ */
+uint64_t computeMortonCode(const glm::vec3& pos, const EventsAABB& aabb);
+
+/**
+ * Compute a spatially coherent order of the events. The cells are sorted
+ * along the Morton curve of their somata and the events of every cell along
+ * the Morton curve of their positions, so the events of a cell stay
+ * contiguous.
+ * @param events the events in report order
+ * @param cells the events' ranges of the cells in report order, updated to
+ * the ranges of the new order
+ * @param aabb the bounding box of the events
+ * @return the report index of every event of the new order
+ */
+EventsOrder computeSpatialOrder(const Events& events, CellsEvents& cells,
+                                const EventsAABB& aabb);
+
+/**
+ * Gather the powers of a frame from report order to a reordered layout.
+ * @param reportPowers the powers in report order
+ * @param order the report index of every event of the layout
+ * @param powers the powers of the layout, order.size() values
+ */
+void gatherPowers(const float* reportPowers, const EventsOrder& order,
+                  float* powers);
+}
+#endif // _SpatialOrder_h_
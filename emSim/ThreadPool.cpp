@@ -0,0 +1,348 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ThreadPool.h"
+#include "helpers.h"
+
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace ems
+{
+namespace
+{
+const size_t noWorker = std::numeric_limits<size_t>::max();
+thread_local size_t currentWorker = noWorker;
+
+int readTopology(const int cpu, const std::string& name)
+{
+    std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                       "/topology/" + name);
+    int value = -1;
+    if (!(file >> value))
+        return -1;
+    return value;
+}
+
+/**
+ * @return the CPUs the process is allowed to run on, only the first hardware
+ * thread of each core if useSMT is false.
+ */
+std::vector<int> getCPUs(const bool useSMT)
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        std::set<std::pair<int, int>> cores;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (!CPU_ISSET(cpu, &set))
+                continue;
+            if (!useSMT)
+            {
+                const int package = readTopology(cpu, "physical_package_id");
+                const int core = readTopology(cpu, "core_id");
+                if (core >= 0 && !cores.insert({package, core}).second)
+                    continue;
+            }
+            cpus.push_back(cpu);
+        }
+    }
+
+    if (cpus.empty())
+    {
+        const int count = std::max(int(std::thread::hardware_concurrency()), 1);
+        for (int cpu = 0; cpu < count; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+}
+
+ThreadPoolConfig ThreadPoolConfig::fromEnvironment()
+{
+    ThreadPoolConfig config;
+    const char* threads = std::getenv("EMSIM_THREADS");
+    if (threads && *threads)
+    {
+        const std::string value(threads);
+        if (value.find_first_not_of("0123456789") != std::string::npos ||
+            value.size() > 6)
+            throw(std::runtime_error("ERROR: Invalid EMSIM_THREADS: " +
+                                     value));
+        config.threads = std::stoul(value);
+    }
+    config.pinThreads = parseEnvironmentFlag("EMSIM_PIN_THREADS", config.pinThreads);
+    config.useSMT = parseEnvironmentFlag("EMSIM_SMT", config.useSMT);
+    return config;
+}
+
+ThreadPool& ThreadPool::getInstance()
+{
+    static ThreadPool pool(ThreadPoolConfig::fromEnvironment());
+    return pool;
+}
+
+ThreadPool::ThreadPool(const ThreadPoolConfig& config)
+    : _done(0u)
+{
+    _start(config);
+}
+
+ThreadPool::~ThreadPool()
+{
+    _stop();
+}
+
+void ThreadPool::configure(const ThreadPoolConfig& config)
+{
+    if (isWorkerThread())
+        throw(std::runtime_error(
+            "ERROR: The thread pool can not be configured from one of its "
+            "threads"));
+
+    std::lock_guard<std::mutex> submitLock(_submitMutex);
+    _stop();
+    _start(config);
+}
+
+std::string ThreadPool::getDescription() const
+{
+    std::string description = std::to_string(_threads.size());
+    if (_pinnedCPUs.empty())
+        return description + " unpinned";
+
+    description += " pinned to ";
+    for (size_t i = 0; i < _pinnedCPUs.size(); ++i)
+        description += (i ? "," : "") + std::to_string(_pinnedCPUs[i]);
+    return description;
+}
+
+std::vector<ThreadStats> ThreadPool::getStats() const
+{
+    std::vector<ThreadStats> stats;
+    for (size_t i = 0; i < _threads.size(); ++i)
+        stats.push_back(_ranges[i].stats);
+    return stats;
+}
+
+void ThreadPool::resetStats()
+{
+    for (size_t i = 0; i < _threads.size(); ++i)
+        _ranges[i].stats = ThreadStats();
+}
+
+bool ThreadPool::isWorkerThread()
+{
+    return currentWorker != noWorker;
+}
+
+void ThreadPool::parallelFor(const size_t count, const Function& func)
+{
+    if (count == 0)
+        return;
+
+    // Nested loops run on the calling thread, its siblings being busy
+    if (isWorkerThread())
+    {
+        for (size_t i = 0; i < count; ++i)
+            func(i, currentWorker);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submitLock(_submitMutex);
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    const size_t nThreads = _threads.size();
+    for (size_t i = 0; i < nThreads; ++i)
+    {
+        _ranges[i].begin = count * i / nThreads;
+        _ranges[i].end = count * (i + 1) / nThreads;
+    }
+    _function = &func;
+    _count = count;
+    _done = 0u;
+    _exception = nullptr;
+    ++_generation;
+    _wakeCondition.notify_all();
+
+    // Waiting for all the threads to leave the loop makes their statistics
+    // safe to read
+    _doneCondition.wait(lock, [this] {
+        return _done == _count && _activeThreads == 0;
+    });
+    _function = nullptr;
+    const std::exception_ptr exception = _exception;
+    _exception = nullptr;
+    lock.unlock();
+
+    if (exception)
+        std::rethrow_exception(exception);
+}
+
+void ThreadPool::_start(const ThreadPoolConfig& config)
+{
+    const std::vector<int> cpus = getCPUs(config.useSMT);
+    const size_t nThreads = config.threads ? config.threads : cpus.size();
+
+    _pinnedCPUs.clear();
+    if (config.pinThreads)
+    {
+        for (size_t i = 0; i < nThreads; ++i)
+            _pinnedCPUs.push_back(cpus[i % cpus.size()]);
+    }
+
+    _ranges.reset(new Range[nThreads]);
+    for (size_t i = 0; i < nThreads; ++i)
+        _threads.emplace_back(&ThreadPool::_worker, this, i, _generation);
+}
+
+void ThreadPool::_stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wakeCondition.notify_all();
+    for (auto& thread : _threads)
+        thread.join();
+    _threads.clear();
+    _stopping = false;
+}
+
+void ThreadPool::_worker(const size_t index, size_t generation)
+{
+    currentWorker = index;
+    if (!_pinnedCPUs.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(_pinnedCPUs[index], &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    for (;;)
+    {
+        const Function* func;
+        size_t count;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wakeCondition.wait(lock, [&] {
+                return _stopping || _generation != generation;
+            });
+            if (_stopping)
+                return;
+            generation = _generation;
+            // Woken up after the end of the loop
+            if (_done == _count)
+                continue;
+            func = _function;
+            count = _count;
+            ++_activeThreads;
+        }
+
+        ThreadStats& stats = _ranges[index].stats;
+        const auto start = std::chrono::steady_clock::now();
+        size_t item;
+        for (;;)
+        {
+            if (!_pop(index, item))
+            {
+                if (_steal(index))
+                {
+                    ++stats.steals;
+                    continue;
+                }
+                break;
+            }
+
+            try
+            {
+                (*func)(item, index);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_exception)
+                    _exception = std::current_exception();
+            }
+
+            ++stats.tasks;
+            if (++_done == count)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _doneCondition.notify_all();
+            }
+        }
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        stats.busyTime += elapsed.count();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        --_activeThreads;
+        _doneCondition.notify_all();
+    }
+}
+
+bool ThreadPool::_pop(const size_t index, size_t& item)
+{
+    Range& range = _ranges[index];
+    std::lock_guard<std::mutex> lock(range.mutex);
+    if (range.begin == range.end)
+        return false;
+    item = range.begin++;
+    return true;
+}
+
+bool ThreadPool::_steal(const size_t index)
+{
+    const size_t nThreads = _threads.size();
+    for (size_t i = 1; i < nThreads; ++i)
+    {
+        Range& victim = _ranges[(index + i) % nThreads];
+        size_t begin, end;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.begin == victim.end)
+                continue;
+            begin = victim.begin + (victim.end - victim.begin) / 2;
+            end = victim.end;
+            victim.end = begin;
+        }
+
+        // Never hold two ranges at once, two thieves robbing each other
+        // would deadlock
+        Range& range = _ranges[index];
+        std::lock_guard<std::mutex> lock(range.mutex);
+        range.begin = begin;
+        range.end = end;
+        return true;
+    }
+    return false;
+}
+}
@@ -0,0 +1,208 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _EMSim_ThreadPool_h_
+#define _EMSim_ThreadPool_h_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ems
+{
+/** Threads of the pool and their placement on the CPUs */
+struct ThreadPoolConfig
+{
+    /** Number of threads, 0 for one per CPU selected by useSMT */
+    size_t threads = 0u;
+    /** Pin each thread to one CPU, round robin over the selected CPUs */
+    bool pinThreads = false;
+    /** Use all the hardware threads of a core, or only one per core */
+    bool useSMT = true;
+
+    /**
+     * @return the configuration given by the environment variables
+     * EMSIM_THREADS, EMSIM_PIN_THREADS and EMSIM_SMT, the defaults above
+     * otherwise.
+     * @throw std::runtime_error if a variable can not be parsed
+     */
+    static ThreadPoolConfig fromEnvironment();
+};
+
+/** Work done by a thread of the pool since the last ThreadPool::resetStats() */
+struct ThreadStats
+{
+    /** Number of loop iterations run */
+    size_t tasks = 0u;
+    /** Number of ranges of iterations stolen from the other threads */
+    size_t steals = 0u;
+    /** Time spent in loops, from waking up to running out of iterations */
+    double busyTime = 0.0;
+};
+
+/**
+ * Persistent pool of threads running all the parallel loops of the library,
+ * the C++ ones through parallelFor() and the ISPC launches through the task
+ * system entry points.
+ *
+ * A loop is split in one contiguous range of indices per thread. A thread
+ * which runs out of indices steals the upper half of the remaining range of
+ * the next busy thread, so uneven iterations are balanced without any shared
+ * counter being hammered. The threads sleep between loops.
+ *
+ * Only one loop runs at a time: loops submitted concurrently from several
+ * threads are serialized, loops submitted from inside a loop of the pool are
+ * run serially by the calling thread.
+ */
+class ThreadPool
+{
+public:
+    /** func(index, threadIndex), threadIndex being in [0, getThreadsCount()) */
+    typedef std::function<void(size_t, size_t)> Function;
+
+    /**
+     * @return the pool of the library, created with
+     * ThreadPoolConfig::fromEnvironment() on first use.
+     */
+    static ThreadPool& getInstance();
+
+    ~ThreadPool();
+
+    /**
+     * Restart the threads with the given configuration.
+     * @throw std::runtime_error if called from a thread of the pool
+     */
+    void configure(const ThreadPoolConfig& config);
+
+    /**
+     * Call func(i, threadIndex) for every i in [0, count) and wait for all of
+     * them to return. The first exception thrown by func is rethrown once
+     * all the other iterations are done.
+     */
+    void parallelFor(size_t count, const Function& func);
+
+    /** @return the number of threads running the loops */
+    size_t getThreadsCount() const { return _threads.size(); }
+
+    /** @return the CPUs the threads are pinned to, empty if not pinned */
+    const std::vector<int>& getPinnedCPUs() const { return _pinnedCPUs; }
+
+    /** @return the number of threads and their CPUs, e.g. "4 pinned to 0,2,4,6" */
+    std::string getDescription() const;
+
+    /**
+     * @return the load of every thread, to be called between loops.
+     */
+    std::vector<ThreadStats> getStats() const;
+
+    /** Reset the load of all the threads, to be called between loops */
+    void resetStats();
+
+    /** @return true if the calling thread is one of the pool */
+    static bool isWorkerThread();
+
+private:
+    // A range of indices owned by a thread, shrunk by thieves from its end,
+    // and the statistics of the thread. The padding keeps the ranges of two
+    // threads off the same cache line.
+    struct Range
+    {
+        std::mutex mutex;
+        size_t begin = 0u;
+        size_t end = 0u;
+        ThreadStats stats;
+        char padding[64];
+    };
+
+    explicit ThreadPool(const ThreadPoolConfig& config);
+
+    void _start(const ThreadPoolConfig& config);
+    void _stop();
+    void _worker(size_t index, size_t generation);
+    bool _pop(size_t index, size_t& item);
+    bool _steal(size_t index);
+
+    std::vector<std::thread> _threads;
+    std::vector<int> _pinnedCPUs;
+    std::unique_ptr<Range[]> _ranges;
+
+    std::mutex _submitMutex;
+    std::mutex _mutex;
+    std::condition_variable _wakeCondition;
+    std::condition_variable _doneCondition;
+    size_t _generation = 0u;
+    size_t _activeThreads = 0u;
+    bool _stopping = false;
+
+    const Function* _function = nullptr;
+    size_t _count = 0u;
+    std::atomic<size_t> _done;
+    std::exception_ptr _exception;
+};
+
+/**
+ * Call func(i) for every i in [0, count) from the threads of the pool.
+ */
+template <typename F>
+void parallelFor(const size_t count, const F& func)
+{
+    ThreadPool::getInstance().parallelFor(count, [&](const size_t i, size_t) {
+        func(i);
+    });
+}
+
+/**
+ * Call func(begin, end) for consecutive ranges of at most chunkSize indices
+ * covering [0, count), from the threads of the pool. The range of a chunk
+ * starts at chunk * chunkSize.
+ */
+template <typename F>
+void parallelForChunks(const size_t count, const size_t chunkSize,
+                       const F& func)
+{
+    parallelFor((count + chunkSize - 1) / chunkSize, [&](const size_t chunk) {
+        const size_t begin = chunk * chunkSize;
+        func(begin, std::min(begin + chunkSize, count));
+    });
+}
+
+/**
+ * Copy count values from source to destination with the threads of the
+ * pool, one memcpy of up to 1M values per iteration.
+ */
+template <typename T>
+void parallelCopy(T* destination, const T* source, const size_t count)
+{
+    parallelForChunks(count, 1u << 20, [&](const size_t begin,
+                                           const size_t end) {
+        std::memcpy(destination + begin, source + begin,
+                    (end - begin) * sizeof(T));
+    });
+}
+}
+#endif // _EMSim_ThreadPool_h_
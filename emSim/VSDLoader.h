@@ -21,6 +21,7 @@
 #define _VSDLoader_h_
 
 #include <emSim/AttenuationCurve.h>
+#include <emSim/HDF5Output.h>
 #include <emSim/Volume.h>
 
 #include <brain/brain.h>
@@ -57,6 +58,14 @@ struct VSDParams
     bool exportVolume = false;
     bool exportPointSprite = false;
     bool exportSomaPixels = false;
+    bool outputStack = false;
+    bool hdf5 = false;
+    std::string hdf5Chunks = "1,0,0,0";
+    HDF5Config hdf5Config;
+    bool compressVolume = false;
+    CodecConfig codec;
+    size_t writeBuffers = 2u;
+    size_t writeThreads = 4u;
 };
 
 class VSDLoader
@@ -18,7 +18,6 @@
  */
 
 #include <algorithm>
-#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -28,8 +27,15 @@
 
 namespace ems
 {
+namespace
+{
+// Number of voxels converted to fp32 at once when writing a reduced precision
+// volume.
+const size_t writeChunkSize = 1u << 20;
+}
+
 Volume::Volume(const glm::vec3& voxelSize, const glm::vec3& extent,
-               const EventsAABB& circuitAABB)
+               const EventsAABB& circuitAABB, const Precision precision)
     : _voxelSize(voxelSize)
     , _volumeSize(glm::uvec3(
           (circuitAABB.max.x - circuitAABB.min.x + extent.x) / voxelSize.x +
@@ -38,84 +44,161 @@ Volume::Volume(const glm::vec3& voxelSize, const glm::vec3& extent,
               0.5f,
           (circuitAABB.max.z - circuitAABB.min.z + extent.z) / voxelSize.z +
               0.5f))
-    , _data(alignedMalloc<float>(_getVoxelCount()))
+    , _precision(precision)
+    , _data(precision == Precision::fp32
+                ? alignedMalloc<float>(_getVoxelCount())
+                : nullptr)
+    , _halfData(precision == Precision::fp32
+                    ? nullptr
+                    : alignedMalloc<uint16_t>(_getVoxelCount()))
     , _origin(glm::vec3(circuitAABB.min.x - extent.x / 2.0f,
                         circuitAABB.min.y - extent.y / 2.0f,
                         circuitAABB.min.z - extent.z / 2.0f))
 {
     std::cout << "INFO: Volume size is [" << _volumeSize.x << " "
-              << _volumeSize.y << " " << _volumeSize.z << "]" << std::endl;
-    std::memset(_data.get(), 0.0f, _getVoxelCount() * sizeof(float));
+              << _volumeSize.y << " " << _volumeSize.z << "]";
+    if (_precision != Precision::fp32)
+        std::cout << ", " << getPrecisionName(_precision) << " voxels";
+    std::cout << std::endl;
+    clear();
 }
 
 void Volume::clear(const float value)
 {
-    std::memset(_data.get(), value, _getVoxelCount() * sizeof(float));
+    if (_precision == Precision::fp32)
+        fillMemory(_data.get(), _getVoxelCount(), value);
+    else
+        fillMemory(_halfData.get(), _getVoxelCount(),
+                   encodeValue(value, _precision));
 }
 
 void Volume::writeToFile(const float time, const float timeStep, 
                          const std::string& dataUnit, 
                          const std::string& outputFile,
                          const std::string& blueconfig,
-                         const std::string& report, const std::string& target)
+                         const std::string& report, const std::string& target,
+                         FileWriter* writer)
 {
-    std::ofstream output;
-    output.open(outputFile + "_volume_floats_" +
-                    createTimeStepSuffix(time) + ".raw",
-                std::ios::out | std::ios::binary);
-    output.write((char*)_data.get(), sizeof(float) * _getVoxelCount());
-    output.close();
+    _writeValues(outputFile + "_volume_floats_" + createTimeStepSuffix(time) +
+                     ".raw",
+                 writer);
 
-    std::string voltUnit = dataUnit;
-    std::replace(voltUnit.begin(), voltUnit.end(), 'A', 'V');
+    writeTextFile(outputFile + "_volume_info_" + createTimeStepSuffix(time) + ".txt",
+                  _getInfo(timeStep, dataUnit, blueconfig, report, target), writer);
 
-    std::ofstream info;
-    info.open(outputFile + "_volume_info_" + createTimeStepSuffix(time) + ".txt");
-    info << "# File generated by EMSim tool:\n"
-         << "# - BlueConfig: " << blueconfig << "\n"
-         << "# - Target: " << target << "\n"
-         << "# - Report: " << report << "\n"
-         << "# - Time step: " << timeStep << "\n"
-         << "# - Units: " << voltUnit << "\n"
-         << "# - SizeInVoxels: " << _volumeSize.x << " " << _volumeSize.y << " " << _volumeSize.z << "\n"
-         << "# - SizeInMicrons: " << _volumeSize.x * _voxelSize.x << " " << _volumeSize.y * _voxelSize.y << " " << _volumeSize.z * _voxelSize.z << "\n"
-         << "#" << std::endl;
-
-    std::cout << "INFO: Volume for time " << createTimeStepSuffix(time) << " written to disk." << std::endl;
+    std::cout << "INFO: Volume for time " << createTimeStepSuffix(time)
+              << (writer ? " queued for writing." : " written to disk.") << std::endl;
 }
 
 void Volume::writeToFileMhd(const float time,
-                            const std::string& dataUnit, 
-                            const std::string& outputFile)
+                            const std::string&,
+                            const std::string& outputFile,
+                            FileWriter* writer)
 {
     const std::string volumeFileName = outputFile + "_volume_floats" + createTimeStepSuffix(time) + ".raw";
-    std::ofstream output;
-    output.open(volumeFileName, std::ios::out | std::ios::binary);
-    output.write((char*)_data.get(), sizeof(float) * _getVoxelCount());
-    output.close();
+    _writeValues(volumeFileName, writer);
 
-    std::string voltUnit = dataUnit;
-    std::replace(voltUnit.begin(), voltUnit.end(), 'A', 'V');
+    const std::string header = createMhdHeader(
+        {_volumeSize.x, _volumeSize.y, _volumeSize.z},
+        {_voxelSize.x, _voxelSize.y, _voxelSize.z},
+        {_origin.x, _origin.y, _origin.z}, volumeFileName);
+    writeTextFile(outputFile + "_volume_floats_" + createTimeStepSuffix(time) + ".mhd",
+                  header, writer);
 
-    std::ofstream mhdFile;
-    mhdFile.open(outputFile + "_volume_floats_" + createTimeStepSuffix(time) + ".mhd");
+    std::cout << "INFO: Volume .mhd for time: " << createTimeStepSuffix(time)
+              << (writer ? " queued for writing." : " written to disk.") << std::endl;
+}
+
+CodecStats Volume::writeToFileCompressed(
+    const float time, const float timeStep, const std::string& dataUnit,
+    const std::string& outputFile, const std::string& blueconfig,
+    const std::string& report, const std::string& target,
+    const CodecConfig& codec, FileWriter* writer) const
+{
+    std::vector<float> values;
+    if (_precision != Precision::fp32)
+    {
+        values.resize(_getVoxelCount());
+        decodeValues(_halfData.get(), values.size(), _precision,
+                     values.data());
+    }
+
+    std::string data;
+    const CodecStats stats =
+        compressVolume(values.empty() ? _data.get() : values.data(),
+                       _volumeSize, _voxelSize, _origin, codec, data);
+    writeTextFile(outputFile + "_volume_floats_" + createTimeStepSuffix(time) +
+                      ".emz",
+                  std::move(data), writer);
+
+    writeTextFile(outputFile + "_volume_info_" + createTimeStepSuffix(time) + ".txt",
+                  _getInfo(timeStep, dataUnit, blueconfig, report, target), writer);
+
+    std::cout << "INFO: Volume for time " << createTimeStepSuffix(time)
+              << " compressed " << stats.getRatio() << "x"
+              << (writer ? ", queued for writing." : ", written to disk.")
+              << std::endl;
+    return stats;
+}
+
+void Volume::writeToStack(MappedStack& stack, const size_t frame) const
+{
+    const size_t voxelCount = _getVoxelCount();
+    if (stack.getFrameValuesCount() != voxelCount)
+        throw std::runtime_error(
+            "error: Cannot write the volume to the stack. Wrong frame size.");
 
-    mhdFile << "ObjectType = Image\n"
-            << "NDims = 3\n"
-            << "BinaryData = True\n"
-            << "BinaryDataByteOrderMSB = False\n"
-            << "CompressedData = False\n"
-            << "TransformMatrix = 1 0 0 0 1 0 0 0 1\n"
-            << "Offset = 0 0 0\n"
-            << "CenterOfRotation = 0 0 0\n"
-            << "AnatomicalOrientation = 0 0 0\n"
-            << "ElementSpacing = "<< _voxelSize.x << " " << _voxelSize.y << " " << _voxelSize.z << "\n"
-            << "DimSize = "<< _volumeSize.x << " " << _volumeSize.y << " " << _volumeSize.z << "\n"
-            << "ElementType = MET_FLOAT\n"
-            << "ElementDataFile = " << volumeFileName << "\n"
-            << std::endl;
+    if (_precision == Precision::fp32)
+        stack.writeFrame(frame, _data.get());
+    else
+        decodeValues(_halfData.get(), voxelCount, _precision,
+                     stack.getFrame(frame));
+}
+
+size_t Volume::createDataset(HDF5Output& output, const std::string& name,
+                             const size_t nFrames) const
+{
+    const size_t dataset = output.createDataset(
+        name, {_volumeSize.x, _volumeSize.y, _volumeSize.z}, nFrames);
+    output.setAttribute(name, "VoxelSize",
+                        std::vector<double>{_voxelSize.x, _voxelSize.y,
+                                            _voxelSize.z});
+    output.setAttribute(name, "Origin",
+                        std::vector<double>{_origin.x, _origin.y, _origin.z});
+    return dataset;
+}
+
+void Volume::writeToHDF5(HDF5Output& output, const size_t dataset,
+                         const size_t frame) const
+{
+    if (_precision == Precision::fp32)
+    {
+        output.writeFrame(dataset, frame, _data.get());
+        return;
+    }
+    decodeValues(_halfData.get(), _getVoxelCount(), _precision,
+                 output.beginFrame(dataset, frame));
+    output.endFrame(dataset, frame);
+}
+
+std::unique_ptr<MappedStack> Volume::createStack(
+    const float startTime, const float timeStep, const size_t nFrames,
+    const std::string& dataUnit, const std::string& outputFile,
+    const std::string& blueconfig, const std::string& report,
+    const std::string& target) const
+{
+    std::unique_ptr<MappedStack> stack(new MappedStack(
+        outputFile + "_volume_floats",
+        {_volumeSize.x, _volumeSize.y, _volumeSize.z},
+        {_voxelSize.x, _voxelSize.y, _voxelSize.z}, nFrames, startTime,
+        timeStep));
+    writeTextFile(outputFile + "_volume_info.txt",
+                  _getInfo(timeStep, dataUnit, blueconfig, report, target),
+                  nullptr);
 
-    std::cout << "INFO: Volume .mhd for time: " << createTimeStepSuffix(time) << " written to disk." << std::endl;
+    std::cout << "INFO: Volumes of " << nFrames << " frames mapped to "
+              << stack->getRawFileName() << std::endl;
+    return stack;
 }
 
 const glm::uvec3& Volume::getSize() const
@@ -143,9 +226,92 @@ const float* Volume::getData() const
     return _data.get();
 }
 
+uint16_t* Volume::getHalfData()
+{
+    return _halfData.get();
+}
+
+const uint16_t* Volume::getHalfData() const
+{
+    return _halfData.get();
+}
+
+Precision Volume::getPrecision() const
+{
+    return _precision;
+}
+
+float Volume::getValue(const size_t index) const
+{
+    if (_precision == Precision::fp32)
+        return _data[index];
+    return decodeValue(_halfData[index], _precision);
+}
+
+size_t Volume::getDataSize() const
+{
+    return _getVoxelCount() *
+           (_precision == Precision::fp32 ? sizeof(float) : sizeof(uint16_t));
+}
+
 uint64_t Volume::_getVoxelCount() const
 {
     return (uint64_t)_volumeSize.x * (uint64_t)_volumeSize.y *
            (uint64_t)_volumeSize.z;
 }
+
+std::string Volume::_getInfo(const float timeStep, const std::string& dataUnit,
+                             const std::string& blueconfig,
+                             const std::string& report,
+                             const std::string& target) const
+{
+    std::string voltUnit = dataUnit;
+    std::replace(voltUnit.begin(), voltUnit.end(), 'A', 'V');
+
+    std::ostringstream info;
+    info << "# File generated by EMSim tool:\n"
+         << "# - BlueConfig: " << blueconfig << "\n"
+         << "# - Target: " << target << "\n"
+         << "# - Report: " << report << "\n"
+         << "# - Time step: " << timeStep << "\n"
+         << "# - Units: " << voltUnit << "\n"
+         << "# - SizeInVoxels: " << _volumeSize.x << " " << _volumeSize.y << " " << _volumeSize.z << "\n"
+         << "# - SizeInMicrons: " << _volumeSize.x * _voxelSize.x << " " << _volumeSize.y * _voxelSize.y << " " << _volumeSize.z * _voxelSize.z << "\n"
+         << "#" << std::endl;
+    return info.str();
+}
+
+void Volume::_writeValues(const std::string& fileName,
+                          FileWriter* writer) const
+{
+    const size_t voxelCount = _getVoxelCount();
+    if (_precision == Precision::fp32)
+    {
+        writeFloatsFile(fileName, _data.get(), voxelCount, writer);
+        return;
+    }
+
+    // The files always hold fp32 values
+    if (writer)
+    {
+        WriteBuffer buffer = writer->acquireBuffer(voxelCount);
+        decodeValues(_halfData.get(), voxelCount, _precision,
+                     buffer.data.get());
+        writer->write(fileName, std::move(buffer), voxelCount);
+        return;
+    }
+
+    std::ofstream output(fileName, std::ios::out | std::ios::binary);
+    std::vector<float> values(std::min(voxelCount, writeChunkSize));
+    for (size_t start = 0; start < voxelCount; start += writeChunkSize)
+    {
+        const size_t count = std::min(voxelCount - start, writeChunkSize);
+        decodeValues(_halfData.get() + start, count, _precision,
+                     values.data());
+        output.write((const char*)values.data(), sizeof(float) * count);
+    }
+    output.close();
+    if (!output)
+        throw std::runtime_error("error: Cannot write " + fileName);
+}
 }
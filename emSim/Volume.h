@@ -26,6 +26,11 @@
 #include <vector>
 
 #include <emSim/Events.h>
+#include <emSim/FileWriter.h>
+#include <emSim/HDF5Output.h>
+#include <emSim/MappedStack.h>
+#include <emSim/Precision.h>
+#include <emSim/VolumeCodec.h>
 #include <emSim/helpers.h>
 
 namespace ems
@@ -33,6 +38,11 @@ namespace ems
 /**
  * This class is responsable for computing a 3d volume.
  * It allocates and stores the volume for a single timestep.
+ *
+ * The voxels are stored as fp32 values by default. A volume of fp16 or bf16
+ * precision halves the memory and the traffic of the kernels writing it; only
+ * the kernels of QuantizedEvents can compute it, and it is converted back to
+ * fp32 when written to a file.
  */
 class Volume
 {
@@ -46,10 +56,12 @@ public:
      * will increase the size of the volume to provide more space arround the
      * events.
      * @param circuitAABB the bounding box of the events
+     * @param precision the storage precision of the voxels
      * @throw std::bad_alloc if memory allocation did not work
      */
     Volume(const glm::vec3& voxelSize, const glm::vec3& extent,
-           const EventsAABB& circuitAABB);
+           const EventsAABB& circuitAABB,
+           Precision precision = Precision::fp32);
 
     Volume(Volume&& other) = default;
     Volume& operator=(Volume&& other) = default;
@@ -68,20 +80,99 @@ public:
      * @param blueconfig the name of the blueconfig
      * @param report the name of the report
      * @param target the name of the target
+     * @param writer the background writer of the files, null to write them
+     * before returning
+     * @throw std::runtime_error if the files can not be written
      */
     void writeToFile(const float time, const float timeStep, 
                      const std::string& dataUnit, const std::string& outputFile, 
                      const std::string& blueconfig, const std::string& report, 
-                     const std::string& target);
+                     const std::string& target, FileWriter* writer = nullptr);
 
    /**
      * Write sample points values for all time steps in a file.
      * @param time the current time
      * @param dataUnit a string describing the data units (ex: "mA")
      * @param outputFile the file name where the volume will be written
+     * @param writer the background writer of the files, null to write them
+     * before returning
+     * @throw std::runtime_error if the files can not be written
      */
     void writeToFileMhd(const float time, const std::string& dataUnit, 
-                     const std::string& outputFile);
+                     const std::string& outputFile, FileWriter* writer = nullptr);
+
+    /**
+     * Write the volume compressed with a bounded error, see compressVolume(),
+     * and its info text file. The compressed file, suffixed .emz, is read
+     * back by the emsimDecode tool.
+     * @param time the current time
+     * @param the timeStep used for the computation
+     * @param dataUnit a string describing the data units (ex: "mA")
+     * @param outputFile the prefix of the files' names
+     * @param blueconfig the name of the blueconfig
+     * @param report the name of the report
+     * @param target the name of the target
+     * @param codec the error bound of the compression
+     * @param writer the background writer of the files, null to write them
+     * before returning
+     * @return the sizes and the maximum error of the compression
+     * @throw std::runtime_error if the files can not be written
+     */
+    CodecStats writeToFileCompressed(
+        float time, float timeStep, const std::string& dataUnit,
+        const std::string& outputFile, const std::string& blueconfig,
+        const std::string& report, const std::string& target,
+        const CodecConfig& codec, FileWriter* writer = nullptr) const;
+
+    /**
+     * Create a single file for the volumes of all the time steps, see
+     * MappedStack, and its info text file.
+     * @param startTime the time of the first volume
+     * @param timeStep the time between two volumes
+     * @param nFrames the number of volumes
+     * @param dataUnit a string describing the data units (ex: "mA")
+     * @param outputFile the prefix of the files' names
+     * @param blueconfig the name of the blueconfig
+     * @param report the name of the report
+     * @param target the name of the target
+     * @return the mapped file, to be filled with writeToStack()
+     * @throw std::runtime_error if the files can not be created
+     */
+    std::unique_ptr<MappedStack> createStack(
+        float startTime, float timeStep, size_t nFrames,
+        const std::string& dataUnit, const std::string& outputFile,
+        const std::string& blueconfig, const std::string& report,
+        const std::string& target) const;
+
+    /**
+     * Write the voxels to a frame of a file created by createStack().
+     * @param stack the file of all the volumes
+     * @param frame the index of the time step
+     * @throw std::runtime_error if frame is out of range or the stack's
+     * volumes have another size
+     */
+    void writeToStack(MappedStack& stack, size_t frame) const;
+
+    /**
+     * Create a dataset for the volumes of all the time steps, with the
+     * voxel size and origin as attributes.
+     * @param output the HDF5 file
+     * @param name the name of the dataset
+     * @param nFrames the number of volumes
+     * @return the index of the dataset, to be filled with writeToHDF5()
+     * @throw std::runtime_error if the dataset can not be created
+     */
+    size_t createDataset(HDF5Output& output, const std::string& name,
+                         size_t nFrames) const;
+
+    /**
+     * Queue the voxels as a frame of an HDF5 dataset.
+     * @param output the HDF5 file
+     * @param dataset the index of the dataset from createDataset()
+     * @param frame the index of the time step
+     * @throw std::runtime_error if a previous write failed
+     */
+    void writeToHDF5(HDF5Output& output, size_t dataset, size_t frame) const;
 
     /**
      * @return 3d vector containing the size of the volume in voxels.
@@ -99,21 +190,57 @@ public:
     const glm::vec3& getVoxelSize() const;
 
     /**
-     * @return The pointer to the voxels values.
+     * @return The pointer to the voxels values, null if the precision is not
+     * fp32.
      */
     float* getData();
 
     /**
-     * @return The const pointer to the voxels values.
+     * @return The const pointer to the voxels values, null if the precision
+     * is not fp32.
      */
     const float* getData() const;
 
+    /**
+     * @return The pointer to the fp16 or bf16 voxels values, null if the
+     * precision is fp32.
+     */
+    uint16_t* getHalfData();
+
+    /**
+     * @return The const pointer to the fp16 or bf16 voxels values, null if
+     * the precision is fp32.
+     */
+    const uint16_t* getHalfData() const;
+
+    /**
+     * @return the storage precision of the voxels.
+     */
+    Precision getPrecision() const;
+
+    /**
+     * @param index the index of the voxel, x first
+     * @return the fp32 value of the voxel, whatever the precision.
+     */
+    float getValue(size_t index) const;
+
+    /**
+     * @return the size in bytes of the voxels values.
+     */
+    size_t getDataSize() const;
+
 private:
     uint64_t _getVoxelCount() const;
+    std::string _getInfo(float timeStep, const std::string& dataUnit,
+                         const std::string& blueconfig, const std::string& report,
+                         const std::string& target) const;
+    void _writeValues(const std::string& fileName, FileWriter* writer) const;
 
     glm::vec3 _voxelSize;
     glm::uvec3 _volumeSize;
+    Precision _precision;
     AlignedFloatPtr _data;
+    AlignedHalfPtr _halfData;
     glm::vec3 _origin;
 };
 }
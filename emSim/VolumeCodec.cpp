@@ -0,0 +1,400 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <zlib.h>
+
+#include <emSim/ThreadPool.h>
+#include <emSim/VolumeCodec.h>
+
+namespace ems
+{
+namespace
+{
+const char codecMagic[4] = {'E', 'M', 'S', 'Z'};
+const uint32_t codecVersion = 1u;
+// Code of the values kept exactly, the others being the zigzag code of
+// quanta in [-maxQuantum, maxQuantum]
+const uint32_t escapeCode = 0xFFFFu;
+const float maxQuantum = 32766.0f;
+
+struct Header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t size[3];
+    float voxelSize[3];
+    float origin[3];
+    float errorBound;
+    uint32_t brickSize[3];
+    uint32_t bricks;
+};
+
+// Sizes of a compressed brick, the table of all of them following the header
+struct BrickHeader
+{
+    uint32_t storedSize;
+    uint32_t escapes;
+};
+
+struct Brick
+{
+    glm::uvec3 begin;
+    glm::uvec3 size;
+
+    size_t getCount() const { return size_t(size.x) * size.y * size.z; }
+};
+
+std::runtime_error corrupted()
+{
+    return std::runtime_error("error: Corrupted compressed volume");
+}
+
+glm::uvec3 getBricksCount(const glm::uvec3& size, const glm::uvec3& brickSize)
+{
+    return (size + brickSize - 1u) / brickSize;
+}
+
+Brick getBrick(const size_t index, const glm::uvec3& size,
+               const glm::uvec3& brickSize)
+{
+    const glm::uvec3 count = getBricksCount(size, brickSize);
+    const glm::uvec3 position(index % count.x, (index / count.x) % count.y,
+                              index / (size_t(count.x) * count.y));
+    Brick brick;
+    brick.begin = position * brickSize;
+    brick.size = glm::min(brickSize, size - brick.begin);
+    return brick;
+}
+
+size_t getVolumeIndex(const glm::uvec3& size, const Brick& brick,
+                      const uint32_t y, const uint32_t z)
+{
+    return ((size_t(brick.begin.z) + z) * size.y + brick.begin.y + y) *
+               size.x +
+           brick.begin.x;
+}
+
+// 3D Lorenzo predictor from the decompressed values of the brick, the
+// neighbours outside of the brick being 0 to compress the bricks
+// independently
+float predict(const float* values, const size_t index, const uint32_t x,
+              const uint32_t y, const uint32_t z, const glm::uvec3& size)
+{
+    const size_t dy = size.x;
+    const size_t dz = size_t(size.x) * size.y;
+    const float x0 = x ? values[index - 1] : 0.0f;
+    const float y0 = y ? values[index - dy] : 0.0f;
+    const float z0 = z ? values[index - dz] : 0.0f;
+    const float xy = x && y ? values[index - 1 - dy] : 0.0f;
+    const float xz = x && z ? values[index - 1 - dz] : 0.0f;
+    const float yz = y && z ? values[index - dy - dz] : 0.0f;
+    const float xyz = x && y && z ? values[index - 1 - dy - dz] : 0.0f;
+    return (x0 + y0 + z0) - (xy + xz + yz) + xyz;
+}
+
+// Shared by the compression and the decompression to get the same rounding
+float reconstruct(const float prediction, const int32_t quantum,
+                  const float step)
+{
+    return prediction + float(quantum) * step;
+}
+
+uint32_t zigzag(const int32_t value)
+{
+    return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+}
+
+int32_t unzigzag(const uint32_t code)
+{
+    return int32_t(code >> 1) ^ -int32_t(code & 1u);
+}
+
+// The low bytes of the codes, their high bytes and the escaped values,
+// deflated
+std::string compressBrick(const float* values, const glm::uvec3& size,
+                          const Brick& brick, const float errorBound,
+                          BrickHeader& header, float& maxError)
+{
+    const size_t count = brick.getCount();
+    const float step = 2.0f * errorBound;
+    std::vector<float> decompressed(count);
+    std::vector<unsigned char> codes(2 * count);
+    std::vector<float> escaped;
+
+    size_t i = 0;
+    for (uint32_t z = 0; z < brick.size.z; ++z)
+        for (uint32_t y = 0; y < brick.size.y; ++y)
+        {
+            const float* row = values + getVolumeIndex(size, brick, y, z);
+            for (uint32_t x = 0; x < brick.size.x; ++x, ++i)
+            {
+                const float value = row[x];
+                const float prediction =
+                    predict(decompressed.data(), i, x, y, z, brick.size);
+                uint32_t code = escapeCode;
+                if (step > 0.0f)
+                {
+                    // NaN and infinities fail the comparisons
+                    const float quantum = std::round((value - prediction) / step);
+                    if (std::abs(quantum) <= maxQuantum)
+                    {
+                        const float result =
+                            reconstruct(prediction, int32_t(quantum), step);
+                        const float error = std::abs(result - value);
+                        if (error <= errorBound)
+                        {
+                            code = zigzag(int32_t(quantum));
+                            decompressed[i] = result;
+                            maxError = std::max(maxError, error);
+                        }
+                    }
+                }
+                else if (value == prediction)
+                {
+                    code = 0u;
+                    decompressed[i] = value;
+                }
+
+                if (code == escapeCode)
+                {
+                    escaped.push_back(value);
+                    decompressed[i] = std::isfinite(value) ? value : 0.0f;
+                }
+                codes[i] = code & 0xFFu;
+                codes[count + i] = code >> 8;
+            }
+        }
+
+    header.escapes = uint32_t(escaped.size());
+    codes.resize(2 * count + sizeof(float) * escaped.size());
+    if (!escaped.empty())
+        std::memcpy(codes.data() + 2 * count, escaped.data(),
+                    sizeof(float) * escaped.size());
+
+    uLongf storedSize = compressBound(uLong(codes.size()));
+    std::string stored(storedSize, '\0');
+    if (compress2((Bytef*)&stored[0], &storedSize, codes.data(),
+                  uLong(codes.size()), Z_DEFAULT_COMPRESSION) != Z_OK)
+    {
+        throw std::runtime_error("error: Cannot compress the volume");
+    }
+    stored.resize(storedSize);
+    header.storedSize = uint32_t(storedSize);
+    return stored;
+}
+
+void decompressBrick(const char* data, const BrickHeader& header,
+                     const glm::uvec3& size, const Brick& brick,
+                     const float errorBound, float* values)
+{
+    const size_t count = brick.getCount();
+    std::vector<unsigned char> codes(2 * count +
+                                     sizeof(float) * header.escapes);
+    uLongf codesSize = uLongf(codes.size());
+    if (uncompress(codes.data(), &codesSize, (const Bytef*)data,
+                   header.storedSize) != Z_OK ||
+        codesSize != codes.size())
+    {
+        throw corrupted();
+    }
+    const unsigned char* escaped = codes.data() + 2 * count;
+
+    const float step = 2.0f * errorBound;
+    std::vector<float> decompressed(count);
+    size_t escapes = 0;
+    size_t i = 0;
+    for (uint32_t z = 0; z < brick.size.z; ++z)
+        for (uint32_t y = 0; y < brick.size.y; ++y)
+        {
+            float* row = values + getVolumeIndex(size, brick, y, z);
+            for (uint32_t x = 0; x < brick.size.x; ++x, ++i)
+            {
+                const float prediction =
+                    predict(decompressed.data(), i, x, y, z, brick.size);
+                const uint32_t code =
+                    codes[i] | (uint32_t(codes[count + i]) << 8);
+                float value;
+                if (code == escapeCode)
+                {
+                    if (escapes == header.escapes)
+                        throw corrupted();
+                    std::memcpy(&value, escaped + sizeof(float) * escapes++,
+                                sizeof(float));
+                    decompressed[i] = std::isfinite(value) ? value : 0.0f;
+                }
+                else
+                {
+                    value = reconstruct(prediction, unzigzag(code), step);
+                    decompressed[i] = value;
+                }
+                row[x] = value;
+            }
+        }
+}
+}
+
+CodecStats& CodecStats::operator+=(const CodecStats& other)
+{
+    bytes += other.bytes;
+    storedBytes += other.storedBytes;
+    maxError = std::max(maxError, other.maxError);
+    return *this;
+}
+
+double CodecStats::getRatio() const
+{
+    return storedBytes > 0u ? double(bytes) / storedBytes : 0.0;
+}
+
+CodecStats compressVolume(const float* values, const glm::uvec3& size,
+                          const glm::vec3& voxelSize, const glm::vec3& origin,
+                          const CodecConfig& config, std::string& output)
+{
+    const size_t count = size_t(size.x) * size.y * size.z;
+    float errorBound = std::max(config.errorBound, 0.0f);
+    if (config.relative && count > 0u)
+    {
+        // Range of the finite values, one slice per iteration
+        std::vector<glm::vec2> ranges(size.z);
+        parallelFor(size.z, [&](const size_t z) {
+            glm::vec2 range(std::numeric_limits<float>::max(),
+                            std::numeric_limits<float>::lowest());
+            const float* slice = values + z * size.x * size.y;
+            for (size_t i = 0; i < size_t(size.x) * size.y; ++i)
+            {
+                if (!std::isfinite(slice[i]))
+                    continue;
+                range.x = std::min(range.x, slice[i]);
+                range.y = std::max(range.y, slice[i]);
+            }
+            ranges[z] = range;
+        });
+        glm::vec2 range = ranges.front();
+        for (const glm::vec2& slice : ranges)
+            range = glm::vec2(std::min(range.x, slice.x),
+                              std::max(range.y, slice.y));
+        errorBound *= range.y > range.x ? range.y - range.x : 0.0f;
+    }
+
+    glm::uvec3 brickSize = config.brickSize;
+    for (size_t i = 0; i < 3; ++i)
+        brickSize[i] = std::max(brickSize[i] ? brickSize[i] : size[i], 1u);
+    const glm::uvec3 bricksCount = getBricksCount(size, brickSize);
+    const size_t nBricks = size_t(bricksCount.x) * bricksCount.y * bricksCount.z;
+
+    std::vector<std::string> bricks(nBricks);
+    std::vector<BrickHeader> headers(nBricks);
+    std::vector<float> maxErrors(nBricks, 0.0f);
+    parallelFor(nBricks, [&](const size_t i) {
+        bricks[i] = compressBrick(values, size, getBrick(i, size, brickSize),
+                                  errorBound, headers[i], maxErrors[i]);
+    });
+
+    Header header;
+    std::memcpy(header.magic, codecMagic, sizeof(codecMagic));
+    header.version = codecVersion;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        header.size[i] = size[i];
+        header.voxelSize[i] = voxelSize[i];
+        header.origin[i] = origin[i];
+        header.brickSize[i] = brickSize[i];
+    }
+    header.errorBound = errorBound;
+    header.bricks = uint32_t(nBricks);
+
+    size_t storedSize = sizeof(Header) + sizeof(BrickHeader) * nBricks;
+    for (const std::string& brick : bricks)
+        storedSize += brick.size();
+    output.clear();
+    output.reserve(storedSize);
+    output.append((const char*)&header, sizeof(Header));
+    output.append((const char*)headers.data(), sizeof(BrickHeader) * nBricks);
+    for (const std::string& brick : bricks)
+        output.append(brick);
+
+    CodecStats stats;
+    stats.bytes = sizeof(float) * count;
+    stats.storedBytes = output.size();
+    for (const float error : maxErrors)
+        stats.maxError = std::max(stats.maxError, error);
+    return stats;
+}
+
+CompressedVolumeInfo decompressVolume(const char* data, const size_t size,
+                                      std::vector<float>& values)
+{
+    Header header;
+    if (size < sizeof(Header))
+        throw corrupted();
+    std::memcpy(&header, data, sizeof(Header));
+    if (std::memcmp(header.magic, codecMagic, sizeof(codecMagic)) != 0 ||
+        header.version != codecVersion)
+    {
+        throw std::runtime_error("error: Not a compressed volume");
+    }
+
+    CompressedVolumeInfo info;
+    glm::uvec3 brickSize;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        info.size[i] = header.size[i];
+        info.voxelSize[i] = header.voxelSize[i];
+        info.origin[i] = header.origin[i];
+        brickSize[i] = header.brickSize[i];
+    }
+    info.errorBound = header.errorBound;
+    if (brickSize.x == 0u || brickSize.y == 0u || brickSize.z == 0u)
+        throw corrupted();
+    const glm::uvec3 bricksCount = getBricksCount(info.size, brickSize);
+    const size_t nBricks = size_t(bricksCount.x) * bricksCount.y * bricksCount.z;
+    if (header.bricks != nBricks ||
+        (size - sizeof(Header)) / sizeof(BrickHeader) < nBricks)
+    {
+        throw corrupted();
+    }
+
+    std::vector<BrickHeader> headers(nBricks);
+    std::memcpy(headers.data(), data + sizeof(Header),
+                sizeof(BrickHeader) * nBricks);
+    std::vector<size_t> offsets(nBricks);
+    size_t offset = sizeof(Header) + sizeof(BrickHeader) * nBricks;
+    for (size_t i = 0; i < nBricks; ++i)
+    {
+        offsets[i] = offset;
+        offset += headers[i].storedSize;
+    }
+    if (offset > size)
+        throw corrupted();
+
+    values.resize(size_t(info.size.x) * info.size.y * info.size.z);
+    parallelFor(nBricks, [&](const size_t i) {
+        decompressBrick(data + offsets[i], headers[i], info.size,
+                        getBrick(i, info.size, brickSize), info.errorBound,
+                        values.data());
+    });
+    return info;
+}
+}
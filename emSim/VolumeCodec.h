@@ -0,0 +1,103 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _EMSim_VolumeCodec_h_
+#define _EMSim_VolumeCodec_h_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_CTOR_INIT
+#include <glm/glm.hpp>
+
+namespace ems
+{
+/** Error bound and layout of the compressed volumes */
+struct CodecConfig
+{
+    /**
+     * Maximum absolute difference between a value and its decompressed
+     * value, or a fraction of the value range of each volume if relative is
+     * set. 0 keeps every value exactly.
+     */
+    float errorBound = 0.0f;
+    bool relative = false;
+    /** Number of voxels along x, y and z of the bricks compressed in parallel */
+    glm::uvec3 brickSize = glm::uvec3(32u);
+};
+
+/** Compression done by compressVolume(), or summed over several volumes */
+struct CodecStats
+{
+    /** Size of the values, before compression */
+    size_t bytes = 0u;
+    /** Size of the compressed volumes */
+    size_t storedBytes = 0u;
+    /** Maximum absolute difference between a value and its decompressed value */
+    float maxError = 0.0f;
+
+    CodecStats& operator+=(const CodecStats& other);
+
+    /** @return bytes / storedBytes, 0 if nothing was compressed */
+    double getRatio() const;
+};
+
+/** Description of a compressed volume */
+struct CompressedVolumeInfo
+{
+    glm::uvec3 size;
+    glm::vec3 voxelSize;
+    glm::vec3 origin;
+    /** The absolute error bound the volume was compressed with */
+    float errorBound = 0.0f;
+};
+
+/**
+ * Compress a volume with a bounded error: each value is predicted from its
+ * already decompressed neighbours (3D Lorenzo predictor), the difference is
+ * quantized in steps of twice the error bound and the quantized differences
+ * are deflated. The values that can not be quantized within the bound, like
+ * NaN or infinities, are kept exactly. Smooth fields mostly quantize to 0 and
+ * compress well beyond 10x for a bound of a thousandth of their range.
+ *
+ * The bricks are compressed independently by the threads of the pool.
+ * @param values the voxels values, x first
+ * @param size the number of voxels along x, y and z
+ * @param voxelSize the size of a voxel, stored for the decoder
+ * @param origin the origin of the volume, stored for the decoder
+ * @param config the error bound and the bricks size
+ * @param output the compressed volume, replaced
+ * @return the sizes and the maximum error of the compression
+ */
+CodecStats compressVolume(const float* values, const glm::uvec3& size,
+                          const glm::vec3& voxelSize, const glm::vec3& origin,
+                          const CodecConfig& config, std::string& output);
+
+/**
+ * Decompress a volume compressed by compressVolume(), the bricks in parallel.
+ * @param data the compressed volume
+ * @param size the number of bytes of data
+ * @param values the voxels values, x first, resized
+ * @return the size, voxel size, origin and error bound of the volume
+ * @throw std::runtime_error if data is not a valid compressed volume
+ */
+CompressedVolumeInfo decompressVolume(const char* data, size_t size,
+                                      std::vector<float>& values);
+}
+#endif // _EMSim_VolumeCodec_h_
@@ -20,43 +20,94 @@
 #ifndef _EMSim_helpers_h_
 #define _EMSim_helpers_h_
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <iomanip>
 #include <memory>
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 #define GLM_FORCE_CTOR_INIT
 #include <glm/glm.hpp>
 
+#include <emSim/Memory.h>
+#include <emSim/ThreadPool.h>
+
 namespace ems
 {
-const uint32_t alignment = 32u;
+// Cache line size, also the width of the widest SIMD registers
+const uint32_t alignment = 64u;
+
+// The events' arrays are padded to a multiple of this number of floats, so
+// that the arrays of every time step start on an aligned address.
+const size_t simdPadding = alignment / sizeof(float);
+
+// Number of events sharing a quantization origin in QuantizedEvents, also the
+// number of events dequantized at once by its kernels.
+const uint32_t quantizedBlockSize = 256u;
+
+// Ec =  1 / (4 * PI * conductivity),
+// with conductivity = 1 / 1000000 * 3.54 (siemens per micrometer)
+const float Ec = 281704.249f;
 
 template <typename T>
 struct AlignedMemoryDeleter
 {
-#ifdef USE_ALIGNED_MALLOC
-    void operator()(T* mem) { _mm_free(mem); }
-#else
-    void operator()(T* mem) { free(mem); }
-#endif
+    void operator()(T* mem) { freeMemory(mem); }
 };
 
 using AlignedFloatPtr = std::unique_ptr<float[], AlignedMemoryDeleter<float>>;
+using AlignedHalfPtr =
+    std::unique_ptr<uint16_t[], AlignedMemoryDeleter<uint16_t>>;
 
+/**
+ * Allocate an uninitialized buffer aligned to the cache line size, see
+ * allocateMemory().
+ * @throw std::bad_alloc if the allocation fails
+ */
 template <typename T>
 T* alignedMalloc(size_t numberOfElements)
 {
-#ifdef USE_ALIGNED_MALLOC
-    T* ptr = (T*)_mm_malloc(numberOfElements * sizeof(T), alignment);
-#else
-    T* ptr = (T*)malloc(numberOfElements * sizeof(T));
-#endif
+    T* ptr = (T*)allocateMemory(numberOfElements * sizeof(T));
     if (ptr == 0)
         throw(std::bad_alloc( ));
 
     return ptr;
 }
 
+/**
+ * @return the given number of elements rounded up to a multiple of
+ * simdPadding.
+ */
+inline size_t padEventsCount(const size_t count)
+{
+    return (count + simdPadding - 1) / simdPadding * simdPadding;
+}
+
+/**
+ * @param name the name of an environment variable set to 0 or 1
+ * @param defaultValue the value if the variable is not set or empty
+ * @return the value of the variable
+ * @throw std::runtime_error if the variable is set to another value
+ */
+inline bool parseEnvironmentFlag(const char* name, const bool defaultValue)
+{
+    const char* value = std::getenv(name);
+    if (!value || !*value)
+        return defaultValue;
+    const std::string flag(value);
+    if (flag == "1")
+        return true;
+    if (flag == "0")
+        return false;
+    throw(std::runtime_error(std::string("ERROR: ") + name +
+                             " must be 0 or 1, got " + flag));
+}
+
 inline std::string createTimeStepSuffix(const float time)
 {
     std::stringstream stream;
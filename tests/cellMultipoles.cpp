@@ -0,0 +1,199 @@
+/* Copyright (c) 2017, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim
+ * <https://bbpcode.epfl.ch/browse/code/viz/EMSim/>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <cmath>
+
+#include <emSim/CellMultipoles.h>
+#include <emSim/Events.h>
+#include <emSim/Volume.h>
+
+#define BOOST_TEST_MODULE cellMultipoles
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+const size_t nCells = 27u;
+const size_t eventsPerCell = 40u;
+
+// Neuron-like cells whose currents sum to zero, with a soma and a dendrite
+ems::Events createEvents(ems::CellsEvents& cells)
+{
+    ems::Events events(nCells * eventsPerCell);
+
+    for (size_t i = 0; i < nCells; ++i)
+    {
+        ems::CellEvents cell;
+        cell.begin = i * eventsPerCell;
+        cell.end = cell.begin + eventsPerCell;
+        cell.soma = glm::vec3(float(i % 3) * 300.0f - 300.0f,
+                              float((i / 3) % 3) * 300.0f - 300.0f,
+                              float(i / 9) * 300.0f - 300.0f);
+        cells.push_back(cell);
+
+        for (size_t j = 0; j < eventsPerCell; ++j)
+        {
+            const float t = float(j) / eventsPerCell;
+            const glm::vec3 pos =
+                cell.soma + glm::vec3(15.0f * std::cos(9.0f * t), 120.0f * t,
+                                      15.0f * std::sin(4.0f * t + i));
+            events.addEvent(pos, j == 0 ? 8.0f : 1.0f);
+            events.getPowers()[cell.begin + j] =
+                j == 0 ? -float(eventsPerCell - 1) : 1.0f + 0.5f * std::sin(t);
+        }
+        float sum = 0.0f;
+        for (size_t j = 1; j < eventsPerCell; ++j)
+            sum += events.getPowers()[cell.begin + j];
+        events.getPowers()[cell.begin] = -sum;
+    }
+    return events;
+}
+
+float computeExact(const ems::Events& events, const glm::vec3& pos)
+{
+    float value = 0.0f;
+    for (size_t i = 0; i < events.getEventsCount(); ++i)
+    {
+        value += events.getPowers()[i] /
+                 std::max(glm::length(pos - events.getPosition(i)),
+                          events.getRadii()[i]);
+    }
+    return 281704.249f * value;
+}
+
+struct Positions
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+};
+
+Positions createPositions()
+{
+    Positions positions;
+    for (size_t i = 0; i < 200; ++i)
+    {
+        positions.x.push_back(-400.0f + float((i * 37) % 800));
+        positions.y.push_back(-400.0f + float((i * 53) % 900));
+        positions.z.push_back(-400.0f + float((i * 71) % 800));
+    }
+    return positions;
+}
+
+float computeRMSError(const ems::CellMultipoles& multipoles,
+                      const ems::Events& events, float& rmsValue)
+{
+    const Positions positions = createPositions();
+    const size_t nPoints = positions.x.size();
+    std::vector<float> values(nPoints);
+    multipoles.computeValues(events, positions.x.data(), positions.y.data(),
+                             positions.z.data(), nPoints, values.data());
+
+    double squaredError = 0.0;
+    double squaredValue = 0.0;
+    for (size_t i = 0; i < nPoints; ++i)
+    {
+        const float exact = computeExact(
+            events,
+            glm::vec3(positions.x[i], positions.y[i], positions.z[i]));
+        squaredError += (values[i] - exact) * (values[i] - exact);
+        squaredValue += exact * exact;
+    }
+    rmsValue = std::sqrt(squaredValue / nPoints);
+    return std::sqrt(squaredError / nPoints);
+}
+}
+
+BOOST_AUTO_TEST_CASE(exactWithinCutoff)
+{
+    ems::CellsEvents cells;
+    const ems::Events events = createEvents(cells);
+    ems::CellMultipoles multipoles(events, cells, 10000.0f);
+    multipoles.update(events);
+
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(-400.0f), 0.0f);
+    aabb.add(glm::vec3(400.0f), 0.0f);
+    ems::Volume volume(glm::vec3(80.0f), glm::vec3(0.0f), aabb);
+
+    BOOST_CHECK_CLOSE(multipoles.computeVolume(events, volume), 1.0f, 1e-4f);
+
+    const glm::uvec3& size = volume.getSize();
+    for (size_t z = 0; z < size.z; z += 3)
+        for (size_t y = 0; y < size.y; y += 2)
+            for (size_t x = 0; x < size.x; ++x)
+            {
+                const glm::vec3 pos =
+                    volume.getOrigin() +
+                    glm::vec3(x, y, z) * volume.getVoxelSize();
+                const float exact = computeExact(events, pos);
+                BOOST_CHECK_SMALL(
+                    volume.getData()[(z * size.y + y) * size.x + x] - exact,
+                    std::abs(exact) * 1e-4f + 1e-2f);
+            }
+}
+
+BOOST_AUTO_TEST_CASE(farField)
+{
+    ems::CellsEvents cells;
+    const ems::Events events = createEvents(cells);
+
+    ems::CellMultipoles noCutoff(events, cells, 0.0f);
+    noCutoff.update(events);
+    ems::CellMultipoles cutoff(events, cells, 100.0f);
+    cutoff.update(events);
+
+    float rmsValue = 0.0f;
+    const float noCutoffError = computeRMSError(noCutoff, events, rmsValue);
+    const float cutoffError = computeRMSError(cutoff, events, rmsValue);
+
+    BOOST_CHECK_LT(cutoffError, noCutoffError);
+    BOOST_CHECK_LT(cutoffError, 0.05f * rmsValue);
+}
+
+BOOST_AUTO_TEST_CASE(framesMoments)
+{
+    ems::CellsEvents cells;
+    ems::Events events = createEvents(cells);
+    events.setFramesCount(2u);
+    const size_t nEvents = events.getEventsCount();
+    ems::CellsEvents referenceCells;
+    const ems::Events reference = createEvents(referenceCells);
+    for (size_t i = 0; i < nEvents; ++i)
+        events.getPowers(1)[i] = reference.getPowers()[i];
+
+    ems::CellMultipoles multipoles(events, cells, 50.0f);
+    multipoles.update(events, 1u);
+
+    const Positions positions = createPositions();
+    const size_t nPoints = positions.x.size();
+    std::vector<float> values(nPoints);
+    multipoles.computeValues(events, positions.x.data(), positions.y.data(),
+                             positions.z.data(), nPoints, values.data(), 1u);
+
+    ems::CellMultipoles referenceMultipoles(reference, referenceCells, 50.0f);
+    referenceMultipoles.update(reference);
+    std::vector<float> referenceValues(nPoints);
+    referenceMultipoles.computeValues(reference, positions.x.data(),
+                                      positions.y.data(), positions.z.data(),
+                                      nPoints, referenceValues.data());
+
+    for (size_t i = 0; i < nPoints; ++i)
+        BOOST_CHECK_CLOSE(values[i], referenceValues[i], 1e-4f);
+}
@@ -0,0 +1,123 @@
+/* Copyright (c) 2017, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim
+ * <https://bbpcode.epfl.ch/browse/code/viz/EMSim/>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <cmath>
+
+#include <emSim/CompactEvents.h>
+#include <emSim/Kernels.h>
+#include <emSim/Events.h>
+#include <emSim/Volume.h>
+
+#define BOOST_TEST_MODULE compactEvents
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+const size_t nEvents = 100000u;
+
+// One event out of ten is active in each frame, the others are resting
+ems::Events createEvents(const size_t nFrames)
+{
+    ems::Events events(nEvents, nFrames);
+    for (size_t i = 0; i < nEvents; ++i)
+    {
+        events.addEvent(glm::vec3(float(i % 100) * 4.0f - 200.0f,
+                                  float((i / 100) % 100) * 4.0f - 200.0f,
+                                  float(i / 10000) * 40.0f - 200.0f),
+                        1.0f);
+        for (size_t j = 0; j < nFrames; ++j)
+            events.getPowers(j)[i] =
+                (i + j) % 10 == 0 ? std::sin(0.1f * i) + 2.0f : 1e-6f;
+    }
+    return events;
+}
+}
+
+BOOST_AUTO_TEST_CASE(compaction)
+{
+    const ems::Events events = createEvents(2u);
+    ems::CompactEvents compactEvents(events, 1e-3f);
+
+    compactEvents.update(events);
+    BOOST_CHECK_EQUAL(compactEvents.getEventsCount(), nEvents / 10);
+    BOOST_CHECK_CLOSE(compactEvents.getCompactionRatio(), 0.1f, 1e-3f);
+    for (size_t i = 0; i < compactEvents.getEventsCount(); ++i)
+    {
+        const size_t index = i * 10;
+        BOOST_REQUIRE_EQUAL(compactEvents.getPowers()[i],
+                            events.getPowers()[index]);
+        BOOST_REQUIRE_EQUAL(compactEvents.getRadii()[i],
+                            events.getRadii()[index]);
+        BOOST_REQUIRE_EQUAL(compactEvents.getPositionsX()[i],
+                            events.getPositionsX()[index]);
+        BOOST_REQUIRE_EQUAL(compactEvents.getPositionsY()[i],
+                            events.getPositionsY()[index]);
+        BOOST_REQUIRE_EQUAL(compactEvents.getPositionsZ()[i],
+                            events.getPositionsZ()[index]);
+    }
+
+    // The events active in any of the frames are kept for all of them
+    compactEvents.update(events, 2u);
+    BOOST_CHECK_EQUAL(compactEvents.getEventsCount(), nEvents / 5);
+    BOOST_CHECK_EQUAL(compactEvents.getPowers(1u)[0], events.getPowers(1u)[0]);
+    BOOST_CHECK_EQUAL(compactEvents.getPowers(1u)[1], events.getPowers(1u)[9]);
+
+    ems::CompactEvents lossless(events, 0.0f);
+    lossless.update(events);
+    BOOST_CHECK_EQUAL(lossless.getEventsCount(), nEvents);
+}
+
+BOOST_AUTO_TEST_CASE(compactVolume)
+{
+    const ems::Events events = createEvents(1u);
+    ems::CompactEvents compactEvents(events, 1e-3f);
+    compactEvents.update(events);
+
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(-200.0f), 0.0f);
+    aabb.add(glm::vec3(200.0f), 0.0f);
+    ems::Volume volume(glm::vec3(40.0f), glm::vec3(0.0f), aabb);
+    ems::Volume reference(glm::vec3(40.0f), glm::vec3(0.0f), aabb);
+
+    ems::kernels::computeVolume(compactEvents.getPositionsX(),
+                                compactEvents.getPositionsY(),
+                                compactEvents.getPositionsZ(),
+                                compactEvents.getRadii(),
+                                compactEvents.getPowers(),
+                                compactEvents.getEventsCount(), volume.getData(),
+                                volume.getSize().x, volume.getSize().y,
+                                volume.getSize().z, volume.getVoxelSize().x,
+                                volume.getVoxelSize().y, volume.getVoxelSize().z,
+                                volume.getOrigin().x, volume.getOrigin().y,
+                                volume.getOrigin().z);
+    ems::kernels::computeVolume(events.getPositionsX(), events.getPositionsY(),
+                                events.getPositionsZ(), events.getRadii(),
+                                events.getPowers(), nEvents, reference.getData(),
+                                reference.getSize().x, reference.getSize().y,
+                                reference.getSize().z, reference.getVoxelSize().x,
+                                reference.getVoxelSize().y,
+                                reference.getVoxelSize().z,
+                                reference.getOrigin().x, reference.getOrigin().y,
+                                reference.getOrigin().z);
+
+    const glm::uvec3& size = volume.getSize();
+    for (size_t i = 0; i < size_t(size.x) * size.y * size.z; ++i)
+        BOOST_REQUIRE_CLOSE(volume.getData()[i], reference.getData()[i], 0.1f);
+}
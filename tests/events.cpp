@@ -0,0 +1,119 @@
+/* Copyright (c) 2020, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim
+ * <https://bbpcode.epfl.ch/browse/code/viz/EMSim/>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <emSim/Events.h>
+
+#define BOOST_TEST_MODULE events
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+const size_t nEvents = 21u;
+
+void checkPadding(const float* powers, const size_t nPaddedEvents,
+                  const size_t nFrames)
+{
+    for (size_t i = 0; i < nFrames; ++i)
+        for (size_t j = nEvents; j < nPaddedEvents; ++j)
+            BOOST_CHECK_EQUAL(powers[i * nPaddedEvents + j], 0.0f);
+}
+}
+
+BOOST_AUTO_TEST_CASE(swapPowers)
+{
+    ems::Events events(nEvents, 2u);
+    const size_t nPaddedEvents = events.getPaddedEventsCount();
+    BOOST_REQUIRE_GT(nPaddedEvents, nEvents);
+    for (size_t i = 0; i < nEvents; ++i)
+        events.getPowers(1)[i] = float(i);
+
+    ems::PowersPool pool(nPaddedEvents);
+    size_t nFrames = 0u;
+    ems::AlignedFloatPtr powers = pool.acquire(3u, nFrames);
+    BOOST_CHECK_EQUAL(nFrames, 3u);
+    checkPadding(powers.get(), nPaddedEvents, nFrames);
+    for (size_t i = 0; i < nEvents; ++i)
+        powers[2 * nPaddedEvents + i] = -float(i);
+
+    const float* previous = events.getPowers();
+    const float* next = powers.get();
+    events.swapPowers(powers, nFrames);
+
+    BOOST_CHECK_EQUAL(events.getFramesCount(), 3u);
+    BOOST_CHECK_EQUAL(events.getPowers(), next);
+    BOOST_CHECK_EQUAL(events.getPowers(2)[nEvents - 1], -float(nEvents - 1));
+    checkPadding(events.getPowers(), nPaddedEvents, 3u);
+
+    BOOST_CHECK_EQUAL(nFrames, 2u);
+    BOOST_CHECK_EQUAL(powers.get(), previous);
+    BOOST_CHECK_EQUAL(powers[nPaddedEvents + nEvents - 1], float(nEvents - 1));
+    checkPadding(powers.get(), nPaddedEvents, nFrames);
+}
+
+BOOST_AUTO_TEST_CASE(powersPoolReuse)
+{
+    ems::PowersPool pool(32u);
+    size_t capacity = 0u;
+    ems::AlignedFloatPtr first = pool.acquire(4u, capacity);
+    const float* firstData = first.get();
+    pool.release(std::move(first), capacity);
+    BOOST_CHECK_EQUAL(pool.getFreeCount(), 1u);
+
+    // A smaller batch, like the last one of a report, reuses the buffer
+    ems::AlignedFloatPtr reused = pool.acquire(3u, capacity);
+    BOOST_CHECK_EQUAL(reused.get(), firstData);
+    BOOST_CHECK_EQUAL(capacity, 4u);
+    BOOST_CHECK_EQUAL(pool.getFreeCount(), 0u);
+
+    // The smallest large enough buffer is taken
+    size_t smallCapacity = 0u;
+    ems::AlignedFloatPtr small = pool.acquire(2u, smallCapacity);
+    const float* smallData = small.get();
+    BOOST_CHECK_EQUAL(smallCapacity, 2u);
+    pool.release(std::move(reused), capacity);
+    pool.release(std::move(small), smallCapacity);
+    ems::AlignedFloatPtr best = pool.acquire(1u, capacity);
+    BOOST_CHECK_EQUAL(best.get(), smallData);
+    BOOST_CHECK_EQUAL(capacity, 2u);
+    pool.release(std::move(best), capacity);
+    BOOST_CHECK_EQUAL(pool.getFreeCount(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(powersPoolGrowth)
+{
+    ems::PowersPool pool(16u);
+    size_t capacity = 0u;
+    ems::AlignedFloatPtr small = pool.acquire(1u, capacity);
+    pool.release(std::move(small), capacity);
+    ems::AlignedFloatPtr medium = pool.acquire(2u, capacity);
+    pool.release(std::move(medium), capacity);
+    // The 1 frame buffer is too small and released
+    BOOST_CHECK_EQUAL(pool.getFreeCount(), 1u);
+
+    // Larger batches allocate a new null buffer and drop the smaller ones
+    ems::AlignedFloatPtr large = pool.acquire(8u, capacity);
+    BOOST_CHECK_EQUAL(capacity, 8u);
+    BOOST_CHECK_EQUAL(pool.getFreeCount(), 0u);
+    for (size_t i = 0; i < 16u * 8u; ++i)
+        BOOST_CHECK_EQUAL(large[i], 0.0f);
+
+    pool.release(ems::AlignedFloatPtr(), 0u);
+    BOOST_CHECK_EQUAL(pool.getFreeCount(), 0u);
+}
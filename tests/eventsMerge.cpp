@@ -0,0 +1,215 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <cmath>
+
+#include <emSim/EventsMerge.h>
+#include <emSim/Kernels.h>
+#include <emSim/Volume.h>
+
+#define BOOST_TEST_MODULE eventsMerge
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+const size_t nCells = 30u;
+const size_t somaEvents = 4u;
+const size_t eventsPerCell = 40u;
+
+// The first events of every cell are the compartments of the soma, all at
+// the soma position with the soma radius
+ems::Events createEvents(ems::CellsEvents& cells, ems::EventsAABB& aabb)
+{
+    ems::Events events(nCells * eventsPerCell, 2u);
+    for (size_t i = 0; i < nCells; ++i)
+    {
+        ems::CellEvents cell;
+        cell.begin = i * eventsPerCell;
+        cell.end = cell.begin + eventsPerCell;
+        cell.soma = glm::vec3(float((i * 37) % 30) * 30.0f - 450.0f,
+                              float((i * 11) % 30) * 30.0f - 450.0f,
+                              float((i * 23) % 30) * 30.0f - 450.0f);
+        cells.push_back(cell);
+
+        for (size_t j = 0; j < eventsPerCell; ++j)
+        {
+            const size_t index = cell.begin + j;
+            const bool soma = j < somaEvents;
+            const glm::vec3 pos =
+                soma ? cell.soma
+                     : cell.soma + glm::vec3(std::sin(1.3f * j),
+                                             std::cos(0.7f * j),
+                                             std::sin(0.3f * j)) *
+                                       float(j) * 5.0f;
+            const float radius = soma ? 8.0f : 1.0f + 0.01f * j;
+            events.addEvent(pos, radius);
+            aabb.add(pos, radius);
+            events.getPowers(0)[index] = std::sin(0.1f * index);
+            events.getPowers(1)[index] = std::cos(0.2f * index);
+        }
+    }
+    return events;
+}
+
+void computeVolume(const ems::Events& events, const float* powers,
+                   ems::Volume& volume)
+{
+    ems::kernels::computeVolume(
+        events.getPositionsX(), events.getPositionsY(), events.getPositionsZ(),
+        events.getRadii(), powers, events.getEventsCount(), volume.getData(),
+        volume.getSize().x, volume.getSize().y, volume.getSize().z,
+        volume.getVoxelSize().x, volume.getVoxelSize().y,
+        volume.getVoxelSize().z, volume.getOrigin().x, volume.getOrigin().y,
+        volume.getOrigin().z);
+}
+}
+
+BOOST_AUTO_TEST_CASE(somaEventsMerge)
+{
+    ems::CellsEvents cells;
+    ems::EventsAABB aabb;
+    const ems::Events events = createEvents(cells, aabb);
+
+    const ems::EventsMerge merge = ems::computeEventsMerge(events, cells);
+    const size_t nMerged = nCells * (eventsPerCell - somaEvents + 1u);
+    BOOST_REQUIRE_EQUAL(merge.getEventsCount(), nMerged);
+    BOOST_REQUIRE_EQUAL(merge.members.size(), events.getEventsCount());
+    BOOST_CHECK_EQUAL(merge.offsets.back(), events.getEventsCount());
+
+    uint32_t begin = 0u;
+    for (size_t i = 0; i < cells.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(cells[i].begin, begin);
+        BOOST_CHECK_EQUAL(cells[i].end - cells[i].begin,
+                          eventsPerCell - somaEvents + 1u);
+        begin = cells[i].end;
+
+        // The soma compartments are merged into the first one, the other
+        // events are kept in report order
+        const uint32_t first = i * eventsPerCell;
+        BOOST_REQUIRE_EQUAL(merge.offsets[cells[i].begin + 1] -
+                                merge.offsets[cells[i].begin],
+                            somaEvents);
+        for (size_t j = 0; j < somaEvents; ++j)
+            BOOST_CHECK_EQUAL(merge.members[merge.offsets[cells[i].begin] + j],
+                              first + j);
+        for (uint32_t j = cells[i].begin + 1; j < cells[i].end; ++j)
+        {
+            BOOST_REQUIRE_EQUAL(merge.offsets[j + 1] - merge.offsets[j], 1u);
+            BOOST_CHECK_EQUAL(merge.members[merge.offsets[j]],
+                              first + somaEvents + j - cells[i].begin - 1u);
+        }
+    }
+    BOOST_CHECK_EQUAL(begin, nMerged);
+}
+
+BOOST_AUTO_TEST_CASE(noMerge)
+{
+    ems::Events events(3u);
+    events.addEvent(glm::vec3(0.0f), 1.0f);
+    events.addEvent(glm::vec3(0.0f), 2.0f);
+    events.addEvent(glm::vec3(0.0f, 0.0f, 1.0f), 1.0f);
+    ems::CellsEvents cells(1u);
+    cells[0].end = 3u;
+
+    const ems::EventsMerge merge = ems::computeEventsMerge(events, cells);
+    BOOST_CHECK_EQUAL(merge.getEventsCount(), 3u);
+    BOOST_CHECK_EQUAL(cells[0].begin, 0u);
+    BOOST_CHECK_EQUAL(cells[0].end, 3u);
+    for (uint32_t i = 0; i < 3u; ++i)
+        BOOST_CHECK_EQUAL(merge.members[i], i);
+
+    // The events of different cells are never merged
+    cells = ems::CellsEvents(2u);
+    cells[0].end = 1u;
+    cells[1].begin = 1u;
+    cells[1].end = 2u;
+    ems::Events separate(2u);
+    separate.addEvent(glm::vec3(0.0f), 1.0f);
+    separate.addEvent(glm::vec3(0.0f), 1.0f);
+    BOOST_CHECK_EQUAL(ems::computeEventsMerge(separate, cells).getEventsCount(),
+                      2u);
+}
+
+BOOST_AUTO_TEST_CASE(mergedVolume)
+{
+    ems::CellsEvents cells;
+    ems::EventsAABB aabb;
+    const ems::Events events = createEvents(cells, aabb);
+    const ems::EventsMerge merge = ems::computeEventsMerge(events, cells);
+    ems::Events merged = ems::mergeEvents(events, merge);
+    BOOST_REQUIRE_EQUAL(merged.getEventsCount(), merge.getEventsCount());
+
+    ems::gatherSumPowers(events.getPowers(1), merge, merged.getPowers());
+    for (size_t i = 0; i < merge.getEventsCount(); ++i)
+    {
+        float sum = 0.0f;
+        for (uint32_t j = merge.offsets[i]; j < merge.offsets[i + 1]; ++j)
+        {
+            BOOST_REQUIRE(merged.getPosition(i) ==
+                          events.getPosition(merge.members[j]));
+            BOOST_REQUIRE_EQUAL(merged.getRadii()[i],
+                                events.getRadii()[merge.members[j]]);
+            sum += events.getPowers(1)[merge.members[j]];
+        }
+        BOOST_CHECK_CLOSE(merged.getPowers()[i], sum, 1e-4f);
+    }
+
+    ems::Volume referenceVolume(glm::vec3(50.0f), glm::vec3(0.0f), aabb);
+    ems::Volume volume(glm::vec3(50.0f), glm::vec3(0.0f), aabb);
+    computeVolume(events, events.getPowers(1), referenceVolume);
+    computeVolume(merged, merged.getPowers(), volume);
+    // Only the summation order differs
+    const glm::uvec3& size = volume.getSize();
+    const size_t nVoxels = size_t(size.x) * size.y * size.z;
+    float maxValue = 0.0f;
+    for (size_t i = 0; i < nVoxels; ++i)
+        maxValue = std::max(maxValue, std::abs(referenceVolume.getData()[i]));
+    for (size_t i = 0; i < nVoxels; ++i)
+        BOOST_CHECK_SMALL(volume.getData()[i] - referenceVolume.getData()[i],
+                          maxValue * 1e-5f);
+}
+
+BOOST_AUTO_TEST_CASE(reorderMerge)
+{
+    ems::CellsEvents cells;
+    ems::EventsAABB aabb;
+    const ems::Events events = createEvents(cells, aabb);
+    const ems::EventsMerge merge = ems::computeEventsMerge(events, cells);
+    ems::Events merged = ems::mergeEvents(events, merge);
+    ems::gatherSumPowers(events.getPowers(0), merge, merged.getPowers());
+
+    const ems::EventsOrder order =
+        ems::computeSpatialOrder(merged, cells, aabb);
+    merged.reorder(order);
+    const ems::EventsMerge reordered = ems::reorderEventsMerge(merge, order);
+    BOOST_REQUIRE_EQUAL(reordered.getEventsCount(), merge.getEventsCount());
+    BOOST_REQUIRE_EQUAL(reordered.members.size(), merge.members.size());
+
+    // Summing the report powers through the reordered merge gives the
+    // reordered merged powers
+    std::vector<float> powers(reordered.getEventsCount());
+    ems::gatherSumPowers(events.getPowers(0), reordered, powers.data());
+    for (size_t i = 0; i < powers.size(); ++i)
+    {
+        BOOST_REQUIRE(merged.getPosition(i) ==
+                      events.getPosition(
+                          reordered.members[reordered.offsets[i]]));
+        BOOST_CHECK_EQUAL(powers[i], merged.getPowers()[i]);
+    }
+}
@@ -0,0 +1,105 @@
+/* Copyright (c) 2017, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim
+ * <https://bbpcode.epfl.ch/browse/code/viz/EMSim/>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include <emSim/Events.h>
+#include <emSim/FFTVolume.h>
+#include <emSim/Volume.h>
+
+#define BOOST_TEST_MODULE fftVolume
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+void computeExactVolume(const ems::Events& events, ems::Volume& volume)
+{
+    const glm::uvec3& size = volume.getSize();
+    for (size_t z = 0; z < size.z; ++z)
+    {
+        for (size_t y = 0; y < size.y; ++y)
+        {
+            for (size_t x = 0; x < size.x; ++x)
+            {
+                const glm::vec3 voxelPos =
+                    volume.getOrigin() +
+                    glm::vec3(x, y, z) * volume.getVoxelSize();
+                double value = 0.0;
+                for (size_t i = 0; i < events.getEventsCount(); ++i)
+                {
+                    const glm::vec3 pos = events.getPosition(i);
+                    value += events.getPowers()[i] /
+                             std::max(glm::length(voxelPos - pos),
+                                      events.getRadii()[i]);
+                }
+                volume.getData()[(z * size.y + y) * size.x + x] =
+                    281704.249 * value;
+            }
+        }
+    }
+}
+}
+
+BOOST_AUTO_TEST_CASE(convolution)
+{
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(-100.0f, -80.0f, -60.0f), 0.0f);
+    aabb.add(glm::vec3(100.0f, 80.0f, 60.0f), 0.0f);
+    ems::Volume volume(glm::vec3(10.0f), glm::vec3(40.0f), aabb);
+    ems::Volume reference(glm::vec3(10.0f), glm::vec3(40.0f), aabb);
+
+    // The last event lies outside of the volume
+    ems::Events events(6u);
+    events.addEvent(glm::vec3(-42.0f, 3.0f, -7.0f), 4.0f);
+    events.addEvent(glm::vec3(17.0f, -21.0f, 12.0f), 2.0f);
+    events.addEvent(glm::vec3(63.0f, 30.0f, 25.0f), 8.0f);
+    events.addEvent(glm::vec3(-80.0f, -70.0f, 50.0f), 1.0f);
+    events.addEvent(glm::vec3(0.0f, 0.0f, 0.0f), 3.0f);
+    events.addEvent(glm::vec3(300.0f, 0.0f, 0.0f), 3.0f);
+    const float powers[] = {10.0f, -4.0f, 7.0f, 2.0f, -6.0f, 5.0f};
+    std::copy(powers, powers + 6, events.getPowers());
+
+    computeExactVolume(events, reference);
+
+    ems::FFTVolume fftVolume(volume, events, 2u);
+    BOOST_CHECK_EQUAL(fftVolume.getGridSize().x, 64u);
+    BOOST_CHECK_EQUAL(fftVolume.getGridSize().y, 64u);
+    BOOST_CHECK_EQUAL(fftVolume.getGridSize().z, 32u);
+    fftVolume.compute(events, volume);
+
+    const glm::uvec3& size = volume.getSize();
+    const size_t voxelCount = size_t(size.x) * size.y * size.z;
+    double squaredError = 0.0;
+    double squaredValue = 0.0;
+    for (size_t i = 0; i < voxelCount; ++i)
+    {
+        const double delta = volume.getData()[i] - reference.getData()[i];
+        squaredError += delta * delta;
+        squaredValue += double(reference.getData()[i]) * reference.getData()[i];
+    }
+    BOOST_CHECK_LT(std::sqrt(squaredError / squaredValue), 0.01);
+
+    // The voxels around the events are corrected with the exact values
+    const size_t eventVoxel = (size_t(7) * size.y + 10) * size.x + 8;
+    BOOST_CHECK_CLOSE(volume.getData()[eventVoxel],
+                      reference.getData()[eventVoxel], 1.0);
+}
@@ -0,0 +1,175 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include <emSim/FileWriter.h>
+#include <emSim/Volume.h>
+
+#define BOOST_TEST_MODULE fileWriter
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+std::string readFile(const std::string& fileName)
+{
+    std::ifstream input(fileName, std::ios::in | std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(input),
+                       std::istreambuf_iterator<char>());
+}
+
+std::string toString(const std::vector<float>& values)
+{
+    return std::string((const char*)values.data(),
+                       values.size() * sizeof(float));
+}
+}
+
+BOOST_AUTO_TEST_CASE(parallelChunks)
+{
+    // Small chunks, so every file is written by several threads
+    ems::FileWriter writer(2u, 3u, 1000u);
+    std::vector<std::vector<float>> contents;
+    for (size_t i = 0; i < 6; ++i)
+    {
+        std::vector<float> values(10000u + 77u * i);
+        for (size_t j = 0; j < values.size(); ++j)
+            values[j] = float(i) * 0.5f + float(j);
+        ems::writeFloatsFile("fileWriter_" + std::to_string(i) + ".raw",
+                             values.data(), values.size(), &writer);
+        contents.push_back(std::move(values));
+    }
+    writer.write("fileWriter.txt", std::string("text file\n"));
+    writer.flush();
+
+    for (size_t i = 0; i < contents.size(); ++i)
+    {
+        const std::string fileName =
+            "fileWriter_" + std::to_string(i) + ".raw";
+        BOOST_CHECK(readFile(fileName) == toString(contents[i]));
+        std::remove(fileName.c_str());
+    }
+    BOOST_CHECK_EQUAL(readFile("fileWriter.txt"), "text file\n");
+    std::remove("fileWriter.txt");
+
+    const ems::WriteStats stats = writer.getStats();
+    BOOST_CHECK_EQUAL(stats.files, 7u);
+    size_t bytes = 10u;
+    for (const auto& values : contents)
+        bytes += values.size() * sizeof(float);
+    BOOST_CHECK_EQUAL(stats.bytes, bytes);
+}
+
+BOOST_AUTO_TEST_CASE(bufferPool)
+{
+    ems::FileWriter writer(1u, 1u);
+    const float* previous = nullptr;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        // With a single buffer, every acquisition waits for the previous
+        // file and gets the same memory back
+        ems::WriteBuffer buffer = writer.acquireBuffer(100u);
+        BOOST_CHECK_GE(buffer.capacity, 100u);
+        if (previous)
+            BOOST_CHECK_EQUAL(buffer.data.get(), previous);
+        previous = buffer.data.get();
+        for (size_t j = 0; j < 100u; ++j)
+            buffer.data[j] = float(i);
+        writer.write("fileWriter.raw", std::move(buffer), 100u);
+    }
+    writer.flush();
+    BOOST_CHECK(readFile("fileWriter.raw") ==
+                toString(std::vector<float>(100u, 3.0f)));
+    std::remove("fileWriter.raw");
+}
+
+BOOST_AUTO_TEST_CASE(errors)
+{
+    ems::FileWriter writer;
+    const std::vector<float> values(1000u, 1.0f);
+    // The files are opened by the writing threads, so like a write error an
+    // open error is thrown by the next flush only
+    ems::writeFloatsFile("missing/fileWriter.raw", values.data(),
+                         values.size(), &writer);
+    BOOST_CHECK_THROW(writer.flush(), std::runtime_error);
+    BOOST_CHECK_NO_THROW(writer.flush());
+    BOOST_CHECK_THROW(ems::writeFloatsFile("missing/fileWriter.raw",
+                                           values.data(), values.size(),
+                                           nullptr),
+                      std::runtime_error);
+
+    // A write error is thrown by the next flush only
+    ems::writeFloatsFile("/dev/full", values.data(), values.size(), &writer);
+    BOOST_CHECK_THROW(writer.flush(), std::runtime_error);
+    BOOST_CHECK_NO_THROW(writer.flush());
+
+    // The buffers are still usable after an error
+    ems::writeTextFile("fileWriter.txt", "text", &writer);
+    BOOST_CHECK_NO_THROW(writer.flush());
+    BOOST_CHECK_EQUAL(readFile("fileWriter.txt"), "text");
+    std::remove("fileWriter.txt");
+}
+
+BOOST_AUTO_TEST_CASE(volumeFiles)
+{
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(0.0f), 0.0f);
+    aabb.add(glm::vec3(100.0f, 60.0f, 40.0f), 0.0f);
+    for (const auto precision : {ems::Precision::fp32, ems::Precision::fp16})
+    {
+        ems::Volume volume(glm::vec3(4.0f), glm::vec3(0.0f), aabb, precision);
+        volume.clear(0.25f);
+
+        volume.writeToFile(1.0f, 0.1f, "mA", "fileWriterSync", "config",
+                           "report", "target");
+        ems::FileWriter writer(1u, 2u, 4096u);
+        volume.writeToFile(1.0f, 0.1f, "mA", "fileWriterAsync", "config",
+                           "report", "target", &writer);
+        // The volume can be modified once queued
+        volume.clear(1.0f);
+        writer.flush();
+
+        for (const std::string suffix :
+             {"_volume_floats_1.0.raw", "_volume_info_1.0.txt"})
+        {
+            const std::string sync = readFile("fileWriterSync" + suffix);
+            BOOST_CHECK(!sync.empty());
+            BOOST_CHECK(sync == readFile("fileWriterAsync" + suffix));
+            std::remove(("fileWriterSync" + suffix).c_str());
+            std::remove(("fileWriterAsync" + suffix).c_str());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(mhdHeader)
+{
+    const std::string header =
+        ems::createMhdHeader({10u, 20u}, {0.5f, 2.0f}, {-1.0f, 3.0f},
+                             "output/image.raw");
+    BOOST_CHECK(header.find("NDims = 2\n") != std::string::npos);
+    BOOST_CHECK(header.find("TransformMatrix = 1 0 0 1\n") !=
+                std::string::npos);
+    BOOST_CHECK(header.find("Offset = -1 3\n") != std::string::npos);
+    BOOST_CHECK(header.find("ElementSpacing = 0.5 2\n") != std::string::npos);
+    BOOST_CHECK(header.find("DimSize = 10 20\n") != std::string::npos);
+    // Relative to the header, which is next to the raw file
+    BOOST_CHECK(header.find("ElementDataFile = image.raw\n") !=
+                std::string::npos);
+}
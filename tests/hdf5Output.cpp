@@ -0,0 +1,219 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <cstdio>
+
+#include <hdf5.h>
+
+#include <emSim/HDF5Output.h>
+#include <emSim/SamplePoints.h>
+#include <emSim/Volume.h>
+
+#define BOOST_TEST_MODULE hdf5Output
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+const std::string fileName = "hdf5Output.h5";
+
+std::vector<float> readDataset(const std::string& name,
+                               std::vector<hsize_t>& dims,
+                               std::vector<hsize_t>& chunk)
+{
+    const hid_t file = H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    BOOST_REQUIRE_GE(file, 0);
+    const hid_t dataset = H5Dopen2(file, name.c_str(), H5P_DEFAULT);
+    BOOST_REQUIRE_GE(dataset, 0);
+    const hid_t space = H5Dget_space(dataset);
+    dims.resize(H5Sget_simple_extent_ndims(space));
+    H5Sget_simple_extent_dims(space, dims.data(), nullptr);
+    const hid_t properties = H5Dget_create_plist(dataset);
+    chunk.resize(dims.size());
+    H5Pget_chunk(properties, chunk.size(), chunk.data());
+
+    size_t count = 1u;
+    for (const hsize_t size : dims)
+        count *= size;
+    std::vector<float> values(count);
+    BOOST_CHECK_GE(H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL,
+                           H5P_DEFAULT, values.data()),
+                   0);
+    H5Pclose(properties);
+    H5Sclose(space);
+    H5Dclose(dataset);
+    H5Fclose(file);
+    return values;
+}
+
+std::string readStringAttribute(const std::string& object,
+                                const std::string& name)
+{
+    const hid_t file = H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    const hid_t attribute =
+        H5Aopen_by_name(file, object.c_str(), name.c_str(), H5P_DEFAULT,
+                        H5P_DEFAULT);
+    BOOST_REQUIRE_GE(attribute, 0);
+    const hid_t type = H5Aget_type(attribute);
+    std::string value(H5Tget_size(type), '\0');
+    H5Aread(attribute, type, &value[0]);
+    H5Tclose(type);
+    H5Aclose(attribute);
+    H5Fclose(file);
+    return value;
+}
+
+// Frames of 2 values along z, 3 along y and 5 along x
+const size_t nFrames = 7u;
+const size_t frameValues = 30u;
+
+float getValue(const size_t frame, const size_t index)
+{
+    return float(frame * 1000 + index);
+}
+
+void writeFrames(const ems::HDF5Config& config)
+{
+    ems::HDF5Output output(fileName, config);
+    const size_t dataset = output.createDataset("frames", {5u, 3u, 2u}, nFrames);
+    output.setAttribute("/", "Report", "currents");
+    output.setAttribute("frames", "Spacing", std::vector<double>{1.0, 2.0});
+    for (size_t i = 0; i < nFrames; ++i)
+    {
+        std::vector<float> values(frameValues);
+        for (size_t j = 0; j < frameValues; ++j)
+            values[j] = getValue(i, j);
+        output.writeFrame(dataset, i, values.data());
+    }
+    output.flush();
+    BOOST_CHECK_EQUAL(output.getStats().bytes,
+                      nFrames * frameValues * sizeof(float));
+}
+
+void checkFrames(const std::vector<hsize_t>& expectedChunk)
+{
+    std::vector<hsize_t> dims;
+    std::vector<hsize_t> chunk;
+    const std::vector<float> values = readDataset("frames", dims, chunk);
+    BOOST_CHECK(dims == std::vector<hsize_t>({nFrames, 2u, 3u, 5u}));
+    BOOST_CHECK(chunk == expectedChunk);
+    for (size_t i = 0; i < nFrames; ++i)
+        for (size_t j = 0; j < frameValues; ++j)
+            BOOST_CHECK_EQUAL(values[i * frameValues + j], getValue(i, j));
+    BOOST_CHECK_EQUAL(readStringAttribute("/", "Report"), "currents");
+}
+}
+
+BOOST_AUTO_TEST_CASE(parseChunks)
+{
+    ems::HDF5Config config;
+    ems::parseHDF5Chunks("64,8,4,2", config);
+    BOOST_CHECK_EQUAL(config.chunkFrames, 64u);
+    BOOST_CHECK(config.chunkSize == glm::uvec3(8u, 4u, 2u));
+
+    BOOST_CHECK_THROW(ems::parseHDF5Chunks("64,8,4", config),
+                      std::runtime_error);
+    BOOST_CHECK_THROW(ems::parseHDF5Chunks("0,8,4,2", config),
+                      std::runtime_error);
+    BOOST_CHECK_THROW(ems::parseHDF5Chunks("1,8,4,2,1", config),
+                      std::runtime_error);
+    BOOST_CHECK_THROW(ems::parseHDF5Chunks("1,a,4,2", config),
+                      std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(frameChunks)
+{
+    writeFrames(ems::HDF5Config());
+    checkFrames({1u, 2u, 3u, 5u});
+    std::remove(fileName.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(timeSeriesChunks)
+{
+    // Partial chunks along every dimension, compressed by several threads
+    ems::HDF5Config config;
+    config.chunkFrames = 3u;
+    config.chunkSize = glm::uvec3(2u, 2u, 1u);
+    config.compression = 4;
+    config.threads = 3u;
+    config.queuedBlocks = 1u;
+    writeFrames(config);
+    checkFrames({3u, 1u, 2u, 2u});
+    std::remove(fileName.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(volumeAndSamplePoints)
+{
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(0.0f), 0.0f);
+    aabb.add(glm::vec3(100.0f, 60.0f, 40.0f), 0.0f);
+    ems::Volume volume(glm::vec3(4.0f), glm::vec3(0.0f), aabb,
+                       ems::Precision::fp16);
+    const glm::uvec3& size = volume.getSize();
+    const size_t nVoxels = size_t(size.x) * size.y * size.z;
+
+    ems::SamplePoints samplePoints(2u, {glm::vec3(1.0f, 2.0f, 3.0f),
+                                        glm::vec3(4.0f, 5.0f, 6.0f)});
+    {
+        ems::HDF5Config config;
+        config.compression = 1;
+        ems::HDF5Output output(fileName, config);
+        const size_t dataset = volume.createDataset(output, "volume", 2u);
+        for (size_t i = 0; i < 2; ++i)
+        {
+            volume.clear(float(i) + 0.5f);
+            volume.writeToHDF5(output, dataset, i);
+        }
+        samplePoints.writeToHDF5(output, glm::vec2(0.0f, 0.1f), 0.1f, "mA");
+        output.flush();
+        BOOST_CHECK_LT(output.getStats().storedBytes,
+                       output.getStats().bytes / 10u);
+    }
+
+    std::vector<hsize_t> dims;
+    std::vector<hsize_t> chunk;
+    const std::vector<float> values = readDataset("volume", dims, chunk);
+    BOOST_CHECK(dims ==
+                std::vector<hsize_t>({2u, size.z, size.y, size.x}));
+    for (size_t i = 0; i < values.size(); i += 101)
+        BOOST_CHECK_EQUAL(values[i], float(i / nVoxels) + 0.5f);
+
+    const std::vector<float> points =
+        readDataset("sample_points", dims, chunk);
+    BOOST_CHECK(dims == std::vector<hsize_t>({2u, 2u}));
+    BOOST_CHECK_EQUAL(points.size(), 4u);
+    BOOST_CHECK_EQUAL(readStringAttribute("sample_points", "Units"), "mV");
+    std::remove(fileName.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(errors)
+{
+    BOOST_CHECK_THROW(ems::HDF5Output("missing/hdf5Output.h5",
+                                      ems::HDF5Config()),
+                      std::runtime_error);
+
+    ems::HDF5Output output(fileName, ems::HDF5Config());
+    BOOST_CHECK_THROW(output.createDataset("frames", {}, 2u),
+                      std::runtime_error);
+    const size_t dataset = output.createDataset("frames", {4u}, 2u);
+    BOOST_CHECK_THROW(output.createDataset("frames", {4u}, 2u),
+                      std::runtime_error);
+    BOOST_CHECK_THROW(output.beginFrame(dataset, 2u), std::runtime_error);
+    BOOST_CHECK_THROW(output.setAttribute("missing", "name", "value"),
+                      std::runtime_error);
+    std::remove(fileName.c_str());
+}
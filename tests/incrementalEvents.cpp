@@ -0,0 +1,140 @@
+/* Copyright (c) 2017, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim
+ * <https://bbpcode.epfl.ch/browse/code/viz/EMSim/>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <cmath>
+
+#include <emSim/Kernels.h>
+#include <emSim/Events.h>
+#include <emSim/IncrementalEvents.h>
+#include <emSim/Volume.h>
+
+#define BOOST_TEST_MODULE incrementalEvents
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+const size_t nEvents = 1000u;
+
+ems::Events createEvents(const size_t nFrames)
+{
+    ems::Events events(nEvents, nFrames);
+    for (size_t i = 0; i < nEvents; ++i)
+    {
+        events.addEvent(glm::vec3(float(i % 10) * 40.0f - 200.0f,
+                                  float((i / 10) % 10) * 40.0f - 200.0f,
+                                  float(i / 100) * 40.0f - 200.0f),
+                        2.0f);
+        for (size_t j = 0; j < nFrames; ++j)
+            events.getPowers(j)[i] = std::sin(0.1f * i + 0.05f * j * (i % 7));
+    }
+    return events;
+}
+
+void computeLFP(const ems::IncrementalEvents& events, ems::Volume& volume)
+{
+    const auto compute = events.isFullRefresh() ? ems::kernels::computeVolume
+                                                : ems::kernels::accumulateVolume;
+    compute(events.getPositionsX(), events.getPositionsY(),
+            events.getPositionsZ(), events.getRadii(), events.getPowers(),
+            events.getEventsCount(), volume.getData(), volume.getSize().x,
+            volume.getSize().y, volume.getSize().z, volume.getVoxelSize().x,
+            volume.getVoxelSize().y, volume.getVoxelSize().z,
+            volume.getOrigin().x, volume.getOrigin().y, volume.getOrigin().z);
+}
+}
+
+BOOST_AUTO_TEST_CASE(selection)
+{
+    ems::Events events = createEvents(4u);
+    ems::IncrementalEvents incremental(events, 0.1f, 3u);
+
+    incremental.update(events, 0u);
+    BOOST_CHECK(incremental.isFullRefresh());
+    BOOST_CHECK_EQUAL(incremental.getEventsCount(), nEvents);
+    BOOST_CHECK_EQUAL(incremental.getPowers(), events.getPowers(0u));
+
+    // Only two events change by more than the threshold
+    std::copy(events.getPowers(0u), events.getPowers(0u) + nEvents,
+              events.getPowers(1u));
+    events.getPowers(1u)[10] += 0.5f;
+    events.getPowers(1u)[20] -= 0.05f;
+    events.getPowers(1u)[30] -= 0.2f;
+    incremental.update(events, 1u);
+    BOOST_CHECK(!incremental.isFullRefresh());
+    BOOST_CHECK_EQUAL(incremental.getEventsCount(), 2u);
+    BOOST_CHECK_CLOSE(incremental.getPowers()[0], 0.5f, 1e-3f);
+    BOOST_CHECK_CLOSE(incremental.getPowers()[1], -0.2f, 1e-3f);
+    BOOST_CHECK_EQUAL(incremental.getPositionsX()[1],
+                      events.getPositionsX()[30]);
+    BOOST_CHECK_CLOSE(incremental.getSelectedRatio(), 0.002f, 1e-3f);
+
+    // The changes below the threshold accumulate until they are selected
+    std::copy(events.getPowers(1u), events.getPowers(1u) + nEvents,
+              events.getPowers(2u));
+    events.getPowers(2u)[20] -= 0.1f;
+    incremental.update(events, 2u);
+    BOOST_CHECK_EQUAL(incremental.getEventsCount(), 1u);
+    BOOST_CHECK_CLOSE(incremental.getPowers()[0], -0.15f, 1e-3f);
+
+    incremental.update(events, 3u);
+    BOOST_CHECK(incremental.isFullRefresh());
+    BOOST_CHECK_EQUAL(incremental.getEventsCount(), nEvents);
+}
+
+BOOST_AUTO_TEST_CASE(incrementalVolume)
+{
+    const size_t nFrames = 10u;
+    const ems::Events events = createEvents(nFrames);
+
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(-200.0f), 0.0f);
+    aabb.add(glm::vec3(200.0f), 0.0f);
+    ems::Volume volume(glm::vec3(20.0f), glm::vec3(0.0f), aabb);
+    ems::Volume reference(glm::vec3(20.0f), glm::vec3(0.0f), aabb);
+
+    ems::IncrementalEvents incremental(events, 0.0f, 0u);
+    for (size_t i = 0; i < nFrames; ++i)
+    {
+        incremental.update(events, i);
+        computeLFP(incremental, volume);
+    }
+
+    ems::kernels::computeVolume(events.getPositionsX(), events.getPositionsY(),
+                                events.getPositionsZ(), events.getRadii(),
+                                events.getPowers(nFrames - 1), nEvents,
+                                reference.getData(), reference.getSize().x,
+                                reference.getSize().y, reference.getSize().z,
+                                reference.getVoxelSize().x,
+                                reference.getVoxelSize().y,
+                                reference.getVoxelSize().z,
+                                reference.getOrigin().x, reference.getOrigin().y,
+                                reference.getOrigin().z);
+
+    const glm::uvec3& size = volume.getSize();
+    float maxValue = 0.0f;
+    float maxError = 0.0f;
+    for (size_t i = 0; i < size_t(size.x) * size.y * size.z; ++i)
+    {
+        maxValue = std::max(maxValue, std::abs(reference.getData()[i]));
+        maxError = std::max(maxError, std::abs(volume.getData()[i] -
+                                               reference.getData()[i]));
+    }
+    BOOST_CHECK_SMALL(maxError, maxValue * 1e-4f);
+}
@@ -0,0 +1,245 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include <emSim/Events.h>
+#include <emSim/Kernels.h>
+#include <emSim/SimdKernels.h>
+
+#define BOOST_TEST_MODULE kernels
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+// Sizes which are not multiples of the SIMD widths nor of the blocking
+const size_t nEvents = 1037u;
+const size_t nFrames = 3u;
+const uint32_t sizeX = 13u;
+const uint32_t sizeY = 7u;
+const uint32_t sizeZ = 5u;
+const size_t nVoxels = sizeX * sizeY * sizeZ;
+const uint32_t nSamplePoints = 37u;
+const float voxelSize = 40.0f;
+const float origin = -250.0f;
+
+ems::Events createEvents()
+{
+    ems::Events events(nEvents, nFrames);
+    for (size_t i = 0; i < nEvents; ++i)
+    {
+        events.addEvent(glm::vec3(float((i * 37) % 500) - 250.0f,
+                                  float((i * 53) % 300) - 150.0f,
+                                  float((i * 71) % 200) - 100.0f),
+                        1.0f + float(i % 5));
+        for (size_t j = 0; j < nFrames; ++j)
+            events.getPowers(j)[i] = std::sin(float(i + 7 * j));
+    }
+    return events;
+}
+
+struct SamplePoints
+{
+    SamplePoints()
+    {
+        for (size_t i = 0; i < nSamplePoints; ++i)
+        {
+            x.push_back(float((i * 31) % 400) - 200.0f);
+            y.push_back(float((i * 17) % 300) - 150.0f);
+            z.push_back(float((i * 13) % 200) - 100.0f);
+        }
+    }
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+};
+
+// The order of the summations differs between the widths
+void checkClose(const std::vector<float>& values,
+                const std::vector<float>& reference)
+{
+    BOOST_REQUIRE_EQUAL(values.size(), reference.size());
+    float maxValue = 0.0f;
+    for (const float value : reference)
+        maxValue = std::max(maxValue, std::abs(value));
+    for (size_t i = 0; i < values.size(); ++i)
+        BOOST_CHECK_SMALL(values[i] - reference[i], maxValue * 1e-5f);
+}
+
+template <size_t W>
+std::vector<float> computeVolume(const ems::Events& events, const bool tiles)
+{
+    std::vector<float> volume(nVoxels, 1.0f);
+    if (tiles)
+        ems::simd::computeVolumeTiles<W>(
+            events.getPositionsX(), events.getPositionsY(),
+            events.getPositionsZ(), events.getRadii(), events.getPowers(),
+            nEvents, volume.data(), sizeX, sizeY, sizeZ, voxelSize, voxelSize,
+            voxelSize, origin, origin, origin, 4u, 3u, 2u, 100u, true);
+    else
+        ems::simd::computeVolume<W>(
+            events.getPositionsX(), events.getPositionsY(),
+            events.getPositionsZ(), events.getRadii(), events.getPowers(),
+            nEvents, volume.data(), sizeX, sizeY, sizeZ, voxelSize, voxelSize,
+            voxelSize, origin, origin, origin, false);
+    return volume;
+}
+
+template <size_t W>
+std::vector<float> computeVolumeFrames(const ems::Events& events)
+{
+    std::vector<float> volumes(nFrames * nVoxels);
+    std::vector<float*> volumesData;
+    for (size_t j = 0; j < nFrames; ++j)
+        volumesData.push_back(volumes.data() + j * nVoxels);
+    ems::simd::computeVolumeFrames<W>(
+        events.getPositionsX(), events.getPositionsY(), events.getPositionsZ(),
+        events.getRadii(), events.getPowers(), nEvents,
+        events.getPaddedEventsCount(), nFrames, volumesData.data(), sizeX,
+        sizeY, sizeZ, voxelSize, voxelSize, voxelSize, origin, origin, origin);
+    return volumes;
+}
+
+template <size_t W>
+std::vector<float> computeSamplePoints(const ems::Events& events)
+{
+    const SamplePoints points;
+    std::vector<float> values(nFrames * nSamplePoints);
+    for (size_t j = 0; j < nFrames; ++j)
+        ems::simd::computeSamplePoints<W>(
+            events.getPositionsX(), events.getPositionsY(),
+            events.getPositionsZ(), events.getRadii(), events.getPowers(j),
+            nEvents, j, points.x.data(), points.y.data(), points.z.data(),
+            values.data(), nSamplePoints);
+    return values;
+}
+
+template <size_t W>
+std::vector<float> computeTransferMatrix(const ems::Events& events)
+{
+    const SamplePoints points;
+    std::vector<float> matrix(nSamplePoints * nEvents);
+    ems::simd::computeTransferMatrix<W>(
+        events.getPositionsX(), events.getPositionsY(), events.getPositionsZ(),
+        events.getRadii(), nEvents, points.x.data(), points.y.data(),
+        points.z.data(), nSamplePoints, matrix.data());
+    return matrix;
+}
+
+template <size_t W>
+std::vector<float> applyTransferMatrix(const ems::Events& events)
+{
+    const std::vector<float> matrix = computeTransferMatrix<1>(events);
+    std::vector<float> values(nFrames * nSamplePoints);
+    ems::simd::applyTransferMatrix<W>(matrix.data(), nSamplePoints, nEvents,
+                                      events.getPowers(),
+                                      events.getPaddedEventsCount(), nFrames,
+                                      values.data());
+    return values;
+}
+
+std::vector<ems::KernelsBackend> getBackends()
+{
+    std::vector<ems::KernelsBackend> backends{ems::KernelsBackend::cpp};
+    if (ems::hasISPCKernels())
+        backends.push_back(ems::KernelsBackend::ispc);
+    return backends;
+}
+}
+
+BOOST_AUTO_TEST_CASE(simdWidths)
+{
+    const ems::Events events = createEvents();
+    const size_t W = ems::simd::nativeWidth;
+
+    checkClose(computeVolume<W>(events, false), computeVolume<1>(events, false));
+    checkClose(computeVolume<W>(events, true), computeVolume<1>(events, true));
+    checkClose(computeVolumeFrames<W>(events), computeVolumeFrames<1>(events));
+    checkClose(computeSamplePoints<W>(events), computeSamplePoints<1>(events));
+    checkClose(computeTransferMatrix<W>(events),
+               computeTransferMatrix<1>(events));
+    checkClose(applyTransferMatrix<W>(events), applyTransferMatrix<1>(events));
+}
+
+BOOST_AUTO_TEST_CASE(scalarReference)
+{
+    const ems::Events events = createEvents();
+
+    std::vector<float> reference;
+    for (size_t z = 0; z < sizeZ; ++z)
+        for (size_t y = 0; y < sizeY; ++y)
+            for (size_t x = 0; x < sizeX; ++x)
+            {
+                const glm::vec3 pos =
+                    glm::vec3(origin) + glm::vec3(x, y, z) * voxelSize;
+                double value = 0.0;
+                for (size_t i = 0; i < nEvents; ++i)
+                    value += events.getPowers()[i] /
+                             std::max(glm::length(pos - events.getPosition(i)),
+                                      events.getRadii()[i]);
+                reference.push_back(281704.249f * value);
+            }
+    checkClose(computeVolume<1>(events, false), reference);
+}
+
+BOOST_AUTO_TEST_CASE(backends)
+{
+    const ems::Events events = createEvents();
+    const SamplePoints points;
+    const std::vector<float> referenceVolume = computeVolume<1>(events, false);
+    const std::vector<float> referenceValues = computeSamplePoints<1>(events);
+
+    for (const auto backend : getBackends())
+    {
+        ems::setKernelsBackend(backend);
+        BOOST_CHECK(ems::getKernelsBackend() == backend);
+
+        std::vector<float> volume(nVoxels);
+        ems::kernels::computeVolume(
+            events.getPositionsX(), events.getPositionsY(),
+            events.getPositionsZ(), events.getRadii(), events.getPowers(),
+            nEvents, volume.data(), sizeX, sizeY, sizeZ, voxelSize, voxelSize,
+            voxelSize, origin, origin, origin);
+        checkClose(volume, referenceVolume);
+
+        std::vector<float> values(nFrames * nSamplePoints);
+        for (size_t j = 0; j < nFrames; ++j)
+            ems::kernels::computeSamplePoints(
+                events.getPositionsX(), events.getPositionsY(),
+                events.getPositionsZ(), events.getRadii(), events.getPowers(j),
+                nEvents, j, points.x.data(), points.y.data(), points.z.data(),
+                values.data(), nSamplePoints);
+        checkClose(values, referenceValues);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(backendErrors)
+{
+    BOOST_CHECK(ems::parseKernelsBackend("cpp") == ems::KernelsBackend::cpp);
+    BOOST_CHECK(ems::parseKernelsBackend("ispc") == ems::KernelsBackend::ispc);
+    BOOST_CHECK_THROW(ems::parseKernelsBackend("cuda"), std::runtime_error);
+
+    if (ems::hasISPCKernels())
+        BOOST_CHECK_NO_THROW(ems::setKernelsBackend(ems::KernelsBackend::ispc));
+    else
+        BOOST_CHECK_THROW(ems::setKernelsBackend(ems::KernelsBackend::ispc),
+                          std::runtime_error);
+    BOOST_CHECK_NO_THROW(ems::setKernelsBackend(ems::KernelsBackend::cpp));
+}
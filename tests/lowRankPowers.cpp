@@ -0,0 +1,118 @@
+/* Copyright (c) 2017, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim
+ * <https://bbpcode.epfl.ch/browse/code/viz/EMSim/>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <cmath>
+
+#include <emSim/LowRankPowers.h>
+
+#define BOOST_TEST_MODULE lowRankPowers
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+const size_t nEvents = 5000u;
+const size_t nFrames = 200u;
+
+// Sum of three separable spatio-temporal patterns of decreasing amplitude
+float getPower(const size_t event, const size_t frame)
+{
+    return 10.0f * std::sin(0.01f * event) * std::cos(0.05f * frame) +
+           3.0f * std::cos(0.003f * event) * std::sin(0.11f * frame) +
+           1.0f * std::sin(0.07f * event + 1.0f) * std::exp(-0.01f * frame);
+}
+
+void loadFrame(const size_t frame, float* powers)
+{
+    for (size_t i = 0; i < nEvents; ++i)
+        powers[i] = getPower(i, frame);
+}
+
+float computeRelativeError(const ems::LowRankPowers& lowRank)
+{
+    std::vector<float> powers(nEvents);
+    std::vector<const float*> basis;
+    for (size_t k = 0; k < lowRank.getRank(); ++k)
+        basis.push_back(lowRank.getBasis(k));
+    double squaredError = 0.0;
+    double squaredNorm = 0.0;
+    for (size_t t = 0; t < nFrames; ++t)
+    {
+        lowRank.reconstruct(basis, nEvents, t, powers.data());
+        for (size_t i = 0; i < nEvents; ++i)
+        {
+            const double power = getPower(i, t);
+            squaredError += (powers[i] - power) * (powers[i] - power);
+            squaredNorm += power * power;
+        }
+    }
+    return std::sqrt(squaredError / squaredNorm);
+}
+}
+
+BOOST_AUTO_TEST_CASE(exactRank)
+{
+    const ems::LowRankPowers lowRank(nEvents, nFrames, 10u, 5u, loadFrame);
+
+    BOOST_CHECK_EQUAL(lowRank.getRank(), 3u);
+    BOOST_CHECK_EQUAL(lowRank.getFramesCount(), nFrames);
+    BOOST_CHECK_SMALL(lowRank.getRelativeError(), 1e-3f);
+    BOOST_CHECK_SMALL(computeRelativeError(lowRank), 1e-4f);
+}
+
+BOOST_AUTO_TEST_CASE(truncatedRank)
+{
+    const ems::LowRankPowers lowRank(nEvents, nFrames, 2u, 5u, loadFrame);
+    BOOST_CHECK_EQUAL(lowRank.getRank(), 2u);
+
+    // The reported error matches the error of the reconstruction and is
+    // dominated by the smallest pattern.
+    const float error = computeRelativeError(lowRank);
+    BOOST_CHECK_CLOSE(lowRank.getRelativeError(), error, 1.0f);
+    BOOST_CHECK_GT(error, 0.01f);
+    BOOST_CHECK_LT(error, 0.2f);
+}
+
+BOOST_AUTO_TEST_CASE(reconstructOutputs)
+{
+    const ems::LowRankPowers lowRank(nEvents, nFrames, 3u, 5u, loadFrame);
+
+    // Any linear output of the powers is reconstructed the same way, here
+    // the sum of the powers of every group of 100 events.
+    const size_t nGroups = nEvents / 100u;
+    std::vector<float> basisValues(lowRank.getRank() * nGroups, 0.0f);
+    for (size_t k = 0; k < lowRank.getRank(); ++k)
+        for (size_t i = 0; i < nEvents; ++i)
+            basisValues[k * nGroups + i / 100] += lowRank.getBasis(k)[i];
+
+    std::vector<const float*> basis;
+    for (size_t k = 0; k < lowRank.getRank(); ++k)
+        basis.push_back(basisValues.data() + k * nGroups);
+
+    std::vector<float> values(nGroups);
+    const size_t frame = 42u;
+    lowRank.reconstruct(basis, nGroups, frame, values.data());
+    for (size_t g = 0; g < nGroups; ++g)
+    {
+        float expected = 0.0f;
+        for (size_t i = g * 100; i < (g + 1) * 100; ++i)
+            expected += getPower(i, frame);
+        BOOST_CHECK_SMALL(values[g] - expected, 1e-2f);
+    }
+}
@@ -0,0 +1,130 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include <emSim/MappedStack.h>
+#include <emSim/Volume.h>
+
+#define BOOST_TEST_MODULE mappedStack
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+std::string readFile(const std::string& fileName)
+{
+    std::ifstream input(fileName, std::ios::in | std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(input),
+                       std::istreambuf_iterator<char>());
+}
+}
+
+BOOST_AUTO_TEST_CASE(imageStack)
+{
+    const size_t nFrames = 5u;
+    {
+        ems::MappedStack stack("mappedStack", {7u, 3u}, {2.0f, 4.0f}, nFrames,
+                               1.5f, 0.1f);
+        BOOST_CHECK_EQUAL(stack.getFrameValuesCount(), 21u);
+        BOOST_CHECK_EQUAL(stack.getFramesCount(), nFrames);
+        BOOST_CHECK_EQUAL(stack.getRawFileName(), "mappedStack.raw");
+
+        // The frames are written in any order
+        for (size_t i = nFrames; i-- > 0;)
+        {
+            std::vector<float> image(21u);
+            for (size_t j = 0; j < image.size(); ++j)
+                image[j] = float(i * 100 + j);
+            stack.writeFrame(i, image.data());
+        }
+        BOOST_CHECK_THROW(stack.getFrame(nFrames), std::runtime_error);
+        stack.flush();
+    }
+
+    const std::string raw = readFile("mappedStack.raw");
+    BOOST_REQUIRE_EQUAL(raw.size(), nFrames * 21u * sizeof(float));
+    const float* values = (const float*)raw.data();
+    for (size_t i = 0; i < nFrames * 21u; ++i)
+        BOOST_CHECK_EQUAL(values[i], float(i / 21u * 100 + i % 21u));
+
+    const std::string header = readFile("mappedStack.mhd");
+    BOOST_CHECK(header.find("NDims = 3\n") != std::string::npos);
+    BOOST_CHECK(header.find("TransformMatrix = 1 0 0 0 1 0 0 0 1\n") !=
+                std::string::npos);
+    BOOST_CHECK(header.find("Offset = 0 0 1.5\n") != std::string::npos);
+    BOOST_CHECK(header.find("ElementSpacing = 2 4 0.1\n") !=
+                std::string::npos);
+    BOOST_CHECK(header.find("DimSize = 7 3 5\n") != std::string::npos);
+    BOOST_CHECK(header.find("ElementDataFile = mappedStack.raw\n") !=
+                std::string::npos);
+    std::remove("mappedStack.raw");
+    std::remove("mappedStack.mhd");
+
+    BOOST_CHECK_THROW(ems::MappedStack("mappedStack", {7u, 3u}, {2.0f},
+                                       nFrames, 0.0f, 0.1f),
+                      std::runtime_error);
+    BOOST_CHECK_THROW(ems::MappedStack("missing/mappedStack", {7u}, {2.0f},
+                                       nFrames, 0.0f, 0.1f),
+                      std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(volumeStack)
+{
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(0.0f), 0.0f);
+    aabb.add(glm::vec3(100.0f, 60.0f, 40.0f), 0.0f);
+    for (const auto precision : {ems::Precision::fp32, ems::Precision::bf16})
+    {
+        ems::Volume volume(glm::vec3(4.0f), glm::vec3(0.0f), aabb, precision);
+        const glm::uvec3& size = volume.getSize();
+        const size_t nVoxels = size_t(size.x) * size.y * size.z;
+        {
+            std::unique_ptr<ems::MappedStack> stack = volume.createStack(
+                0.0f, 0.1f, 3u, "mA", "mappedStack", "config", "report",
+                "target");
+            for (size_t i = 0; i < 3; ++i)
+            {
+                volume.clear(float(i) + 0.5f);
+                volume.writeToStack(*stack, i);
+            }
+            stack->flush();
+
+            ems::Volume other(glm::vec3(8.0f), glm::vec3(0.0f), aabb);
+            BOOST_CHECK_THROW(other.writeToStack(*stack, 0),
+                              std::runtime_error);
+        }
+
+        const std::string raw = readFile("mappedStack_volume_floats.raw");
+        BOOST_REQUIRE_EQUAL(raw.size(), 3u * nVoxels * sizeof(float));
+        const float* values = (const float*)raw.data();
+        for (size_t i = 0; i < 3u * nVoxels; i += 97)
+            BOOST_CHECK_EQUAL(values[i], float(i / nVoxels) + 0.5f);
+
+        const std::string header = readFile("mappedStack_volume_floats.mhd");
+        BOOST_CHECK(header.find("NDims = 4\n") != std::string::npos);
+        BOOST_CHECK(header.find("DimSize = 25 15 10 3\n") !=
+                    std::string::npos);
+        BOOST_CHECK(readFile("mappedStack_volume_info.txt")
+                        .find("# - Units: mV\n") != std::string::npos);
+        std::remove("mappedStack_volume_floats.raw");
+        std::remove("mappedStack_volume_floats.mhd");
+        std::remove("mappedStack_volume_info.txt");
+    }
+}
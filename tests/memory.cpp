@@ -0,0 +1,173 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <emSim/Memory.h>
+#include <emSim/Volume.h>
+#include <emSim/helpers.h>
+
+#define BOOST_TEST_MODULE memory
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+// Several huge pages and not a multiple of one
+const size_t largeCount = (5u << 20) + 7u;
+
+void checkBuffer(const ems::HugePages hugePages)
+{
+    ems::MemoryConfig config;
+    config.hugePages = hugePages;
+    ems::setMemoryConfig(config);
+
+    const ems::MemoryStats before = ems::getMemoryStats();
+    {
+        ems::AlignedFloatPtr data(ems::alignedMalloc<float>(largeCount));
+        BOOST_CHECK_EQUAL(uintptr_t(data.get()) % ems::alignment, 0u);
+
+        ems::fillMemory(data.get(), largeCount, 2.5f);
+        for (size_t i = 0; i < largeCount; i += 4097u)
+            BOOST_CHECK_EQUAL(data[i], 2.5f);
+        BOOST_CHECK_EQUAL(data[largeCount - 1], 2.5f);
+
+        const ems::MemoryStats stats = ems::getMemoryStats();
+        const size_t bytes = largeCount * sizeof(float);
+        // The reserved huge pages are mapped whole
+        const size_t hugePageSize = 2u << 20;
+        const size_t allocatedBytes =
+            stats.hugetlbBytes > before.hugetlbBytes
+                ? (bytes + hugePageSize - 1) / hugePageSize * hugePageSize
+                : bytes;
+        BOOST_CHECK_EQUAL(stats.allocatedBytes,
+                          before.allocatedBytes + allocatedBytes);
+        const size_t hugeBytes = (stats.transparentBytes + stats.hugetlbBytes) -
+                                 (before.transparentBytes + before.hugetlbBytes);
+        BOOST_CHECK_EQUAL(hugeBytes, hugePages == ems::HugePages::none
+                                         ? 0u
+                                         : allocatedBytes);
+
+        // Every page has been touched
+        const ems::MemoryPlacement placement =
+            ems::getMemoryPlacement(data.get(), bytes);
+        size_t total = placement.unknownBytes;
+        for (const size_t node : placement.nodeBytes)
+            total += node;
+        BOOST_CHECK_EQUAL(total, bytes);
+        BOOST_CHECK_LE(placement.hugePageBytes, bytes);
+        BOOST_CHECK(!placement.getDescription().empty());
+    }
+    BOOST_CHECK_EQUAL(ems::getMemoryStats().allocatedBytes,
+                      before.allocatedBytes);
+    ems::setMemoryConfig(ems::MemoryConfig());
+}
+}
+
+BOOST_AUTO_TEST_CASE(regularPages)
+{
+    checkBuffer(ems::HugePages::none);
+}
+
+BOOST_AUTO_TEST_CASE(transparentHugePages)
+{
+    checkBuffer(ems::HugePages::transparent);
+}
+
+// Without reserved huge pages the allocation falls back to transparent ones
+BOOST_AUTO_TEST_CASE(hugetlbPages)
+{
+    const size_t fallbacks = ems::getMemoryStats().hugetlbFallbacks;
+    checkBuffer(ems::HugePages::hugetlb);
+    BOOST_CHECK_LE(ems::getMemoryStats().hugetlbFallbacks, fallbacks + 1u);
+}
+
+BOOST_AUTO_TEST_CASE(smallBuffers)
+{
+    ems::MemoryConfig config;
+    config.hugePages = ems::HugePages::hugetlb;
+    ems::setMemoryConfig(config);
+
+    // Smaller than a huge page, never backed by one
+    const ems::MemoryStats before = ems::getMemoryStats();
+    ems::AlignedFloatPtr data(ems::alignedMalloc<float>(1000u));
+    ems::AlignedFloatPtr empty(ems::alignedMalloc<float>(0u));
+    const ems::MemoryStats stats = ems::getMemoryStats();
+    BOOST_CHECK_EQUAL(stats.transparentBytes, before.transparentBytes);
+    BOOST_CHECK_EQUAL(stats.hugetlbBytes, before.hugetlbBytes);
+    BOOST_CHECK(empty);
+
+    ems::fillMemory(data.get(), 1000u, -1.0f);
+    BOOST_CHECK_EQUAL(data[999], -1.0f);
+    ems::setMemoryConfig(ems::MemoryConfig());
+}
+
+BOOST_AUTO_TEST_CASE(serialFirstTouch)
+{
+    ems::MemoryConfig config;
+    config.parallelFirstTouch = false;
+    ems::setMemoryConfig(config);
+
+    ems::AlignedFloatPtr data(ems::alignedMalloc<float>(largeCount));
+    ems::fillMemory(data.get(), largeCount, 3.0f);
+    BOOST_CHECK_EQUAL(data[0], 3.0f);
+    BOOST_CHECK_EQUAL(data[largeCount - 1], 3.0f);
+    ems::setMemoryConfig(ems::MemoryConfig());
+}
+
+BOOST_AUTO_TEST_CASE(volumeClear)
+{
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(0.0f), 0.0f);
+    aabb.add(glm::vec3(100.0f), 0.0f);
+    ems::Volume volume(glm::vec3(10.0f), glm::vec3(0.0f), aabb);
+    const glm::uvec3& size = volume.getSize();
+    const size_t count = size_t(size.x) * size.y * size.z;
+
+    for (size_t i = 0; i < count; ++i)
+        BOOST_CHECK_EQUAL(volume.getData()[i], 0.0f);
+    volume.clear(1.5f);
+    for (size_t i = 0; i < count; ++i)
+        BOOST_CHECK_EQUAL(volume.getData()[i], 1.5f);
+}
+
+BOOST_AUTO_TEST_CASE(configuration)
+{
+    BOOST_CHECK(ems::parseHugePages("none") == ems::HugePages::none);
+    BOOST_CHECK(ems::parseHugePages("transparent") ==
+                ems::HugePages::transparent);
+    BOOST_CHECK(ems::parseHugePages("hugetlb") == ems::HugePages::hugetlb);
+    BOOST_CHECK_THROW(ems::parseHugePages("1GB"), std::runtime_error);
+
+    setenv("EMSIM_HUGE_PAGES", "transparent", 1);
+    setenv("EMSIM_FIRST_TOUCH", "0", 1);
+    ems::MemoryConfig config = ems::MemoryConfig::fromEnvironment();
+    BOOST_CHECK(config.hugePages == ems::HugePages::transparent);
+    BOOST_CHECK(!config.parallelFirstTouch);
+
+    setenv("EMSIM_FIRST_TOUCH", "no", 1);
+    BOOST_CHECK_THROW(ems::MemoryConfig::fromEnvironment(),
+                      std::runtime_error);
+
+    unsetenv("EMSIM_HUGE_PAGES");
+    unsetenv("EMSIM_FIRST_TOUCH");
+    config = ems::MemoryConfig::fromEnvironment();
+    BOOST_CHECK(config.hugePages == ems::HugePages::none);
+    BOOST_CHECK(config.parallelFirstTouch);
+}
@@ -0,0 +1,131 @@
+/* Copyright (c) 2017, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim
+ * <https://bbpcode.epfl.ch/browse/code/viz/EMSim/>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <cmath>
+
+#include <emSim/Events.h>
+#include <emSim/Octree.h>
+#include <emSim/Volume.h>
+
+#define BOOST_TEST_MODULE octree
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+// Small neuron-like clusters of events whose currents sum to zero
+ems::Events createEvents()
+{
+    const size_t nClusters = 64u;
+    const size_t eventsPerCluster = 32u;
+    ems::Events events(nClusters * eventsPerCluster);
+
+    for (size_t i = 0; i < nClusters; ++i)
+    {
+        const glm::vec3 soma(float(i % 4) * 200.0f - 300.0f,
+                             float((i / 4) % 4) * 200.0f - 300.0f,
+                             float(i / 16) * 200.0f - 300.0f);
+        for (size_t j = 0; j < eventsPerCluster; ++j)
+        {
+            const float t = float(j) / eventsPerCluster;
+            const glm::vec3 pos = soma + glm::vec3(20.0f * std::cos(7.0f * t),
+                                                   100.0f * t,
+                                                   20.0f * std::sin(5.0f * t));
+            events.addEvent(pos, 1.0f);
+            events.getPowers()[i * eventsPerCluster + j] =
+                j == 0 ? -float(eventsPerCluster - 1) : 1.0f;
+        }
+    }
+    return events;
+}
+}
+
+BOOST_AUTO_TEST_CASE(exactWithoutOpening)
+{
+    const ems::Events events = createEvents();
+    ems::Octree octree(events, 0.0f, false, 8u);
+    octree.update(events);
+
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(-400.0f), 0.0f);
+    aabb.add(glm::vec3(400.0f), 0.0f);
+    ems::Volume volume(glm::vec3(50.0f), glm::vec3(0.0f), aabb);
+
+    const ems::Octree::Stats stats = octree.computeVolume(volume);
+    BOOST_CHECK_EQUAL(stats.approximatedInteractions, 0u);
+    BOOST_CHECK_CLOSE(stats.getWorkRatio(), 1.0, 1e-6);
+
+    const ems::Octree::Error error = octree.estimateError(volume, 1000u);
+    BOOST_CHECK_SMALL(error.maxError, error.rmsValue * 1e-4f);
+}
+
+BOOST_AUTO_TEST_CASE(approximation)
+{
+    const ems::Events events = createEvents();
+
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(-400.0f), 0.0f);
+    aabb.add(glm::vec3(400.0f), 0.0f);
+    ems::Volume monopoles(glm::vec3(50.0f), glm::vec3(0.0f), aabb);
+    ems::Volume dipoles(glm::vec3(50.0f), glm::vec3(0.0f), aabb);
+
+    ems::Octree monopoleTree(events, 0.5f, false, 8u);
+    monopoleTree.update(events);
+    const ems::Octree::Stats stats = monopoleTree.computeVolume(monopoles);
+    BOOST_CHECK_GT(stats.approximatedInteractions, 0u);
+    BOOST_CHECK_LT(stats.getWorkRatio(), 0.5);
+
+    ems::Octree dipoleTree(events, 0.5f, true, 8u);
+    dipoleTree.update(events);
+    dipoleTree.computeVolume(dipoles);
+
+    const ems::Octree::Error monopoleError =
+        monopoleTree.estimateError(monopoles, 1000u);
+    const ems::Octree::Error dipoleError =
+        dipoleTree.estimateError(dipoles, 1000u);
+    // The clusters' currents sum to zero, their far field is a dipole
+    BOOST_CHECK_LT(dipoleError.rmsError, 0.1f * dipoleError.rmsValue);
+    BOOST_CHECK_LT(dipoleError.rmsError, 0.2f * monopoleError.rmsError);
+
+    // Sample points use the same traversal, a smaller opening angle is more
+    // accurate
+    ems::Octree accurateTree(events, 0.2f, true, 8u);
+    accurateTree.update(events);
+    const float positionsX[] = {0.0f, 150.0f};
+    const float positionsY[] = {0.0f, -20.0f};
+    const float positionsZ[] = {0.0f, 35.0f};
+    std::vector<float> values(2);
+    dipoleTree.computeValues(positionsX, positionsY, positionsZ, 2u,
+                             values.data());
+    const ems::Octree::Error pointsError = dipoleTree.estimateError(
+        positionsX, positionsY, positionsZ, 2u, values.data());
+    accurateTree.computeValues(positionsX, positionsY, positionsZ, 2u,
+                               values.data());
+    const ems::Octree::Error accuratePointsError = accurateTree.estimateError(
+        positionsX, positionsY, positionsZ, 2u, values.data());
+    BOOST_CHECK_LT(accuratePointsError.maxError, pointsError.maxError);
+    BOOST_CHECK_LT(accuratePointsError.maxError,
+                   0.2f * accuratePointsError.rmsValue);
+
+    // A subset of the positions can not have a larger error
+    const ems::Octree::Error sampledError = accurateTree.estimateError(
+        positionsX, positionsY, positionsZ, 2u, values.data(), 1u);
+    BOOST_CHECK_LE(sampledError.maxError, accuratePointsError.maxError);
+}
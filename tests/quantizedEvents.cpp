@@ -0,0 +1,339 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <emSim/Kernels.h>
+#include <emSim/QuantizedEvents.h>
+#include <emSim/SimdKernels.h>
+#include <emSim/Volume.h>
+
+#define BOOST_TEST_MODULE quantizedEvents
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+// Several blocks of events, the last one partial
+const size_t nCells = 9u;
+const size_t eventsPerCell = 97u;
+const size_t nFrames = 2u;
+
+// Cells spread over the volume, their events loaded one cell after the other
+ems::Events createEvents()
+{
+    ems::Events events(nCells * eventsPerCell, nFrames);
+    for (size_t i = 0; i < nCells; ++i)
+    {
+        const glm::vec3 soma(float(i % 3) * 150.0f - 150.0f,
+                             float(i / 3) * 100.0f - 100.0f,
+                             float(i % 2) * 60.0f - 30.0f);
+        for (size_t j = 0; j < eventsPerCell; ++j)
+        {
+            const float t = float(j) / eventsPerCell;
+            events.addEvent(soma + glm::vec3(20.0f * std::cos(7.0f * t),
+                                             90.0f * t - 45.0f,
+                                             20.0f * std::sin(5.0f * t)),
+                            j == 0 ? 6.0f : 0.5f + 0.1f * (j % 4));
+            for (size_t f = 0; f < nFrames; ++f)
+                events.getPowers(f)[i * eventsPerCell + j] =
+                    1e-3f * std::sin(float(i * eventsPerCell + j + 13 * f));
+        }
+    }
+    return events;
+}
+
+ems::EventsAABB createAABB()
+{
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(-200.0f, -160.0f, -70.0f), 0.0f);
+    aabb.add(glm::vec3(200.0f, 160.0f, 70.0f), 0.0f);
+    return aabb;
+}
+
+const glm::vec3 voxelSize(9.0f, 11.0f, 7.0f);
+
+void computeReference(const ems::Events& events, const size_t frame,
+                      ems::Volume& volume)
+{
+    ems::kernels::computeVolume(
+        events.getPositionsX(), events.getPositionsY(), events.getPositionsZ(),
+        events.getRadii(), events.getPowers(frame), events.getEventsCount(),
+        volume.getData(), volume.getSize().x, volume.getSize().y,
+        volume.getSize().z, volume.getVoxelSize().x, volume.getVoxelSize().y,
+        volume.getVoxelSize().z, volume.getOrigin().x, volume.getOrigin().y,
+        volume.getOrigin().z);
+}
+
+size_t getVoxelCount(const ems::Volume& volume)
+{
+    return size_t(volume.getSize().x) * volume.getSize().y *
+           volume.getSize().z;
+}
+
+// Largest deviation relative to the largest reference value
+float getRelativeError(const ems::Volume& volume,
+                       const ems::Volume& reference)
+{
+    float maxValue = 0.0f;
+    float maxError = 0.0f;
+    for (size_t i = 0; i < getVoxelCount(volume); ++i)
+    {
+        maxValue = std::max(maxValue, std::abs(reference.getValue(i)));
+        maxError = std::max(maxError, std::abs(volume.getValue(i) -
+                                               reference.getValue(i)));
+    }
+    return maxError / maxValue;
+}
+}
+
+BOOST_AUTO_TEST_CASE(halfConversions)
+{
+    BOOST_CHECK_EQUAL(ems::floatToHalf(0.0f), 0x0000u);
+    BOOST_CHECK_EQUAL(ems::floatToHalf(-0.0f), 0x8000u);
+    BOOST_CHECK_EQUAL(ems::floatToHalf(1.0f), 0x3c00u);
+    BOOST_CHECK_EQUAL(ems::floatToHalf(-2.0f), 0xc000u);
+    BOOST_CHECK_EQUAL(ems::floatToHalf(65504.0f), 0x7bffu);
+    BOOST_CHECK_EQUAL(ems::floatToHalf(65519.0f), 0x7bffu);
+    BOOST_CHECK_EQUAL(ems::floatToHalf(65520.0f), 0x7c00u);
+    BOOST_CHECK_EQUAL(ems::floatToHalf(1e10f), 0x7c00u);
+    BOOST_CHECK_EQUAL(
+        ems::floatToHalf(-std::numeric_limits<float>::infinity()), 0xfc00u);
+    BOOST_CHECK(std::isnan(ems::halfToFloat(
+        ems::floatToHalf(std::numeric_limits<float>::quiet_NaN()))));
+    // Smallest subnormal, and ties to even
+    BOOST_CHECK_EQUAL(ems::floatToHalf(std::ldexp(1.0f, -24)), 0x0001u);
+    BOOST_CHECK_EQUAL(ems::floatToHalf(std::ldexp(1.0f, -26)), 0x0000u);
+    BOOST_CHECK_EQUAL(ems::floatToHalf(1.0f + std::ldexp(1.0f, -11)),
+                      0x3c00u);
+    BOOST_CHECK_EQUAL(ems::floatToHalf(1.0f + 3.0f * std::ldexp(1.0f, -11)),
+                      0x3c02u);
+
+    // Every finite value converts back to itself
+    for (uint32_t value = 0; value < 0x10000u; ++value)
+    {
+        if ((value & 0x7c00u) == 0x7c00u)
+            continue;
+        BOOST_REQUIRE_EQUAL(ems::floatToHalf(ems::halfToFloat(value)), value);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(bfloat16Conversions)
+{
+    BOOST_CHECK_EQUAL(ems::floatToBFloat16(1.0f), 0x3f80u);
+    BOOST_CHECK_EQUAL(ems::floatToBFloat16(-2.0f), 0xc000u);
+    BOOST_CHECK_EQUAL(ems::bfloat16ToFloat(0x3f80u), 1.0f);
+    BOOST_CHECK_EQUAL(ems::floatToBFloat16(1.0f + std::ldexp(1.0f, -8)),
+                      0x3f80u);
+    BOOST_CHECK_EQUAL(ems::floatToBFloat16(1.0f + 3.0f * std::ldexp(1.0f, -8)),
+                      0x3f82u);
+    BOOST_CHECK(std::isnan(ems::bfloat16ToFloat(
+        ems::floatToBFloat16(std::numeric_limits<float>::quiet_NaN()))));
+
+    for (uint32_t value = 0; value < 0x10000u; ++value)
+    {
+        if ((value & 0x7f80u) == 0x7f80u)
+            continue;
+        BOOST_REQUIRE_EQUAL(ems::floatToBFloat16(ems::bfloat16ToFloat(value)),
+                            value);
+    }
+
+    std::vector<float> values = {0.5f, -1e-30f, 3e30f, 7.0f};
+    std::vector<uint16_t> encoded(values.size());
+    std::vector<float> decoded(values.size());
+    ems::encodeValues(values.data(), values.size(), ems::Precision::bf16,
+                      encoded.data());
+    ems::decodeValues(encoded.data(), values.size(), ems::Precision::bf16,
+                      decoded.data());
+    for (size_t i = 0; i < values.size(); ++i)
+        BOOST_CHECK_CLOSE(decoded[i], values[i], 0.4);
+}
+
+BOOST_AUTO_TEST_CASE(precisionNames)
+{
+    BOOST_CHECK(ems::parsePrecision("fp32") == ems::Precision::fp32);
+    BOOST_CHECK(ems::parsePrecision("fp16") == ems::Precision::fp16);
+    BOOST_CHECK(ems::parsePrecision("bf16") == ems::Precision::bf16);
+    BOOST_CHECK_THROW(ems::parsePrecision("fp8"), std::runtime_error);
+    BOOST_CHECK_EQUAL(ems::getPrecisionName(ems::Precision::bf16), "bf16");
+}
+
+BOOST_AUTO_TEST_CASE(quantization)
+{
+    const ems::Events events = createEvents();
+    BOOST_CHECK_THROW(ems::QuantizedEvents(events, ems::Precision::fp32),
+                      std::runtime_error);
+
+    ems::QuantizedEvents quantized(events, ems::Precision::fp16);
+    BOOST_CHECK_EQUAL(quantized.getEventsCount(), events.getEventsCount());
+    BOOST_CHECK_EQUAL(quantized.getPaddedEventsCount(),
+                      events.getPaddedEventsCount());
+    // A block spans two cells at most, less than 400 micrometers, quantized
+    // by steps of 400 / 65535
+    BOOST_CHECK_GT(quantized.getPositionError(), 0.0f);
+    BOOST_CHECK_LT(quantized.getPositionError(), 400.0f / 65535.0f);
+
+    quantized.update(events, nFrames);
+    for (size_t f = 0; f < nFrames; ++f)
+    {
+        const float scale = quantized.getPowersScale(f);
+        BOOST_CHECK_EQUAL(std::exp2(std::round(std::log2(scale))), scale);
+        for (size_t i = 0; i < events.getPaddedEventsCount(); ++i)
+        {
+            const float power =
+                ems::halfToFloat(quantized.getPowers(f)[i]) * scale;
+            BOOST_CHECK_SMALL(power - events.getPowers(f)[i],
+                              std::abs(events.getPowers(f)[i]) * 5e-4f +
+                                  1e-12f);
+        }
+    }
+    // Half of the fp32 storage, plus the origins of the blocks
+    BOOST_CHECK_LT(quantized.getDataSize(),
+                   events.getPaddedEventsCount() * (4 + nFrames) *
+                       sizeof(float) * 51 / 100);
+}
+
+BOOST_AUTO_TEST_CASE(quantizedVolume)
+{
+    const ems::Events events = createEvents();
+    const ems::EventsAABB aabb = createAABB();
+
+    for (const auto backend : {ems::KernelsBackend::cpp,
+                               ems::KernelsBackend::ispc})
+    {
+        if (backend == ems::KernelsBackend::ispc && !ems::hasISPCKernels())
+            continue;
+        ems::setKernelsBackend(backend);
+
+        for (const auto powersPrecision :
+             {ems::Precision::fp16, ems::Precision::bf16})
+        {
+            ems::QuantizedEvents quantized(events, powersPrecision);
+            quantized.update(events, nFrames);
+
+            for (size_t f = 0; f < nFrames; ++f)
+            {
+                ems::Volume reference(voxelSize, glm::vec3(0.0f), aabb);
+                computeReference(events, f, reference);
+
+                // fp16 keeps 11 bits of the powers, bf16 8 bits. The voxels
+                // next to an event are also sensitive to its quantized
+                // position.
+                const float tolerance =
+                    powersPrecision == ems::Precision::fp16 ? 5e-3f : 1e-2f;
+                ems::Volume volume(voxelSize, glm::vec3(0.0f), aabb);
+                quantized.computeVolume(volume, f);
+                BOOST_CHECK_LT(getRelativeError(volume, reference), tolerance);
+
+                ems::Volume halfVolume(voxelSize, glm::vec3(0.0f), aabb,
+                                       ems::Precision::fp16);
+                quantized.computeVolume(halfVolume, f);
+                BOOST_CHECK_LT(getRelativeError(halfVolume, reference),
+                               tolerance + 1e-3f);
+
+                const ems::QuantizedEvents::Error error =
+                    quantized.estimateError(events, f, halfVolume, 500u);
+                BOOST_CHECK_GT(error.rmsValue, 0.0f);
+                BOOST_CHECK_LT(error.rmsError, tolerance * error.rmsValue);
+            }
+        }
+    }
+    ems::setKernelsBackend(ems::hasISPCKernels() ? ems::KernelsBackend::ispc
+                                                 : ems::KernelsBackend::cpp);
+}
+
+BOOST_AUTO_TEST_CASE(accumulate)
+{
+    const ems::Events events = createEvents();
+    const ems::EventsAABB aabb = createAABB();
+    ems::QuantizedEvents quantized(events, ems::Precision::fp16);
+    quantized.update(events);
+
+    for (const auto precision : {ems::Precision::fp32, ems::Precision::bf16})
+    {
+        ems::Volume once(voxelSize, glm::vec3(0.0f), aabb, precision);
+        quantized.computeVolume(once);
+        ems::Volume twice(voxelSize, glm::vec3(0.0f), aabb, precision);
+        twice.clear(5.0f);
+        quantized.computeVolume(twice);
+        quantized.computeVolume(twice, 0u, true);
+
+        for (size_t i = 0; i < getVoxelCount(once); i += 7)
+            BOOST_CHECK_SMALL(twice.getValue(i) - 2.0f * once.getValue(i),
+                              std::abs(once.getValue(i)) * 1e-2f + 1e-3f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(simdWidths)
+{
+    const ems::Events events = createEvents();
+    ems::QuantizedEvents quantized(events, ems::Precision::fp16);
+    quantized.update(events);
+
+    const uint32_t sizeX = 37u;
+    const uint32_t sizeY = 6u;
+    const uint32_t sizeZ = 5u;
+    std::vector<float> scalar(sizeX * sizeY * sizeZ);
+    std::vector<float> vector(scalar.size());
+    std::vector<uint16_t> halfScalar(scalar.size());
+    std::vector<uint16_t> halfVector(scalar.size());
+
+    const auto compute = [&](const auto kernel, float* data, uint16_t* half) {
+        kernel(quantized.getPositionsX(), quantized.getPositionsY(),
+               quantized.getPositionsZ(), quantized.getBlocks(),
+               quantized.getRadii(), quantized.getPowers(),
+               uint32_t(ems::Precision::fp16), quantized.getPowersScale(),
+               quantized.getEventsCount(), data, half,
+               uint32_t(data ? ems::Precision::fp32 : ems::Precision::fp16),
+               sizeX, sizeY, sizeZ, 10.0f, 10.0f, 10.0f, -180.0f, -30.0f,
+               -20.0f, false);
+    };
+    compute(ems::simd::computeQuantizedVolume<1>, scalar.data(), nullptr);
+    compute(ems::simd::computeQuantizedVolume<ems::simd::nativeWidth>,
+            vector.data(), nullptr);
+    compute(ems::simd::computeQuantizedVolume<1>, nullptr, halfScalar.data());
+    compute(ems::simd::computeQuantizedVolume<ems::simd::nativeWidth>,
+            nullptr, halfVector.data());
+
+    float maxValue = 0.0f;
+    for (const float value : scalar)
+        maxValue = std::max(maxValue, std::abs(value));
+    for (size_t i = 0; i < scalar.size(); ++i)
+    {
+        BOOST_CHECK_SMALL(vector[i] - scalar[i], maxValue * 1e-5f);
+        BOOST_CHECK_SMALL(ems::halfToFloat(halfVector[i]) -
+                              ems::halfToFloat(halfScalar[i]),
+                          maxValue * 1e-3f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(noEvents)
+{
+    const ems::Events events(0u);
+    ems::QuantizedEvents quantized(events, ems::Precision::bf16);
+    quantized.update(events);
+
+    ems::Volume volume(voxelSize, glm::vec3(0.0f), createAABB(),
+                       ems::Precision::fp16);
+    volume.clear(1.0f);
+    quantized.computeVolume(volume);
+    for (size_t i = 0; i < getVoxelCount(volume); ++i)
+        BOOST_CHECK_EQUAL(volume.getValue(i), 0.0f);
+}
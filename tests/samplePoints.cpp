@@ -19,6 +19,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <algorithm>
 #include <cmath>
 
 #include <emSim/Events.h>
@@ -64,3 +65,95 @@ BOOST_AUTO_TEST_CASE(refineSamplePoints)
     BOOST_CHECK_CLOSE(samplePoints.getValues()[270], -303871.4f, 0.01);
     BOOST_CHECK_CLOSE(samplePoints.getValues()[136], 170521.4f, 0.01);
 }
+
+BOOST_AUTO_TEST_CASE(fewSamplePointsManyEvents)
+{
+    // Few sample points and many events select the event-parallel path of the
+    // kernel, which must match the direct sum.
+    const size_t nTimeSteps = 2u;
+    const size_t nEvents = 100000u;
+    ems::Events events(nEvents);
+
+    for (size_t i = 0; i < nEvents; ++i)
+    {
+        const float angle = 2.0f * M_PI * (float)i / (float)nEvents;
+        const float height = (float)(i % 100) - 50.0f;
+        events.addEvent(glm::vec3(100.0f * std::cos(angle), height,
+                                  100.0f * std::sin(angle)),
+                        1.0f);
+        events.getPowers()[i] = 1.0f + (float)(i % 7) * 0.1f;
+    }
+
+    std::vector<glm::vec3> positions;
+    positions.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
+    positions.push_back(glm::vec3(100.0f, 10.0f, 5.0f));
+
+    ems::SamplePoints samplePoints(nTimeSteps, positions);
+    for (uint32_t i = 0; i < nTimeSteps; ++i)
+        samplePoints.computeNextFrame(events);
+
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        double expected = 0.0;
+        for (size_t j = 0; j < nEvents; ++j)
+        {
+            const glm::vec3 eventPos = events.getPosition(j);
+            const double dist = std::max(glm::length(positions[i] - eventPos),
+                                         events.getRadii()[j]);
+            expected += events.getPowers()[j] / dist;
+        }
+        expected *= 281704.249;
+
+        BOOST_CHECK_CLOSE(samplePoints.getValues()[i], expected, 0.01);
+        BOOST_CHECK_CLOSE(samplePoints.getValues()[positions.size() + i],
+                          expected, 0.01);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(transferMatrix)
+{
+    const size_t nTimeSteps = 91u;
+    const size_t nEvents = 3u;
+    ems::Events events(nEvents);
+
+    events.addEvent(glm::vec3(-0.5f, 0.0f, 0.0f), 0.25f);
+    events.addEvent(glm::vec3(0.5f, 0.0f, 0.0f), 0.25f);
+    events.addEvent(glm::vec3(0.0f, 2.0f, -1.0f), 0.5f);
+
+    std::vector<glm::vec3> positions;
+    positions.push_back(glm::vec3(-1.0f, 0.0f, 0.0f));
+    positions.push_back(glm::vec3(1.0f, 0.0f, 0.0f));
+    positions.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
+    positions.push_back(glm::vec3(-0.5f, 0.0f, 0.0f));
+    positions.push_back(glm::vec3(-0.6f, 0.0f, 0.0f));
+
+    ems::SamplePoints direct(nTimeSteps, positions);
+    ems::SamplePoints full(nTimeSteps, positions);
+    ems::SamplePoints blocked(nTimeSteps, positions);
+
+    // The frame block size does not divide the number of frames and the
+    // second matrix only holds one event at a time.
+    full.useTransferMatrix(8u, 1u << 20);
+    blocked.useTransferMatrix(8u, positions.size() * sizeof(float));
+
+    for (uint32_t i = 0; i < nTimeSteps; ++i)
+    {
+        const float angle = M_PI * (float)i / 180.0f;
+        events.getPowers()[0] = -std::sin(angle);
+        events.getPowers()[1] = std::sin(angle);
+        events.getPowers()[2] = 2.0f + std::cos(angle);
+
+        direct.computeNextFrame(events);
+        full.computeNextFrame(events);
+        blocked.computeNextFrame(events);
+    }
+
+    // Absolute tolerance as some values cross zero, the values are of the
+    // order of 1e6.
+    for (size_t i = 0; i < nTimeSteps * positions.size(); ++i)
+    {
+        BOOST_CHECK_SMALL(full.getValues()[i] - direct.getValues()[i], 10.0f);
+        BOOST_CHECK_SMALL(blocked.getValues()[i] - direct.getValues()[i],
+                          10.0f);
+    }
+}
@@ -0,0 +1,182 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <algorithm>
+#include <cmath>
+
+#include <emSim/Kernels.h>
+#include <emSim/SpatialOrder.h>
+#include <emSim/Volume.h>
+
+#define BOOST_TEST_MODULE spatialOrder
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+const size_t nCells = 50u;
+const size_t eventsPerCell = 40u;
+
+// The cells are given in a scattered order, their events along a random walk
+ems::Events createEvents(ems::CellsEvents& cells, ems::EventsAABB& aabb)
+{
+    ems::Events events(nCells * eventsPerCell, 2u);
+    for (size_t i = 0; i < nCells; ++i)
+    {
+        ems::CellEvents cell;
+        cell.begin = i * eventsPerCell;
+        cell.end = cell.begin + eventsPerCell;
+        cell.soma = glm::vec3(float((i * 37) % 50) * 20.0f - 500.0f,
+                              float((i * 11) % 50) * 20.0f - 500.0f,
+                              float((i * 23) % 50) * 20.0f - 500.0f);
+        cells.push_back(cell);
+
+        for (size_t j = 0; j < eventsPerCell; ++j)
+        {
+            const size_t index = cell.begin + j;
+            const glm::vec3 pos =
+                cell.soma + glm::vec3(std::sin(1.3f * j), std::cos(0.7f * j),
+                                      std::sin(0.3f * j)) *
+                                float(j) * 5.0f;
+            events.addEvent(pos, 1.0f + 0.01f * j);
+            aabb.add(pos, 1.0f + 0.01f * j);
+            events.getPowers(0)[index] = std::sin(0.1f * index);
+            events.getPowers(1)[index] = std::cos(0.2f * index);
+        }
+    }
+    return events;
+}
+
+void computeVolume(const ems::Events& events, ems::Volume& volume)
+{
+    ems::kernels::computeVolume(events.getPositionsX(), events.getPositionsY(),
+                                events.getPositionsZ(), events.getRadii(),
+                                events.getPowers(), events.getEventsCount(),
+                                volume.getData(), volume.getSize().x,
+                                volume.getSize().y, volume.getSize().z,
+                                volume.getVoxelSize().x, volume.getVoxelSize().y,
+                                volume.getVoxelSize().z, volume.getOrigin().x,
+                                volume.getOrigin().y, volume.getOrigin().z);
+}
+}
+
+BOOST_AUTO_TEST_CASE(mortonCode)
+{
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(0.0f), 0.0f);
+    aabb.add(glm::vec3(100.0f), 0.0f);
+
+    BOOST_CHECK_EQUAL(ems::computeMortonCode(glm::vec3(0.0f), aabb), 0u);
+    BOOST_CHECK_EQUAL(ems::computeMortonCode(glm::vec3(100.0f), aabb),
+                      (uint64_t(1) << 63) - 1u);
+    BOOST_CHECK_EQUAL(ems::computeMortonCode(glm::vec3(-10.0f), aabb), 0u);
+
+    // The highest bits of the code are the octant of the position
+    const uint64_t octantX = ems::computeMortonCode(glm::vec3(60, 10, 10), aabb);
+    const uint64_t octantY = ems::computeMortonCode(glm::vec3(10, 60, 10), aabb);
+    const uint64_t octantZ = ems::computeMortonCode(glm::vec3(10, 10, 60), aabb);
+    BOOST_CHECK_EQUAL(octantX >> 60, 1u);
+    BOOST_CHECK_EQUAL(octantY >> 60, 2u);
+    BOOST_CHECK_EQUAL(octantZ >> 60, 4u);
+}
+
+BOOST_AUTO_TEST_CASE(cellsOrder)
+{
+    ems::CellsEvents cells;
+    ems::EventsAABB aabb;
+    const ems::Events events = createEvents(cells, aabb);
+    const ems::CellsEvents reportCells = cells;
+
+    const ems::EventsOrder order =
+        ems::computeSpatialOrder(events, cells, aabb);
+    BOOST_REQUIRE_EQUAL(order.size(), events.getEventsCount());
+    BOOST_REQUIRE_EQUAL(cells.size(), nCells);
+
+    ems::EventsOrder sorted = order;
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < sorted.size(); ++i)
+        BOOST_REQUIRE_EQUAL(sorted[i], i);
+
+    uint32_t begin = 0u;
+    for (size_t i = 0; i < cells.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(cells[i].begin, begin);
+        begin = cells[i].end;
+        if (i > 0)
+            BOOST_CHECK_LE(ems::computeMortonCode(cells[i - 1].soma, aabb),
+                           ems::computeMortonCode(cells[i].soma, aabb));
+
+        // The events of a cell come from the same cell of the report
+        const uint32_t reportCell = order[cells[i].begin] / eventsPerCell;
+        BOOST_CHECK(reportCells[reportCell].soma == cells[i].soma);
+        for (uint32_t j = cells[i].begin; j < cells[i].end; ++j)
+        {
+            BOOST_CHECK_EQUAL(order[j] / eventsPerCell, reportCell);
+            if (j > cells[i].begin)
+                BOOST_CHECK_LE(
+                    ems::computeMortonCode(events.getPosition(order[j - 1]),
+                                           aabb),
+                    ems::computeMortonCode(events.getPosition(order[j]), aabb));
+        }
+    }
+    BOOST_CHECK_EQUAL(begin, events.getEventsCount());
+}
+
+BOOST_AUTO_TEST_CASE(reorderEvents)
+{
+    ems::CellsEvents referenceCells;
+    ems::EventsAABB aabb;
+    const ems::Events reference = createEvents(referenceCells, aabb);
+    ems::CellsEvents cells;
+    ems::Events events = createEvents(cells, aabb);
+    const ems::EventsOrder order =
+        ems::computeSpatialOrder(events, cells, aabb);
+    events.reorder(order);
+
+    std::vector<float> gathered(order.size());
+    ems::gatherPowers(reference.getPowers(1), order, gathered.data());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        BOOST_REQUIRE(events.getPosition(i) ==
+                      reference.getPosition(order[i]));
+        BOOST_REQUIRE_EQUAL(events.getRadii()[i],
+                            reference.getRadii()[order[i]]);
+        BOOST_REQUIRE_EQUAL(events.getPowers(0)[i],
+                            reference.getPowers(0)[order[i]]);
+        BOOST_REQUIRE_EQUAL(events.getPowers(1)[i], gathered[i]);
+    }
+    for (size_t i = events.getEventsCount();
+         i < events.getPaddedEventsCount(); ++i)
+        BOOST_CHECK_EQUAL(events.getPowers(0)[i], 0.0f);
+
+    ems::Volume referenceVolume(glm::vec3(50.0f), glm::vec3(0.0f), aabb);
+    ems::Volume volume(glm::vec3(50.0f), glm::vec3(0.0f), aabb);
+    computeVolume(reference, referenceVolume);
+    computeVolume(events, volume);
+    // Only the summation order differs
+    const glm::uvec3& size = volume.getSize();
+    const size_t nVoxels = size_t(size.x) * size.y * size.z;
+    float maxValue = 0.0f;
+    for (size_t i = 0; i < nVoxels; ++i)
+        maxValue = std::max(maxValue, std::abs(referenceVolume.getData()[i]));
+    for (size_t i = 0; i < nVoxels; ++i)
+        BOOST_CHECK_SMALL(volume.getData()[i] - referenceVolume.getData()[i],
+                          maxValue * 1e-5f);
+
+    BOOST_CHECK_THROW(events.reorder(ems::EventsOrder(3u)),
+                      std::runtime_error);
+}
@@ -0,0 +1,253 @@
+/* Copyright (c) 2017-2020, EPFL/Blue Brain Project
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim <https://github.com/BlueBrain/EMSim>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <emSim/ThreadPool.h>
+
+#define BOOST_TEST_MODULE threadPool
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+ems::ThreadPool& configurePool(const size_t threads, const bool pin = false)
+{
+    ems::ThreadPoolConfig config;
+    config.threads = threads;
+    config.pinThreads = pin;
+    ems::ThreadPool& pool = ems::ThreadPool::getInstance();
+    pool.configure(config);
+    return pool;
+}
+
+// Boost.Test assertions are not thread safe, so only return the result
+bool runsAllIndicesOnce(ems::ThreadPool& pool, const size_t count)
+{
+    std::vector<std::atomic<size_t>> calls(count);
+    for (auto& call : calls)
+        call = 0u;
+    std::atomic<bool> validThreads(true);
+
+    pool.parallelFor(count, [&](const size_t i, const size_t thread) {
+        ++calls[i];
+        if (thread >= pool.getThreadsCount())
+            validThreads = false;
+    });
+
+    for (const auto& call : calls)
+        if (call != 1u)
+            return false;
+    return validThreads;
+}
+}
+
+BOOST_AUTO_TEST_CASE(allIndicesOnce)
+{
+    for (const size_t threads : {1u, 3u, 8u})
+    {
+        ems::ThreadPool& pool = configurePool(threads);
+        BOOST_CHECK_EQUAL(pool.getThreadsCount(), threads);
+        for (const size_t count : {0u, 1u, 2u, 7u, 1000u})
+            BOOST_CHECK(runsAllIndicesOnce(pool, count));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(unevenWork)
+{
+    ems::ThreadPool& pool = configurePool(4u);
+
+    // All the work is in the first range, the other threads have to steal it
+    std::atomic<size_t> sum(0u);
+    ems::parallelFor(400u, [&](const size_t i) {
+        if (i < 100u)
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        sum += i;
+    });
+    BOOST_CHECK_EQUAL(sum, 399u * 400u / 2u);
+    BOOST_CHECK(runsAllIndicesOnce(pool, 400u));
+}
+
+BOOST_AUTO_TEST_CASE(chunks)
+{
+    configurePool(3u);
+    for (const size_t count : {0u, 1u, 10u, 11u})
+    {
+        std::vector<size_t> hits(count, 0u);
+        std::atomic<bool> validRanges(true);
+        ems::parallelForChunks(count, 5u, [&](const size_t begin,
+                                              const size_t end) {
+            if (begin % 5u != 0u || end <= begin || end - begin > 5u ||
+                end > count)
+            {
+                validRanges = false;
+            }
+            for (size_t i = begin; i < end; ++i)
+                ++hits[i];
+        });
+        BOOST_CHECK(validRanges);
+        BOOST_CHECK(std::all_of(hits.begin(), hits.end(),
+                                [](const size_t hit) { return hit == 1u; }));
+    }
+
+    std::vector<float> source((1u << 20) * 2u + 3u);
+    for (size_t i = 0; i < source.size(); ++i)
+        source[i] = float(i);
+    std::vector<float> destination(source.size(), -1.0f);
+    ems::parallelCopy(destination.data(), source.data(), source.size());
+    BOOST_CHECK(destination == source);
+}
+
+BOOST_AUTO_TEST_CASE(stats)
+{
+    ems::ThreadPool& pool = configurePool(4u);
+    pool.resetStats();
+
+    // All the work is in the first range, it has to be stolen
+    ems::parallelFor(400u, [&](const size_t i) {
+        if (i < 100u)
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+    });
+    ems::parallelFor(3u, [&](size_t) {});
+
+    const std::vector<ems::ThreadStats> stats = pool.getStats();
+    BOOST_REQUIRE_EQUAL(stats.size(), 4u);
+    size_t tasks = 0u;
+    size_t steals = 0u;
+    double busyTime = 0.0;
+    for (const auto& thread : stats)
+    {
+        tasks += thread.tasks;
+        steals += thread.steals;
+        busyTime += thread.busyTime;
+    }
+    BOOST_CHECK_EQUAL(tasks, 403u);
+    BOOST_CHECK_GT(steals, 0u);
+    BOOST_CHECK_GT(busyTime, 0.02);
+
+    pool.resetStats();
+    for (const auto& thread : pool.getStats())
+    {
+        BOOST_CHECK_EQUAL(thread.tasks, 0u);
+        BOOST_CHECK_EQUAL(thread.steals, 0u);
+        BOOST_CHECK_EQUAL(thread.busyTime, 0.0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(nestedLoops)
+{
+    configurePool(4u);
+
+    std::vector<std::atomic<size_t>> calls(10u * 10u);
+    for (auto& call : calls)
+        call = 0u;
+    std::atomic<bool> inWorkers(true);
+    ems::parallelFor(10u, [&](const size_t i) {
+        if (!ems::ThreadPool::isWorkerThread())
+            inWorkers = false;
+        ems::parallelFor(10u, [&](const size_t j) { ++calls[i * 10u + j]; });
+    });
+    for (const auto& call : calls)
+        BOOST_CHECK_EQUAL(call, 1u);
+    BOOST_CHECK(inWorkers);
+    BOOST_CHECK(!ems::ThreadPool::isWorkerThread());
+}
+
+BOOST_AUTO_TEST_CASE(concurrentLoops)
+{
+    ems::ThreadPool& pool = configurePool(3u);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 4; ++i)
+        threads.emplace_back([&] {
+            for (size_t j = 0; j < 20; ++j)
+                BOOST_CHECK(runsAllIndicesOnce(pool, 100u));
+        });
+    for (auto& thread : threads)
+        thread.join();
+}
+
+BOOST_AUTO_TEST_CASE(exceptions)
+{
+    ems::ThreadPool& pool = configurePool(4u);
+
+    std::atomic<size_t> calls(0u);
+    BOOST_CHECK_THROW(ems::parallelFor(100u,
+                                       [&](const size_t i) {
+                                           ++calls;
+                                           if (i == 42u)
+                                               throw std::runtime_error("42");
+                                       }),
+                      std::runtime_error);
+    BOOST_CHECK_EQUAL(calls, 100u);
+
+    // The pool is still usable, but can't be reconfigured from a loop
+    BOOST_CHECK(runsAllIndicesOnce(pool, 100u));
+    BOOST_CHECK_THROW(ems::parallelFor(1u,
+                                       [&](size_t) {
+                                           pool.configure(
+                                               ems::ThreadPoolConfig());
+                                       }),
+                      std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(pinning)
+{
+    ems::ThreadPool& pool = configurePool(5u, true);
+    BOOST_CHECK_EQUAL(pool.getPinnedCPUs().size(), 5u);
+    BOOST_CHECK(runsAllIndicesOnce(pool, 100u));
+
+    configurePool(2u);
+    BOOST_CHECK(pool.getPinnedCPUs().empty());
+    BOOST_CHECK_EQUAL(pool.getDescription(), "2 unpinned");
+}
+
+BOOST_AUTO_TEST_CASE(environment)
+{
+    setenv("EMSIM_THREADS", "5", 1);
+    setenv("EMSIM_PIN_THREADS", "1", 1);
+    setenv("EMSIM_SMT", "0", 1);
+    ems::ThreadPoolConfig config = ems::ThreadPoolConfig::fromEnvironment();
+    BOOST_CHECK_EQUAL(config.threads, 5u);
+    BOOST_CHECK(config.pinThreads);
+    BOOST_CHECK(!config.useSMT);
+
+    for (const char* threads : {"many", "-1", "4x"})
+    {
+        setenv("EMSIM_THREADS", threads, 1);
+        BOOST_CHECK_THROW(ems::ThreadPoolConfig::fromEnvironment(),
+                          std::runtime_error);
+    }
+    setenv("EMSIM_THREADS", "", 1);
+    setenv("EMSIM_PIN_THREADS", "yes", 1);
+    BOOST_CHECK_THROW(ems::ThreadPoolConfig::fromEnvironment(),
+                      std::runtime_error);
+
+    unsetenv("EMSIM_THREADS");
+    unsetenv("EMSIM_PIN_THREADS");
+    unsetenv("EMSIM_SMT");
+    config = ems::ThreadPoolConfig::fromEnvironment();
+    BOOST_CHECK_EQUAL(config.threads, 0u);
+    BOOST_CHECK(!config.pinThreads);
+    BOOST_CHECK(config.useSMT);
+}
@@ -19,9 +19,10 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <algorithm>
 #include <cmath>
 
-#include <emSim/ComputeVolume.h>
+#include <emSim/Kernels.h>
 #include <emSim/Events.h>
 #include <emSim/Volume.h>
 
@@ -30,12 +31,13 @@
 
 void computeLFP(const ems::Events& events, ems::Volume& volume)
 {
-    ispc::ComputeVolume_ispc(events.getFlatPositions(), events.getRadii(),
-                             events.getPowers(), events.getEventsCount(),
-                             volume.getData(), volume.getSize().x, volume.getSize().y,
-                             volume.getSize().z, volume.getVoxelSize().x, volume.getVoxelSize().y,
-                             volume.getVoxelSize().z, volume.getOrigin().x, volume.getOrigin().y, 
-                             volume.getOrigin().y);
+    ems::kernels::computeVolume(events.getPositionsX(), events.getPositionsY(),
+                                events.getPositionsZ(), events.getRadii(),
+                                events.getPowers(), events.getEventsCount(),
+                                volume.getData(), volume.getSize().x, volume.getSize().y,
+                                volume.getSize().z, volume.getVoxelSize().x, volume.getVoxelSize().y,
+                                volume.getVoxelSize().z, volume.getOrigin().x, volume.getOrigin().y, 
+                                volume.getOrigin().y);
 }
 
 BOOST_AUTO_TEST_CASE(computeVolume)
@@ -72,3 +74,192 @@ BOOST_AUTO_TEST_CASE(computeVolume)
     BOOST_CHECK_CLOSE(volume.getData()[240000], 3130.926f, 0.01);
     BOOST_CHECK_CLOSE(volume.getData()[1000000], 3449.999f, 0.01);
 }
+
+BOOST_AUTO_TEST_CASE(computeVolumeOddSize)
+{
+    // A row length that is not a multiple of any SIMD width exercises the
+    // partial vectors at the end of each row.
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(-105.0f, -50.0f, -50.0f), 0.0f);
+    aabb.add(glm::vec3(105.0f, 50.0f, 50.0f), 0.0f);
+    const glm::vec3 resolution(10.0f, 10.0f, 10.0f);
+
+    ems::Volume volume(resolution, glm::vec3(0.0f), aabb);
+    BOOST_CHECK_EQUAL(volume.getSize().x, 21u);
+    BOOST_CHECK_EQUAL(volume.getSize().y, 10u);
+    BOOST_CHECK_EQUAL(volume.getSize().z, 10u);
+
+    ems::Events events(3u);
+    events.addEvent(glm::vec3(-42.0f, 3.0f, -7.0f), 4.0f);
+    events.addEvent(glm::vec3(17.0f, -21.0f, 12.0f), 2.0f);
+    events.addEvent(glm::vec3(63.0f, 30.0f, 25.0f), 8.0f);
+    events.getPowers()[0] = 10.0f;
+    events.getPowers()[1] = 4.0f;
+    events.getPowers()[2] = 7.0f;
+
+    computeLFP(events, volume);
+
+    const glm::uvec3& size = volume.getSize();
+    const glm::vec3& origin = volume.getOrigin();
+    for (uint32_t z = 0; z < size.z; ++z)
+    {
+        for (uint32_t y = 0; y < size.y; ++y)
+        {
+            for (uint32_t x = 0; x < size.x; ++x)
+            {
+                const glm::vec3 voxelPos(origin.x + x * resolution.x,
+                                         origin.y + y * resolution.y,
+                                         origin.z + z * resolution.z);
+                double expected = 0.0;
+                for (size_t i = 0; i < events.getEventsCount(); ++i)
+                {
+                    const glm::vec3 eventPos = events.getPosition(i);
+                    const double dist =
+                        std::max(glm::length(voxelPos - eventPos),
+                                 events.getRadii()[i]);
+                    expected += events.getPowers()[i] / dist;
+                }
+                expected *= 281704.249;
+
+                const size_t index = (z * size.y + y) * size.x + x;
+                BOOST_CHECK_CLOSE(volume.getData()[index], expected, 0.01);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(computeVolumeFrames)
+{
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(-105.0f, -50.0f, -50.0f), 0.0f);
+    aabb.add(glm::vec3(105.0f, 50.0f, 50.0f), 0.0f);
+    const glm::vec3 resolution(10.0f, 10.0f, 10.0f);
+
+    // The frame count is not a multiple of the kernel's frame tile
+    const size_t nFrames = 6u;
+    ems::Events events(3u, nFrames);
+    events.addEvent(glm::vec3(-42.0f, 3.0f, -7.0f), 4.0f);
+    events.addEvent(glm::vec3(17.0f, -21.0f, 12.0f), 2.0f);
+    events.addEvent(glm::vec3(63.0f, 30.0f, 25.0f), 8.0f);
+
+    std::vector<std::unique_ptr<ems::Volume>> volumes;
+    std::vector<float*> volumesData;
+    for (size_t i = 0; i < nFrames; ++i)
+    {
+        for (size_t j = 0; j < events.getEventsCount(); ++j)
+            events.getPowers(i)[j] = 1.0f + i + 2.0f * j;
+        volumes.emplace_back(new ems::Volume(resolution, glm::vec3(0.0f), aabb));
+        volumesData.push_back(volumes.back()->getData());
+    }
+
+    const ems::Volume& volume = *volumes.front();
+    ems::kernels::computeVolumeFrames(
+        events.getPositionsX(), events.getPositionsY(), events.getPositionsZ(),
+        events.getRadii(), events.getPowers(), events.getEventsCount(),
+        events.getPaddedEventsCount(), nFrames, volumesData.data(),
+        volume.getSize().x, volume.getSize().y, volume.getSize().z,
+        resolution.x, resolution.y, resolution.z, volume.getOrigin().x,
+        volume.getOrigin().y, volume.getOrigin().z);
+
+    ems::Volume reference(resolution, glm::vec3(0.0f), aabb);
+    const size_t voxelCount =
+        volume.getSize().x * volume.getSize().y * volume.getSize().z;
+    for (size_t i = 0; i < nFrames; ++i)
+    {
+        ems::kernels::computeVolume(
+            events.getPositionsX(), events.getPositionsY(),
+            events.getPositionsZ(), events.getRadii(), events.getPowers(i),
+            events.getEventsCount(), reference.getData(), volume.getSize().x,
+            volume.getSize().y, volume.getSize().z, resolution.x,
+            resolution.y, resolution.z, volume.getOrigin().x,
+            volume.getOrigin().y, volume.getOrigin().z);
+
+        for (size_t j = 0; j < voxelCount; ++j)
+            BOOST_CHECK_CLOSE(volumes[i]->getData()[j],
+                              reference.getData()[j], 0.001);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(computeVolumeTiles)
+{
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(-105.0f, -50.0f, -50.0f), 0.0f);
+    aabb.add(glm::vec3(105.0f, 50.0f, 50.0f), 0.0f);
+    const glm::vec3 resolution(10.0f, 10.0f, 10.0f);
+
+    ems::Events events(37u);
+    for (size_t i = 0; i < events.getEventsCount(); ++i)
+    {
+        events.addEvent(glm::vec3(-90.0f + 5.0f * i, 40.0f - 2.0f * i,
+                                  float(i % 7) * 10.0f - 30.0f),
+                        1.0f + float(i % 3));
+        events.getPowers()[i] = std::sin(0.5f * i);
+    }
+
+    ems::Volume reference(resolution, glm::vec3(0.0f), aabb);
+    const glm::uvec3& size = reference.getSize();
+    ems::kernels::computeVolume(events.getPositionsX(), events.getPositionsY(),
+                                events.getPositionsZ(), events.getRadii(),
+                                events.getPowers(), events.getEventsCount(),
+                                reference.getData(), size.x, size.y, size.z,
+                                resolution.x, resolution.y, resolution.z,
+                                reference.getOrigin().x, reference.getOrigin().y,
+                                reference.getOrigin().z);
+    const size_t voxelCount = size_t(size.x) * size.y * size.z;
+    float maxValue = 0.0f;
+    for (size_t j = 0; j < voxelCount; ++j)
+        maxValue = std::max(maxValue, std::abs(reference.getData()[j]));
+
+    // The tile and chunk sizes do not divide the volume and event counts
+    const glm::uvec3 tileSizes[] = {glm::uvec3(8, 4, 2), glm::uvec3(5, 3, 7),
+                                    glm::uvec3(0, 0, 1)};
+    const uint32_t chunkSizes[] = {16u, 5u, 0u};
+    for (size_t t = 0; t < 3; ++t)
+    {
+        ems::Volume volume(resolution, glm::vec3(0.0f), aabb);
+        for (size_t i = 0; i < 2; ++i)
+            ems::kernels::computeVolumeTiles(
+                events.getPositionsX(), events.getPositionsY(),
+                events.getPositionsZ(), events.getRadii(), events.getPowers(),
+                events.getEventsCount(), volume.getData(), size.x, size.y,
+                size.z, resolution.x, resolution.y, resolution.z,
+                volume.getOrigin().x, volume.getOrigin().y,
+                volume.getOrigin().z, tileSizes[t].x, tileSizes[t].y,
+                tileSizes[t].z, chunkSizes[t], i == 1);
+
+        // The second call accumulates on top of the first one
+        for (size_t j = 0; j < voxelCount; ++j)
+            BOOST_CHECK_SMALL(volume.getData()[j] -
+                                  2.0f * reference.getData()[j],
+                              maxValue * 1e-5f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(halfPrecision)
+{
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(-105.0f, -50.0f, -50.0f), 0.0f);
+    aabb.add(glm::vec3(105.0f, 50.0f, 50.0f), 0.0f);
+    const glm::vec3 resolution(10.0f, 10.0f, 10.0f);
+
+    ems::Volume volume(resolution, glm::vec3(0.0f), aabb, ems::Precision::fp16);
+    BOOST_CHECK(volume.getPrecision() == ems::Precision::fp16);
+    BOOST_CHECK(!volume.getData());
+    BOOST_REQUIRE(volume.getHalfData());
+    const size_t voxelCount =
+        volume.getSize().x * volume.getSize().y * volume.getSize().z;
+    BOOST_CHECK_EQUAL(volume.getDataSize(), voxelCount * sizeof(uint16_t));
+    BOOST_CHECK_EQUAL(volume.getValue(voxelCount - 1), 0.0f);
+
+    volume.clear(0.1f);
+    BOOST_CHECK_EQUAL(volume.getHalfData()[0], ems::floatToHalf(0.1f));
+    BOOST_CHECK_CLOSE(volume.getValue(voxelCount / 2), 0.1f, 0.05);
+
+    ems::Volume bf16(resolution, glm::vec3(0.0f), aabb, ems::Precision::bf16);
+    bf16.clear(3.0e20f);
+    BOOST_CHECK_CLOSE(bf16.getValue(voxelCount - 1), 3.0e20f, 0.4);
+
+    ems::Volume fp32(resolution, glm::vec3(0.0f), aabb);
+    BOOST_CHECK(!fp32.getHalfData());
+    BOOST_CHECK_EQUAL(fp32.getDataSize(), voxelCount * sizeof(float));
+}
@@ -0,0 +1,235 @@
+/* Copyright (c) 2017, EPFL/Blue Brain Project
+ * All rights reserved. Do not distribute without permission.
+ * Responsible Author: Grigori Chevtchenko <grigori.chevtchenko@epfl.ch>
+ *
+ * This file is part of EMSim
+ * <https://bbpcode.epfl.ch/browse/code/viz/EMSim/>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <random>
+
+#include <emSim/Volume.h>
+#include <emSim/VolumeCodec.h>
+
+#define BOOST_TEST_MODULE volumeCodec
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+const glm::uvec3 size(96u, 80u, 64u);
+const glm::vec3 voxelSize(4.0f, 5.0f, 6.0f);
+const glm::vec3 origin(-10.0f, 20.0f, 30.0f);
+
+// Potential of a few point sources, smooth away from them like an LFP field
+std::vector<float> createField()
+{
+    const glm::vec3 sources[] = {glm::vec3(100.0f, 150.0f, 200.0f),
+                                 glm::vec3(300.0f, 250.0f, 120.0f),
+                                 glm::vec3(200.0f, 50.0f, 300.0f)};
+    const float powers[] = {5.0f, -3.0f, -2.0f};
+
+    std::vector<float> values(size_t(size.x) * size.y * size.z);
+    size_t i = 0;
+    for (uint32_t z = 0; z < size.z; ++z)
+        for (uint32_t y = 0; y < size.y; ++y)
+            for (uint32_t x = 0; x < size.x; ++x, ++i)
+            {
+                const glm::vec3 position = glm::vec3(x, y, z) * voxelSize;
+                for (size_t j = 0; j < 3; ++j)
+                    values[i] +=
+                        powers[j] /
+                        std::max(glm::length(position - sources[j]), 10.0f);
+            }
+    return values;
+}
+
+float getRange(const std::vector<float>& values)
+{
+    const auto range = std::minmax_element(values.begin(), values.end());
+    return *range.second - *range.first;
+}
+
+std::vector<float> decompress(const std::string& data,
+                              ems::CompressedVolumeInfo& info)
+{
+    std::vector<float> values;
+    info = ems::decompressVolume(data.data(), data.size(), values);
+    return values;
+}
+}
+
+BOOST_AUTO_TEST_CASE(smoothField)
+{
+    const std::vector<float> values = createField();
+    ems::CodecConfig config;
+    config.errorBound = 1e-3f;
+    config.relative = true;
+
+    std::string data;
+    const ems::CodecStats stats =
+        ems::compressVolume(values.data(), size, voxelSize, origin, config, data);
+    const float errorBound = config.errorBound * getRange(values);
+
+    BOOST_CHECK_EQUAL(stats.bytes, sizeof(float) * values.size());
+    BOOST_CHECK_EQUAL(stats.storedBytes, data.size());
+    BOOST_TEST_MESSAGE("Compression ratio " << stats.getRatio());
+    BOOST_CHECK_GT(stats.getRatio(), 10.0);
+    BOOST_CHECK_LE(stats.maxError, errorBound);
+
+    ems::CompressedVolumeInfo info;
+    const std::vector<float> result = decompress(data, info);
+    BOOST_CHECK(info.size == size);
+    BOOST_CHECK(info.voxelSize == voxelSize);
+    BOOST_CHECK(info.origin == origin);
+    BOOST_CHECK_CLOSE(info.errorBound, errorBound, 1e-4f);
+    BOOST_REQUIRE_EQUAL(result.size(), values.size());
+
+    float maxError = 0.0f;
+    for (size_t i = 0; i < values.size(); ++i)
+        maxError = std::max(maxError, std::abs(result[i] - values[i]));
+    BOOST_CHECK_EQUAL(maxError, stats.maxError);
+}
+
+BOOST_AUTO_TEST_CASE(absoluteBound)
+{
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<float> values = createField();
+    for (float& value : values)
+        value += 0.01f * distribution(generator);
+
+    // Bricks not dividing the volume
+    ems::CodecConfig config;
+    config.errorBound = 0.002f;
+    config.brickSize = glm::uvec3(13u, 7u, 0u);
+
+    std::string data;
+    const ems::CodecStats stats =
+        ems::compressVolume(values.data(), size, voxelSize, origin, config, data);
+    BOOST_CHECK_LE(stats.maxError, config.errorBound);
+    BOOST_CHECK_GT(stats.getRatio(), 1.0);
+
+    ems::CompressedVolumeInfo info;
+    const std::vector<float> result = decompress(data, info);
+    BOOST_CHECK_EQUAL(info.errorBound, config.errorBound);
+    for (size_t i = 0; i < values.size(); ++i)
+        BOOST_CHECK_LE(std::abs(result[i] - values[i]), config.errorBound);
+}
+
+BOOST_AUTO_TEST_CASE(exactValues)
+{
+    std::vector<float> values = createField();
+    values[10] = std::numeric_limits<float>::quiet_NaN();
+    values[1000] = std::numeric_limits<float>::infinity();
+    values[2000] = 1e30f;
+
+    for (const float errorBound : {0.0f, 1e-4f})
+    {
+        ems::CodecConfig config;
+        config.errorBound = errorBound;
+        config.brickSize = glm::uvec3(16u, 16u, 8u);
+        std::string data;
+        ems::compressVolume(values.data(), size, voxelSize, origin, config,
+                            data);
+
+        ems::CompressedVolumeInfo info;
+        const std::vector<float> result = decompress(data, info);
+        BOOST_CHECK(std::isnan(result[10]));
+        BOOST_CHECK_EQUAL(result[1000], values[1000]);
+        BOOST_CHECK_EQUAL(result[2000], values[2000]);
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            if (i != 10 && i != 1000)
+                BOOST_CHECK_LE(std::abs(result[i] - values[i]), errorBound);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(writeVolume)
+{
+    ems::EventsAABB aabb;
+    aabb.add(glm::vec3(0.0f), 0.0f);
+    aabb.add(glm::vec3(100.0f, 60.0f, 40.0f), 0.0f);
+    ems::Volume volume(glm::vec3(2.0f), glm::vec3(0.0f), aabb,
+                       ems::Precision::fp16);
+    const glm::uvec3& volumeSize = volume.getSize();
+    std::vector<float> values(size_t(volumeSize.x) * volumeSize.y *
+                              volumeSize.z);
+    for (size_t i = 0; i < values.size(); ++i)
+        values[i] = std::sin(0.01f * i);
+    ems::encodeValues(values.data(), values.size(), ems::Precision::fp16,
+                      volume.getHalfData());
+
+    ems::CodecConfig config;
+    config.errorBound = 0.01f;
+    const ems::CodecStats stats =
+        volume.writeToFileCompressed(1.0f, 0.1f, "mA", "volumeCodec", "",
+                                     "", "", config);
+
+    const std::string fileName =
+        "volumeCodec_volume_floats_" + ems::createTimeStepSuffix(1.0f) + ".emz";
+    std::ifstream file(fileName, std::ios::in | std::ios::binary);
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+    BOOST_CHECK_EQUAL(data.size(), stats.storedBytes);
+
+    ems::CompressedVolumeInfo info;
+    const std::vector<float> result = decompress(data, info);
+    BOOST_CHECK(info.size == volumeSize);
+    BOOST_REQUIRE_EQUAL(result.size(), values.size());
+    for (size_t i = 0; i < result.size(); ++i)
+        BOOST_CHECK_LE(std::abs(result[i] - volume.getValue(i)),
+                       config.errorBound);
+
+    std::remove(fileName.c_str());
+    std::remove(("volumeCodec_volume_info_" + ems::createTimeStepSuffix(1.0f) +
+                 ".txt")
+                    .c_str());
+}
+
+BOOST_AUTO_TEST_CASE(errors)
+{
+    const std::vector<float> values = createField();
+    ems::CodecConfig config;
+    config.errorBound = 1e-3f;
+    std::string data;
+    ems::compressVolume(values.data(), size, voxelSize, origin, config, data);
+
+    std::vector<float> result;
+    BOOST_CHECK_THROW(ems::decompressVolume(data.data(), data.size() / 2,
+                                            result),
+                      std::runtime_error);
+    BOOST_CHECK_THROW(ems::decompressVolume(data.data(), 10, result),
+                      std::runtime_error);
+
+    std::string corrupted = data;
+    corrupted[0] = 'X';
+    BOOST_CHECK_THROW(ems::decompressVolume(corrupted.data(),
+                                            corrupted.size(), result),
+                      std::runtime_error);
+
+    corrupted = data;
+    for (size_t i = corrupted.size() / 2; i < corrupted.size() / 2 + 64; ++i)
+        corrupted[i] = char(~corrupted[i]);
+    BOOST_CHECK_THROW(ems::decompressVolume(corrupted.data(),
+                                            corrupted.size(), result),
+                      std::runtime_error);
+}